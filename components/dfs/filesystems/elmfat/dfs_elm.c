@@ -15,6 +15,7 @@
  * 2017-02-13     Hichard      Update Fatfs version to 0.12b, support exFAT.
  * 2017-04-11     Bernard      fix the st_blksize issue.
  * 2017-05-26     Urey         fix f_mount error when mount more fats
+ * 2022-02-24     RT-Thread    access the disk through the block cache.
  */
 
 #include <rtthread.h>
@@ -28,6 +29,7 @@
 
 #include <dfs_fs.h>
 #include <dfs_file.h>
+#include <dfs_bcache.h>
 
 static rt_device_t disk[FF_VOLUMES] = {0};
 
@@ -868,7 +870,7 @@ DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, UINT count)
     rt_size_t result;
     rt_device_t device = disk[drv];
 
-    result = rt_device_read(device, sector, buff, count);
+    result = dfs_bcache_read(device, sector, buff, count);
     if (result == count)
     {
         return RES_OK;
@@ -883,7 +885,7 @@ DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, UINT count)
     rt_size_t result;
     rt_device_t device = disk[drv];
 
-    result = rt_device_write(device, sector, buff, count);
+    result = dfs_bcache_write(device, sector, buff, count);
     if (result == count)
     {
         return RES_OK;
@@ -931,7 +933,9 @@ DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
     }
     else if (ctrl == CTRL_SYNC)
     {
-        rt_device_control(device, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+        /* write back the dirty sectors of cache on fsync and close */
+        if (dfs_bcache_sync(device) != RT_EOK)
+            return RES_ERROR;
     }
     else if (ctrl == CTRL_TRIM)
     {
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#ifndef __DFS_BCACHE_H__
+#define __DFS_BCACHE_H__
+
+#include <dfs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef RT_DFS_USING_BCACHE
+
+struct dfs_bcache_stat
+{
+    rt_uint32_t hits;               /* sectors read from the cache */
+    rt_uint32_t misses;             /* sectors read from the device */
+    rt_uint32_t bypasses;           /* sectors of large requests not cached */
+    rt_uint32_t writebacks;         /* dirty sectors written back */
+    rt_uint32_t device_reads;       /* calls of rt_device_read */
+    rt_uint32_t device_writes;      /* calls of rt_device_write */
+
+    rt_uint32_t blocks;             /* sectors can be cached */
+    rt_uint32_t dirty;              /* dirty sectors in the cache */
+};
+
+int dfs_bcache_attach(rt_device_t device);
+int dfs_bcache_detach(rt_device_t device);
+
+rt_size_t dfs_bcache_read(rt_device_t device, rt_off_t pos, void *buffer, rt_size_t count);
+rt_size_t dfs_bcache_write(rt_device_t device, rt_off_t pos, const void *buffer, rt_size_t count);
+int dfs_bcache_sync(rt_device_t device);
+
+int dfs_bcache_get_stat(rt_device_t device, struct dfs_bcache_stat *stat, rt_bool_t reset);
+
+#else
+
+/* the block device is accessed directly without the cache */
+#define dfs_bcache_read(device, pos, buffer, count)     rt_device_read(device, pos, buffer, count)
+#define dfs_bcache_write(device, pos, buffer, count)    rt_device_write(device, pos, buffer, count)
+#define dfs_bcache_sync(device)                         (rt_device_control(device, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL), RT_EOK)
+
+#endif /* RT_DFS_USING_BCACHE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,662 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ * 2022-02-24     RT-Thread    hold the cache while it's accessed
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <dfs_fs.h>
+#include <dfs_bcache.h>
+#include "dfs_private.h"
+
+/*
+ * The sector cache of block devices shared by the filesystems. The sectors
+ * are kept in a LRU list and found by a hash table. The small requests, which
+ * are the metadata of filesystem mostly, go through the cache, and the large
+ * ones are passed to the device directly. The writes are kept in the cache as
+ * dirty and written back when evicted or synced, with the adjacent dirty
+ * sectors in one device write.
+ *
+ * A cache is held by its attachments and by the accesses in progress, it's
+ * freed when the last of them puts it, so detaching never frees a cache in use.
+ */
+
+struct bcache_block
+{
+    rt_list_t list;                     /* node of LRU list, the head is the latest */
+    struct bcache_block *hash_next;
+    rt_off_t sector;
+    rt_uint8_t valid;
+    rt_uint8_t dirty;
+    rt_uint8_t *data;
+};
+
+struct dfs_bcache
+{
+    rt_device_t device;
+    rt_uint16_t attach_count;           /* the filesystems attached */
+    rt_uint16_t ref_count;              /* the attachments and the accesses in progress */
+    rt_uint32_t sector_size;
+
+    struct rt_mutex lock;
+    rt_list_t lru;
+    struct bcache_block **hash;
+    rt_uint32_t hash_size;
+    struct bcache_block *blocks;
+    rt_uint8_t *bounce;                 /* the dirty sectors written back together */
+
+    struct dfs_bcache_stat stat;
+};
+
+/* the table is changed with dfs_lock held and interrupt disabled, and read with either */
+static struct dfs_bcache *bcache_table[DFS_FILESYSTEMS_MAX];
+
+static int _bcache_index(rt_device_t device)
+{
+    int index;
+
+    for (index = 0; index < DFS_FILESYSTEMS_MAX; index++)
+    {
+        if (bcache_table[index] != RT_NULL && bcache_table[index]->device == device)
+        {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+static struct bcache_block *_bcache_lookup(struct dfs_bcache *cache, rt_off_t sector)
+{
+    struct bcache_block *block;
+
+    for (block = cache->hash[(rt_ubase_t)sector % cache->hash_size]; block != RT_NULL;
+         block = block->hash_next)
+    {
+        if (block->sector == sector)
+        {
+            return block;
+        }
+    }
+
+    return RT_NULL;
+}
+
+static void _bcache_hash_remove(struct dfs_bcache *cache, struct bcache_block *block)
+{
+    struct bcache_block **iter;
+
+    for (iter = &cache->hash[(rt_ubase_t)block->sector % cache->hash_size]; *iter != RT_NULL;
+         iter = &(*iter)->hash_next)
+    {
+        if (*iter == block)
+        {
+            *iter = block->hash_next;
+            break;
+        }
+    }
+    block->hash_next = RT_NULL;
+    block->valid = 0;
+}
+
+static void _bcache_touch(struct dfs_bcache *cache, struct bcache_block *block)
+{
+    rt_list_remove(&block->list);
+    rt_list_insert_after(&cache->lru, &block->list);
+}
+
+/* write back the run of dirty sectors around the block */
+static rt_err_t _bcache_flush_run(struct dfs_bcache *cache, struct bcache_block *block)
+{
+    struct bcache_block *run[RT_DFS_BCACHE_FLUSH_BLKS];
+    struct bcache_block *prev;
+    rt_off_t start = block->sector;
+    rt_uint8_t *buffer;
+    rt_size_t count, index;
+
+    while (start > 0 && (prev = _bcache_lookup(cache, start - 1)) != RT_NULL && prev->dirty)
+    {
+        start --;
+    }
+
+    while (1)
+    {
+        for (count = 0; count < RT_DFS_BCACHE_FLUSH_BLKS; count++)
+        {
+            run[count] = _bcache_lookup(cache, start + count);
+            if (run[count] == RT_NULL || !run[count]->dirty)
+            {
+                break;
+            }
+        }
+        if (count == 0)
+        {
+            break;
+        }
+
+        buffer = run[0]->data;
+        if (count > 1)
+        {
+            buffer = cache->bounce;
+            for (index = 0; index < count; index++)
+            {
+                rt_memcpy(buffer + index * cache->sector_size, run[index]->data, cache->sector_size);
+            }
+        }
+
+        cache->stat.device_writes ++;
+        if (rt_device_write(cache->device, start, buffer, count) != count)
+        {
+            LOG_E("write back sector %d of %s failed.", start, cache->device->parent.name);
+            return -RT_EIO;
+        }
+
+        for (index = 0; index < count; index++)
+        {
+            run[index]->dirty = 0;
+        }
+        cache->stat.dirty -= count;
+        cache->stat.writebacks += count;
+        start += count;
+    }
+
+    return RT_EOK;
+}
+
+/* take the least recently used block for the sector */
+static struct bcache_block *_bcache_alloc(struct dfs_bcache *cache, rt_off_t sector)
+{
+    struct bcache_block *block;
+    rt_ubase_t bucket;
+
+    block = rt_list_entry(cache->lru.prev, struct bcache_block, list);
+    if (block->valid)
+    {
+        if (block->dirty && _bcache_flush_run(cache, block) != RT_EOK)
+        {
+            return RT_NULL;
+        }
+        _bcache_hash_remove(cache, block);
+    }
+
+    bucket = (rt_ubase_t)sector % cache->hash_size;
+    block->sector = sector;
+    block->valid = 1;
+    block->hash_next = cache->hash[bucket];
+    cache->hash[bucket] = block;
+    _bcache_touch(cache, block);
+
+    return block;
+}
+
+static rt_err_t _bcache_sync(struct dfs_bcache *cache)
+{
+    struct bcache_block *block;
+    rt_err_t result = RT_EOK;
+
+    rt_list_for_each_entry(block, &cache->lru, list)
+    {
+        if (cache->stat.dirty == 0)
+        {
+            break;
+        }
+        if (block->dirty && _bcache_flush_run(cache, block) != RT_EOK)
+        {
+            result = -RT_EIO;
+            break;
+        }
+    }
+
+    rt_device_control(cache->device, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+
+    return result;
+}
+
+static void _bcache_free(struct dfs_bcache *cache)
+{
+    rt_mutex_detach(&cache->lock);
+    rt_free(cache->bounce);
+    if (cache->blocks != RT_NULL)
+    {
+        rt_free(cache->blocks[0].data);
+    }
+    rt_free(cache->blocks);
+    rt_free(cache->hash);
+    rt_free(cache);
+}
+
+/* find the cache of the device and hold it, it's released by _bcache_put() */
+static struct dfs_bcache *_bcache_get(rt_device_t device)
+{
+    struct dfs_bcache *cache = RT_NULL;
+    rt_base_t level;
+    int index;
+
+    level = rt_hw_interrupt_disable();
+    index = _bcache_index(device);
+    if (index >= 0)
+    {
+        cache = bcache_table[index];
+        cache->ref_count ++;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return cache;
+}
+
+/* release the cache, the last one writes back the dirty sectors and frees it */
+static void _bcache_put(struct dfs_bcache *cache)
+{
+    rt_base_t level;
+    rt_uint16_t ref_count;
+
+    level = rt_hw_interrupt_disable();
+    ref_count = -- cache->ref_count;
+    rt_hw_interrupt_enable(level);
+
+    if (ref_count > 0)
+    {
+        return;
+    }
+
+    /* the sectors written after detached */
+    if (cache->stat.dirty > 0 && _bcache_sync(cache) != RT_EOK)
+    {
+        LOG_E("%d dirty sectors of %s are lost.", cache->stat.dirty, cache->device->parent.name);
+    }
+    _bcache_free(cache);
+}
+
+/**
+ * This function will attach a sector cache to the block device, the RAM of
+ * cache is limited by RT_DFS_BCACHE_SIZE. The device is accessed directly if
+ * it is not a block device or the cache can not be allocated.
+ *
+ * @param device the opened block device.
+ *
+ * @return 0 on successful or -1 on failed.
+ */
+int dfs_bcache_attach(rt_device_t device)
+{
+    struct rt_device_blk_geometry geometry;
+    struct dfs_bcache *cache;
+    rt_uint8_t *data;
+    rt_uint32_t count, index;
+    rt_base_t level;
+    int slot, result = -1;
+
+    if (device == RT_NULL || device->type != RT_Device_Class_Block)
+    {
+        return -1;
+    }
+
+    rt_memset(&geometry, 0, sizeof(geometry));
+    rt_device_control(device, RT_DEVICE_CTRL_BLK_GETGEOME, &geometry);
+    if (geometry.bytes_per_sector == 0)
+    {
+        return -1;
+    }
+    count = RT_DFS_BCACHE_SIZE / geometry.bytes_per_sector;
+    if (count < RT_DFS_BCACHE_FLUSH_BLKS)
+    {
+        LOG_W("the cache of %d bytes is too small for %s.", RT_DFS_BCACHE_SIZE, device->parent.name);
+        return -1;
+    }
+
+    dfs_lock();
+    slot = _bcache_index(device);
+    if (slot >= 0)
+    {
+        level = rt_hw_interrupt_disable();
+        bcache_table[slot]->attach_count ++;
+        bcache_table[slot]->ref_count ++;
+        rt_hw_interrupt_enable(level);
+        result = 0;
+        goto __exit;
+    }
+    for (slot = 0; slot < DFS_FILESYSTEMS_MAX && bcache_table[slot] != RT_NULL; slot++);
+    if (slot == DFS_FILESYSTEMS_MAX)
+    {
+        goto __exit;
+    }
+
+    cache = (struct dfs_bcache *)rt_calloc(1, sizeof(struct dfs_bcache));
+    if (cache == RT_NULL)
+    {
+        goto __exit;
+    }
+    cache->device = device;
+    cache->attach_count = 1;
+    cache->ref_count = 1;
+    cache->sector_size = geometry.bytes_per_sector;
+    cache->hash_size = count;
+    cache->stat.blocks = count;
+    rt_mutex_init(&cache->lock, "bcache", RT_IPC_FLAG_PRIO);
+    rt_list_init(&cache->lru);
+
+    cache->hash = (struct bcache_block **)rt_calloc(count, sizeof(struct bcache_block *));
+    cache->blocks = (struct bcache_block *)rt_calloc(count, sizeof(struct bcache_block));
+    cache->bounce = (rt_uint8_t *)rt_malloc(RT_DFS_BCACHE_FLUSH_BLKS * cache->sector_size);
+    data = (rt_uint8_t *)rt_malloc(count * cache->sector_size);
+    if (cache->hash == RT_NULL || cache->blocks == RT_NULL || cache->bounce == RT_NULL || data == RT_NULL)
+    {
+        LOG_E("no memory for the cache of %s.", device->parent.name);
+        rt_free(data);
+        rt_free(cache->blocks);
+        cache->blocks = RT_NULL;
+        _bcache_free(cache);
+        goto __exit;
+    }
+
+    for (index = 0; index < count; index++)
+    {
+        cache->blocks[index].data = data + index * cache->sector_size;
+        rt_list_insert_before(&cache->lru, &cache->blocks[index].list);
+    }
+    level = rt_hw_interrupt_disable();
+    bcache_table[slot] = cache;
+    rt_hw_interrupt_enable(level);
+    result = 0;
+
+__exit:
+    dfs_unlock();
+
+    return result;
+}
+
+/**
+ * This function will write back the dirty sectors and detach the cache from
+ * the block device. The cache is freed when the accesses in progress are done.
+ *
+ * @param device the block device.
+ *
+ * @return 0 on successful or -1 on failed.
+ */
+int dfs_bcache_detach(rt_device_t device)
+{
+    struct dfs_bcache *cache;
+    rt_base_t level;
+    int index, result = 0;
+
+    dfs_lock();
+    index = _bcache_index(device);
+    if (index < 0)
+    {
+        dfs_unlock();
+        return -1;
+    }
+
+    cache = bcache_table[index];
+    level = rt_hw_interrupt_disable();
+    if (-- cache->attach_count > 0)
+    {
+        cache->ref_count --;
+        rt_hw_interrupt_enable(level);
+        dfs_unlock();
+        return 0;
+    }
+    /* no more accesses find the cache */
+    bcache_table[index] = RT_NULL;
+    rt_hw_interrupt_enable(level);
+    dfs_unlock();
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    if (_bcache_sync(cache) != RT_EOK)
+    {
+        LOG_E("%d dirty sectors of %s are lost.", cache->stat.dirty, device->parent.name);
+        result = -1;
+    }
+    rt_mutex_release(&cache->lock);
+    _bcache_put(cache);
+
+    return result;
+}
+
+/**
+ * This function will read the sectors of block device through the cache.
+ *
+ * @param device the block device.
+ * @param pos the first sector to read.
+ * @param buffer the buffer to save the data.
+ * @param count the number of sectors.
+ *
+ * @return the number of sectors read.
+ */
+rt_size_t dfs_bcache_read(rt_device_t device, rt_off_t pos, void *buffer, rt_size_t count)
+{
+    struct dfs_bcache *cache;
+    struct bcache_block *block;
+    rt_uint8_t *ptr = (rt_uint8_t *)buffer;
+    rt_size_t done = 0, run, index;
+
+    cache = _bcache_get(device);
+    if (cache == RT_NULL)
+    {
+        return rt_device_read(device, pos, buffer, count);
+    }
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    while (done < count)
+    {
+        block = _bcache_lookup(cache, pos + done);
+        if (block != RT_NULL)
+        {
+            rt_memcpy(ptr + done * cache->sector_size, block->data, cache->sector_size);
+            _bcache_touch(cache, block);
+            cache->stat.hits ++;
+            done ++;
+            continue;
+        }
+
+        /* the missed sectors in a run are read by one device read */
+        for (run = 1; done + run < count && _bcache_lookup(cache, pos + done + run) == RT_NULL; run++);
+        cache->stat.misses += run;
+        cache->stat.device_reads ++;
+        if (rt_device_read(device, pos + done, ptr + done * cache->sector_size, run) != run)
+        {
+            break;
+        }
+
+        if (count > RT_DFS_BCACHE_BYPASS_BLKS)
+        {
+            cache->stat.bypasses += run;
+        }
+        else
+        {
+            for (index = 0; index < run; index++)
+            {
+                block = _bcache_alloc(cache, pos + done + index);
+                if (block == RT_NULL)
+                {
+                    break;
+                }
+                rt_memcpy(block->data, ptr + (done + index) * cache->sector_size, cache->sector_size);
+            }
+        }
+        done += run;
+    }
+    rt_mutex_release(&cache->lock);
+    _bcache_put(cache);
+
+    return done;
+}
+
+/**
+ * This function will write the sectors of block device through the cache. The
+ * small writes are kept in the cache until they are evicted or synced.
+ *
+ * @param device the block device.
+ * @param pos the first sector to write.
+ * @param buffer the data to write.
+ * @param count the number of sectors.
+ *
+ * @return the number of sectors written.
+ */
+rt_size_t dfs_bcache_write(rt_device_t device, rt_off_t pos, const void *buffer, rt_size_t count)
+{
+    struct dfs_bcache *cache;
+    struct bcache_block *block;
+    const rt_uint8_t *ptr = (const rt_uint8_t *)buffer;
+    rt_size_t done;
+
+    cache = _bcache_get(device);
+    if (cache == RT_NULL)
+    {
+        return rt_device_write(device, pos, buffer, count);
+    }
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    if (count > RT_DFS_BCACHE_BYPASS_BLKS)
+    {
+        cache->stat.bypasses += count;
+        cache->stat.device_writes ++;
+        count = rt_device_write(device, pos, buffer, count);
+
+        /* the cached sectors are the same as the device now */
+        for (done = 0; done < count; done++)
+        {
+            block = _bcache_lookup(cache, pos + done);
+            if (block != RT_NULL)
+            {
+                rt_memcpy(block->data, ptr + done * cache->sector_size, cache->sector_size);
+                if (block->dirty)
+                {
+                    block->dirty = 0;
+                    cache->stat.dirty --;
+                }
+            }
+        }
+        rt_mutex_release(&cache->lock);
+        _bcache_put(cache);
+
+        return count;
+    }
+
+    for (done = 0; done < count; done++)
+    {
+        block = _bcache_lookup(cache, pos + done);
+        if (block != RT_NULL)
+        {
+            _bcache_touch(cache, block);
+        }
+        else if ((block = _bcache_alloc(cache, pos + done)) == RT_NULL)
+        {
+            break;
+        }
+
+        rt_memcpy(block->data, ptr + done * cache->sector_size, cache->sector_size);
+        if (!block->dirty)
+        {
+            block->dirty = 1;
+            cache->stat.dirty ++;
+        }
+    }
+    rt_mutex_release(&cache->lock);
+    _bcache_put(cache);
+
+    return done;
+}
+
+/**
+ * This function will write back the dirty sectors and sync the block device.
+ *
+ * @param device the block device.
+ *
+ * @return RT_EOK on successful or -RT_EIO on failed.
+ */
+int dfs_bcache_sync(rt_device_t device)
+{
+    struct dfs_bcache *cache;
+    rt_err_t result;
+
+    cache = _bcache_get(device);
+    if (cache == RT_NULL)
+    {
+        /* not all of the block devices support sync */
+        rt_device_control(device, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+        return RT_EOK;
+    }
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    result = _bcache_sync(cache);
+    rt_mutex_release(&cache->lock);
+    _bcache_put(cache);
+
+    return result;
+}
+
+/**
+ * This function will get the statistics of the cache of block device.
+ *
+ * @param device the block device.
+ * @param stat the statistics returned.
+ * @param reset whether to clear the counters after read.
+ *
+ * @return 0 on successful or -1 on failed.
+ */
+int dfs_bcache_get_stat(rt_device_t device, struct dfs_bcache_stat *stat, rt_bool_t reset)
+{
+    struct dfs_bcache *cache;
+
+    if (stat == RT_NULL || (cache = _bcache_get(device)) == RT_NULL)
+    {
+        return -1;
+    }
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    *stat = cache->stat;
+    if (reset)
+    {
+        cache->stat.hits = 0;
+        cache->stat.misses = 0;
+        cache->stat.bypasses = 0;
+        cache->stat.writebacks = 0;
+        cache->stat.device_reads = 0;
+        cache->stat.device_writes = 0;
+    }
+    rt_mutex_release(&cache->lock);
+    _bcache_put(cache);
+
+    return 0;
+}
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+
+static void bcache_stat(int argc, char **argv)
+{
+    struct dfs_bcache_stat stat;
+    rt_device_t device;
+    rt_base_t level;
+    rt_uint32_t total;
+    int index;
+
+    rt_kprintf("device   hit      miss     bypass   wback    dread    dwrite   dirty/blocks\n");
+    rt_kprintf("-------- -------- -------- -------- -------- -------- -------- ------------\n");
+    for (index = 0; index < DFS_FILESYSTEMS_MAX; index++)
+    {
+        level = rt_hw_interrupt_disable();
+        device = bcache_table[index] != RT_NULL ? bcache_table[index]->device : RT_NULL;
+        rt_hw_interrupt_enable(level);
+
+        if (device == RT_NULL || dfs_bcache_get_stat(device, &stat, argc > 1) != 0)
+        {
+            continue;
+        }
+
+        total = stat.hits + stat.misses;
+        rt_kprintf("%-8.*s %-8d %-8d %-8d %-8d %-8d %-8d %d/%d, hit %d%%\n", RT_NAME_MAX,
+                   device->parent.name, stat.hits, stat.misses, stat.bypasses, stat.writebacks,
+                   stat.device_reads, stat.device_writes, stat.dirty, stat.blocks,
+                   total ? (rt_uint32_t)((rt_uint64_t)stat.hits * 100 / total) : 0);
+    }
+}
+MSH_CMD_EXPORT(bcache_stat, show the statistics of block cache: bcache_stat [reset]);
+#endif /* RT_USING_FINSH */
@@ -10,10 +10,14 @@
  * 2011-03-12     Bernard      fix the filesystem lookup issue.
  * 2017-11-30     Bernard      fix the filesystem_operation_table issue.
  * 2017-12-05     Bernard      fix the fs type search issue in mkfs.
+ * 2022-02-24     RT-Thread    attach the block cache to the mounted device.
  */
 
 #include <dfs_fs.h>
 #include <dfs_file.h>
+#ifdef RT_DFS_USING_BCACHE
+#include <dfs_bcache.h>
+#endif /* RT_DFS_USING_BCACHE */
 #include "dfs_private.h"
 
 /**
@@ -327,6 +331,10 @@ int dfs_mount(const char   *device_name,
 
             goto err1;
         }
+#ifdef RT_DFS_USING_BCACHE
+        /* the block device is accessed directly if no cache is attached */
+        dfs_bcache_attach(dev_id);
+#endif /* RT_DFS_USING_BCACHE */
     }
 
     /* call mount of this filesystem */
@@ -334,7 +342,12 @@ int dfs_mount(const char   *device_name,
     {
         /* close device */
         if (dev_id != NULL)
+        {
+#ifdef RT_DFS_USING_BCACHE
+            dfs_bcache_detach(dev_id);
+#endif /* RT_DFS_USING_BCACHE */
             rt_device_close(fs->dev_id);
+        }
 
         /* mount failed */
         dfs_lock();
@@ -397,7 +410,13 @@ int dfs_unmount(const char *specialfile)
 
     /* close device, but do not check the status of device */
     if (fs->dev_id != NULL)
+    {
+#ifdef RT_DFS_USING_BCACHE
+        /* write back the dirty sectors before the device is closed */
+        dfs_bcache_detach(fs->dev_id);
+#endif /* RT_DFS_USING_BCACHE */
         rt_device_close(fs->dev_id);
+    }
 
     if (fs->path != NULL)
         rt_free(fs->path);
@@ -584,7 +603,13 @@ int dfs_unmount_device(rt_device_t dev)
 
     /* close device, but do not check the status of device */
     if (fs->dev_id != NULL)
+    {
+#ifdef RT_DFS_USING_BCACHE
+        /* write back the dirty sectors before the device is closed */
+        dfs_bcache_detach(fs->dev_id);
+#endif /* RT_DFS_USING_BCACHE */
         rt_device_close(fs->dev_id);
+    }
 
     if (fs->path != NULL)
         rt_free(fs->path);
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author            Notes
  * 2017-12-23     Bernard           first version
+ * 2022-02-24     RT-Thread         add clock_cpu_count
  */
 
 #include <rtdevice.h>
@@ -43,6 +44,21 @@ uint64_t clock_cpu_gettime(void)
     return 0;
 }
 
+/**
+ * The clock_cpu_count() function shall return the current value of cpu time tick
+ * like clock_cpu_gettime(), but it returns 0 without setting errno if there is no
+ * cputime ops. It is used in the scheduler and interrupt paths.
+ *
+ * @return the cpu tick
+ */
+uint64_t clock_cpu_count(void)
+{
+    if (_cputime_ops)
+        return _cputime_ops->cputime_gettime();
+
+    return 0;
+}
+
 /**
  * The clock_cpu_microsecond() fucntion shall return the microsecond according to
  * cpu_tick parameter.
@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-19     RT-Thread    first version
+ * 2022-02-24     RT-Thread    convert the clock count by fixed-point, reject zero period
+ * 2022-02-24     RT-Thread    re-program hwtimer on stop of the first timer, add rt_hrtimer_ns_to_tick()
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+
+#define DBG_TAG    "hrtimer"
+#define DBG_LVL    DBG_WARNING
+#include <rtdbg.h>
+
+#ifndef RT_HRTIMER_DEVICE_NAME
+#define RT_HRTIMER_DEVICE_NAME  "timer0"
+#endif /* RT_HRTIMER_DEVICE_NAME */
+
+/* the longest interval of one hwtimer event, in microsecond */
+#define HRTIMER_EVENT_MAX_US    (1000000)
+
+/*
+ * The hrtimers are sorted by the timeout clock count of cputime, the
+ * one-shot hwtimer is always programmed for the first hrtimer.
+ */
+static rt_list_t _hrtimer_list = RT_LIST_OBJECT_INIT(_hrtimer_list);
+static rt_device_t _hrtimer_dev = RT_NULL;
+/*
+ * The clock count and nanosecond are converted by the 32-bit multipliers and
+ * shifts calculated on init, no floating point is used in interrupt context.
+ */
+static rt_uint32_t _hrtimer_ns_mult = 0, _hrtimer_ns_shift = 0;
+static rt_uint32_t _hrtimer_cnt_mult = 0, _hrtimer_cnt_shift = 0;
+
+/* (value * mult) >> shift without the overflow of 96-bit product */
+rt_inline rt_uint64_t _hrtimer_scale(rt_uint64_t value, rt_uint32_t mult, rt_uint32_t shift)
+{
+    rt_uint64_t lo = (value & 0xffffffffULL) * mult;
+    rt_uint64_t hi = (value >> 32) * mult;
+
+    if (shift >= 32)
+    {
+        return (hi + (lo >> 32)) >> (shift - 32);
+    }
+
+    return (hi << (32 - shift)) + (lo >> shift);
+}
+
+rt_inline rt_uint64_t _hrtimer_ns_to_cnt(rt_uint64_t ns)
+{
+    return _hrtimer_scale(ns, _hrtimer_cnt_mult, _hrtimer_cnt_shift);
+}
+
+rt_inline rt_uint64_t _hrtimer_cnt_to_ns(rt_uint64_t cnt)
+{
+    return _hrtimer_scale(cnt, _hrtimer_ns_mult, _hrtimer_ns_shift);
+}
+
+/**
+ * @brief Calculate the most precise multiplier and shift for a scale factor.
+ *
+ * @param factor is the scale factor, it shall be less than 2^32
+ *
+ * @param mult is the multiplier in 32-bit
+ *
+ * @param shift is the shift of the multiplier, 0 - 63
+ *
+ * @return RT_EOK on OK, -RT_ERROR if the factor is out of range.
+ */
+static rt_err_t _hrtimer_calc_mult(double factor, rt_uint32_t *mult, rt_uint32_t *shift)
+{
+    rt_uint32_t sft = 63;
+
+    while (sft > 0 && factor * (double)(1ULL << sft) >= 4294967296.0)
+    {
+        sft --;
+    }
+
+    factor = factor * (double)(1ULL << sft) + 0.5;
+    if (factor < 1.0 || factor >= 4294967296.0)
+    {
+        return -RT_ERROR;
+    }
+
+    *mult = (rt_uint32_t)factor;
+    *shift = sft;
+
+    return RT_EOK;
+}
+
+/**
+ * @brief Program the hwtimer for the first hrtimer, it's invoked with
+ *        interrupt disabled.
+ *
+ * @param now is the current clock count
+ */
+static void _hrtimer_program(rt_uint64_t now)
+{
+    struct rt_hrtimer *timer;
+    rt_hwtimerval_t tv;
+    rt_uint64_t us;
+
+    if (rt_list_isempty(&_hrtimer_list))
+    {
+        rt_device_control(_hrtimer_dev, HWTIMER_CTRL_STOP, RT_NULL);
+        return;
+    }
+
+    timer = rt_list_entry(_hrtimer_list.next, struct rt_hrtimer, list);
+    if ((rt_int64_t)(timer->timeout - now) > 0)
+    {
+        /* round up, the event shall not come before the timeout */
+        us = (_hrtimer_cnt_to_ns(timer->timeout - now) + 999) / 1000;
+    }
+    else
+    {
+        us = 1;
+    }
+
+    /* a long interval is split to several events */
+    if (us > HRTIMER_EVENT_MAX_US)
+    {
+        us = HRTIMER_EVENT_MAX_US;
+    }
+
+    tv.sec  = us / 1000000;
+    tv.usec = us % 1000000;
+    rt_device_write(_hrtimer_dev, 0, &tv, sizeof(tv));
+}
+
+/**
+ * @brief Insert the timer to the hrtimer list in the order of timeout.
+ *
+ * @param timer is the timer to be inserted
+ *
+ * @return RT_TRUE if the timer is the first one of the list
+ */
+static rt_bool_t _hrtimer_insert(struct rt_hrtimer *timer)
+{
+    rt_list_t *node;
+
+    for (node = _hrtimer_list.next; node != &_hrtimer_list; node = node->next)
+    {
+        struct rt_hrtimer *t = rt_list_entry(node, struct rt_hrtimer, list);
+
+        /* the timer started early will be called early */
+        if ((rt_int64_t)(t->timeout - timer->timeout) > 0)
+        {
+            break;
+        }
+    }
+    rt_list_insert_before(node, &(timer->list));
+
+    return _hrtimer_list.next == &(timer->list);
+}
+
+/**
+ * @brief The timeout indication of hwtimer, it calls the timeout functions of
+ *        the expired hrtimers in interrupt context.
+ */
+static rt_err_t _hrtimer_timeout(rt_device_t dev, rt_size_t size)
+{
+    struct rt_hrtimer *timer;
+    register rt_base_t level;
+    rt_uint64_t now;
+
+    level = rt_hw_interrupt_disable();
+
+    now = clock_cpu_gettime();
+    while (!rt_list_isempty(&_hrtimer_list))
+    {
+        timer = rt_list_entry(_hrtimer_list.next, struct rt_hrtimer, list);
+        if ((rt_int64_t)(now - timer->timeout) < 0)
+        {
+            break;
+        }
+
+        rt_list_remove(&(timer->list));
+        if (timer->flag & RT_TIMER_FLAG_PERIODIC)
+        {
+            timer->timeout += timer->period;
+            /* the missed periods are skipped rather than called back to back */
+            if ((rt_int64_t)(now - timer->timeout) >= 0)
+            {
+                timer->timeout = now + timer->period;
+            }
+            _hrtimer_insert(timer);
+        }
+        else
+        {
+            timer->flag &= ~RT_TIMER_FLAG_ACTIVATED;
+        }
+
+        timer->timeout_func(timer->parameter);
+
+        /* the timeout function may take a while */
+        now = clock_cpu_gettime();
+    }
+
+    _hrtimer_program(now);
+
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+/**
+ * @brief This function will initialize a high resolution timer.
+ *
+ * @param timer is the point of timer
+ *
+ * @param timeout is the callback of timer, which is invoked in interrupt context
+ *
+ * @param parameter is the param of the callback
+ *
+ * @param flag is the flag of timer, RT_TIMER_FLAG_ONE_SHOT or RT_TIMER_FLAG_PERIODIC
+ */
+void rt_hrtimer_init(rt_hrtimer_t timer,
+                     void (*timeout)(void *parameter),
+                     void       *parameter,
+                     rt_uint8_t  flag)
+{
+    RT_ASSERT(timer != RT_NULL);
+    RT_ASSERT(timeout != RT_NULL);
+
+    rt_list_init(&(timer->list));
+    timer->flag = flag & ~RT_TIMER_FLAG_ACTIVATED;
+    timer->timeout_func = timeout;
+    timer->parameter = parameter;
+    timer->period = 0;
+    timer->timeout = 0;
+}
+RTM_EXPORT(rt_hrtimer_init);
+
+/**
+ * @brief This function will start a high resolution timer.
+ *
+ * @param timer is the timer to be started
+ *
+ * @param ns is the timeout, and the interval of periodic timer, in nanosecond
+ *
+ * @return RT_EOK on OK, -RT_ENOSYS if there is no hwtimer for hrtimer,
+ *         -RT_EINVAL if the interval of periodic timer is less than one clock count.
+ */
+rt_err_t rt_hrtimer_start(rt_hrtimer_t timer, rt_uint64_t ns)
+{
+    register rt_base_t level;
+    rt_uint64_t period, now;
+
+    RT_ASSERT(timer != RT_NULL);
+
+    if (_hrtimer_dev == RT_NULL)
+    {
+        return -RT_ENOSYS;
+    }
+
+    /* a periodic timer of zero interval would never leave the interrupt */
+    period = _hrtimer_ns_to_cnt(ns);
+    if ((timer->flag & RT_TIMER_FLAG_PERIODIC) && period == 0)
+    {
+        return -RT_EINVAL;
+    }
+
+    level = rt_hw_interrupt_disable();
+
+    rt_list_remove(&(timer->list));
+
+    now = clock_cpu_gettime();
+    timer->period = period;
+    timer->timeout = now + timer->period;
+    timer->flag |= RT_TIMER_FLAG_ACTIVATED;
+
+    /* the hwtimer is re-programmed only for a new first timer */
+    if (_hrtimer_insert(timer))
+    {
+        _hrtimer_program(now);
+    }
+
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_hrtimer_start);
+
+/**
+ * @brief This function will stop a high resolution timer.
+ *
+ * @param timer is the timer to be stopped
+ *
+ * @return RT_EOK on OK, -RT_ERROR if the timer is not started.
+ */
+rt_err_t rt_hrtimer_stop(rt_hrtimer_t timer)
+{
+    register rt_base_t level;
+    rt_bool_t first;
+
+    RT_ASSERT(timer != RT_NULL);
+
+    if (!(timer->flag & RT_TIMER_FLAG_ACTIVATED))
+    {
+        return -RT_ERROR;
+    }
+
+    level = rt_hw_interrupt_disable();
+
+    first = (_hrtimer_list.next == &(timer->list));
+    rt_list_remove(&(timer->list));
+    timer->flag &= ~RT_TIMER_FLAG_ACTIVATED;
+
+    /* the hwtimer follows the new first timer, or stops for an empty list */
+    if (first && _hrtimer_dev != RT_NULL)
+    {
+        _hrtimer_program(clock_cpu_gettime());
+    }
+
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_hrtimer_stop);
+
+/**
+ * @brief This function will return the cputime clock in nanosecond.
+ *
+ * @return the nanoseconds of cputime clock
+ */
+rt_uint64_t rt_hrtimer_get_ns(void)
+{
+    return _hrtimer_cnt_to_ns(clock_cpu_gettime());
+}
+RTM_EXPORT(rt_hrtimer_get_ns);
+
+/**
+ * @brief This function will convert nanoseconds to OS ticks, for the timeout
+ *        falls back to the tick timer without hrtimer.
+ *
+ * @param ns is the nanoseconds
+ *
+ * @return the ticks rounded up, no more than the longest timeout of timer
+ */
+rt_tick_t rt_hrtimer_ns_to_tick(rt_uint64_t ns)
+{
+    rt_uint64_t tick;
+
+    /* the seconds and the rest are converted apart, no overflow of 64-bit */
+    tick = ns / 1000000000ULL * RT_TICK_PER_SECOND;
+    tick += ((ns % 1000000000ULL) * RT_TICK_PER_SECOND + 999999999ULL) / 1000000000ULL;
+
+    if (tick >= RT_TICK_MAX / 2)
+    {
+        tick = RT_TICK_MAX / 2 - 1;
+    }
+
+    return (rt_tick_t)tick;
+}
+RTM_EXPORT(rt_hrtimer_ns_to_tick);
+
+/**
+ * @brief This function will initialize the hrtimer with the cputime clock and
+ *        the hwtimer device RT_HRTIMER_DEVICE_NAME.
+ */
+int rt_hrtimer_system_init(void)
+{
+    rt_hwtimer_mode_t mode = HWTIMER_MODE_ONESHOT;
+    rt_device_t dev;
+    float res;
+
+    /* the nanosecond of one clock count */
+    res = clock_cpu_getres();
+    if (res <= 0)
+    {
+        LOG_E("no cputime clock for hrtimer");
+        return -RT_ENOSYS;
+    }
+
+    if (_hrtimer_calc_mult(res, &_hrtimer_ns_mult, &_hrtimer_ns_shift) != RT_EOK ||
+        _hrtimer_calc_mult(1.0 / res, &_hrtimer_cnt_mult, &_hrtimer_cnt_shift) != RT_EOK)
+    {
+        LOG_E("cputime resolution %d ns is not supported", (int)res);
+        return -RT_ENOSYS;
+    }
+
+    dev = rt_device_find(RT_HRTIMER_DEVICE_NAME);
+    if (dev == RT_NULL)
+    {
+        LOG_E("hwtimer %s not found", RT_HRTIMER_DEVICE_NAME);
+        return -RT_ENOSYS;
+    }
+
+    if (rt_device_open(dev, RT_DEVICE_OFLAG_RDWR) != RT_EOK)
+    {
+        LOG_E("open hwtimer %s failed", RT_HRTIMER_DEVICE_NAME);
+        return -RT_ERROR;
+    }
+
+    rt_device_control(dev, HWTIMER_CTRL_MODE_SET, &mode);
+    rt_device_set_rx_indicate(dev, _hrtimer_timeout);
+    _hrtimer_dev = dev;
+
+    return RT_EOK;
+}
+INIT_COMPONENT_EXPORT(rt_hrtimer_system_init);
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author            Notes
  * 2017-12-23     Bernard           first version
+ * 2022-02-24     RT-Thread         add clock_cpu_count
  */
 
 #ifndef CPUTIME_H__
@@ -21,6 +22,7 @@ struct rt_clock_cputime_ops
 
 float    clock_cpu_getres(void);
 uint64_t clock_cpu_gettime(void);
+uint64_t clock_cpu_count(void);
 
 uint32_t clock_cpu_microsecond(uint32_t cpu_tick);
 uint32_t clock_cpu_millisecond(uint32_t cpu_tick);
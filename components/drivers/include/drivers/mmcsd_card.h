@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author        Notes
  * 2011-07-25     weety     first version
+ * 2022-02-24     RT-Thread    add the request queue of block devices
  */
 
 #ifndef __MMCSD_CARD_H__
@@ -129,6 +130,10 @@ struct rt_sdio_function {
 
 
 
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+struct mmcsd_blk_queue;
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
+
 struct rt_mmcsd_card {
     struct rt_mmcsd_host *host;
     rt_uint32_t rca;        /* card addr */
@@ -162,6 +167,9 @@ struct rt_mmcsd_card {
     struct rt_sdio_cis     cis;  /* common tuple info */
     struct rt_sdio_function *sdio_function[SDIO_MAX_FUNCTIONS + 1]; /* SDIO functions (devices) */
     rt_list_t blk_devices;  /* for block device list */
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    struct mmcsd_blk_queue *blk_queue;  /* request queue shared by the block devices */
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
 };
 
 #ifdef __cplusplus
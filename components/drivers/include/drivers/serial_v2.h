@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author           Notes
  * 2021-06-01     KyleChan     first version
+ * 2022-02-24     RT-Thread    add the DMA ping-pong receive and the buffer chain transmit
  */
 
 #ifndef __SERIAL_V2_H__
@@ -64,11 +65,20 @@
 
 #define RT_DEVICE_CHECK_OPTMODE         0x20
 
+#define RT_SERIAL_CTRL_GET_STAT         0x21    /* get the struct rt_serial_stat */
+#define RT_SERIAL_CTRL_TX_CHAIN         0x22    /* submit a chain of struct rt_serial_tx_desc */
+#define RT_SERIAL_CTRL_RX_PEEK          0x23    /* peek the received data in place by struct rt_serial_span */
+#define RT_SERIAL_CTRL_RX_CONSUME       0x24    /* consume the size of data peeked */
+
 #define RT_SERIAL_EVENT_RX_IND          0x01    /* Rx indication */
 #define RT_SERIAL_EVENT_TX_DONE         0x02    /* Tx complete   */
 #define RT_SERIAL_EVENT_RX_DMADONE      0x03    /* Rx DMA transfer done */
 #define RT_SERIAL_EVENT_TX_DMADONE      0x04    /* Tx DMA transfer done */
 #define RT_SERIAL_EVENT_RX_TIMEOUT      0x05    /* Rx timeout    */
+#define RT_SERIAL_EVENT_RX_DMA_HT       0x06    /* Rx DMA half transfer, the first half is full */
+#define RT_SERIAL_EVENT_RX_DMA_TC       0x07    /* Rx DMA transfer complete, the second half is full */
+#define RT_SERIAL_EVENT_RX_IDLE         0x08    /* Rx line idle, with the DMA position << 8 */
+#define RT_SERIAL_EVENT_RX_DMA_ERR      0x09    /* Rx DMA or line error, the DMA is restarted */
 
 #define RT_SERIAL_ERR_OVERRUN           0x01
 #define RT_SERIAL_ERR_FRAMING           0x02
@@ -111,6 +121,47 @@ struct serial_configure
     rt_uint32_t reserved                :6;
 };
 
+struct rt_serial_device;
+
+/*
+ * Serial statistics of the DMA ping-pong mode
+ */
+struct rt_serial_stat
+{
+    rt_uint32_t rx_bytes;                       /* bytes received */
+    rt_uint32_t tx_bytes;                       /* bytes transmitted by the buffer chain */
+    rt_uint32_t rx_overruns;                    /* times of the rx fifo overrun */
+    rt_uint32_t rx_dropped;                     /* bytes dropped in the overruns */
+    rt_uint32_t dma_restarts;                   /* times of the rx DMA restarted on error */
+    rt_uint32_t rx_bps;                         /* bytes per second received since the last query */
+    rt_uint32_t tx_bps;                         /* bytes per second transmitted since the last query */
+};
+
+/*
+ * Serial transmit descriptor of the buffer chain, the buffer is sent by DMA in place
+ * and it shall be kept until the descriptor is done.
+ */
+struct rt_serial_tx_desc
+{
+    struct rt_serial_tx_desc *next;
+
+    const rt_uint8_t *buf;
+    rt_size_t size;
+
+    /* called in interrupt when the buffer is sent, or the port is closed */
+    void (*done)(struct rt_serial_device *serial, struct rt_serial_tx_desc *desc);
+    void *user_data;
+};
+
+/*
+ * Serial span of the data received, for RT_SERIAL_CTRL_RX_PEEK
+ */
+struct rt_serial_span
+{
+    rt_uint8_t *ptr;
+    rt_size_t size;
+};
+
 /*
  * Serial Receive FIFO mode
  */
@@ -122,6 +173,16 @@ struct rt_serial_rx_fifo
 
     rt_uint16_t rx_cpt_index;
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    /* the fifo of DMA ping-pong mode, the interrupt is the only producer */
+    struct rt_spsc_ringbuffer spsc;
+
+    /* the buffer of circular DMA, made of the ping and pong halves */
+    rt_uint8_t *dma_buf;
+    rt_size_t dma_size;
+    rt_size_t dma_pos;
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
     /* software fifo */
     rt_uint8_t buffer[];
 };
@@ -139,6 +200,12 @@ struct rt_serial_tx_fifo
 
     struct rt_completion tx_cpt;
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    /* the buffer chain, the head is being sent */
+    struct rt_serial_tx_desc *desc_head;
+    struct rt_serial_tx_desc *desc_tail;
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
     /* software fifo */
     rt_uint8_t buffer[];
 };
@@ -152,6 +219,13 @@ struct rt_serial_device
 
     void *serial_rx;
     void *serial_tx;
+
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    struct rt_serial_stat     stat;
+    rt_tick_t                 stat_tick;
+    rt_uint32_t               stat_rx_bytes;
+    rt_uint32_t               stat_tx_bytes;
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
 };
 
 /**
@@ -173,6 +247,14 @@ struct rt_uart_ops
                                  rt_uint8_t             *buf,
                                  rt_size_t               size,
                                  rt_uint32_t             tx_flag);
+
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    /* start the circular rx DMA over the buffer, with the interrupts of half transfer,
+     * transfer complete and idle line, which are reported in the order of the DMA */
+    rt_err_t (*dma_rx_start)(struct rt_serial_device    *serial,
+                                    rt_uint8_t          *buf,
+                                    rt_size_t            size);
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
 };
 
 void rt_hw_serial_isr(struct rt_serial_device *serial, int event);
@@ -7,6 +7,8 @@
  * Date           Author       Notes
  * 2012-11-23     Bernard      Add extern "C"
  * 2020-06-13     armink       fix the 3 wires issue
+ * 2022-02-24     RT-Thread    add the asynchronous queued transfer
+ * 2022-02-24     RT-Thread    add the lock nest of bus for the busy statistics
  */
 
 #ifndef __SPI_H__
@@ -69,6 +71,42 @@ struct rt_spi_message
     unsigned cs_release : 1;
 };
 
+#ifdef RT_SPI_USING_ASYNC
+struct rt_spi_device;
+
+/**
+ * SPI asynchronous message, it queues a message list to the SPI device. The message
+ * list and the buffers shall be kept until the done callback is called.
+ */
+struct rt_spi_async_message
+{
+    rt_list_t list;                                     /**< node in the queue of device */
+
+    struct rt_spi_message *message;                     /**< the message list to be transferred */
+    struct rt_spi_message *failed;                      /**< the message failed, RT_NULL on success */
+    rt_err_t result;
+
+    /* called in the spi async thread when the message list is transferred */
+    void (*done)(struct rt_spi_device *device, struct rt_spi_async_message *async);
+    void *user_data;
+};
+
+/**
+ * SPI bus statistics
+ */
+struct rt_spi_bus_stat
+{
+    rt_tick_t start_tick;                               /**< tick of the last reset */
+    rt_tick_t busy_ticks;                               /**< ticks the bus is held since the last reset */
+
+    rt_uint32_t async_messages;                         /**< async message lists done */
+    rt_uint32_t async_errors;                           /**< async message lists failed */
+    rt_uint32_t async_bytes;                            /**< bytes transferred by async messages */
+    rt_uint32_t async_queued;                           /**< async message lists in the queues */
+    rt_uint32_t async_queued_max;                       /**< the most async message lists queued */
+};
+#endif /* RT_SPI_USING_ASYNC */
+
 /**
  * SPI configuration structure
  */
@@ -90,6 +128,15 @@ struct rt_spi_bus
 
     struct rt_mutex lock;
     struct rt_spi_device *owner;
+
+#ifdef RT_SPI_USING_ASYNC
+    rt_list_t async_pending;                            /* devices with messages queued, in the order to be served */
+    struct rt_semaphore async_sem;
+    rt_thread_t async_thread;
+    rt_uint16_t lock_nest;                              /* the nest of bus lock, the bus is busy while it's not zero */
+    rt_tick_t lock_tick;
+    struct rt_spi_bus_stat stat;
+#endif /* RT_SPI_USING_ASYNC */
 };
 
 /**
@@ -111,6 +158,11 @@ struct rt_spi_device
 
     struct rt_spi_configuration config;
     void   *user_data;
+
+#ifdef RT_SPI_USING_ASYNC
+    rt_list_t async_queue;                              /* async messages queued */
+    rt_list_t async_node;                               /* node in the pending list of bus */
+#endif /* RT_SPI_USING_ASYNC */
 };
 
 struct rt_qspi_message
@@ -254,6 +306,58 @@ rt_size_t rt_spi_transfer(struct rt_spi_device *device,
 struct rt_spi_message *rt_spi_transfer_message(struct rt_spi_device  *device,
                                                struct rt_spi_message *message);
 
+#ifdef RT_SPI_USING_ASYNC
+/**
+ * This function queues a message list to the SPI device and returns at once, the
+ * message lists are transferred in order of submission for each device, and the
+ * devices on one bus are served in turn.
+ *
+ * A message list ends with the chip select taken (cs_release of the last message
+ * is 0) keeps the bus for the device until its next message list releases it, or
+ * no message list of the device comes in RT_SPI_ASYNC_CS_WAIT milliseconds.
+ *
+ * @param device the SPI device attached to SPI bus
+ * @param async the asynchronous message
+ *
+ * @return RT_EOK on queued successfully, others on failed.
+ */
+rt_err_t rt_spi_transfer_message_async(struct rt_spi_device        *device,
+                                       struct rt_spi_async_message *async);
+
+/**
+ * This function gets the statistics of SPI bus.
+ *
+ * @param bus the SPI bus
+ * @param stat the statistics got
+ * @param reset reset the counters after got
+ */
+void rt_spi_bus_get_stat(struct rt_spi_bus      *bus,
+                         struct rt_spi_bus_stat *stat,
+                         rt_bool_t               reset);
+
+/**
+ * This function initializes an asynchronous message.
+ *
+ * @param async the asynchronous message
+ * @param message the message list to be transferred
+ * @param done the callback when the message list is transferred
+ * @param user_data the user data for the callback
+ */
+rt_inline void rt_spi_async_message_init(struct rt_spi_async_message *async,
+                                         struct rt_spi_message       *message,
+                                         void (*done)(struct rt_spi_device *device,
+                                                      struct rt_spi_async_message *async),
+                                         void                        *user_data)
+{
+    rt_list_init(&async->list);
+    async->message   = message;
+    async->failed    = RT_NULL;
+    async->result    = RT_EOK;
+    async->done      = done;
+    async->user_data = user_data;
+}
+#endif /* RT_SPI_USING_ASYNC */
+
 rt_inline rt_size_t rt_spi_recv(struct rt_spi_device *device,
                                 void                 *recv_buf,
                                 rt_size_t             length)
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+#ifndef SPSC_RINGBUFFER_H__
+#define SPSC_RINGBUFFER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <rtthread.h>
+
+/*
+ * Introduction:
+ * The spsc ring buffer is a ring buffer of bytes for one producer and one consumer, which may
+ * run in thread, interrupt or on different cpus without any lock. The write index is only
+ * written by the producer and the read index only by the consumer, each side loads the index
+ * of the other side with acquire order and stores its own with release order.
+ *
+ * The indices run in [0, 2 * buffer_size), the index in the second half is the mirror of the
+ * same position, so a full buffer is told from an empty one without losing a byte. The indices
+ * are as wide as rt_ubase_t, so the buffer size is not limited to 32KiB as the rt_ringbuffer.
+ *
+ * Besides the put and get by copy, the producer may reserve a contiguous span of the free space,
+ * fill it in place (by DMA, for example) and commit it, while the consumer may peek a contiguous
+ * span of the data, parse it in place and consume it.
+ */
+struct rt_spsc_ringbuffer
+{
+    rt_uint8_t *buffer_ptr;
+    rt_size_t buffer_size;
+
+    volatile rt_ubase_t write_index;                    /**< written by the producer only */
+    volatile rt_ubase_t read_index;                     /**< written by the consumer only */
+};
+
+void rt_spsc_ringbuffer_init(struct rt_spsc_ringbuffer *rb, rt_uint8_t *pool, rt_size_t size);
+void rt_spsc_ringbuffer_reset(struct rt_spsc_ringbuffer *rb);
+rt_size_t rt_spsc_ringbuffer_data_len(struct rt_spsc_ringbuffer *rb);
+rt_size_t rt_spsc_ringbuffer_space_len(struct rt_spsc_ringbuffer *rb);
+
+/* the producer side */
+rt_size_t rt_spsc_ringbuffer_put(struct rt_spsc_ringbuffer *rb, const rt_uint8_t *ptr, rt_size_t length);
+rt_size_t rt_spsc_ringbuffer_putchar(struct rt_spsc_ringbuffer *rb, const rt_uint8_t ch);
+rt_size_t rt_spsc_ringbuffer_reserve(struct rt_spsc_ringbuffer *rb, rt_uint8_t **ptr);
+void rt_spsc_ringbuffer_commit(struct rt_spsc_ringbuffer *rb, rt_size_t length);
+
+/* the consumer side */
+rt_size_t rt_spsc_ringbuffer_get(struct rt_spsc_ringbuffer *rb, rt_uint8_t *ptr, rt_size_t length);
+rt_size_t rt_spsc_ringbuffer_getchar(struct rt_spsc_ringbuffer *rb, rt_uint8_t *ch);
+rt_size_t rt_spsc_ringbuffer_peek(struct rt_spsc_ringbuffer *rb, rt_uint8_t **ptr);
+void rt_spsc_ringbuffer_consume(struct rt_spsc_ringbuffer *rb, rt_size_t length);
+
+#ifdef RT_USING_HEAP
+struct rt_spsc_ringbuffer *rt_spsc_ringbuffer_create(rt_size_t size);
+void rt_spsc_ringbuffer_destroy(struct rt_spsc_ringbuffer *rb);
+#endif /* RT_USING_HEAP */
+
+/**
+ * @brief Get the buffer size of the spsc ring buffer object.
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ *
+ * @return  Buffer size.
+ */
+rt_inline rt_size_t rt_spsc_ringbuffer_get_size(struct rt_spsc_ringbuffer *rb)
+{
+    RT_ASSERT(rb != RT_NULL);
+    return rb->buffer_size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPSC_RINGBUFFER_H__ */
@@ -7,11 +7,13 @@
  * Date           Author       Notes
  * 2021-08-01     Meco Man     remove rt_delayed_work_init() and rt_delayed_work structure
  * 2021-08-14     Jackistang   add comments for rt_work_init()
+ * 2022-02-24     RT-Thread    add the workers, the priority lanes and the futures
  */
 #ifndef WORKQUEUE_H__
 #define WORKQUEUE_H__
 
 #include <rtthread.h>
+#include "completion.h"
 
 enum
 {
@@ -27,15 +29,41 @@ enum
     RT_WORK_TYPE_DELAYED     = 0x0001,
 };
 
+/**
+ * work priority definitions, each priority is a lane of the workers
+ */
+enum
+{
+    RT_WORK_PRIORITY_HIGH    = 0,
+    RT_WORK_PRIORITY_NORMAL  = 1,
+    RT_WORK_PRIORITY_LOW     = 2,
+    RT_WORK_PRIORITY_NR,
+};
+
+struct rt_workqueue;
+
+/* worker thread of workqueue */
+struct rt_workqueue_worker
+{
+    rt_list_t      work_list[RT_WORK_PRIORITY_NR]; /* pending works of each lane */
+    struct rt_work *work_current; /* current work */
+
+    rt_thread_t    thread;
+    struct rt_workqueue *queue;
+
+    rt_uint32_t    done;          /* works done */
+    rt_uint32_t    stolen;        /* works taken from the lanes of other workers */
+};
+
 /* workqueue implementation */
 struct rt_workqueue
 {
-    rt_list_t      work_list;
     rt_list_t      delayed_list;
-    struct rt_work *work_current; /* current work */
 
     struct rt_semaphore sem;
-    rt_thread_t    work_thread;
+
+    rt_uint8_t     nr_workers;
+    struct rt_workqueue_worker *workers;
 };
 
 struct rt_work
@@ -46,16 +74,33 @@ struct rt_work
     void *work_data;
     rt_uint16_t flags;
     rt_uint16_t type;
+    rt_uint8_t  priority;
     struct rt_timer timer;
     struct rt_workqueue *workqueue;
 };
 
+/* work with a result, which can be waited for */
+struct rt_work_future
+{
+    struct rt_work work;
+
+    void *(*func)(void *arg);
+    void *arg;
+    void *result;
+    rt_uint8_t pending;           /* submitted and not done yet */
+
+    struct rt_completion completion;
+};
+
 #ifdef RT_USING_HEAP
 /**
  * WorkQueue for DeviceDriver
  */
 void rt_work_init(struct rt_work *work, void (*work_func)(struct rt_work *work, void *work_data), void *work_data);
+void rt_work_set_priority(struct rt_work *work, rt_uint8_t priority);
 struct rt_workqueue *rt_workqueue_create(const char *name, rt_uint16_t stack_size, rt_uint8_t priority);
+struct rt_workqueue *rt_workqueue_create_workers(const char *name, rt_uint16_t stack_size, rt_uint8_t priority,
+                                                 rt_uint8_t workers);
 rt_err_t rt_workqueue_destroy(struct rt_workqueue *queue);
 rt_err_t rt_workqueue_dowork(struct rt_workqueue *queue, struct rt_work *work);
 rt_err_t rt_workqueue_submit_work(struct rt_workqueue *queue, struct rt_work *work, rt_tick_t ticks);
@@ -64,10 +109,15 @@ rt_err_t rt_workqueue_cancel_work_sync(struct rt_workqueue *queue, struct rt_wor
 rt_err_t rt_workqueue_cancel_all_work(struct rt_workqueue *queue);
 rt_err_t rt_workqueue_urgent_work(struct rt_workqueue *queue, struct rt_work *work);
 
+void rt_work_future_init(struct rt_work_future *future, void *(*func)(void *arg), void *arg);
+rt_err_t rt_workqueue_submit_future(struct rt_workqueue *queue, struct rt_work_future *future);
+rt_err_t rt_work_future_wait(struct rt_work_future *future, rt_int32_t timeout, void **result);
+
 #ifdef RT_USING_SYSTEM_WORKQUEUE
 rt_err_t rt_work_submit(struct rt_work *work, rt_tick_t ticks);
 rt_err_t rt_work_urgent(struct rt_work *work);
 rt_err_t rt_work_cancel(struct rt_work *work);
+rt_err_t rt_work_submit_future(struct rt_work_future *future);
 #endif /* RT_USING_SYSTEM_WORKQUEUE */
 
 
@@ -7,6 +7,7 @@
  * Date           Author       Notes
  * 2012-01-08     bernard      first version.
  * 2014-07-12     bernard      Add workqueue implementation.
+ * 2022-02-24     RT-Thread    add the spsc ring buffer
  */
 
 #ifndef __RT_DEVICE_H__
@@ -15,6 +16,7 @@
 #include <rtthread.h>
 
 #include "ipc/ringbuffer.h"
+#include "ipc/spsc_ringbuffer.h"
 #include "ipc/completion.h"
 #include "ipc/dataqueue.h"
 #include "ipc/workqueue.h"
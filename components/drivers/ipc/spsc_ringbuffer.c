@@ -0,0 +1,511 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ * 2022-02-24     RT-Thread    add the compiler barrier around the index on a single cpu
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+
+/*
+ * Load the index of the other side before touching the buffer, and store the own index after
+ * the buffer is done, the atomic operations come with the barriers of cpu. On a single cpu
+ * the order of its own accesses is kept, only the compiler shall not move the accesses of the
+ * buffer across the volatile index.
+ */
+#if defined(__CC_ARM)
+#define _spsc_barrier()     __schedule_barrier()
+#elif defined(__GNUC__) || defined(__ARMCC_VERSION) || defined(__IAR_SYSTEMS_ICC__) || defined(__TASKING__)
+#define _spsc_barrier()     __asm volatile ("" ::: "memory")
+#else
+/* the calls of the other unit are barriers to any compiler */
+#define _spsc_barrier()     rt_hw_interrupt_enable(rt_hw_interrupt_disable())
+#endif /* defined(__CC_ARM) */
+
+rt_inline rt_ubase_t _spsc_load(volatile rt_ubase_t *index)
+{
+#if defined(RT_USING_HW_ATOMIC)
+    return (rt_ubase_t)rt_hw_atomic_load((volatile rt_atomic_t *)index);
+#elif defined(RT_USING_SMP)
+    rt_base_t level;
+    rt_ubase_t value;
+
+    level = rt_hw_interrupt_disable();
+    value = *index;
+    rt_hw_interrupt_enable(level);
+
+    return value;
+#else
+    rt_ubase_t value;
+
+    value = *index;
+    /* the buffer is touched after the index of the other side is loaded */
+    _spsc_barrier();
+
+    return value;
+#endif /* defined(RT_USING_HW_ATOMIC) */
+}
+
+rt_inline void _spsc_store(volatile rt_ubase_t *index, rt_ubase_t value)
+{
+#if defined(RT_USING_HW_ATOMIC)
+    rt_hw_atomic_store((volatile rt_atomic_t *)index, (rt_atomic_t)value);
+#elif defined(RT_USING_SMP)
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    *index = value;
+    rt_hw_interrupt_enable(level);
+#else
+    /* the buffer is done before the own index is published */
+    _spsc_barrier();
+    *index = value;
+#endif /* defined(RT_USING_HW_ATOMIC) */
+}
+
+/* the position in buffer of an index */
+rt_inline rt_size_t _spsc_offset(struct rt_spsc_ringbuffer *rb, rt_ubase_t index)
+{
+    return (index < rb->buffer_size) ? index : index - rb->buffer_size;
+}
+
+rt_inline rt_ubase_t _spsc_advance(struct rt_spsc_ringbuffer *rb, rt_ubase_t index, rt_size_t length)
+{
+    index += length;
+    if (index >= 2 * rb->buffer_size)
+    {
+        index -= 2 * rb->buffer_size;
+    }
+
+    return index;
+}
+
+rt_inline rt_size_t _spsc_data_len(struct rt_spsc_ringbuffer *rb, rt_ubase_t read_index, rt_ubase_t write_index)
+{
+    if (write_index >= read_index)
+    {
+        return write_index - read_index;
+    }
+
+    return write_index + 2 * rb->buffer_size - read_index;
+}
+
+/**
+ * @brief Initialize the spsc ring buffer object.
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ * @param pool      A pointer to the buffer.
+ * @param size      The size of the buffer in bytes, no more than half of the range of rt_ubase_t.
+ */
+void rt_spsc_ringbuffer_init(struct rt_spsc_ringbuffer *rb,
+                             rt_uint8_t                *pool,
+                             rt_size_t                  size)
+{
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(size > 0 && size <= (~(rt_ubase_t)0) / 2);
+
+    rb->buffer_ptr = pool;
+    rb->buffer_size = size;
+    rb->write_index = 0;
+    rb->read_index = 0;
+}
+RTM_EXPORT(rt_spsc_ringbuffer_init);
+
+/**
+ * @brief Reset the spsc ring buffer object, and clear all contents in the buffer.
+ *
+ * @note  Neither the producer nor the consumer shall run at the same time.
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ */
+void rt_spsc_ringbuffer_reset(struct rt_spsc_ringbuffer *rb)
+{
+    RT_ASSERT(rb != RT_NULL);
+
+    _spsc_store(&rb->write_index, 0);
+    _spsc_store(&rb->read_index, 0);
+}
+RTM_EXPORT(rt_spsc_ringbuffer_reset);
+
+/**
+ * @brief Get the size of data in the spsc ring buffer object. It's exact for the consumer,
+ *        and no more than the real one for the producer.
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ *
+ * @return Return the size of data in the buffer in bytes.
+ */
+rt_size_t rt_spsc_ringbuffer_data_len(struct rt_spsc_ringbuffer *rb)
+{
+    rt_ubase_t read_index, write_index;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    read_index = _spsc_load(&rb->read_index);
+    write_index = _spsc_load(&rb->write_index);
+
+    return _spsc_data_len(rb, read_index, write_index);
+}
+RTM_EXPORT(rt_spsc_ringbuffer_data_len);
+
+/**
+ * @brief Get the size of free space in the spsc ring buffer object. It's exact for the
+ *        producer, and no more than the real one for the consumer.
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ *
+ * @return Return the size of free space in the buffer in bytes.
+ */
+rt_size_t rt_spsc_ringbuffer_space_len(struct rt_spsc_ringbuffer *rb)
+{
+    rt_ubase_t read_index, write_index;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    write_index = _spsc_load(&rb->write_index);
+    read_index = _spsc_load(&rb->read_index);
+
+    return rb->buffer_size - _spsc_data_len(rb, read_index, write_index);
+}
+RTM_EXPORT(rt_spsc_ringbuffer_space_len);
+
+/**
+ * @brief Put a block of data into the spsc ring buffer, called by the producer. If the free
+ *        space is insufficient, it will discard out-of-range data.
+ *
+ * @param rb            A pointer to the spsc ring buffer object.
+ * @param ptr           A pointer to the data buffer.
+ * @param length        The size of data in bytes.
+ *
+ * @return Return the data size we put into the spsc ring buffer.
+ */
+rt_size_t rt_spsc_ringbuffer_put(struct rt_spsc_ringbuffer *rb,
+                                 const rt_uint8_t          *ptr,
+                                 rt_size_t                  length)
+{
+    rt_ubase_t read_index, write_index;
+    rt_size_t space, offset, first;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    read_index = _spsc_load(&rb->read_index);
+    write_index = rb->write_index;
+
+    space = rb->buffer_size - _spsc_data_len(rb, read_index, write_index);
+    if (length > space)
+    {
+        length = space;
+    }
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    offset = _spsc_offset(rb, write_index);
+    first = rb->buffer_size - offset;
+    if (first > length)
+    {
+        first = length;
+    }
+
+    rt_memcpy(&rb->buffer_ptr[offset], ptr, first);
+    if (length > first)
+    {
+        rt_memcpy(&rb->buffer_ptr[0], &ptr[first], length - first);
+    }
+
+    _spsc_store(&rb->write_index, _spsc_advance(rb, write_index, length));
+
+    return length;
+}
+RTM_EXPORT(rt_spsc_ringbuffer_put);
+
+/**
+ * @brief Put a byte into the spsc ring buffer, called by the producer.
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ * @param ch        A byte put into the buffer.
+ *
+ * @return Return the data size we put into the spsc ring buffer. 0 if the buffer is full.
+ */
+rt_size_t rt_spsc_ringbuffer_putchar(struct rt_spsc_ringbuffer *rb, const rt_uint8_t ch)
+{
+    rt_ubase_t read_index, write_index;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    read_index = _spsc_load(&rb->read_index);
+    write_index = rb->write_index;
+
+    if (_spsc_data_len(rb, read_index, write_index) == rb->buffer_size)
+    {
+        return 0;
+    }
+
+    rb->buffer_ptr[_spsc_offset(rb, write_index)] = ch;
+    _spsc_store(&rb->write_index, _spsc_advance(rb, write_index, 1));
+
+    return 1;
+}
+RTM_EXPORT(rt_spsc_ringbuffer_putchar);
+
+/**
+ * @brief Reserve the contiguous free space from the write position of the spsc ring buffer,
+ *        called by the producer. The span is filled in place and made visible to the consumer
+ *        by rt_spsc_ringbuffer_commit().
+ *
+ * @note  The free space wrapped to the head of buffer is in the next span, after the commit.
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ * @param ptr       A pointer to the start of the span, RT_NULL if the buffer is full.
+ *
+ * @return Return the size of the span in bytes.
+ */
+rt_size_t rt_spsc_ringbuffer_reserve(struct rt_spsc_ringbuffer *rb, rt_uint8_t **ptr)
+{
+    rt_ubase_t read_index, write_index;
+    rt_size_t space, offset;
+
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(ptr != RT_NULL);
+
+    read_index = _spsc_load(&rb->read_index);
+    write_index = rb->write_index;
+
+    *ptr = RT_NULL;
+
+    space = rb->buffer_size - _spsc_data_len(rb, read_index, write_index);
+    if (space == 0)
+    {
+        return 0;
+    }
+
+    offset = _spsc_offset(rb, write_index);
+    if (space > rb->buffer_size - offset)
+    {
+        space = rb->buffer_size - offset;
+    }
+
+    *ptr = &rb->buffer_ptr[offset];
+
+    return space;
+}
+RTM_EXPORT(rt_spsc_ringbuffer_reserve);
+
+/**
+ * @brief Commit the data filled in the span given by rt_spsc_ringbuffer_reserve(), called
+ *        by the producer.
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ * @param length    The size of data filled, no more than the size of the span.
+ */
+void rt_spsc_ringbuffer_commit(struct rt_spsc_ringbuffer *rb, rt_size_t length)
+{
+    rt_ubase_t write_index;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    write_index = rb->write_index;
+    RT_ASSERT(length <= rb->buffer_size - _spsc_offset(rb, write_index));
+
+    _spsc_store(&rb->write_index, _spsc_advance(rb, write_index, length));
+}
+RTM_EXPORT(rt_spsc_ringbuffer_commit);
+
+/**
+ * @brief Get a block of data from the spsc ring buffer, called by the consumer.
+ *
+ * @param rb            A pointer to the spsc ring buffer object.
+ * @param ptr           A pointer to the data buffer.
+ * @param length        The size of the data we want to read from the buffer.
+ *
+ * @return Return the data size we read from the spsc ring buffer.
+ */
+rt_size_t rt_spsc_ringbuffer_get(struct rt_spsc_ringbuffer *rb,
+                                 rt_uint8_t                *ptr,
+                                 rt_size_t                  length)
+{
+    rt_ubase_t read_index, write_index;
+    rt_size_t size, offset, first;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    write_index = _spsc_load(&rb->write_index);
+    read_index = rb->read_index;
+
+    size = _spsc_data_len(rb, read_index, write_index);
+    if (length > size)
+    {
+        length = size;
+    }
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    offset = _spsc_offset(rb, read_index);
+    first = rb->buffer_size - offset;
+    if (first > length)
+    {
+        first = length;
+    }
+
+    rt_memcpy(ptr, &rb->buffer_ptr[offset], first);
+    if (length > first)
+    {
+        rt_memcpy(&ptr[first], &rb->buffer_ptr[0], length - first);
+    }
+
+    _spsc_store(&rb->read_index, _spsc_advance(rb, read_index, length));
+
+    return length;
+}
+RTM_EXPORT(rt_spsc_ringbuffer_get);
+
+/**
+ * @brief Get a byte from the spsc ring buffer, called by the consumer.
+ *
+ * @param rb        The pointer to the spsc ring buffer object.
+ * @param ch        A pointer to the buffer, used to store one byte.
+ *
+ * @return 0    The buffer is empty.
+ * @return 1    Success
+ */
+rt_size_t rt_spsc_ringbuffer_getchar(struct rt_spsc_ringbuffer *rb, rt_uint8_t *ch)
+{
+    rt_ubase_t read_index, write_index;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    write_index = _spsc_load(&rb->write_index);
+    read_index = rb->read_index;
+
+    if (write_index == read_index)
+    {
+        return 0;
+    }
+
+    *ch = rb->buffer_ptr[_spsc_offset(rb, read_index)];
+    _spsc_store(&rb->read_index, _spsc_advance(rb, read_index, 1));
+
+    return 1;
+}
+RTM_EXPORT(rt_spsc_ringbuffer_getchar);
+
+/**
+ * @brief Peek the contiguous data from the read position of the spsc ring buffer, called
+ *        by the consumer. The data is kept in the buffer until rt_spsc_ringbuffer_consume().
+ *
+ * @note  The data wrapped to the head of buffer is in the next span, after the consume.
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ * @param ptr       A pointer to the start of the span, RT_NULL if the buffer is empty.
+ *
+ * @return Return the size of the span in bytes.
+ */
+rt_size_t rt_spsc_ringbuffer_peek(struct rt_spsc_ringbuffer *rb, rt_uint8_t **ptr)
+{
+    rt_ubase_t read_index, write_index;
+    rt_size_t size, offset;
+
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(ptr != RT_NULL);
+
+    write_index = _spsc_load(&rb->write_index);
+    read_index = rb->read_index;
+
+    *ptr = RT_NULL;
+
+    size = _spsc_data_len(rb, read_index, write_index);
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    offset = _spsc_offset(rb, read_index);
+    if (size > rb->buffer_size - offset)
+    {
+        size = rb->buffer_size - offset;
+    }
+
+    *ptr = &rb->buffer_ptr[offset];
+
+    return size;
+}
+RTM_EXPORT(rt_spsc_ringbuffer_peek);
+
+/**
+ * @brief Consume the data of the span given by rt_spsc_ringbuffer_peek(), called by the
+ *        consumer. The space is given back to the producer.
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ * @param length    The size of data consumed, no more than the size of the span.
+ */
+void rt_spsc_ringbuffer_consume(struct rt_spsc_ringbuffer *rb, rt_size_t length)
+{
+    rt_ubase_t read_index;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    read_index = rb->read_index;
+    RT_ASSERT(length <= rb->buffer_size - _spsc_offset(rb, read_index));
+
+    _spsc_store(&rb->read_index, _spsc_advance(rb, read_index, length));
+}
+RTM_EXPORT(rt_spsc_ringbuffer_consume);
+
+#ifdef RT_USING_HEAP
+
+/**
+ * @brief Create a spsc ring buffer object with a given size.
+ *
+ * @param size      The size of the buffer in bytes.
+ *
+ * @return Return a pointer to spsc ring buffer object. When the return value is RT_NULL, it means this creation failed.
+ */
+struct rt_spsc_ringbuffer *rt_spsc_ringbuffer_create(rt_size_t size)
+{
+    struct rt_spsc_ringbuffer *rb;
+    rt_uint8_t *pool;
+
+    RT_ASSERT(size > 0);
+
+    rb = (struct rt_spsc_ringbuffer *)rt_malloc(sizeof(struct rt_spsc_ringbuffer));
+    if (rb == RT_NULL)
+        goto exit;
+
+    pool = (rt_uint8_t *)rt_malloc(size);
+    if (pool == RT_NULL)
+    {
+        rt_free(rb);
+        rb = RT_NULL;
+        goto exit;
+    }
+    rt_spsc_ringbuffer_init(rb, pool, size);
+
+exit:
+    return rb;
+}
+RTM_EXPORT(rt_spsc_ringbuffer_create);
+
+/**
+ * @brief Destroy the spsc ring buffer object, which is created by rt_spsc_ringbuffer_create().
+ *
+ * @param rb        A pointer to the spsc ring buffer object.
+ */
+void rt_spsc_ringbuffer_destroy(struct rt_spsc_ringbuffer *rb)
+{
+    RT_ASSERT(rb != RT_NULL);
+
+    rt_free(rb->buffer_ptr);
+    rt_free(rb);
+}
+RTM_EXPORT(rt_spsc_ringbuffer_destroy);
+
+#endif /* RT_USING_HEAP */
@@ -9,6 +9,8 @@
  * 2021-08-01     Meco Man     remove rt_delayed_work_init()
  * 2021-08-14     Jackistang   add comments for function interface
  * 2022-01-16     Meco Man     add rt_work_urgent()
+ * 2022-02-24     RT-Thread    add the workers, the priority lanes and the futures
+ * 2022-02-24     RT-Thread    reject the resubmit of a pending future
  */
 
 #include <rthw.h>
@@ -50,21 +52,117 @@ rt_inline rt_err_t _workqueue_work_completion(struct rt_workqueue *queue)
     return result;
 }
 
+/*
+ * The pending works are kept in the lanes of the workers. A work is queued to
+ * the worker of the current cpu, and a worker takes the oldest work of the
+ * highest lane, from its own lanes first and then from the others, so an idle
+ * worker steals the works behind a slow one.
+ */
+
+/* the worker of the current cpu, the first one without RT_USING_SMP */
+rt_inline struct rt_workqueue_worker *_workqueue_local_worker(struct rt_workqueue *queue)
+{
+#ifdef RT_USING_SMP
+    return &(queue->workers[rt_hw_cpu_id() % queue->nr_workers]);
+#else
+    return &(queue->workers[0]);
+#endif /* RT_USING_SMP */
+}
+
+/* whether the work is executing on a worker, called with interrupt disabled */
+static rt_bool_t _workqueue_work_running(struct rt_workqueue *queue, struct rt_work *work)
+{
+    int index;
+
+    for (index = 0; index < queue->nr_workers; index++)
+    {
+        if (queue->workers[index].work_current == work)
+        {
+            return RT_TRUE;
+        }
+    }
+
+    return RT_FALSE;
+}
+
+/*
+ * resume the worker holding the work if it is idle, otherwise another idle
+ * worker which will steal it. It's called with interrupt disabled, and the
+ * caller shall schedule if a worker is resumed.
+ */
+static rt_bool_t _workqueue_wakeup(struct rt_workqueue *queue, struct rt_workqueue_worker *target)
+{
+    int index, first;
+    struct rt_workqueue_worker *worker;
+
+    first = target - queue->workers;
+    for (index = 0; index < queue->nr_workers; index++)
+    {
+        worker = &(queue->workers[(first + index) % queue->nr_workers]);
+        if (worker->work_current == RT_NULL &&
+            ((worker->thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_SUSPEND))
+        {
+            rt_thread_resume(worker->thread);
+            return RT_TRUE;
+        }
+    }
+
+    return RT_FALSE;
+}
+
+/* queue the work to a lane of the worker, called with interrupt disabled */
+rt_inline void _workqueue_queue_work(struct rt_workqueue *queue, struct rt_workqueue_worker *worker,
+                                     struct rt_work *work)
+{
+    rt_list_insert_before(&(worker->work_list[work->priority]), &(work->list));
+    work->flags |= RT_WORK_STATE_PENDING;
+    work->workqueue = queue;
+}
+
+/* the next work of the worker, called with interrupt disabled */
+static struct rt_work *_workqueue_next_work(struct rt_workqueue_worker *worker)
+{
+    int priority, index, first;
+    struct rt_workqueue *queue = worker->queue;
+    struct rt_workqueue_worker *victim;
+
+    first = worker - queue->workers;
+    for (priority = 0; priority < RT_WORK_PRIORITY_NR; priority++)
+    {
+        for (index = 0; index < queue->nr_workers; index++)
+        {
+            victim = &(queue->workers[(first + index) % queue->nr_workers]);
+            if (!rt_list_isempty(&(victim->work_list[priority])))
+            {
+                if (victim != worker)
+                {
+                    worker->stolen ++;
+                }
+
+                return rt_list_first_entry(&(victim->work_list[priority]), struct rt_work, list);
+            }
+        }
+    }
+
+    return RT_NULL;
+}
+
 static void _workqueue_thread_entry(void *parameter)
 {
     rt_base_t level;
     struct rt_work *work;
-    struct rt_workqueue *queue;
+    struct rt_workqueue_worker *worker;
 
-    queue = (struct rt_workqueue *) parameter;
-    RT_ASSERT(queue != RT_NULL);
+    worker = (struct rt_workqueue_worker *) parameter;
+    RT_ASSERT(worker != RT_NULL);
 
     while (1)
     {
         level = rt_hw_interrupt_disable();
-        if (rt_list_isempty(&(queue->work_list)))
+        work = _workqueue_next_work(worker);
+        if (work == RT_NULL)
         {
-            /* no software timer exist, suspend self. */
+            /* no work to do, suspend self. */
             rt_thread_suspend(rt_thread_self());
             rt_hw_interrupt_enable(level);
             rt_schedule();
@@ -72,20 +170,20 @@ static void _workqueue_thread_entry(void *parameter)
         }
 
         /* we have work to do with. */
-        work = rt_list_entry(queue->work_list.next, struct rt_work, list);
         rt_list_remove(&(work->list));
-        queue->work_current = work;
+        worker->work_current = work;
         work->flags &= ~RT_WORK_STATE_PENDING;
         work->workqueue = RT_NULL;
         rt_hw_interrupt_enable(level);
 
-        /* do work */
+        /* do work, the work may be freed in it */
         work->work_func(work, work->work_data);
         /* clean current work */
-        queue->work_current = RT_NULL;
+        worker->work_current = RT_NULL;
+        worker->done ++;
 
         /* ack work completion */
-        _workqueue_work_completion(queue);
+        _workqueue_work_completion(worker->queue);
     }
 }
 
@@ -102,11 +200,11 @@ static rt_err_t _workqueue_submit_work(struct rt_workqueue *queue,
 
     if (ticks == 0)
     {
-        if (queue->work_current != work)
+        struct rt_workqueue_worker *worker = _workqueue_local_worker(queue);
+
+        if (!_workqueue_work_running(queue, work))
         {
-            rt_list_insert_after(queue->work_list.prev, &(work->list));
-            work->flags |= RT_WORK_STATE_PENDING;
-            work->workqueue = queue;
+            _workqueue_queue_work(queue, worker, work);
             err = RT_EOK;
         }
         else
@@ -114,12 +212,9 @@ static rt_err_t _workqueue_submit_work(struct rt_workqueue *queue,
             err = -RT_EBUSY;
         }
 
-        /* whether the workqueue is doing work */
-        if (queue->work_current == RT_NULL &&
-            ((queue->work_thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_SUSPEND))
+        /* whether an idle worker can do the work */
+        if (_workqueue_wakeup(queue, worker))
         {
-            /* resume work thread */
-            rt_thread_resume(queue->work_thread);
             rt_hw_interrupt_enable(level);
             rt_schedule();
         }
@@ -169,7 +264,7 @@ static rt_err_t _workqueue_cancel_work(struct rt_workqueue *queue, struct rt_wor
         rt_timer_detach(&(work->timer));
         work->flags &= ~RT_WORK_STATE_SUBMITTING;
     }
-    err = queue->work_current != work ? RT_EOK : -RT_EBUSY;
+    err = _workqueue_work_running(queue, work) ? -RT_EBUSY : RT_EOK;
     work->workqueue = RT_NULL;
     rt_hw_interrupt_enable(level);
     return err;
@@ -179,6 +274,7 @@ static void _delayed_work_timeout_handler(void *parameter)
 {
     struct rt_work *work;
     struct rt_workqueue *queue;
+    struct rt_workqueue_worker *worker;
     rt_base_t level;
 
     work = (struct rt_work *)parameter;
@@ -186,22 +282,19 @@ static void _delayed_work_timeout_handler(void *parameter)
     RT_ASSERT(queue != RT_NULL);
 
     level = rt_hw_interrupt_disable();
+    worker = _workqueue_local_worker(queue);
     rt_timer_detach(&(work->timer));
     work->flags &= ~RT_WORK_STATE_SUBMITTING;
     /* remove delay list */
     rt_list_remove(&(work->list));
     /* insert work queue */
-    if (queue->work_current != work)
+    if (!_workqueue_work_running(queue, work))
     {
-        rt_list_insert_after(queue->work_list.prev, &(work->list));
-        work->flags |= RT_WORK_STATE_PENDING;
+        _workqueue_queue_work(queue, worker, work);
     }
-    /* whether the workqueue is doing work */
-    if (queue->work_current == RT_NULL &&
-        ((queue->work_thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_SUSPEND))
+    /* whether an idle worker can do the work */
+    if (_workqueue_wakeup(queue, worker))
     {
-        /* resume work thread */
-        rt_thread_resume(queue->work_thread);
         rt_hw_interrupt_enable(level);
         rt_schedule();
     }
@@ -233,6 +326,25 @@ void rt_work_init(struct rt_work *work,
     work->workqueue = RT_NULL;
     work->flags = 0;
     work->type = 0;
+    work->priority = RT_WORK_PRIORITY_NORMAL;
+}
+
+/**
+ * @brief Set the priority of a work item. The works of higher priority are executed
+ *        first, the works of the same priority in the order of submission.
+ *
+ * @param work is a pointer to the work item object.
+ *
+ * @param priority is RT_WORK_PRIORITY_HIGH, RT_WORK_PRIORITY_NORMAL or RT_WORK_PRIORITY_LOW.
+ *
+ * @note It takes effect at the next submission of the work item.
+ */
+void rt_work_set_priority(struct rt_work *work, rt_uint8_t priority)
+{
+    RT_ASSERT(work != RT_NULL);
+    RT_ASSERT(priority < RT_WORK_PRIORITY_NR);
+
+    work->priority = priority;
 }
 
 /**
@@ -247,27 +359,101 @@ void rt_work_init(struct rt_work *work,
  * @return Return a pointer to the workqueue object. It will return RT_NULL if failed.
  */
 struct rt_workqueue *rt_workqueue_create(const char *name, rt_uint16_t stack_size, rt_uint8_t priority)
+{
+    return rt_workqueue_create_workers(name, stack_size, priority, 1);
+}
+
+/**
+ * @brief Create a work queue with several worker threads. The work items run in
+ *        parallel on the workers, an idle worker takes the work items queued to
+ *        the busy ones. With RT_USING_SMP the workers are bound to the cpus in
+ *        turn, and a work item is queued to the worker of the cpu submitting it.
+ *
+ * @param name is a name of the work queue thread, the workers are named with
+ *        their index appended.
+ *
+ * @param stack_size is stack size of each worker thread.
+ *
+ * @param priority is a priority of the worker threads.
+ *
+ * @param workers is the number of worker threads, 0 for one on each cpu.
+ *
+ * @return Return a pointer to the workqueue object. It will return RT_NULL if failed.
+ */
+struct rt_workqueue *rt_workqueue_create_workers(const char *name, rt_uint16_t stack_size, rt_uint8_t priority,
+                                                 rt_uint8_t workers)
 {
     struct rt_workqueue *queue = RT_NULL;
+    struct rt_workqueue_worker *worker;
+    char thread_name[RT_NAME_MAX];
+    int index, lane;
+
+    if (workers == 0)
+    {
+#ifdef RT_USING_SMP
+        workers = RT_CPUS_NR;
+#else
+        workers = 1;
+#endif /* RT_USING_SMP */
+    }
 
-    queue = (struct rt_workqueue *)RT_KERNEL_MALLOC(sizeof(struct rt_workqueue));
+    queue = (struct rt_workqueue *)RT_KERNEL_MALLOC(sizeof(struct rt_workqueue) +
+                                                    workers * sizeof(struct rt_workqueue_worker));
     if (queue != RT_NULL)
     {
         /* initialize work list */
-        rt_list_init(&(queue->work_list));
         rt_list_init(&(queue->delayed_list));
-        queue->work_current = RT_NULL;
         rt_sem_init(&(queue->sem), "wqueue", 0, RT_IPC_FLAG_FIFO);
+        queue->nr_workers = workers;
+        queue->workers = (struct rt_workqueue_worker *)(queue + 1);
 
-        /* create the work thread */
-        queue->work_thread = rt_thread_create(name, _workqueue_thread_entry, queue, stack_size, priority, 10);
-        if (queue->work_thread == RT_NULL)
+        for (index = 0; index < workers; index++)
         {
-            RT_KERNEL_FREE(queue);
-            return RT_NULL;
+            worker = &(queue->workers[index]);
+            for (lane = 0; lane < RT_WORK_PRIORITY_NR; lane++)
+            {
+                rt_list_init(&(worker->work_list[lane]));
+            }
+            worker->work_current = RT_NULL;
+            worker->queue = queue;
+            worker->done = 0;
+            worker->stolen = 0;
+
+            /* create the work thread */
+            if (workers == 1)
+            {
+                worker->thread = rt_thread_create(name, _workqueue_thread_entry, worker,
+                                                  stack_size, priority, 10);
+            }
+            else
+            {
+                rt_snprintf(thread_name, sizeof(thread_name), "%.*s%d", RT_NAME_MAX - 3, name, index);
+                worker->thread = rt_thread_create(thread_name, _workqueue_thread_entry, worker,
+                                                  stack_size, priority, 10);
+            }
+            if (worker->thread == RT_NULL)
+            {
+                while (index--)
+                {
+                    rt_thread_delete(queue->workers[index].thread);
+                }
+                rt_sem_detach(&(queue->sem));
+                RT_KERNEL_FREE(queue);
+                return RT_NULL;
+            }
+#ifdef RT_USING_SMP
+            if (workers > 1)
+            {
+                rt_thread_control(worker->thread, RT_THREAD_CTRL_BIND_CPU,
+                                  (void *)(rt_ubase_t)(index % RT_CPUS_NR));
+            }
+#endif /* RT_USING_SMP */
         }
 
-        rt_thread_startup(queue->work_thread);
+        for (index = 0; index < workers; index++)
+        {
+            rt_thread_startup(queue->workers[index].thread);
+        }
     }
 
     return queue;
@@ -282,10 +468,15 @@ struct rt_workqueue *rt_workqueue_create(const char *name, rt_uint16_t stack_siz
  */
 rt_err_t rt_workqueue_destroy(struct rt_workqueue *queue)
 {
+    int index;
+
     RT_ASSERT(queue != RT_NULL);
 
     rt_workqueue_cancel_all_work(queue);
-    rt_thread_delete(queue->work_thread);
+    for (index = 0; index < queue->nr_workers; index++)
+    {
+        rt_thread_delete(queue->workers[index].thread);
+    }
     rt_sem_detach(&(queue->sem));
     RT_KERNEL_FREE(queue);
 
@@ -346,20 +537,22 @@ rt_err_t rt_workqueue_submit_work(struct rt_workqueue *queue, struct rt_work *wo
 rt_err_t rt_workqueue_urgent_work(struct rt_workqueue *queue, struct rt_work *work)
 {
     rt_base_t level;
+    struct rt_workqueue_worker *worker;
 
     RT_ASSERT(queue != RT_NULL);
     RT_ASSERT(work != RT_NULL);
 
     level = rt_hw_interrupt_disable();
+    worker = _workqueue_local_worker(queue);
     /* NOTE: the work MUST be initialized firstly */
     rt_list_remove(&(work->list));
-    rt_list_insert_after(&queue->work_list, &(work->list));
-    /* whether the workqueue is doing work */
-    if (queue->work_current == RT_NULL &&
-        ((queue->work_thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_SUSPEND))
+    /* the head of the highest lane */
+    rt_list_insert_after(&(worker->work_list[RT_WORK_PRIORITY_HIGH]), &(work->list));
+    work->flags |= RT_WORK_STATE_PENDING;
+    work->workqueue = queue;
+    /* whether an idle worker can do the work */
+    if (_workqueue_wakeup(queue, worker))
     {
-        /* resume work thread */
-        rt_thread_resume(queue->work_thread);
         rt_hw_interrupt_enable(level);
         rt_schedule();
     }
@@ -400,13 +593,27 @@ rt_err_t rt_workqueue_cancel_work(struct rt_workqueue *queue, struct rt_work *wo
  */
 rt_err_t rt_workqueue_cancel_work_sync(struct rt_workqueue *queue, struct rt_work *work)
 {
+    rt_base_t level;
+    rt_bool_t running;
+
     RT_ASSERT(queue != RT_NULL);
     RT_ASSERT(work != RT_NULL);
 
-    if (queue->work_current == work) /* it's current work in the queue */
+    level = rt_hw_interrupt_disable();
+    running = _workqueue_work_running(queue, work);
+    rt_hw_interrupt_enable(level);
+
+    if (running) /* it's current work of a worker */
     {
-        /* wait for work completion */
-        rt_sem_take(&(queue->sem), RT_WAITING_FOREVER);
+        /* wait for work completion, any worker may ack its own work */
+        do
+        {
+            rt_sem_take(&(queue->sem), RT_WAITING_FOREVER);
+
+            level = rt_hw_interrupt_disable();
+            running = _workqueue_work_running(queue, work);
+            rt_hw_interrupt_enable(level);
+        } while (running);
     }
     else
     {
@@ -426,15 +633,24 @@ rt_err_t rt_workqueue_cancel_work_sync(struct rt_workqueue *queue, struct rt_wor
 rt_err_t rt_workqueue_cancel_all_work(struct rt_workqueue *queue)
 {
     struct rt_work *work;
+    rt_list_t *work_list;
+    int index, lane;
 
     RT_ASSERT(queue != RT_NULL);
 
     /* cancel work */
     rt_enter_critical();
-    while (rt_list_isempty(&queue->work_list) == RT_FALSE)
+    for (index = 0; index < queue->nr_workers; index++)
     {
-        work = rt_list_first_entry(&queue->work_list, struct rt_work, list);
-        _workqueue_cancel_work(queue, work);
+        for (lane = 0; lane < RT_WORK_PRIORITY_NR; lane++)
+        {
+            work_list = &(queue->workers[index].work_list[lane]);
+            while (rt_list_isempty(work_list) == RT_FALSE)
+            {
+                work = rt_list_first_entry(work_list, struct rt_work, list);
+                _workqueue_cancel_work(queue, work);
+            }
+        }
     }
     /* cancel delay work */
     while (rt_list_isempty(&queue->delayed_list) == RT_FALSE)
@@ -447,8 +663,115 @@ rt_err_t rt_workqueue_cancel_all_work(struct rt_workqueue *queue)
     return RT_EOK;
 }
 
+static void _work_future_func(struct rt_work *work, void *work_data)
+{
+    struct rt_work_future *future = (struct rt_work_future *)work_data;
+    rt_base_t level;
+
+    future->result = future->func(future->arg);
+
+    level = rt_hw_interrupt_disable();
+    future->pending = RT_FALSE;
+    /* the future may be freed by the waiter from now on */
+    rt_completion_done(&(future->completion));
+    rt_hw_interrupt_enable(level);
+}
+
+/**
+ * @brief Initialize a future, which is a work item with a result to be waited for.
+ *
+ * @param future is a pointer to the future object.
+ *
+ * @param func is the function to be executed by the work queue, it returns the result.
+ *
+ * @param arg is the argument of the function.
+ */
+void rt_work_future_init(struct rt_work_future *future, void *(*func)(void *arg), void *arg)
+{
+    RT_ASSERT(future != RT_NULL);
+    RT_ASSERT(func != RT_NULL);
+
+    rt_work_init(&(future->work), _work_future_func, future);
+    future->func = func;
+    future->arg = arg;
+    future->result = RT_NULL;
+    future->pending = RT_FALSE;
+    rt_completion_init(&(future->completion));
+}
+
+/**
+ * @brief Submit a future to the work queue without delay. The priority of the
+ *        future is set by rt_work_set_priority() on its work item. A future is
+ *        submitted again only after it's done.
+ *
+ * @param queue is a pointer to the workqueue object.
+ *
+ * @param future is a pointer to the future object.
+ *
+ * @return RT_EOK       Success.
+ *         -RT_EBUSY    The future is pending or executing.
+ */
+rt_err_t rt_workqueue_submit_future(struct rt_workqueue *queue, struct rt_work_future *future)
+{
+    rt_base_t level;
+    rt_err_t err;
+
+    RT_ASSERT(queue != RT_NULL);
+    RT_ASSERT(future != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    if (future->pending)
+    {
+        rt_hw_interrupt_enable(level);
+        return -RT_EBUSY;
+    }
+    future->pending = RT_TRUE;
+    /* drop the last result not waited for, the thread already waiting is kept */
+    rt_completion_wait(&(future->completion), 0);
+    rt_hw_interrupt_enable(level);
+
+    err = _workqueue_submit_work(queue, &(future->work), 0);
+    if (err != RT_EOK)
+    {
+        future->pending = RT_FALSE;
+    }
+
+    return err;
+}
+
+/**
+ * @brief Wait for a future to be done and get its result.
+ *
+ * @param future is a pointer to the future object.
+ *
+ * @param timeout is the timeout in ticks, RT_WAITING_FOREVER to wait until done.
+ *
+ * @param result is the buffer to save the result, it can be RT_NULL.
+ *
+ * @return RT_EOK        Success.
+ *         -RT_ETIMEOUT  The future is not done in time.
+ */
+rt_err_t rt_work_future_wait(struct rt_work_future *future, rt_int32_t timeout, void **result)
+{
+    rt_err_t err;
+
+    RT_ASSERT(future != RT_NULL);
+
+    err = rt_completion_wait(&(future->completion), timeout);
+    if (err == RT_EOK && result != RT_NULL)
+    {
+        *result = future->result;
+    }
+
+    return err;
+}
+
 #ifdef RT_USING_SYSTEM_WORKQUEUE
 
+#ifndef RT_SYSTEM_WORKQUEUE_WORKERS
+#define RT_SYSTEM_WORKQUEUE_WORKERS 1
+#endif /* RT_SYSTEM_WORKQUEUE_WORKERS */
+
 static struct rt_workqueue *sys_workq; /* system work queue */
 
 /**
@@ -494,13 +817,26 @@ rt_err_t rt_work_cancel(struct rt_work *work)
     return rt_workqueue_cancel_work(sys_workq, work);
 }
 
+/**
+ * @brief Submit a future to the system work queue without delay.
+ *
+ * @param future is a pointer to the future object.
+ *
+ * @return RT_EOK       Success.
+ *         -RT_EBUSY    The future is pending or executing.
+ */
+rt_err_t rt_work_submit_future(struct rt_work_future *future)
+{
+    return rt_workqueue_submit_future(sys_workq, future);
+}
+
 static int rt_work_sys_workqueue_init(void)
 {
     if (sys_workq != RT_NULL)
         return RT_EOK;
 
-    sys_workq = rt_workqueue_create("sys workq", RT_SYSTEM_WORKQUEUE_STACKSIZE,
-                                    RT_SYSTEM_WORKQUEUE_PRIORITY);
+    sys_workq = rt_workqueue_create_workers("sys workq", RT_SYSTEM_WORKQUEUE_STACKSIZE,
+                                            RT_SYSTEM_WORKQUEUE_PRIORITY, RT_SYSTEM_WORKQUEUE_WORKERS);
     RT_ASSERT(sys_workq != RT_NULL);
 
     return RT_EOK;
@@ -6,6 +6,8 @@
  * Change Logs:
  * Date           Author        Notes
  * 2011-07-25     weety     first version
+ * 2022-02-24     RT-Thread    add the request merging and read-ahead
+ * 2022-02-24     RT-Thread    keep one exit of read and write with the block queue
  */
 
 #include <rtthread.h>
@@ -34,6 +36,75 @@ struct mmcsd_blk_device
     rt_size_t max_req_size;
 };
 
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+#ifndef RT_MMCSD_RA_MAX_BLKS
+#define RT_MMCSD_RA_MAX_BLKS        32
+#endif
+#ifndef RT_MMCSD_WB_BLKS
+#define RT_MMCSD_WB_BLKS            32
+#endif
+#ifndef RT_MMCSD_PRE_ERASE_BLKS
+#define RT_MMCSD_PRE_ERASE_BLKS     8
+#endif
+#ifdef RT_MMCSD_USING_BLK_THREAD
+#ifndef RT_MMCSD_BLK_FLUSH_MS
+#define RT_MMCSD_BLK_FLUSH_MS       100
+#endif
+#ifndef RT_MMCSD_BLK_STACK_SIZE
+#define RT_MMCSD_BLK_STACK_SIZE     1024
+#endif
+#ifndef RT_MMCSD_BLK_THREAD_PRIORITY
+#define RT_MMCSD_BLK_THREAD_PRIORITY 22
+#endif
+#endif /* RT_MMCSD_USING_BLK_THREAD */
+
+/* the first window of the read-ahead when the reads turn sequential */
+#define MMCSD_RA_MIN_BLKS   BLK_MIN(8, RT_MMCSD_RA_MAX_BLKS)
+
+struct mmcsd_blk_stat
+{
+    rt_uint32_t reads;          /* read calls */
+    rt_uint32_t read_reqs;      /* read requests sent to the card */
+    rt_uint32_t ra_hits;        /* sectors got from the read-ahead */
+    rt_uint32_t writes;         /* write calls */
+    rt_uint32_t write_reqs;     /* write requests sent to the card */
+    rt_uint32_t merged;         /* write calls merged into the buffer */
+    rt_uint32_t pre_erases;     /* ACMD23 sent before the writes */
+};
+
+/*
+ * The request queue of a card, shared by the block devices of the card, so the
+ * sectors are cached by the address on the card and the partitions and the whole
+ * card see the same data.
+ */
+struct mmcsd_blk_queue
+{
+    struct rt_mmcsd_card *card;
+    struct rt_mutex lock;
+    rt_uint32_t capacity;       /* sectors of the card */
+    rt_size_t max_req_size;     /* sectors of one request */
+
+    rt_uint8_t *ra_buf;
+    rt_uint32_t ra_start;       /* the first sector read ahead */
+    rt_uint32_t ra_count;       /* sectors read ahead */
+    rt_uint32_t ra_window;      /* sectors to read ahead, 0 on random reads */
+    rt_uint32_t next_sector;    /* the sector after the last read */
+
+    rt_uint8_t *wb_buf;
+    rt_uint32_t wb_start;       /* the first sector merged */
+    rt_uint32_t wb_count;       /* sectors merged */
+
+#ifdef RT_MMCSD_USING_BLK_THREAD
+    rt_thread_t thread;
+    struct rt_semaphore sem;
+    struct rt_semaphore exit_sem;
+    volatile rt_bool_t exit;    /* set by the deleter, read by the flush thread */
+#endif /* RT_MMCSD_USING_BLK_THREAD */
+
+    struct mmcsd_blk_stat stat;
+};
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
+
 #ifndef RT_MMCSD_MAX_PARTITION
 #define RT_MMCSD_MAX_PARTITION 16
 #endif
@@ -201,6 +272,325 @@ static rt_err_t rt_mmcsd_req_blk(struct rt_mmcsd_card *card,
     return RT_EOK;
 }
 
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+/* ask the SD card to pre-erase the blocks to be written by the next CMD25 */
+static void mmcsd_pre_erase(struct rt_mmcsd_card *card, rt_size_t blks)
+{
+    struct rt_mmcsd_cmd cmd;
+
+    mmcsd_host_lock(card->host);
+
+    rt_memset(&cmd, 0, sizeof(struct rt_mmcsd_cmd));
+    cmd.cmd_code = APP_CMD;
+    cmd.arg = card->rca << 16;
+    cmd.flags = RESP_SPI_R1 | RESP_R1 | CMD_AC;
+    if (mmcsd_send_cmd(card->host, &cmd, 0) == 0 &&
+        (controller_is_spi(card->host) || (cmd.resp[0] & R1_APP_CMD)))
+    {
+        rt_memset(&cmd, 0, sizeof(struct rt_mmcsd_cmd));
+        cmd.cmd_code = SD_APP_SET_WR_BLK_ERASE_COUNT;
+        cmd.arg = blks & 0x7fffff;
+        cmd.flags = RESP_SPI_R1 | RESP_R1 | CMD_AC;
+        /* it's only a hint, the write goes on if the card refuses it */
+        mmcsd_send_cmd(card->host, &cmd, 0);
+    }
+
+    mmcsd_host_unlock(card->host);
+}
+
+static rt_err_t mmcsd_queue_req(struct mmcsd_blk_queue *queue,
+                                rt_uint32_t             sector,
+                                rt_uint8_t             *buf,
+                                rt_size_t               blks,
+                                rt_uint8_t              dir)
+{
+    rt_size_t req_size;
+    rt_err_t err;
+
+    while (blks)
+    {
+        req_size = BLK_MIN(blks, queue->max_req_size);
+        if (dir)
+        {
+            if (RT_MMCSD_PRE_ERASE_BLKS > 0 && req_size >= RT_MMCSD_PRE_ERASE_BLKS &&
+                queue->card->card_type == CARD_TYPE_SD)
+            {
+                mmcsd_pre_erase(queue->card, req_size);
+                queue->stat.pre_erases ++;
+            }
+            queue->stat.write_reqs ++;
+        }
+        else
+        {
+            queue->stat.read_reqs ++;
+        }
+
+        err = rt_mmcsd_req_blk(queue->card, sector, buf, req_size, dir);
+        if (err)
+            return err;
+
+        sector += req_size;
+        buf += req_size << 9;
+        blks -= req_size;
+    }
+
+    return RT_EOK;
+}
+
+/* write the merged sectors to the card, with the queue locked */
+static rt_err_t mmcsd_queue_flush(struct mmcsd_blk_queue *queue)
+{
+    rt_err_t err = RT_EOK;
+
+    if (queue->wb_count)
+    {
+        err = mmcsd_queue_req(queue, queue->wb_start, queue->wb_buf, queue->wb_count, 1);
+
+        /* the sectors read ahead may be older than the ones flushed */
+        if (queue->ra_count && queue->wb_start < queue->ra_start + queue->ra_count &&
+            queue->wb_start + queue->wb_count > queue->ra_start)
+        {
+            queue->ra_count = 0;
+        }
+        queue->wb_count = 0;
+    }
+
+    return err;
+}
+
+/* flush the merged sectors before the card is read in the range, with the queue locked */
+static rt_err_t mmcsd_queue_flush_range(struct mmcsd_blk_queue *queue,
+                                        rt_uint32_t             sector,
+                                        rt_size_t               blks)
+{
+    if (queue->wb_count && sector < queue->wb_start + queue->wb_count &&
+        sector + blks > queue->wb_start)
+    {
+        return mmcsd_queue_flush(queue);
+    }
+
+    return RT_EOK;
+}
+
+static rt_err_t mmcsd_queue_read(struct mmcsd_blk_queue *queue,
+                                 rt_uint32_t             sector,
+                                 rt_uint8_t             *buf,
+                                 rt_size_t               blks)
+{
+    rt_size_t count;
+    rt_err_t err = RT_EOK;
+
+    rt_mutex_take(&queue->lock, RT_WAITING_FOREVER);
+    queue->stat.reads ++;
+
+    /* grow the window on sequential reads, and drop it on random reads */
+    if (sector == queue->next_sector)
+        queue->ra_window = queue->ra_window ? BLK_MIN(queue->ra_window * 2, RT_MMCSD_RA_MAX_BLKS) : MMCSD_RA_MIN_BLKS;
+    else
+        queue->ra_window = 0;
+    queue->next_sector = sector + blks;
+
+    while (blks)
+    {
+        /* copy the sectors read ahead */
+        if (queue->ra_count && sector >= queue->ra_start && sector < queue->ra_start + queue->ra_count)
+        {
+            count = BLK_MIN(blks, queue->ra_start + queue->ra_count - sector);
+            rt_memcpy(buf, queue->ra_buf + ((sector - queue->ra_start) << 9), count << 9);
+            queue->stat.ra_hits += count;
+        }
+        else if (blks >= queue->ra_window)
+        {
+            /* large enough to read to the buffer of caller directly */
+            err = mmcsd_queue_flush_range(queue, sector, blks);
+            if (err == RT_EOK)
+                err = mmcsd_queue_req(queue, sector, buf, blks, 0);
+            break;
+        }
+        else
+        {
+            /* read the window ahead, it's not beyond the end of card */
+            count = queue->ra_window;
+            if (sector + count > queue->capacity)
+                count = queue->capacity - sector;
+            if (count < blks)
+                count = blks;
+
+            /* the merged sectors are newer than the card in the whole window */
+            queue->ra_count = 0;
+            err = mmcsd_queue_flush_range(queue, sector, count);
+            if (err)
+                break;
+            err = mmcsd_queue_req(queue, sector, queue->ra_buf, count, 0);
+            if (err)
+                break;
+            queue->ra_start = sector;
+            queue->ra_count = count;
+            continue;
+        }
+
+        sector += count;
+        buf += count << 9;
+        blks -= count;
+    }
+
+    rt_mutex_release(&queue->lock);
+
+    return err;
+}
+
+static rt_err_t mmcsd_queue_write(struct mmcsd_blk_queue *queue,
+                                  rt_uint32_t             sector,
+                                  const rt_uint8_t       *buf,
+                                  rt_size_t               blks)
+{
+    rt_err_t err = RT_EOK;
+
+    rt_mutex_take(&queue->lock, RT_WAITING_FOREVER);
+    queue->stat.writes ++;
+
+    /* the sectors read ahead are stale */
+    if (queue->ra_count && sector < queue->ra_start + queue->ra_count &&
+        sector + blks > queue->ra_start)
+    {
+        queue->ra_count = 0;
+    }
+
+    if (queue->wb_count && sector >= queue->wb_start &&
+        sector <= queue->wb_start + queue->wb_count &&
+        sector + blks <= queue->wb_start + RT_MMCSD_WB_BLKS)
+    {
+        /* overwrite or append to the merged sectors */
+        rt_memcpy(queue->wb_buf + ((sector - queue->wb_start) << 9), buf, blks << 9);
+        if (sector + blks > queue->wb_start + queue->wb_count)
+            queue->wb_count = sector + blks - queue->wb_start;
+        queue->stat.merged ++;
+        goto __exit;
+    }
+
+    err = mmcsd_queue_flush(queue);
+    if (err)
+        goto __exit;
+
+    if (blks < RT_MMCSD_WB_BLKS)
+    {
+        /* start merging from this write */
+        rt_memcpy(queue->wb_buf, buf, blks << 9);
+        queue->wb_start = sector;
+        queue->wb_count = blks;
+#ifdef RT_MMCSD_USING_BLK_THREAD
+        rt_sem_release(&queue->sem);
+#endif /* RT_MMCSD_USING_BLK_THREAD */
+    }
+    else
+    {
+        err = mmcsd_queue_req(queue, sector, (rt_uint8_t *)buf, blks, 1);
+    }
+
+__exit:
+    rt_mutex_release(&queue->lock);
+
+    return err;
+}
+
+static rt_err_t mmcsd_queue_sync(struct mmcsd_blk_queue *queue)
+{
+    rt_err_t err;
+
+    rt_mutex_take(&queue->lock, RT_WAITING_FOREVER);
+    err = mmcsd_queue_flush(queue);
+    rt_mutex_release(&queue->lock);
+
+    return err;
+}
+
+#ifdef RT_MMCSD_USING_BLK_THREAD
+static void mmcsd_queue_thread_entry(void *parameter)
+{
+    struct mmcsd_blk_queue *queue = (struct mmcsd_blk_queue *)parameter;
+
+    while (!queue->exit)
+    {
+        /* a write is buffered, flush it after a delay to merge the writes following it */
+        rt_sem_take(&queue->sem, RT_WAITING_FOREVER);
+        rt_thread_mdelay(RT_MMCSD_BLK_FLUSH_MS);
+        while (rt_sem_trytake(&queue->sem) == RT_EOK);
+
+        if (mmcsd_queue_sync(queue) != RT_EOK)
+            LOG_E("mmcsd flush merged writes failed");
+    }
+
+    rt_sem_release(&queue->exit_sem);
+}
+#endif /* RT_MMCSD_USING_BLK_THREAD */
+
+static struct mmcsd_blk_queue *mmcsd_queue_create(struct rt_mmcsd_card *card)
+{
+    struct mmcsd_blk_queue *queue;
+
+    queue = rt_calloc(1, sizeof(struct mmcsd_blk_queue));
+    if (queue == RT_NULL)
+        return RT_NULL;
+
+    queue->ra_buf = rt_malloc(RT_MMCSD_RA_MAX_BLKS << 9);
+    queue->wb_buf = rt_malloc(RT_MMCSD_WB_BLKS << 9);
+    if (queue->ra_buf == RT_NULL || queue->wb_buf == RT_NULL)
+        goto __err;
+
+    queue->card = card;
+    queue->capacity = card->card_capacity * (1024 / 512);
+    queue->max_req_size = BLK_MIN((card->host->max_dma_segs *
+                                   card->host->max_seg_size) >> 9,
+                                  (card->host->max_blk_count *
+                                   card->host->max_blk_size) >> 9);
+    queue->next_sector = (rt_uint32_t)-1;
+    rt_mutex_init(&queue->lock, "mmcsd_q", RT_IPC_FLAG_PRIO);
+
+#ifdef RT_MMCSD_USING_BLK_THREAD
+    rt_sem_init(&queue->sem, "mmcsd_q", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&queue->exit_sem, "mmcsd_q", 0, RT_IPC_FLAG_FIFO);
+    queue->thread = rt_thread_create("mmcsd_q", mmcsd_queue_thread_entry, queue,
+                                     RT_MMCSD_BLK_STACK_SIZE, RT_MMCSD_BLK_THREAD_PRIORITY, 20);
+    if (queue->thread == RT_NULL)
+    {
+        rt_sem_detach(&queue->sem);
+        rt_sem_detach(&queue->exit_sem);
+        rt_mutex_detach(&queue->lock);
+        goto __err;
+    }
+    rt_thread_startup(queue->thread);
+#endif /* RT_MMCSD_USING_BLK_THREAD */
+
+    return queue;
+
+__err:
+    rt_free(queue->ra_buf);
+    rt_free(queue->wb_buf);
+    rt_free(queue);
+
+    return RT_NULL;
+}
+
+static void mmcsd_queue_delete(struct mmcsd_blk_queue *queue)
+{
+#ifdef RT_MMCSD_USING_BLK_THREAD
+    queue->exit = RT_TRUE;
+    rt_sem_release(&queue->sem);
+    rt_sem_take(&queue->exit_sem, RT_WAITING_FOREVER);
+    rt_sem_detach(&queue->sem);
+    rt_sem_detach(&queue->exit_sem);
+#else
+    /* the card may be gone, try it anyway */
+    mmcsd_queue_sync(queue);
+#endif /* RT_MMCSD_USING_BLK_THREAD */
+
+    rt_mutex_detach(&queue->lock);
+    rt_free(queue->ra_buf);
+    rt_free(queue->wb_buf);
+    rt_free(queue);
+}
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
+
 static rt_err_t rt_mmcsd_init(rt_device_t dev)
 {
     return RT_EOK;
@@ -213,7 +603,13 @@ static rt_err_t rt_mmcsd_open(rt_device_t dev, rt_uint16_t oflag)
 
 static rt_err_t rt_mmcsd_close(rt_device_t dev)
 {
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    struct mmcsd_blk_device *blk_dev = (struct mmcsd_blk_device *)dev->user_data;
+
+    return mmcsd_queue_sync(blk_dev->card->blk_queue);
+#else
     return RT_EOK;
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
 }
 
 static rt_err_t rt_mmcsd_control(rt_device_t dev, int cmd, void *args)
@@ -224,6 +620,10 @@ static rt_err_t rt_mmcsd_control(rt_device_t dev, int cmd, void *args)
     case RT_DEVICE_CTRL_BLK_GETGEOME:
         rt_memcpy(args, &blk_dev->geometry, sizeof(struct rt_device_blk_geometry));
         break;
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    case RT_DEVICE_CTRL_BLK_SYNC:
+        return mmcsd_queue_sync(blk_dev->card->blk_queue);
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
     default:
         break;
     }
@@ -236,8 +636,10 @@ static rt_size_t rt_mmcsd_read(rt_device_t dev,
                                rt_size_t   size)
 {
     rt_err_t err = 0;
+#ifndef RT_MMCSD_USING_BLK_QUEUE
     rt_size_t offset = 0;
     rt_size_t req_size = 0;
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
     rt_size_t remain_size = size;
     void *rd_ptr = (void *)buffer;
     struct mmcsd_blk_device *blk_dev = (struct mmcsd_blk_device *)dev->user_data;
@@ -249,6 +651,11 @@ static rt_size_t rt_mmcsd_read(rt_device_t dev,
         return 0;
     }
 
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    err = mmcsd_queue_read(blk_dev->card->blk_queue, part->offset + pos, rd_ptr, size);
+    if (err == RT_EOK)
+        remain_size = 0;
+#else
     rt_sem_take(part->lock, RT_WAITING_FOREVER);
     while (remain_size)
     {
@@ -261,6 +668,7 @@ static rt_size_t rt_mmcsd_read(rt_device_t dev,
         remain_size -= req_size;
     }
     rt_sem_release(part->lock);
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
 
     /* the length of reading must align to SECTOR SIZE */
     if (err)
@@ -277,8 +685,10 @@ static rt_size_t rt_mmcsd_write(rt_device_t dev,
                                 rt_size_t   size)
 {
     rt_err_t err = 0;
+#ifndef RT_MMCSD_USING_BLK_QUEUE
     rt_size_t offset = 0;
     rt_size_t req_size = 0;
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
     rt_size_t remain_size = size;
     void *wr_ptr = (void *)buffer;
     struct mmcsd_blk_device *blk_dev = (struct mmcsd_blk_device *)dev->user_data;
@@ -290,6 +700,11 @@ static rt_size_t rt_mmcsd_write(rt_device_t dev,
         return 0;
     }
 
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    err = mmcsd_queue_write(blk_dev->card->blk_queue, part->offset + pos, wr_ptr, size);
+    if (err == RT_EOK)
+        remain_size = 0;
+#else
     rt_sem_take(part->lock, RT_WAITING_FOREVER);
     while (remain_size)
     {
@@ -302,6 +717,7 @@ static rt_size_t rt_mmcsd_write(rt_device_t dev,
         remain_size -= req_size;
     }
     rt_sem_release(part->lock);
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
 
     /* the length of reading must align to SECTOR SIZE */
     if (err)
@@ -421,6 +837,50 @@ static struct mmcsd_blk_device * rt_mmcsd_create_blkdev(struct rt_mmcsd_card *ca
     return blk_dev;
 }
 
+#if defined(RT_MMCSD_USING_BLK_QUEUE) && defined(RT_USING_FINSH)
+#include <finsh.h>
+
+static void mmcsd_stat(int argc, char **argv)
+{
+    struct mmcsd_blk_device *blk_dev;
+    struct mmcsd_blk_stat stat;
+    struct mmcsd_blk_queue *queue;
+    rt_device_t dev;
+
+    if (argc < 2)
+    {
+        rt_kprintf("Usage: mmcsd_stat <sd device> [reset]\n");
+        return;
+    }
+
+    dev = rt_device_find(argv[1]);
+#ifdef RT_USING_DEVICE_OPS
+    if (dev == RT_NULL || dev->ops != &mmcsd_blk_ops)
+#else
+    if (dev == RT_NULL || dev->read != rt_mmcsd_read)
+#endif
+    {
+        rt_kprintf("mmcsd block device %s not found\n", argv[1]);
+        return;
+    }
+
+    blk_dev = (struct mmcsd_blk_device *)dev->user_data;
+    queue = blk_dev->card->blk_queue;
+
+    rt_mutex_take(&queue->lock, RT_WAITING_FOREVER);
+    stat = queue->stat;
+    if (argc > 2)
+        rt_memset(&queue->stat, 0, sizeof(queue->stat));
+    rt_mutex_release(&queue->lock);
+
+    rt_kprintf("read       %d calls, %d requests, %d sectors read ahead\n",
+               stat.reads, stat.read_reqs, stat.ra_hits);
+    rt_kprintf("write      %d calls, %d requests, %d merged, %d pre-erased\n",
+               stat.writes, stat.write_reqs, stat.merged, stat.pre_erases);
+}
+MSH_CMD_EXPORT(mmcsd_stat, show the request statistics of mmcsd block device);
+#endif /* RT_MMCSD_USING_BLK_QUEUE && RT_USING_FINSH */
+
 rt_int32_t rt_mmcsd_blk_probe(struct rt_mmcsd_card *card)
 {
     rt_int32_t err = 0;
@@ -456,6 +916,15 @@ rt_int32_t rt_mmcsd_blk_probe(struct rt_mmcsd_card *card)
         /* Initial blk_device link-list. */
         rt_list_init(&card->blk_devices);
 
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+        card->blk_queue = mmcsd_queue_create(card);
+        if (card->blk_queue == RT_NULL)
+        {
+            err = -RT_ENOMEM;
+            goto exit_rt_mmcsd_blk_probe;
+        }
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
+
         for (i = 0; i < RT_MMCSD_MAX_PARTITION; i++)
         {
             /* Get the first partition */
@@ -523,4 +992,12 @@ void rt_mmcsd_blk_remove(struct rt_mmcsd_card *card)
             rt_free(blk_dev);
         }
     }
+
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    if (card->blk_queue != RT_NULL)
+    {
+        mmcsd_queue_delete(card->blk_queue);
+        card->blk_queue = RT_NULL;
+    }
+#endif /* RT_MMCSD_USING_BLK_QUEUE */
 }
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2021-06-01     KyleChan     first version
+ * 2022-02-24     RT-Thread    add the DMA ping-pong receive and the buffer chain transmit
  */
 
 #include <rthw.h>
@@ -16,6 +17,24 @@
 #define DBG_LVL    DBG_INFO
 #include <rtdbg.h>
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+#ifndef RT_SERIAL_DMA_PINGPONG_BUFSZ
+#define RT_SERIAL_DMA_PINGPONG_BUFSZ    256
+#endif /* RT_SERIAL_DMA_PINGPONG_BUFSZ */
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
+/* Get the length of the data in the receive fifo of either mode */
+static rt_size_t _serial_rx_data_len(struct rt_serial_device  *serial,
+                                     struct rt_serial_rx_fifo *rx_fifo)
+{
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    if (serial->parent.open_flag & RT_DEVICE_FLAG_DMA_RX)
+        return rt_spsc_ringbuffer_data_len(&(rx_fifo->spsc));
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
+    return rt_ringbuffer_data_len(&(rx_fifo->rb));
+}
+
 #ifdef RT_USING_POSIX_STDIO
 #include <unistd.h>
 #include <fcntl.h>
@@ -161,7 +180,7 @@ static int serial_fops_poll(struct dfs_fd *fd, struct rt_pollreq *req)
 
         level = rt_hw_interrupt_disable();
 
-        if (rt_ringbuffer_data_len(&rx_fifo->rb))
+        if (_serial_rx_data_len(serial, rx_fifo))
             mask |= POLLIN;
         rt_hw_interrupt_enable(level);
     }
@@ -404,7 +423,7 @@ static rt_size_t _serial_fifo_rx(struct rt_device        *dev,
             return 0;
         }
         /* Get the length of the data from the ringbuffer */
-        recv_len = rt_ringbuffer_data_len(&(rx_fifo->rb));
+        recv_len = _serial_rx_data_len(serial, rx_fifo);
 
         if (recv_len < size)
         {
@@ -417,6 +436,14 @@ static rt_size_t _serial_fifo_rx(struct rt_device        *dev,
 
     /* This part of the code is open_flag as RT_SERIAL_RX_NON_BLOCKING */
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    if (dev->open_flag & RT_DEVICE_FLAG_DMA_RX)
+    {
+        /* The interrupt is the only producer of the fifo, no lock is needed */
+        return rt_spsc_ringbuffer_get(&(rx_fifo->spsc), buffer, size);
+    }
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
     level = rt_hw_interrupt_disable();
     /* When open_flag is RT_SERIAL_RX_NON_BLOCKING,
      * the data is retrieved directly from the ringbuffer and returned */
@@ -593,6 +620,139 @@ static rt_size_t _serial_fifo_tx_nonblocking(struct rt_device        *dev,
 }
 
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+/**
+  * @brief Submit a chain of transmit descriptors, the buffers are sent by DMA
+  *        one after another without copy. The transmit is started if the
+  *        serial device is idle.
+  * @param serial RT-thread serial device.
+  * @param chain The first descriptor of the chain, linked by next.
+  * @return Return the status of the operation.
+  */
+static rt_err_t _serial_tx_chain_submit(struct rt_serial_device  *serial,
+                                        struct rt_serial_tx_desc *chain)
+{
+    struct rt_serial_tx_fifo *tx_fifo;
+    struct rt_serial_tx_desc *tail;
+    rt_base_t level;
+    rt_bool_t start;
+
+    tx_fifo = (struct rt_serial_tx_fifo *) serial->serial_tx;
+    if (tx_fifo == RT_NULL || !(serial->parent.open_flag & RT_DEVICE_FLAG_DMA_TX))
+        return -RT_ENOSYS;
+    if (chain == RT_NULL)
+        return -RT_EINVAL;
+
+    for (tail = chain; tail->next != RT_NULL; tail = tail->next)
+    {
+        RT_ASSERT(tail->size > 0);
+    }
+    RT_ASSERT(tail->size > 0);
+
+    level = rt_hw_interrupt_disable();
+    start = (tx_fifo->desc_head == RT_NULL);
+    if (start)
+        tx_fifo->desc_head = chain;
+    else
+        tx_fifo->desc_tail->next = chain;
+    tx_fifo->desc_tail = tail;
+    rt_hw_interrupt_enable(level);
+
+    /* The head can't be done before it's started */
+    if (start)
+    {
+        serial->ops->transmit(serial,
+                              (rt_uint8_t *)chain->buf,
+                              chain->size,
+                              RT_SERIAL_TX_NON_BLOCKING);
+    }
+
+    return RT_EOK;
+}
+
+static void _serial_tx_desc_done(struct rt_serial_device  *serial,
+                                 struct rt_serial_tx_desc *desc)
+{
+    rt_completion_done((struct rt_completion *)desc->user_data);
+}
+
+/**
+  * @brief Serial transmit data routines, This function will transmit
+  *        the data in place by the buffer chain, and wait only once.
+  * @param dev The pointer of device driver structure
+  * @param pos Empty parameter.
+  * @param buffer Transmit data buffer.
+  * @param size Transmit data buffer length.
+  * @return Return the final length of data transmit.
+  */
+static rt_size_t _serial_fifo_tx_chain(struct rt_device        *dev,
+                                              rt_off_t          pos,
+                                        const void             *buffer,
+                                              rt_size_t         size)
+{
+    struct rt_serial_device *serial;
+    struct rt_serial_tx_desc desc;
+    struct rt_completion tx_cpt;
+
+    RT_ASSERT(dev != RT_NULL);
+    if (size == 0) return 0;
+
+    serial = (struct rt_serial_device *)dev;
+    RT_ASSERT((serial != RT_NULL) && (buffer != RT_NULL));
+
+    if (rt_thread_self() == RT_NULL || (serial->parent.open_flag & RT_DEVICE_FLAG_STREAM))
+    {
+        /* using poll tx when the scheduler not startup or in stream mode */
+        return _serial_poll_tx(dev, pos, buffer, size);
+    }
+
+    rt_completion_init(&tx_cpt);
+    desc.next = RT_NULL;
+    desc.buf = (const rt_uint8_t *)buffer;
+    desc.size = size;
+    desc.done = _serial_tx_desc_done;
+    desc.user_data = &tx_cpt;
+
+    if (_serial_tx_chain_submit(serial, &desc) != RT_EOK)
+        return 0;
+
+    /* Waiting for the whole buffer */
+    rt_completion_wait(&tx_cpt, RT_WAITING_FOREVER);
+
+    return size;
+}
+
+/**
+  * @brief Get the statistics of serial device, the rates are of the
+  *        time since the last query.
+  * @param serial RT-thread serial device.
+  * @param stat The statistics got.
+  */
+static void _serial_get_stat(struct rt_serial_device *serial,
+                             struct rt_serial_stat   *stat)
+{
+    rt_base_t level;
+    rt_tick_t elapsed;
+
+    level = rt_hw_interrupt_disable();
+    *stat = serial->stat;
+    elapsed = rt_tick_get() - serial->stat_tick;
+    if (elapsed > 0)
+    {
+        stat->rx_bps = (rt_uint32_t)((rt_uint64_t)(stat->rx_bytes - serial->stat_rx_bytes) *
+                                     RT_TICK_PER_SECOND / elapsed);
+        stat->tx_bps = (rt_uint32_t)((rt_uint64_t)(stat->tx_bytes - serial->stat_tx_bytes) *
+                                     RT_TICK_PER_SECOND / elapsed);
+        serial->stat.rx_bps = stat->rx_bps;
+        serial->stat.tx_bps = stat->tx_bps;
+        serial->stat_tick += elapsed;
+        serial->stat_rx_bytes = stat->rx_bytes;
+        serial->stat_tx_bytes = stat->tx_bytes;
+    }
+    rt_hw_interrupt_enable(level);
+}
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
 /**
   * @brief Enable serial transmit mode.
   * @param dev The pointer of device driver structure
@@ -625,6 +785,32 @@ static rt_err_t rt_serial_tx_enable(struct rt_device        *dev,
         dev->open_flag |= RT_SERIAL_TX_BLOCKING;
         return RT_EOK;
     }
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    if (dev->open_flag & RT_DEVICE_FLAG_DMA_TX)
+    {
+        /* The buffers are sent in place, no software fifo is needed */
+        tx_fifo = (struct rt_serial_tx_fifo *) rt_malloc
+                (sizeof(struct rt_serial_tx_fifo));
+        RT_ASSERT(tx_fifo != RT_NULL);
+
+        rt_memset(tx_fifo, 0, sizeof(struct rt_serial_tx_fifo));
+        rt_completion_init(&(tx_fifo->tx_cpt));
+        serial->serial_tx = tx_fifo;
+
+#ifndef RT_USING_DEVICE_OPS
+        dev->write = _serial_fifo_tx_chain;
+#endif
+
+        dev->open_flag |= tx_oflag;
+        /* Call the control() API to configure the serial device by RT_DEVICE_FLAG_DMA_TX */
+        serial->ops->control(serial,
+                            RT_DEVICE_CTRL_CONFIG,
+                            (void *)RT_DEVICE_FLAG_DMA_TX);
+
+        return RT_EOK;
+    }
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
     /* Limits the minimum value of tx_bufsz */
     if (serial->config.tx_bufsz < RT_SERIAL_TX_MINBUFSZ)
         serial->config.tx_bufsz = RT_SERIAL_TX_MINBUFSZ;
@@ -745,6 +931,38 @@ static rt_err_t rt_serial_rx_enable(struct rt_device        *dev,
     if (serial->config.rx_bufsz < RT_SERIAL_RX_MINBUFSZ)
         serial->config.rx_bufsz = RT_SERIAL_RX_MINBUFSZ;
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    if (dev->open_flag & RT_DEVICE_FLAG_DMA_RX)
+    {
+        rt_size_t fifo_size = RT_ALIGN(serial->config.rx_bufsz, RT_ALIGN_SIZE);
+
+        /* The DMA buffer of two halves follows the fifo */
+        rx_fifo = (struct rt_serial_rx_fifo *) rt_malloc
+                (sizeof(struct rt_serial_rx_fifo) + fifo_size + RT_SERIAL_DMA_PINGPONG_BUFSZ);
+        RT_ASSERT(rx_fifo != RT_NULL);
+
+        rt_memset(&(rx_fifo->rb), 0, sizeof(rx_fifo->rb));
+        rt_spsc_ringbuffer_init(&(rx_fifo->spsc), rx_fifo->buffer, serial->config.rx_bufsz);
+        rx_fifo->dma_buf = rx_fifo->buffer + fifo_size;
+        rx_fifo->dma_size = RT_SERIAL_DMA_PINGPONG_BUFSZ;
+        rx_fifo->dma_pos = 0;
+        rx_fifo->rx_cpt_index = 0;
+        rt_completion_init(&(rx_fifo->rx_cpt));
+
+        serial->serial_rx = rx_fifo;
+
+#ifndef RT_USING_DEVICE_OPS
+        dev->read = _serial_fifo_rx;
+#endif
+
+        dev->open_flag |= rx_oflag;
+        /* Call the dma_rx_start() API to receive by the circular DMA */
+        serial->ops->dma_rx_start(serial, rx_fifo->dma_buf, rx_fifo->dma_size);
+
+        return RT_EOK;
+    }
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
     rx_fifo = (struct rt_serial_rx_fifo *) rt_malloc
             (sizeof(struct rt_serial_rx_fifo) + serial->config.rx_bufsz);
 
@@ -817,6 +1035,17 @@ static rt_err_t rt_serial_rx_disable(struct rt_device        *dev,
                             (void *)RT_SERIAL_RX_BLOCKING);
     } while (0);
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    if (dev->open_flag & RT_DEVICE_FLAG_DMA_RX)
+    {
+        /* Stop the circular DMA before the buffer is freed */
+        dev->open_flag &= ~ RT_DEVICE_FLAG_DMA_RX;
+        serial->ops->control(serial,
+                            RT_DEVICE_CTRL_CLR_INT,
+                            (void *)RT_DEVICE_FLAG_DMA_RX);
+    }
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
     rx_fifo = (struct rt_serial_rx_fifo *)serial->serial_rx;
     RT_ASSERT(rx_fifo != RT_NULL);
     rt_free(rx_fifo);
@@ -849,6 +1078,33 @@ static rt_err_t rt_serial_tx_disable(struct rt_device        *dev,
     tx_fifo = (struct rt_serial_tx_fifo *)serial->serial_tx;
     RT_ASSERT(tx_fifo != RT_NULL);
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    if (dev->open_flag & RT_DEVICE_FLAG_DMA_TX)
+    {
+        struct rt_serial_tx_desc *desc, *next;
+        rt_base_t level;
+
+        dev->open_flag &= ~ RT_DEVICE_FLAG_DMA_TX;
+        serial->ops->control(serial,
+                            RT_DEVICE_CTRL_CLR_INT,
+                            (void *)RT_DEVICE_FLAG_DMA_TX);
+
+        /* The descriptors not sent are done as the port is closed */
+        level = rt_hw_interrupt_disable();
+        desc = tx_fifo->desc_head;
+        tx_fifo->desc_head = tx_fifo->desc_tail = RT_NULL;
+        rt_hw_interrupt_enable(level);
+
+        for (; desc != RT_NULL; desc = next)
+        {
+            next = desc->next;
+            desc->next = RT_NULL;
+            if (desc->done != RT_NULL)
+                desc->done(serial, desc);
+        }
+    }
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
     do
     {
         if (tx_oflag == RT_SERIAL_TX_NON_BLOCKING)
@@ -938,6 +1194,29 @@ static rt_err_t rt_serial_open(struct rt_device *dev, rt_uint16_t oflag)
         (dev->open_flag & RT_DEVICE_FLAG_STREAM))
         dev->open_flag |= RT_DEVICE_FLAG_STREAM;
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    /* The DMA modes are used only if the serial device is capable of them */
+    if ((oflag & RT_DEVICE_FLAG_DMA_RX) && serial->config.rx_bufsz != 0)
+    {
+        if ((dev->flag & RT_DEVICE_FLAG_DMA_RX) && serial->ops->dma_rx_start != RT_NULL)
+            dev->open_flag |= RT_DEVICE_FLAG_DMA_RX;
+        else
+            LOG_W("(%s) serial device can't receive by DMA ping-pong", dev->parent.name);
+    }
+    if ((oflag & RT_DEVICE_FLAG_DMA_TX) && serial->config.tx_bufsz != 0)
+    {
+        if (dev->flag & RT_DEVICE_FLAG_DMA_TX)
+            dev->open_flag |= RT_DEVICE_FLAG_DMA_TX;
+        else
+            LOG_W("(%s) serial device can't transmit by DMA", dev->parent.name);
+    }
+
+    rt_memset(&(serial->stat), 0, sizeof(serial->stat));
+    serial->stat_tick = rt_tick_get();
+    serial->stat_rx_bytes = 0;
+    serial->stat_tx_bytes = 0;
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
     /* initialize the Rx structure according to open flag */
     if (serial->serial_rx == RT_NULL)
         rt_serial_rx_enable(dev, dev->open_flag &
@@ -1030,6 +1309,41 @@ static rt_err_t rt_serial_control(struct rt_device *dev,
 
             break;
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+        case RT_SERIAL_CTRL_GET_STAT:
+            if (args == RT_NULL)
+                return -RT_EINVAL;
+            _serial_get_stat(serial, (struct rt_serial_stat *)args);
+            break;
+
+        case RT_SERIAL_CTRL_TX_CHAIN:
+            ret = _serial_tx_chain_submit(serial, (struct rt_serial_tx_desc *)args);
+            break;
+
+        case RT_SERIAL_CTRL_RX_PEEK:
+        {
+            struct rt_serial_span *span = (struct rt_serial_span *)args;
+            struct rt_serial_rx_fifo *rx_fifo = (struct rt_serial_rx_fifo *)serial->serial_rx;
+
+            if (span == RT_NULL)
+                return -RT_EINVAL;
+            if (rx_fifo == RT_NULL || !(dev->open_flag & RT_DEVICE_FLAG_DMA_RX))
+                return -RT_ENOSYS;
+            span->size = rt_spsc_ringbuffer_peek(&(rx_fifo->spsc), &(span->ptr));
+            break;
+        }
+
+        case RT_SERIAL_CTRL_RX_CONSUME:
+        {
+            struct rt_serial_rx_fifo *rx_fifo = (struct rt_serial_rx_fifo *)serial->serial_rx;
+
+            if (rx_fifo == RT_NULL || !(dev->open_flag & RT_DEVICE_FLAG_DMA_RX))
+                return -RT_ENOSYS;
+            rt_spsc_ringbuffer_consume(&(rx_fifo->spsc), (rt_size_t)(rt_ubase_t)args);
+            break;
+        }
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
         default :
             /* control device */
             ret = serial->ops->control(serial, cmd, args);
@@ -1081,6 +1395,13 @@ static rt_size_t rt_serial_write(struct rt_device *dev,
         return _serial_poll_tx(dev, pos, buffer, size);
     }
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+    if (dev->open_flag & RT_DEVICE_FLAG_DMA_TX)
+    {
+        return _serial_fifo_tx_chain(dev, pos, buffer, size);
+    }
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
     if (dev->open_flag | RT_SERIAL_TX_BLOCKING)
     {
         if ((tx_fifo->rb.buffer_ptr) == RT_NULL)
@@ -1150,6 +1471,135 @@ rt_err_t rt_hw_serial_register(struct rt_serial_device *serial,
     return ret;
 }
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+/* Take the data of the DMA buffer in [from, to) into the receive fifo */
+static void _serial_dma_rx_take(struct rt_serial_device  *serial,
+                                struct rt_serial_rx_fifo *rx_fifo,
+                                rt_size_t from, rt_size_t to)
+{
+    rt_size_t length, put_length;
+
+    length = to - from;
+    put_length = rt_spsc_ringbuffer_put(&(rx_fifo->spsc), rx_fifo->dma_buf + from, length);
+    serial->stat.rx_bytes += put_length;
+    if (put_length < length)
+    {
+        /* The reader is too slow, the bytes not fit are lost */
+        serial->stat.rx_overruns ++;
+        serial->stat.rx_dropped += length - put_length;
+    }
+}
+
+/**
+  * @brief Handle the events of the circular receive DMA. The DMA buffer is
+  *        taken by halves at the half/full transfer events, and to the
+  *        position of the DMA at the idle line event.
+  * @param serial RT-thread serial device.
+  * @param event ISR event type.
+  */
+static void _serial_dma_rx_isr(struct rt_serial_device *serial, int event)
+{
+    struct rt_serial_rx_fifo *rx_fifo;
+    rt_size_t rx_length, pos;
+
+    rx_fifo = (struct rt_serial_rx_fifo *)serial->serial_rx;
+    RT_ASSERT(rx_fifo != RT_NULL);
+
+    switch (event & 0xff)
+    {
+        case RT_SERIAL_EVENT_RX_DMA_HT:
+            pos = rx_fifo->dma_size / 2;
+            /* The idle line event may have taken the first half already */
+            if (rx_fifo->dma_pos >= pos) return;
+            break;
+
+        case RT_SERIAL_EVENT_RX_DMA_TC:
+            pos = rx_fifo->dma_size;
+            break;
+
+        case RT_SERIAL_EVENT_RX_IDLE:
+            pos = (event & (~0xff)) >> 8;
+            if (pos > rx_fifo->dma_size) return;
+            break;
+
+        default:
+            /* The DMA is broken, the data not taken is lost */
+            serial->stat.dma_restarts ++;
+            rx_fifo->dma_pos = 0;
+            serial->ops->dma_rx_start(serial, rx_fifo->dma_buf, rx_fifo->dma_size);
+            return;
+    }
+
+    if (pos < rx_fifo->dma_pos)
+    {
+        /* The DMA has wrapped around since the last event */
+        _serial_dma_rx_take(serial, rx_fifo, rx_fifo->dma_pos, rx_fifo->dma_size);
+        rx_fifo->dma_pos = 0;
+    }
+    if (pos > rx_fifo->dma_pos)
+        _serial_dma_rx_take(serial, rx_fifo, rx_fifo->dma_pos, pos);
+    rx_fifo->dma_pos = (pos == rx_fifo->dma_size) ? 0 : pos;
+
+    /* Get the length of the data from the fifo */
+    rx_length = rt_spsc_ringbuffer_data_len(&(rx_fifo->spsc));
+    if (rx_length == 0) return;
+
+    if (serial->parent.open_flag & RT_SERIAL_RX_BLOCKING)
+    {
+        if (rx_fifo->rx_cpt_index && rx_length >= rx_fifo->rx_cpt_index)
+        {
+            rx_fifo->rx_cpt_index = 0;
+            rt_completion_done(&(rx_fifo->rx_cpt));
+        }
+    }
+    /* Trigger the receiving completion callback */
+    if (serial->parent.rx_indicate != RT_NULL)
+        serial->parent.rx_indicate(&(serial->parent), rx_length);
+}
+
+/* Finish the descriptor sent and start the next one of the chain */
+static void _serial_dma_tx_isr(struct rt_serial_device *serial)
+{
+    struct rt_serial_tx_fifo *tx_fifo;
+    struct rt_serial_tx_desc *desc, *next;
+    rt_base_t level;
+
+    tx_fifo = (struct rt_serial_tx_fifo *)serial->serial_tx;
+    RT_ASSERT(tx_fifo != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    desc = tx_fifo->desc_head;
+    if (desc == RT_NULL)
+    {
+        rt_hw_interrupt_enable(level);
+        return;
+    }
+    next = desc->next;
+    tx_fifo->desc_head = next;
+    if (next == RT_NULL)
+        tx_fifo->desc_tail = RT_NULL;
+    serial->stat.tx_bytes += desc->size;
+    rt_hw_interrupt_enable(level);
+
+    /* The next buffer is started before the done callback to keep the line busy */
+    if (next != RT_NULL)
+    {
+        serial->ops->transmit(serial,
+                              (rt_uint8_t *)next->buf,
+                              next->size,
+                              RT_SERIAL_TX_NON_BLOCKING);
+    }
+
+    desc->next = RT_NULL;
+    if (desc->done != RT_NULL)
+        desc->done(serial, desc);
+
+    /* Trigger the transmit completion callback when the chain is drained */
+    if (next == RT_NULL && serial->parent.tx_complete != RT_NULL)
+        serial->parent.tx_complete(&serial->parent, RT_NULL);
+}
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
 /**
   * @brief ISR for serial interrupt
   * @param serial RT-thread serial device.
@@ -1161,6 +1611,16 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
 
     switch (event & 0xff)
     {
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+        /* Circular DMA receive event */
+        case RT_SERIAL_EVENT_RX_DMA_HT:
+        case RT_SERIAL_EVENT_RX_DMA_TC:
+        case RT_SERIAL_EVENT_RX_IDLE:
+        case RT_SERIAL_EVENT_RX_DMA_ERR:
+            _serial_dma_rx_isr(serial, event);
+            break;
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
         /* Interrupt receive event */
         case RT_SERIAL_EVENT_RX_IND:
         case RT_SERIAL_EVENT_RX_DMADONE:
@@ -1237,6 +1697,14 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
             tx_fifo = (struct rt_serial_tx_fifo *)serial->serial_tx;
             RT_ASSERT(tx_fifo != RT_NULL);
 
+#ifdef RT_SERIAL_USING_DMA_PINGPONG
+            if (serial->parent.open_flag & RT_DEVICE_FLAG_DMA_TX)
+            {
+                _serial_dma_tx_isr(serial);
+                break;
+            }
+#endif /* RT_SERIAL_USING_DMA_PINGPONG */
+
             tx_fifo->activated = RT_FALSE;
 
             /* Trigger the transmit completion callback */
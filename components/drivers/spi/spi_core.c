@@ -11,13 +11,57 @@
  * 2012-05-18     bernard      Changed SPI message to message list.
  *                             Added take/release SPI device/bus interface.
  * 2012-09-28     aozima       fixed rt_spi_release_bus assert error.
+ * 2022-02-24     RT-Thread    add the asynchronous queued transfer and bus statistics.
+ * 2022-02-24     RT-Thread    track the busy bus by the lock nest, bound the wait with chip select held.
  */
 
+#include <rthw.h>
 #include <drivers/spi.h>
 
+#define DBG_TAG    "spi.core"
+#define DBG_LVL    DBG_INFO
+#include <rtdbg.h>
+
 extern rt_err_t rt_spi_bus_device_init(struct rt_spi_bus *bus, const char *name);
 extern rt_err_t rt_spidev_device_init(struct rt_spi_device *dev, const char *name);
 
+#ifdef RT_SPI_USING_ASYNC
+static void _spi_async_entry(void *parameter);
+
+/* take the bus lock, the busy time of bus is counted from the outermost take */
+static rt_err_t _spi_bus_lock(struct rt_spi_bus *bus)
+{
+    rt_err_t result;
+    rt_base_t level;
+
+    result = rt_mutex_take(&(bus->lock), RT_WAITING_FOREVER);
+    if (result == RT_EOK)
+    {
+        level = rt_hw_interrupt_disable();
+        if (bus->lock_nest++ == 0)
+            bus->lock_tick = rt_tick_get();
+        rt_hw_interrupt_enable(level);
+    }
+
+    return result;
+}
+
+static void _spi_bus_unlock(struct rt_spi_bus *bus)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (--bus->lock_nest == 0)
+        bus->stat.busy_ticks += rt_tick_get() - bus->lock_tick;
+    rt_hw_interrupt_enable(level);
+
+    rt_mutex_release(&(bus->lock));
+}
+#else
+#define _spi_bus_lock(bus)      rt_mutex_take(&((bus)->lock), RT_WAITING_FOREVER)
+#define _spi_bus_unlock(bus)    rt_mutex_release(&((bus)->lock))
+#endif /* RT_SPI_USING_ASYNC */
+
 rt_err_t rt_spi_bus_register(struct rt_spi_bus       *bus,
                              const char              *name,
                              const struct rt_spi_ops *ops)
@@ -37,6 +81,23 @@ rt_err_t rt_spi_bus_register(struct rt_spi_bus       *bus,
     /* set bus mode */
     bus->mode = RT_SPI_BUS_MODE_SPI;
 
+#ifdef RT_SPI_USING_ASYNC
+    rt_list_init(&(bus->async_pending));
+    bus->lock_nest = 0;
+    rt_memset(&(bus->stat), 0, sizeof(bus->stat));
+    bus->stat.start_tick = rt_tick_get();
+    rt_sem_init(&(bus->async_sem), name, 0, RT_IPC_FLAG_FIFO);
+
+    /* the worker thread transfers the async messages of the bus */
+    bus->async_thread = rt_thread_create(name, _spi_async_entry, bus,
+                                         RT_SPI_ASYNC_STACK_SIZE,
+                                         RT_SPI_ASYNC_THREAD_PRIORITY, 20);
+    if (bus->async_thread != RT_NULL)
+        rt_thread_startup(bus->async_thread);
+    else
+        LOG_W("spi bus %s: create async thread failed", name);
+#endif /* RT_SPI_USING_ASYNC */
+
     return RT_EOK;
 }
 
@@ -61,6 +122,10 @@ rt_err_t rt_spi_bus_attach_device(struct rt_spi_device *device,
 
         rt_memset(&device->config, 0, sizeof(device->config));
         device->parent.user_data = user_data;
+#ifdef RT_SPI_USING_ASYNC
+        rt_list_init(&(device->async_queue));
+        rt_list_init(&(device->async_node));
+#endif /* RT_SPI_USING_ASYNC */
 
         return RT_EOK;
     }
@@ -83,7 +148,7 @@ rt_err_t rt_spi_configure(struct rt_spi_device        *device,
 
     if (device->bus != RT_NULL)
     {
-        result = rt_mutex_take(&(device->bus->lock), RT_WAITING_FOREVER);
+        result = _spi_bus_lock(device->bus);
         if (result == RT_EOK)
         {
             if (device->bus->owner == device)
@@ -92,7 +157,7 @@ rt_err_t rt_spi_configure(struct rt_spi_device        *device,
             }
 
             /* release lock */
-            rt_mutex_release(&(device->bus->lock));
+            _spi_bus_unlock(device->bus);
         }
     }
 
@@ -111,7 +176,7 @@ rt_err_t rt_spi_send_then_send(struct rt_spi_device *device,
     RT_ASSERT(device != RT_NULL);
     RT_ASSERT(device->bus != RT_NULL);
 
-    result = rt_mutex_take(&(device->bus->lock), RT_WAITING_FOREVER);
+    result = _spi_bus_lock(device->bus);
     if (result == RT_EOK)
     {
         if (device->bus->owner != device)
@@ -169,7 +234,7 @@ rt_err_t rt_spi_send_then_send(struct rt_spi_device *device,
     }
 
 __exit:
-    rt_mutex_release(&(device->bus->lock));
+    _spi_bus_unlock(device->bus);
 
     return result;
 }
@@ -186,7 +251,7 @@ rt_err_t rt_spi_send_then_recv(struct rt_spi_device *device,
     RT_ASSERT(device != RT_NULL);
     RT_ASSERT(device->bus != RT_NULL);
 
-    result = rt_mutex_take(&(device->bus->lock), RT_WAITING_FOREVER);
+    result = _spi_bus_lock(device->bus);
     if (result == RT_EOK)
     {
         if (device->bus->owner != device)
@@ -244,7 +309,7 @@ rt_err_t rt_spi_send_then_recv(struct rt_spi_device *device,
     }
 
 __exit:
-    rt_mutex_release(&(device->bus->lock));
+    _spi_bus_unlock(device->bus);
 
     return result;
 }
@@ -260,7 +325,7 @@ rt_size_t rt_spi_transfer(struct rt_spi_device *device,
     RT_ASSERT(device != RT_NULL);
     RT_ASSERT(device->bus != RT_NULL);
 
-    result = rt_mutex_take(&(device->bus->lock), RT_WAITING_FOREVER);
+    result = _spi_bus_lock(device->bus);
     if (result == RT_EOK)
     {
         if (device->bus->owner != device)
@@ -305,7 +370,7 @@ rt_size_t rt_spi_transfer(struct rt_spi_device *device,
     }
 
 __exit:
-    rt_mutex_release(&(device->bus->lock));
+    _spi_bus_unlock(device->bus);
 
     return result;
 }
@@ -323,7 +388,7 @@ struct rt_spi_message *rt_spi_transfer_message(struct rt_spi_device  *device,
     if (index == RT_NULL)
         return index;
 
-    result = rt_mutex_take(&(device->bus->lock), RT_WAITING_FOREVER);
+    result = _spi_bus_lock(device->bus);
     if (result != RT_EOK)
     {
         rt_set_errno(-RT_EBUSY);
@@ -368,7 +433,7 @@ struct rt_spi_message *rt_spi_transfer_message(struct rt_spi_device  *device,
 
 __exit:
     /* release bus lock */
-    rt_mutex_release(&(device->bus->lock));
+    _spi_bus_unlock(device->bus);
 
     return index;
 }
@@ -380,7 +445,7 @@ rt_err_t rt_spi_take_bus(struct rt_spi_device *device)
     RT_ASSERT(device != RT_NULL);
     RT_ASSERT(device->bus != RT_NULL);
 
-    result = rt_mutex_take(&(device->bus->lock), RT_WAITING_FOREVER);
+    result = _spi_bus_lock(device->bus);
     if (result != RT_EOK)
     {
         rt_set_errno(-RT_EBUSY);
@@ -406,7 +471,7 @@ rt_err_t rt_spi_take_bus(struct rt_spi_device *device)
             /* configure SPI bus failed */
             rt_set_errno(-RT_EIO);
             /* release lock */
-            rt_mutex_release(&(device->bus->lock));
+            _spi_bus_unlock(device->bus);
 
             return -RT_EIO;
         }
@@ -422,7 +487,7 @@ rt_err_t rt_spi_release_bus(struct rt_spi_device *device)
     RT_ASSERT(device->bus->owner == device);
 
     /* release lock */
-    rt_mutex_release(&(device->bus->lock));
+    _spi_bus_unlock(device->bus);
 
     return RT_EOK;
 }
@@ -458,3 +523,259 @@ rt_err_t rt_spi_release(struct rt_spi_device *device)
 
     return result;
 }
+
+#ifdef RT_SPI_USING_ASYNC
+rt_err_t rt_spi_transfer_message_async(struct rt_spi_device        *device,
+                                       struct rt_spi_async_message *async)
+{
+    struct rt_spi_bus *bus;
+    rt_base_t level;
+
+    RT_ASSERT(device != RT_NULL);
+    RT_ASSERT(device->bus != RT_NULL);
+    RT_ASSERT(async != RT_NULL);
+
+    bus = device->bus;
+    if (bus->async_thread == RT_NULL)
+        return -RT_ENOSYS;
+    if (async->message == RT_NULL)
+        return -RT_EINVAL;
+
+    async->failed = RT_NULL;
+    async->result = RT_EOK;
+
+    level = rt_hw_interrupt_disable();
+    rt_list_insert_before(&(device->async_queue), &(async->list));
+    /* the device is served after the devices queued before */
+    if (rt_list_isempty(&(device->async_node)))
+        rt_list_insert_before(&(bus->async_pending), &(device->async_node));
+    bus->stat.async_queued ++;
+    if (bus->stat.async_queued > bus->stat.async_queued_max)
+        bus->stat.async_queued_max = bus->stat.async_queued;
+    rt_hw_interrupt_enable(level);
+
+    rt_sem_release(&(bus->async_sem));
+
+    return RT_EOK;
+}
+
+static struct rt_spi_device *_spi_async_next_device(struct rt_spi_bus *bus)
+{
+    struct rt_spi_device *device = RT_NULL;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (!rt_list_isempty(&(bus->async_pending)))
+    {
+        device = rt_list_entry(bus->async_pending.next, struct rt_spi_device, async_node);
+        rt_list_remove(&(device->async_node));
+    }
+    rt_hw_interrupt_enable(level);
+
+    return device;
+}
+
+static struct rt_spi_async_message *_spi_async_pop(struct rt_spi_device *device)
+{
+    struct rt_spi_async_message *async = RT_NULL;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (!rt_list_isempty(&(device->async_queue)))
+    {
+        async = rt_list_entry(device->async_queue.next, struct rt_spi_async_message, list);
+        rt_list_remove(&(async->list));
+        device->bus->stat.async_queued --;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return async;
+}
+
+/* transfer the message list of async, return whether the chip select is held after it */
+static rt_bool_t _spi_async_xfer(struct rt_spi_device        *device,
+                                 struct rt_spi_async_message *async,
+                                 rt_err_t                     configured,
+                                 rt_bool_t                    cs_held)
+{
+    struct rt_spi_bus *bus = device->bus;
+    struct rt_spi_message *index;
+    rt_uint32_t bytes = 0;
+    rt_base_t level;
+
+    if (configured != RT_EOK)
+    {
+        async->failed = async->message;
+        async->result = -RT_EIO;
+        cs_held = RT_FALSE;
+    }
+    for (index = async->message; configured == RT_EOK && index != RT_NULL; index = index->next)
+    {
+        /* a message only taking or releasing the chip select transfers nothing */
+        if (bus->ops->xfer(device, index) == 0 && index->length != 0)
+        {
+            async->failed = index;
+            async->result = -RT_EIO;
+            cs_held = RT_FALSE;
+            break;
+        }
+
+        bytes += index->length;
+        if (index->cs_take)
+            cs_held = RT_TRUE;
+        if (index->cs_release)
+            cs_held = RT_FALSE;
+    }
+
+    level = rt_hw_interrupt_disable();
+    bus->stat.async_messages ++;
+    bus->stat.async_bytes += bytes;
+    if (async->result != RT_EOK)
+        bus->stat.async_errors ++;
+    rt_hw_interrupt_enable(level);
+
+    return cs_held;
+}
+
+static void _spi_async_entry(void *parameter)
+{
+    struct rt_spi_bus *bus = (struct rt_spi_bus *)parameter;
+    struct rt_spi_device *device;
+    struct rt_spi_async_message *async;
+    rt_err_t configured;
+    rt_bool_t cs_held;
+    rt_uint32_t count;
+    rt_tick_t cs_wait, cs_tick = 0, elapsed;
+    rt_base_t level;
+
+    cs_wait = rt_tick_from_millisecond(RT_SPI_ASYNC_CS_WAIT);
+    while (1)
+    {
+        rt_sem_take(&(bus->async_sem), RT_WAITING_FOREVER);
+
+        while ((device = _spi_async_next_device(bus)) != RT_NULL)
+        {
+            if (rt_list_isempty(&(device->async_queue)))
+                continue;
+
+            _spi_bus_lock(bus);
+
+            configured = RT_EOK;
+            if (bus->owner != device)
+            {
+                /* not the same owner as current, re-configure SPI bus */
+                configured = bus->ops->configure(device, &device->config);
+                if (configured == RT_EOK)
+                    bus->owner = device;
+            }
+
+            /* transfer the messages of device back-to-back in one hold of the bus */
+            cs_held = RT_FALSE;
+            count = 0;
+            while (1)
+            {
+                async = _spi_async_pop(device);
+                if (async == RT_NULL)
+                {
+                    if (!cs_held)
+                        break;
+
+                    /*
+                     * The chip select is held, wait a while for the next messages of the
+                     * device. The bus is given up on timeout rather than blocking the
+                     * other users of bus forever, the device is served again on its next
+                     * message.
+                     */
+                    elapsed = rt_tick_get() - cs_tick;
+                    if (elapsed >= cs_wait)
+                        break;
+                    rt_sem_take(&(bus->async_sem), cs_wait - elapsed);
+                    continue;
+                }
+
+                cs_held = _spi_async_xfer(device, async, configured, cs_held);
+                cs_tick = rt_tick_get();
+                if (async->done != RT_NULL)
+                    async->done(device, async);
+
+                if (++count >= RT_SPI_ASYNC_BATCH && !cs_held)
+                    break;
+            }
+
+            _spi_bus_unlock(bus);
+
+            /* serve the rest of device after the other devices */
+            level = rt_hw_interrupt_disable();
+            if (!rt_list_isempty(&(device->async_queue)) && rt_list_isempty(&(device->async_node)))
+                rt_list_insert_before(&(bus->async_pending), &(device->async_node));
+            rt_hw_interrupt_enable(level);
+        }
+    }
+}
+
+void rt_spi_bus_get_stat(struct rt_spi_bus      *bus,
+                         struct rt_spi_bus_stat *stat,
+                         rt_bool_t               reset)
+{
+    rt_tick_t tick;
+    rt_base_t level;
+
+    RT_ASSERT(bus != RT_NULL);
+    RT_ASSERT(stat != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    tick = rt_tick_get();
+    *stat = bus->stat;
+    /* the bus is held now */
+    if (bus->lock_nest != 0)
+        stat->busy_ticks += tick - bus->lock_tick;
+
+    if (reset)
+    {
+        bus->stat.start_tick = tick;
+        bus->stat.busy_ticks = 0;
+        bus->stat.async_messages = 0;
+        bus->stat.async_errors = 0;
+        bus->stat.async_bytes = 0;
+        bus->stat.async_queued_max = bus->stat.async_queued;
+        bus->lock_tick = tick;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+
+static void spi_stat(int argc, char **argv)
+{
+    struct rt_spi_bus_stat stat;
+    rt_device_t bus;
+    rt_tick_t elapsed;
+
+    if (argc < 2)
+    {
+        rt_kprintf("Usage: spi_stat <bus> [reset]\n");
+        return;
+    }
+
+    bus = rt_device_find(argv[1]);
+    if (bus == RT_NULL || bus->type != RT_Device_Class_SPIBUS)
+    {
+        rt_kprintf("spi bus %s not found\n", argv[1]);
+        return;
+    }
+
+    rt_spi_bus_get_stat((struct rt_spi_bus *)bus, &stat, argc > 2);
+    elapsed = rt_tick_get() - stat.start_tick;
+
+    rt_kprintf("busy       %d.%d%% of %d ticks\n",
+               elapsed ? (rt_uint32_t)((rt_uint64_t)stat.busy_ticks * 100 / elapsed) : 0,
+               elapsed ? (rt_uint32_t)((rt_uint64_t)stat.busy_ticks * 1000 / elapsed % 10) : 0,
+               elapsed);
+    rt_kprintf("async      %d messages, %d errors, %d bytes\n",
+               stat.async_messages, stat.async_errors, stat.async_bytes);
+    rt_kprintf("queued     %d, max %d\n", stat.async_queued, stat.async_queued_max);
+}
+MSH_CMD_EXPORT(spi_stat, show the statistics of spi bus);
+#endif /* RT_USING_FINSH */
+#endif /* RT_SPI_USING_ASYNC */
@@ -29,11 +29,15 @@
  * 2018-12-27     Jesven       Fix the problem that disable interrupt too long in list_thread
  *                             Provide protection for the "first layer of objects" when list_*
  * 2020-04-07     chenhui      add clear
+ * 2022-02-24     RT-Thread    add top
+ * 2022-02-24     RT-Thread    show the stack high-water mark of threads
+ * 2022-02-24     RT-Thread    add list_cpu
  */
 
 #include <rthw.h>
 #include <rtthread.h>
 #include <string.h>
+#include <stdlib.h>
 
 #ifdef RT_USING_FINSH
 #include <finsh.h>
@@ -199,7 +203,9 @@ long list_thread(void)
                 thread = (struct rt_thread *)obj;
                 {
                     rt_uint8_t stat;
+#ifndef RT_USING_STACK_WATERMARK
                     rt_uint8_t *ptr;
+#endif /* RT_USING_STACK_WATERMARK */
 
 #ifdef RT_USING_SMP
                     if (thread->oncpu != RT_CPU_DETACHED)
@@ -217,7 +223,19 @@ long list_thread(void)
                     else if (stat == RT_THREAD_CLOSE)   rt_kprintf(" close  ");
                     else if (stat == RT_THREAD_RUNNING) rt_kprintf(" running");
 
+#if defined(RT_USING_STACK_WATERMARK)
+                    /* only the stack used since the last update is scanned */
+                    rt_kprintf(" 0x%08x 0x%08x    %02d%%   0x%08x %03d\n",
 #if defined(ARCH_CPU_STACK_GROWS_UPWARD)
+                               ((rt_ubase_t)thread->sp - (rt_ubase_t)thread->stack_addr),
+#else
+                               thread->stack_size + ((rt_ubase_t)thread->stack_addr - (rt_ubase_t)thread->sp),
+#endif /* ARCH_CPU_STACK_GROWS_UPWARD */
+                               thread->stack_size,
+                               rt_thread_stack_watermark(thread, 0) * 100 / thread->stack_size,
+                               thread->remaining_tick,
+                               thread->error);
+#elif defined(ARCH_CPU_STACK_GROWS_UPWARD)
                     ptr = (rt_uint8_t *)thread->stack_addr + thread->stack_size - 1;
                     while (*ptr == '#')ptr --;
 
@@ -249,6 +267,237 @@ long list_thread(void)
 }
 MSH_CMD_EXPORT(list_thread, list thread);
 
+#ifdef RT_USING_SMP
+long list_cpu(void)
+{
+    int cpu;
+    struct rt_cpu *pcpu;
+    struct rt_thread *thread;
+    const char *item_title = "thread";
+    int maxlen = RT_NAME_MAX;
+
+    rt_kprintf("cpu %-*.s pri  ipi sent   coalesced  received\n", maxlen, item_title);
+    rt_kprintf("--- ");
+    object_split(maxlen);
+    rt_kprintf(" ---  ---------- ---------- ----------\n");
+
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu++)
+    {
+        pcpu = rt_cpu_index(cpu);
+        thread = pcpu->current_thread;
+
+        rt_kprintf("%3d %-*.*s %3d  %10d %10d %10d\n", cpu, maxlen, RT_NAME_MAX,
+                   thread != RT_NULL ? thread->name : "-", pcpu->current_priority,
+                   pcpu->ipi_sent, pcpu->ipi_coalesced, pcpu->ipi_received);
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(list_cpu, list cpu and the schedule IPIs);
+#endif /* RT_USING_SMP */
+
+#ifdef RT_USING_CPU_USAGE
+#ifdef RT_USING_CPUTIME
+#include <rtdevice.h>
+#endif /* RT_USING_CPUTIME */
+
+/* the threads created after the first sample */
+#define TOP_THREAD_EXTRA 8
+
+struct top_sample
+{
+    rt_thread_t thread;
+    char name[RT_NAME_MAX];
+    rt_uint8_t priority;
+    struct rt_thread_usage usage;
+    rt_uint64_t run;            /* the running time in the interval */
+};
+
+static int top_sample_take(struct top_sample *samples, rt_object_t *objects, int max)
+{
+    int i, nr;
+
+    /* the threads deleted are not freed before the sample is done */
+    rt_enter_critical();
+    nr = rt_object_get_pointers(RT_Object_Class_Thread, objects, max);
+    for (i = 0; i < nr; i++)
+    {
+        samples[i].thread = (rt_thread_t)objects[i];
+        rt_strncpy(samples[i].name, objects[i]->name, RT_NAME_MAX);
+        samples[i].priority = samples[i].thread->current_priority;
+        rt_thread_get_usage(samples[i].thread, &samples[i].usage);
+    }
+    rt_exit_critical();
+
+    return nr;
+}
+
+static rt_uint32_t top_to_us(rt_uint64_t time)
+{
+#ifdef RT_USING_CPUTIME
+    /* nanoseconds per count */
+    return (rt_uint32_t)(time * clock_cpu_getres() / 1000);
+#else
+    return (rt_uint32_t)(time * (1000000 / RT_TICK_PER_SECOND));
+#endif /* RT_USING_CPUTIME */
+}
+
+static void top_show(struct top_sample *prev, int prev_nr, struct top_sample *cur, int cur_nr,
+                     rt_uint64_t interval)
+{
+    int i, j;
+    rt_uint32_t load, irq, vcsw, ivcsw;
+    rt_uint64_t wait, total;
+    struct top_sample *old, tmp;
+
+    /* the usage of the interval, a new thread has no previous sample */
+    for (i = 0; i < cur_nr; i++)
+    {
+        cur[i].run = cur[i].usage.run_time;
+        for (j = 0; j < prev_nr; j++)
+        {
+            if (prev[j].thread == cur[i].thread)
+            {
+                cur[i].run -= prev[j].usage.run_time;
+                break;
+            }
+        }
+    }
+
+    /* sort by the running time */
+    for (i = 1; i < cur_nr; i++)
+    {
+        tmp = cur[i];
+        for (j = i; j > 0 && cur[j - 1].run < tmp.run; j--)
+        {
+            cur[j] = cur[j - 1];
+        }
+        cur[j] = tmp;
+    }
+
+#ifdef RT_USING_SMP
+    total = interval * RT_CPUS_NR;
+#else
+    total = interval;
+#endif /* RT_USING_SMP */
+    if (total == 0)
+    {
+        total = 1;
+    }
+
+    rt_kprintf("top - %d threads, interval %d us\n", cur_nr, top_to_us(interval));
+    rt_kprintf("%-*.s pri  %%cpu  %%irq   wait(us)    vcsw   ivcsw   total(ms)\n", RT_NAME_MAX, "thread");
+    object_split(RT_NAME_MAX);
+    rt_kprintf(" --- ----- ----- ---------- ------- ------- -----------\n");
+    for (i = 0; i < cur_nr; i++)
+    {
+        old = RT_NULL;
+        for (j = 0; j < prev_nr; j++)
+        {
+            if (prev[j].thread == cur[i].thread)
+            {
+                old = &prev[j];
+                break;
+            }
+        }
+
+        /* permille of the cpu time */
+        load  = (rt_uint32_t)(cur[i].run * 1000 / total);
+        irq   = (rt_uint32_t)((cur[i].usage.irq_time - (old ? old->usage.irq_time : 0)) * 1000 / total);
+        wait  = cur[i].usage.wait_time - (old ? old->usage.wait_time : 0);
+        vcsw  = cur[i].usage.voluntary_switches - (old ? old->usage.voluntary_switches : 0);
+        ivcsw = cur[i].usage.involuntary_switches - (old ? old->usage.involuntary_switches : 0);
+
+        rt_kprintf("%-*.*s %3d %3d.%d %3d.%d %10d %7d %7d %11d\n", RT_NAME_MAX, RT_NAME_MAX,
+                   cur[i].name, cur[i].priority, load / 10, load % 10, irq / 10, irq % 10,
+                   top_to_us(wait), vcsw, ivcsw, top_to_us(cur[i].usage.run_time) / 1000);
+    }
+}
+
+static long top(int argc, char **argv)
+{
+    int i, max, prev_nr, cur_nr;
+    int delay = 1000, count = 1;
+    rt_bool_t refresh;
+    struct top_sample *prev, *cur, *swap;
+    rt_object_t *objects;
+    rt_uint64_t start, now;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        {
+            delay = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            count = atoi(argv[++i]);
+        }
+        else
+        {
+            rt_kprintf("Usage: top [-d delay_ms] [-n count]\n");
+            return -RT_EINVAL;
+        }
+    }
+    if (delay <= 0 || count <= 0)
+    {
+        rt_kprintf("Usage: top [-d delay_ms] [-n count]\n");
+        return -RT_EINVAL;
+    }
+
+#ifdef RT_USING_CPUTIME
+    if (clock_cpu_getres() <= 0)
+    {
+        rt_kprintf("no cputime clock for the cpu usage.\n");
+        return -RT_ERROR;
+    }
+#endif /* RT_USING_CPUTIME */
+
+    max = rt_object_get_length(RT_Object_Class_Thread) + TOP_THREAD_EXTRA;
+    prev = (struct top_sample *)rt_malloc(sizeof(struct top_sample) * max);
+    cur = (struct top_sample *)rt_malloc(sizeof(struct top_sample) * max);
+    objects = (rt_object_t *)rt_malloc(sizeof(rt_object_t) * max);
+    if (prev == RT_NULL || cur == RT_NULL || objects == RT_NULL)
+    {
+        rt_kprintf("no memory for top.\n");
+        rt_free(prev);
+        rt_free(cur);
+        rt_free(objects);
+        return -RT_ENOMEM;
+    }
+
+    refresh = count > 1;
+    prev_nr = top_sample_take(prev, objects, max);
+    start = rt_thread_usage_clock();
+    while (count--)
+    {
+        rt_thread_mdelay(delay);
+
+        cur_nr = top_sample_take(cur, objects, max);
+        now = rt_thread_usage_clock();
+
+        if (refresh)
+        {
+            clear();
+        }
+        top_show(prev, prev_nr, cur, cur_nr, now - start);
+
+        swap = prev;
+        prev = cur;
+        cur = swap;
+        prev_nr = cur_nr;
+        start = now;
+    }
+
+    rt_free(prev);
+    rt_free(cur);
+    rt_free(objects);
+
+    return 0;
+}
+MSH_CMD_EXPORT(top, show the cpu usage of threads);
+#endif /* RT_USING_CPU_USAGE */
+
 static void show_wait_queue(struct rt_list_node *list)
 {
     struct rt_thread *thread;
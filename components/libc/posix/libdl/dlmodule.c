@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author      Notes
  * 2018/08/29     Bernard     first version
+ * 2022/02/24     RT-Thread   rename the module by rt_object_set_name
  */
 
 #include <rthw.h>
@@ -36,10 +37,9 @@ static struct rt_module_symtab *_rt_module_symtab_end   = RT_NULL;
 static void _dlmodule_set_name(struct rt_dlmodule *module, const char *path)
 {
     int size;
-    struct rt_object *object;
+    char name[RT_NAME_MAX + 1];
     const char *first, *end, *ptr;
 
-    object = &(module->parent);
     ptr   = first = (char *)path;
     end   = path + rt_strlen(path);
 
@@ -56,8 +56,11 @@ static void _dlmodule_set_name(struct rt_dlmodule *module, const char *path)
     size = end - first + 1;
     if (size > RT_NAME_MAX) size = RT_NAME_MAX;
 
-    rt_strncpy(object->name, first, size);
-    object->name[size] = '\0';
+    rt_strncpy(name, first, size);
+    name[size] = '\0';
+
+    /* the module is filed under the new name to be found */
+    rt_object_set_name(&(module->parent), name);
 }
 
 #define RT_MODULE_ARG_MAX    8
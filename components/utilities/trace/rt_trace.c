@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rt_trace.h>
+#include <string.h>
+#ifdef RT_USING_CPUTIME
+#include <rtdevice.h>
+#endif /* RT_USING_CPUTIME */
+#if defined(RT_USING_FINSH) && defined(DFS_USING_POSIX)
+#include <dfs_file.h>
+#include <unistd.h>
+#endif /* defined(RT_USING_FINSH) && defined(DFS_USING_POSIX) */
+
+/*
+ * Every cpu writes the records to its own ring with only the local interrupt
+ * disabled, the oldest records are overwritten when the ring is full. The
+ * rings are read by the dump after the trace is stopped; the oldest record
+ * of a full ring is skipped as another cpu may be still writing it.
+ */
+#if (RT_TRACE_BUF_RECORDS & (RT_TRACE_BUF_RECORDS - 1)) != 0
+#error "RT_TRACE_BUF_RECORDS must be power of 2"
+#endif
+#define TRACE_MASK              (RT_TRACE_BUF_RECORDS - 1)
+
+#ifdef RT_USING_SMP
+#define TRACE_CPUS_NR           RT_CPUS_NR
+#define _trace_cpu_id()         rt_hw_cpu_id()
+#define _trace_lock()           rt_hw_local_irq_disable()
+#define _trace_unlock(level)    rt_hw_local_irq_enable(level)
+#else
+#define TRACE_CPUS_NR           1
+#define _trace_cpu_id()         0
+#define _trace_lock()           rt_hw_interrupt_disable()
+#define _trace_unlock(level)    rt_hw_interrupt_enable(level)
+#endif /* RT_USING_SMP */
+
+struct trace_ring
+{
+    rt_uint32_t head;                                   /* the count of records written */
+    struct rt_trace_record records[RT_TRACE_BUF_RECORDS];
+};
+
+static struct trace_ring _trace_rings[TRACE_CPUS_NR];
+static volatile rt_bool_t _trace_started = RT_FALSE;
+
+/* the objects which are named in the dump */
+static const rt_uint8_t _trace_name_types[] =
+{
+    RT_Object_Class_Thread,
+#ifdef RT_USING_SEMAPHORE
+    RT_Object_Class_Semaphore,
+#endif /* RT_USING_SEMAPHORE */
+#ifdef RT_USING_MUTEX
+    RT_Object_Class_Mutex,
+#endif /* RT_USING_MUTEX */
+    RT_Object_Class_Timer,
+};
+
+#define TRACE_NAME_SIZE         (8 + RT_NAME_MAX)
+
+static rt_uint64_t _trace_clock(void)
+{
+#ifdef RT_USING_CPUTIME
+    return clock_cpu_count();
+#else
+    return rt_tick_get();
+#endif /* RT_USING_CPUTIME */
+}
+
+static rt_uint32_t _trace_clock_hz(void)
+{
+#ifdef RT_USING_CPUTIME
+    float res = clock_cpu_getres();
+
+    /* the resolution is in nanoseconds */
+    if (res > 0)
+    {
+        return (rt_uint32_t)(1000000000.0f / res);
+    }
+#endif /* RT_USING_CPUTIME */
+    return RT_TICK_PER_SECOND;
+}
+
+/**
+ * @brief This function will record an event to the trace buffer of current cpu.
+ *
+ * @param event is the event, RT_TRACE_xxx or from RT_TRACE_USER.
+ *
+ * @param arg0 is the first argument, e.g. the object of event.
+ *
+ * @param arg1 is the second argument.
+ */
+void rt_trace_event(rt_uint8_t event, rt_ubase_t arg0, rt_ubase_t arg1)
+{
+    rt_base_t level;
+    rt_uint64_t stamp;
+    struct trace_ring *ring;
+    struct rt_trace_record *record;
+    int cpu;
+
+    if (!_trace_started)
+    {
+        return;
+    }
+
+    level = _trace_lock();
+    cpu = _trace_cpu_id();
+    ring = &_trace_rings[cpu];
+    stamp = _trace_clock();
+
+    record = &ring->records[ring->head & TRACE_MASK];
+    record->stamp_lo = (rt_uint32_t)stamp;
+    record->stamp_hi = (rt_uint16_t)(stamp >> 32);
+    record->event = event;
+    record->cpu = (rt_uint8_t)cpu;
+    record->arg0 = (rt_uint32_t)arg0;
+    record->arg1 = (rt_uint32_t)arg1;
+    ring->head ++;
+    _trace_unlock(level);
+}
+RTM_EXPORT(rt_trace_event);
+
+/**
+ * @brief This function will start recording the events.
+ */
+void rt_trace_start(void)
+{
+    _trace_started = RT_TRUE;
+}
+RTM_EXPORT(rt_trace_start);
+
+/**
+ * @brief This function will stop recording the events.
+ */
+void rt_trace_stop(void)
+{
+    _trace_started = RT_FALSE;
+}
+RTM_EXPORT(rt_trace_stop);
+
+/**
+ * @brief This function will drop all the records.
+ */
+void rt_trace_clear(void)
+{
+    int cpu;
+
+    for (cpu = 0; cpu < TRACE_CPUS_NR; cpu++)
+    {
+        _trace_rings[cpu].head = 0;
+    }
+}
+RTM_EXPORT(rt_trace_clear);
+
+/**
+ * @brief This function will return whether the events are recorded.
+ *
+ * @return RT_TRUE if the trace is started.
+ */
+rt_bool_t rt_trace_is_started(void)
+{
+    return _trace_started;
+}
+RTM_EXPORT(rt_trace_is_started);
+
+/**
+ * @brief This function will return the count of records of a cpu.
+ *
+ * @param cpu is the index of cpu.
+ *
+ * @return the count of records in the buffer.
+ */
+rt_size_t rt_trace_count(int cpu)
+{
+    rt_uint32_t head;
+
+    if (cpu < 0 || cpu >= TRACE_CPUS_NR)
+    {
+        return 0;
+    }
+
+    head = _trace_rings[cpu].head;
+    if (head >= RT_TRACE_BUF_RECORDS)
+    {
+        /* the oldest one of a full ring is not dumped */
+        return RT_TRACE_BUF_RECORDS - 1;
+    }
+
+    return head;
+}
+RTM_EXPORT(rt_trace_count);
+
+/* snapshot the names of objects, return the count of entries */
+static int _trace_names_take(rt_uint8_t **names)
+{
+    int i, j, nr, total, max;
+    rt_object_t *objects;
+    rt_uint8_t *entry;
+
+    max = 0;
+    for (i = 0; i < sizeof(_trace_name_types) / sizeof(_trace_name_types[0]); i++)
+    {
+        max += rt_object_get_length((enum rt_object_class_type)_trace_name_types[i]);
+    }
+
+    *names = RT_NULL;
+    if (max == 0)
+    {
+        return 0;
+    }
+
+    objects = (rt_object_t *)rt_malloc(sizeof(rt_object_t) * max);
+    *names = (rt_uint8_t *)rt_malloc(TRACE_NAME_SIZE * max);
+    if (objects == RT_NULL || *names == RT_NULL)
+    {
+        rt_free(objects);
+        rt_free(*names);
+        *names = RT_NULL;
+        return -RT_ENOMEM;
+    }
+
+    total = 0;
+    entry = *names;
+    /* the objects deleted are not freed before the names are copied */
+    rt_enter_critical();
+    for (i = 0; i < sizeof(_trace_name_types) / sizeof(_trace_name_types[0]) && total < max; i++)
+    {
+        nr = rt_object_get_pointers((enum rt_object_class_type)_trace_name_types[i],
+                                    objects, max - total);
+        for (j = 0; j < nr; j++)
+        {
+            rt_uint32_t id = (rt_uint32_t)(rt_ubase_t)objects[j];
+
+            rt_memcpy(entry, &id, sizeof(id));
+            entry[4] = _trace_name_types[i];
+            entry[5] = entry[6] = entry[7] = 0;
+            rt_strncpy((char *)&entry[8], objects[j]->name, RT_NAME_MAX);
+            entry += TRACE_NAME_SIZE;
+        }
+        total += nr;
+    }
+    rt_exit_critical();
+
+    rt_free(objects);
+    return total;
+}
+
+/**
+ * @brief This function will dump the names of objects and the records of all
+ *        cpus. The trace is stopped during the dump.
+ *
+ * @param output is the function to write the data of dump.
+ *
+ * @param context is the argument of output.
+ *
+ * @return Return the operation status. When the return value is RT_EOK, the operation is successful.
+ *         If the return value is -RT_ENOMEM, there is no memory for the names.
+ */
+rt_err_t rt_trace_dump(void (*output)(void *context, const void *buf, rt_size_t size), void *context)
+{
+    struct rt_trace_header header;
+    rt_uint8_t *names;
+    rt_uint32_t head, start, count, index, id;
+    rt_bool_t started;
+    int cpu, nr;
+
+    RT_ASSERT(output != RT_NULL);
+
+    started = _trace_started;
+    _trace_started = RT_FALSE;
+
+    nr = _trace_names_take(&names);
+    if (nr < 0)
+    {
+        _trace_started = started;
+        return -RT_ENOMEM;
+    }
+
+    rt_memset(&header, 0, sizeof(header));
+    rt_strncpy(header.magic, RT_TRACE_MAGIC, sizeof(header.magic));
+    header.version = RT_TRACE_VERSION;
+    header.record_size = sizeof(struct rt_trace_record);
+    header.name_max = RT_NAME_MAX;
+    header.cpus = TRACE_CPUS_NR;
+    header.clock_hz = _trace_clock_hz();
+    header.names = nr;
+    output(context, &header, sizeof(header));
+    if (nr > 0)
+    {
+        output(context, names, TRACE_NAME_SIZE * nr);
+    }
+    rt_free(names);
+
+    for (cpu = 0; cpu < TRACE_CPUS_NR; cpu++)
+    {
+        head = _trace_rings[cpu].head;
+        count = rt_trace_count(cpu);
+        start = head - count;
+
+        id = cpu;
+        output(context, &id, sizeof(id));
+        output(context, &count, sizeof(count));
+
+        /* the ring is wrapped at most once */
+        index = start & TRACE_MASK;
+        if (index + count > RT_TRACE_BUF_RECORDS)
+        {
+            output(context, &_trace_rings[cpu].records[index],
+                   sizeof(struct rt_trace_record) * (RT_TRACE_BUF_RECORDS - index));
+            count -= RT_TRACE_BUF_RECORDS - index;
+            index = 0;
+        }
+        if (count > 0)
+        {
+            output(context, &_trace_rings[cpu].records[index], sizeof(struct rt_trace_record) * count);
+        }
+    }
+
+    _trace_started = started;
+    return RT_EOK;
+}
+RTM_EXPORT(rt_trace_dump);
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+
+#define TRACE_LINE_BYTES        32
+
+struct trace_console
+{
+    rt_uint8_t line[TRACE_LINE_BYTES];
+    rt_size_t len;
+};
+
+static void _trace_console_flush(struct trace_console *console)
+{
+    static const char hex[] = "0123456789abcdef";
+    char text[TRACE_LINE_BYTES * 2 + 1];
+    rt_size_t i;
+
+    for (i = 0; i < console->len; i++)
+    {
+        text[i * 2] = hex[console->line[i] >> 4];
+        text[i * 2 + 1] = hex[console->line[i] & 0x0f];
+    }
+    text[i * 2] = '\0';
+    rt_kprintf("#T:%s\n", text);
+    console->len = 0;
+}
+
+/* the binary dump is printed in hex lines, with the prefix for the decoder */
+static void _trace_console_output(void *context, const void *buf, rt_size_t size)
+{
+    struct trace_console *console = (struct trace_console *)context;
+    const rt_uint8_t *data = (const rt_uint8_t *)buf;
+
+    while (size--)
+    {
+        console->line[console->len++] = *data++;
+        if (console->len == TRACE_LINE_BYTES)
+        {
+            _trace_console_flush(console);
+        }
+    }
+}
+
+#ifdef DFS_USING_POSIX
+static void _trace_file_output(void *context, const void *buf, rt_size_t size)
+{
+    write(*(int *)context, buf, size);
+}
+#endif /* DFS_USING_POSIX */
+
+static int cmd_trace(int argc, char **argv)
+{
+    int cpu;
+
+    if (argc < 2)
+    {
+        goto __usage;
+    }
+
+    if (strcmp(argv[1], "start") == 0)
+    {
+        rt_trace_clear();
+        rt_trace_start();
+    }
+    else if (strcmp(argv[1], "stop") == 0)
+    {
+        rt_trace_stop();
+    }
+    else if (strcmp(argv[1], "status") == 0)
+    {
+        rt_kprintf("trace is %s, clock %d Hz\n", _trace_started ? "started" : "stopped", _trace_clock_hz());
+        for (cpu = 0; cpu < TRACE_CPUS_NR; cpu++)
+        {
+            rt_kprintf("cpu%d: %d records, %d written\n", cpu, rt_trace_count(cpu), _trace_rings[cpu].head);
+        }
+    }
+    else if (strcmp(argv[1], "dump") == 0 && argc == 2)
+    {
+        struct trace_console console;
+
+        console.len = 0;
+        if (rt_trace_dump(_trace_console_output, &console) != RT_EOK)
+        {
+            rt_kprintf("no memory for the dump.\n");
+            return -RT_ENOMEM;
+        }
+        if (console.len > 0)
+        {
+            _trace_console_flush(&console);
+        }
+    }
+#ifdef DFS_USING_POSIX
+    else if (strcmp(argv[1], "dump") == 0 && argc == 3)
+    {
+        int fd;
+        rt_err_t result;
+
+        fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0);
+        if (fd < 0)
+        {
+            rt_kprintf("open %s failed.\n", argv[2]);
+            return -RT_ERROR;
+        }
+        result = rt_trace_dump(_trace_file_output, &fd);
+        close(fd);
+        if (result != RT_EOK)
+        {
+            rt_kprintf("no memory for the dump.\n");
+            return result;
+        }
+    }
+#endif /* DFS_USING_POSIX */
+    else
+    {
+        goto __usage;
+    }
+
+    return RT_EOK;
+
+__usage:
+    rt_kprintf("Usage: trace start|stop|status|dump [file]\n");
+    rt_kprintf("  decode the dump with tools/trace_decode.py\n");
+    return -RT_EINVAL;
+}
+MSH_CMD_EXPORT_ALIAS(cmd_trace, trace, record the kernel events: trace start|stop|status|dump [file]);
+#endif /* RT_USING_FINSH */
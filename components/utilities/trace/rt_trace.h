@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#ifndef __RT_TRACE_H__
+#define __RT_TRACE_H__
+
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RT_TRACE_MAGIC          "RTTRACE"
+#define RT_TRACE_VERSION        1
+
+/*
+ * The dump of trace, all the fields are in the byte order of target:
+ *
+ *   struct rt_trace_header
+ *   names * { rt_uint32_t id; rt_uint8_t type; rt_uint8_t reserved[3]; char name[name_max]; }
+ *   cpus  * { rt_uint32_t cpu; rt_uint32_t count; struct rt_trace_record records[count]; }
+ *
+ * The id of object is the low 32 bits of its address, as the arguments of records.
+ */
+struct rt_trace_header
+{
+    char        magic[8];                               /**< RT_TRACE_MAGIC */
+    rt_uint16_t version;                                /**< RT_TRACE_VERSION */
+    rt_uint16_t record_size;                            /**< size of struct rt_trace_record */
+    rt_uint16_t name_max;                               /**< RT_NAME_MAX */
+    rt_uint16_t cpus;                                   /**< number of cpus */
+    rt_uint32_t clock_hz;                               /**< frequency of the time stamp */
+    rt_uint32_t names;                                  /**< number of names */
+};
+
+struct rt_trace_record
+{
+    rt_uint32_t stamp_lo;                               /**< low 32 bits of time stamp */
+    rt_uint16_t stamp_hi;                               /**< high 16 bits of time stamp */
+    rt_uint8_t  event;                                  /**< RT_TRACE_xxx */
+    rt_uint8_t  cpu;                                    /**< cpu of the event */
+    rt_uint32_t arg0;
+    rt_uint32_t arg1;
+};
+
+void rt_trace_start(void);
+void rt_trace_stop(void);
+void rt_trace_clear(void);
+rt_bool_t rt_trace_is_started(void);
+rt_size_t rt_trace_count(int cpu);
+rt_err_t rt_trace_dump(void (*output)(void *context, const void *buf, rt_size_t size), void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RT_TRACE_H__ */
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-08-25     armink       the first version
+ * 2022-02-24     RT-Thread    put the raw async logs to the spsc ring buffer
  */
 
 #include <stdarg.h>
@@ -89,8 +90,8 @@ struct rt_ulog
 #ifdef ULOG_USING_ASYNC_OUTPUT
     rt_bool_t async_enabled;
     rt_rbb_t async_rbb;
-    /* ringbuffer for log_raw function only */
-    struct rt_ringbuffer *async_rb;
+    /* ringbuffer for log_raw function only, put under the output lock and got by the async output */
+    struct rt_spsc_ringbuffer *async_rb;
     rt_thread_t async_th;
     struct rt_semaphore async_notice;
 #endif
@@ -515,7 +516,7 @@ static void do_output(rt_uint32_t level, const char *tag, rt_bool_t is_raw, cons
     }
     else if (ulog.async_rb)
     {
-        rt_ringbuffer_put(ulog.async_rb, (const rt_uint8_t *)log_buf, log_len);
+        rt_spsc_ringbuffer_put(ulog.async_rb, (const rt_uint8_t *)log_buf, log_len);
         /* send a notice */
         rt_sem_release(&ulog.async_notice);
     }
@@ -679,7 +680,7 @@ void ulog_raw(const char *format, ...)
 #ifdef ULOG_USING_ASYNC_OUTPUT
     if (ulog.async_rb == RT_NULL)
     {
-        ulog.async_rb = rt_ringbuffer_create(ULOG_ASYNC_OUTPUT_BUF_SIZE);
+        ulog.async_rb = rt_spsc_ringbuffer_create(ULOG_ASYNC_OUTPUT_BUF_SIZE);
     }
 #endif
 
@@ -756,7 +757,7 @@ void ulog_hexdump(const char *tag, rt_size_t width, rt_uint8_t *buf, rt_size_t s
 #ifdef ULOG_USING_ASYNC_OUTPUT
     if (ulog.async_rb == RT_NULL)
     {
-        ulog.async_rb = rt_ringbuffer_create(ULOG_ASYNC_OUTPUT_BUF_SIZE);
+        ulog.async_rb = rt_spsc_ringbuffer_create(ULOG_ASYNC_OUTPUT_BUF_SIZE);
     }
 #endif
 
@@ -1393,11 +1394,11 @@ void ulog_async_output(void)
     /* output the log_raw format log */
     if (ulog.async_rb)
     {
-        rt_size_t log_len = rt_ringbuffer_data_len(ulog.async_rb);
+        rt_size_t log_len = rt_spsc_ringbuffer_data_len(ulog.async_rb);
         char *log = rt_malloc(log_len);
         if (log)
         {
-            rt_size_t len = rt_ringbuffer_get(ulog.async_rb, (rt_uint8_t *)log, log_len);
+            rt_size_t len = rt_spsc_ringbuffer_get(ulog.async_rb, (rt_uint8_t *)log, log_len);
             ulog_output_to_all_backend(LOG_LVL_DBG, RT_NULL, RT_TRUE, log, len);
             rt_free(log);
         }
@@ -1558,7 +1559,7 @@ void ulog_deinit(void)
     rt_rbb_destroy(ulog.async_rbb);
     rt_thread_delete(ulog.async_th);
     if (ulog.async_rb)
-        rt_ringbuffer_destroy(ulog.async_rb);
+        rt_spsc_ringbuffer_destroy(ulog.async_rb);
 #endif
 
     ulog.init_ok = RT_FALSE;
@@ -7,6 +7,7 @@
  * Date           Author       Notes
  * 2010-02-10     Bernard      first version
  * 2020-04-12     Jianjia Ma   add msh cmd
+ * 2022-02-24     RT-Thread    print the length and ticks of the test
  */
 
 #include <rtthread.h>
@@ -55,7 +56,9 @@ void readspeed(const char* filename, int block_size)
     rt_free(buff_ptr);
 
     /* calculate read speed */
-    rt_kprintf("File read speed: %d byte/s\n", total_length /tick * RT_TICK_PER_SECOND);
+    if (tick == 0) tick = 1;
+    rt_kprintf("File read %d bytes by %d bytes in %d ticks\n", total_length, block_size, tick);
+    rt_kprintf("File read speed: %d byte/s\n", (rt_uint32_t)((rt_uint64_t)total_length * RT_TICK_PER_SECOND / tick));
 }
 
 #ifdef RT_USING_FINSH
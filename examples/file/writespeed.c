@@ -7,6 +7,7 @@
  * Date           Author       Notes
  * 2010-02-10     Bernard      first version
  * 2020-04-12     Jianjia Ma   add msh cmd
+ * 2022-02-24     RT-Thread    count the close in the test, which flushes the data buffered
  */
 #include <rtthread.h>
 #include <dfs_file.h>
@@ -56,14 +57,16 @@ void writespeed(const char* filename, int total_length, int block_size)
 
         index ++;
     }
-    tick = rt_tick_get() - tick;
 
-    /* close file and release memory */
+    /* close file and release memory, the data buffered is written on close */
     close(fd);
+    tick = rt_tick_get() - tick;
     rt_free(buff_ptr);
 
     /* calculate write speed */
-    rt_kprintf("File write speed: %d byte/s\n", total_length / tick * RT_TICK_PER_SECOND);
+    if (tick == 0) tick = 1;
+    rt_kprintf("File write %d bytes by %d bytes in %d ticks\n", index * block_size, block_size, tick);
+    rt_kprintf("File write speed: %d byte/s\n", (rt_uint32_t)((rt_uint64_t)index * block_size * RT_TICK_PER_SECOND / tick));
 }
 
 #ifdef RT_USING_FINSH
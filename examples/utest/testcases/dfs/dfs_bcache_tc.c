@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <dfs_bcache.h>
+#include "utest.h"
+
+#define TC_DEVICE_NAME      "bc_ram"
+#define TC_SECTOR_SIZE      512
+#define TC_CACHE_BLKS       (RT_DFS_BCACHE_SIZE / TC_SECTOR_SIZE)
+#define TC_SECTOR_COUNT     (TC_CACHE_BLKS * 4)
+
+/* the ram disk counts the requests it serves */
+static struct rt_device ram_disk;
+static rt_uint8_t *ram_data;
+static rt_uint32_t ram_reads, ram_writes;
+static rt_uint8_t buffer[(RT_DFS_BCACHE_BYPASS_BLKS + 1) * TC_SECTOR_SIZE];
+
+static rt_size_t ram_read(rt_device_t dev, rt_off_t pos, void *buf, rt_size_t size)
+{
+    if (pos + size > TC_SECTOR_COUNT)
+    {
+        return 0;
+    }
+    ram_reads ++;
+    rt_memcpy(buf, ram_data + pos * TC_SECTOR_SIZE, size * TC_SECTOR_SIZE);
+
+    return size;
+}
+
+static rt_size_t ram_write(rt_device_t dev, rt_off_t pos, const void *buf, rt_size_t size)
+{
+    if (pos + size > TC_SECTOR_COUNT)
+    {
+        return 0;
+    }
+    ram_writes ++;
+    rt_memcpy(ram_data + pos * TC_SECTOR_SIZE, buf, size * TC_SECTOR_SIZE);
+
+    return size;
+}
+
+static rt_err_t ram_control(rt_device_t dev, int cmd, void *args)
+{
+    if (cmd == RT_DEVICE_CTRL_BLK_GETGEOME)
+    {
+        struct rt_device_blk_geometry *geometry = (struct rt_device_blk_geometry *)args;
+
+        geometry->bytes_per_sector = TC_SECTOR_SIZE;
+        geometry->sector_count = TC_SECTOR_COUNT;
+        geometry->block_size = TC_SECTOR_SIZE;
+    }
+
+    return RT_EOK;
+}
+
+#ifdef RT_USING_DEVICE_OPS
+const static struct rt_device_ops ram_disk_ops =
+{
+    RT_NULL,
+    RT_NULL,
+    RT_NULL,
+    ram_read,
+    ram_write,
+    ram_control
+};
+#endif
+
+static void ram_reset(void)
+{
+    ram_reads = 0;
+    ram_writes = 0;
+}
+
+static void test_bcache_read_hit(void)
+{
+    struct dfs_bcache_stat stat;
+
+    dfs_bcache_get_stat(&ram_disk, &stat, RT_TRUE);
+    ram_reset();
+
+    /* the sectors read again are served by the cache */
+    uassert_int_equal(dfs_bcache_read(&ram_disk, 3, buffer, 2), 2);
+    uassert_int_equal(dfs_bcache_read(&ram_disk, 3, buffer, 1), 1);
+    uassert_int_equal(dfs_bcache_read(&ram_disk, 4, buffer, 1), 1);
+    uassert_int_equal(ram_reads, 1);
+    uassert_buf_equal(buffer, ram_data + 4 * TC_SECTOR_SIZE, TC_SECTOR_SIZE);
+
+    /* the large read bypasses the cache */
+    uassert_int_equal(dfs_bcache_read(&ram_disk, 8, buffer, RT_DFS_BCACHE_BYPASS_BLKS + 1),
+                      RT_DFS_BCACHE_BYPASS_BLKS + 1);
+    uassert_int_equal(dfs_bcache_read(&ram_disk, 8, buffer, 1), 1);
+    uassert_int_equal(ram_reads, 3);
+
+    uassert_int_equal(dfs_bcache_get_stat(&ram_disk, &stat, RT_FALSE), 0);
+    uassert_int_equal(stat.hits, 2);
+    uassert_int_equal(stat.misses, 2 + RT_DFS_BCACHE_BYPASS_BLKS + 1 + 1);
+    uassert_int_equal(stat.bypasses, RT_DFS_BCACHE_BYPASS_BLKS + 1);
+    uassert_int_equal(stat.blocks, TC_CACHE_BLKS);
+}
+
+static void test_bcache_write_back(void)
+{
+    struct dfs_bcache_stat stat;
+    int i;
+
+    dfs_bcache_get_stat(&ram_disk, &stat, RT_TRUE);
+    ram_reset();
+
+    /* the sectors written one by one are kept in the cache */
+    for (i = 0; i < 4; i++)
+    {
+        rt_memset(buffer, 0xa0 + i, TC_SECTOR_SIZE);
+        uassert_int_equal(dfs_bcache_write(&ram_disk, 20 + i, buffer, 1), 1);
+    }
+    uassert_int_equal(ram_writes, 0);
+    uassert_int_equal(dfs_bcache_read(&ram_disk, 22, buffer, 1), 1);
+    uassert_int_equal(buffer[0], 0xa2);
+    uassert_int_equal(ram_reads, 0);
+
+    /* the dirty sectors inside a large read are read from the cache */
+    uassert_int_equal(dfs_bcache_read(&ram_disk, 18, buffer, RT_DFS_BCACHE_BYPASS_BLKS + 1),
+                      RT_DFS_BCACHE_BYPASS_BLKS + 1);
+    uassert_int_equal(buffer[3 * TC_SECTOR_SIZE], 0xa1);
+
+    /* the adjacent dirty sectors are written back together on sync */
+    dfs_bcache_get_stat(&ram_disk, &stat, RT_FALSE);
+    uassert_int_equal(stat.dirty, 4);
+    uassert_int_equal(dfs_bcache_sync(&ram_disk), RT_EOK);
+    uassert_int_equal(ram_writes, (4 + RT_DFS_BCACHE_FLUSH_BLKS - 1) / RT_DFS_BCACHE_FLUSH_BLKS);
+    for (i = 0; i < 4; i++)
+    {
+        uassert_int_equal(ram_data[(20 + i) * TC_SECTOR_SIZE], 0xa0 + i);
+    }
+
+    dfs_bcache_get_stat(&ram_disk, &stat, RT_FALSE);
+    uassert_int_equal(stat.dirty, 0);
+    uassert_int_equal(stat.writebacks, 4);
+}
+
+static void test_bcache_evict(void)
+{
+    struct dfs_bcache_stat stat;
+    int i;
+
+    ram_reset();
+
+    /* the dirty sectors are written back when evicted */
+    for (i = 0; i < TC_CACHE_BLKS * 2; i++)
+    {
+        rt_memset(buffer, i, TC_SECTOR_SIZE);
+        uassert_int_equal(dfs_bcache_write(&ram_disk, TC_CACHE_BLKS + i, buffer, 1), 1);
+    }
+    uassert_true(ram_writes > 0);
+    uassert_true(ram_writes <= TC_CACHE_BLKS * 2 / RT_DFS_BCACHE_FLUSH_BLKS + 1);
+    dfs_bcache_get_stat(&ram_disk, &stat, RT_FALSE);
+    uassert_true(stat.dirty <= TC_CACHE_BLKS);
+
+    /* the cached copy is updated by the large write */
+    rt_memset(buffer, 0x55, sizeof(buffer));
+    uassert_int_equal(dfs_bcache_write(&ram_disk, TC_CACHE_BLKS * 3 - 1, buffer, RT_DFS_BCACHE_BYPASS_BLKS + 1),
+                      RT_DFS_BCACHE_BYPASS_BLKS + 1);
+    uassert_int_equal(dfs_bcache_read(&ram_disk, TC_CACHE_BLKS * 3 - 1, buffer, 1), 1);
+    uassert_int_equal(buffer[0], 0x55);
+
+    /* the detach writes back all of the dirty sectors */
+    uassert_int_equal(dfs_bcache_detach(&ram_disk), 0);
+    for (i = 0; i < TC_CACHE_BLKS * 2 - 1; i++)
+    {
+        uassert_int_equal(ram_data[(TC_CACHE_BLKS + i) * TC_SECTOR_SIZE], (rt_uint8_t)i);
+    }
+    uassert_int_equal(dfs_bcache_get_stat(&ram_disk, &stat, RT_FALSE), -1);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    ram_data = (rt_uint8_t *)rt_malloc(TC_SECTOR_COUNT * TC_SECTOR_SIZE);
+    if (ram_data == RT_NULL)
+    {
+        return -RT_ENOMEM;
+    }
+    rt_memset(ram_data, 0, TC_SECTOR_COUNT * TC_SECTOR_SIZE);
+    ram_data[4 * TC_SECTOR_SIZE] = 0x44;
+
+    rt_memset(&ram_disk, 0, sizeof(ram_disk));
+    ram_disk.type = RT_Device_Class_Block;
+#ifdef RT_USING_DEVICE_OPS
+    ram_disk.ops = &ram_disk_ops;
+#else
+    ram_disk.read = ram_read;
+    ram_disk.write = ram_write;
+    ram_disk.control = ram_control;
+#endif
+    if (rt_device_register(&ram_disk, TC_DEVICE_NAME, RT_DEVICE_FLAG_RDWR) != RT_EOK ||
+        rt_device_open(&ram_disk, RT_DEVICE_OFLAG_RDWR) != RT_EOK)
+    {
+        return -RT_ERROR;
+    }
+
+    return dfs_bcache_attach(&ram_disk) == 0 ? RT_EOK : -RT_ERROR;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    dfs_bcache_detach(&ram_disk);
+    rt_device_close(&ram_disk);
+    rt_device_unregister(&ram_disk);
+    rt_free(ram_data);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_bcache_read_hit);
+    UTEST_UNIT_RUN(test_bcache_write_back);
+    UTEST_UNIT_RUN(test_bcache_evict);
+}
+UTEST_TC_EXPORT(testcase, "testcases.dfs.dfs_bcache_tc", utest_tc_init, utest_tc_cleanup, 10);
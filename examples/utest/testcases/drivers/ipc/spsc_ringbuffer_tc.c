@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "utest.h"
+
+#define TEST_BUFFER_SIZE    100
+#define TEST_LARGE_SIZE     (40 * 1024)
+#define TEST_STREAM_SIZE    (256 * 1024)
+#define TEST_STACK_SIZE     2048
+
+static struct rt_spsc_ringbuffer *stream_rb;
+static struct rt_semaphore sem_done;
+static volatile rt_uint32_t stream_errors;
+
+static void test_spsc_ringbuffer_put_get(void)
+{
+    struct rt_spsc_ringbuffer rb;
+    rt_uint8_t pool[TEST_BUFFER_SIZE];
+    rt_uint8_t in[TEST_BUFFER_SIZE], out[TEST_BUFFER_SIZE];
+    rt_uint8_t ch;
+    int i;
+
+    for (i = 0; i < TEST_BUFFER_SIZE; i++)
+    {
+        in[i] = (rt_uint8_t)i;
+    }
+
+    /* the size is not aligned, every byte is usable */
+    rt_spsc_ringbuffer_init(&rb, pool, TEST_BUFFER_SIZE);
+    uassert_int_equal(rt_spsc_ringbuffer_get_size(&rb), TEST_BUFFER_SIZE);
+    uassert_int_equal(rt_spsc_ringbuffer_space_len(&rb), TEST_BUFFER_SIZE);
+    uassert_int_equal(rt_spsc_ringbuffer_getchar(&rb, &ch), 0);
+
+    /* the data wraps around the end of buffer */
+    uassert_int_equal(rt_spsc_ringbuffer_put(&rb, in, 70), 70);
+    uassert_int_equal(rt_spsc_ringbuffer_get(&rb, out, 60), 60);
+    uassert_buf_equal(out, in, 60);
+    uassert_int_equal(rt_spsc_ringbuffer_put(&rb, in, TEST_BUFFER_SIZE), 90);
+    uassert_int_equal(rt_spsc_ringbuffer_data_len(&rb), TEST_BUFFER_SIZE);
+    uassert_int_equal(rt_spsc_ringbuffer_putchar(&rb, 0), 0);
+
+    uassert_int_equal(rt_spsc_ringbuffer_get(&rb, out, 10), 10);
+    uassert_buf_equal(out, &in[60], 10);
+    uassert_int_equal(rt_spsc_ringbuffer_get(&rb, out, TEST_BUFFER_SIZE), 90);
+    uassert_buf_equal(out, in, 90);
+    uassert_int_equal(rt_spsc_ringbuffer_data_len(&rb), 0);
+
+    uassert_int_equal(rt_spsc_ringbuffer_putchar(&rb, 0x5a), 1);
+    uassert_int_equal(rt_spsc_ringbuffer_getchar(&rb, &ch), 1);
+    uassert_int_equal(ch, 0x5a);
+
+    rt_spsc_ringbuffer_reset(&rb);
+    uassert_int_equal(rt_spsc_ringbuffer_space_len(&rb), TEST_BUFFER_SIZE);
+}
+
+static void test_spsc_ringbuffer_span(void)
+{
+    struct rt_spsc_ringbuffer rb;
+    rt_uint8_t pool[TEST_BUFFER_SIZE];
+    rt_uint8_t *span;
+    rt_size_t size;
+
+    rt_spsc_ringbuffer_init(&rb, pool, TEST_BUFFER_SIZE);
+
+    /* the span ends at the end of buffer */
+    size = rt_spsc_ringbuffer_reserve(&rb, &span);
+    uassert_int_equal(size, TEST_BUFFER_SIZE);
+    uassert_true(span == pool);
+    rt_memset(span, 'a', 80);
+    rt_spsc_ringbuffer_commit(&rb, 80);
+
+    size = rt_spsc_ringbuffer_peek(&rb, &span);
+    uassert_int_equal(size, 80);
+    uassert_true(span == pool);
+    uassert_int_equal(span[79], 'a');
+    rt_spsc_ringbuffer_consume(&rb, 50);
+
+    size = rt_spsc_ringbuffer_reserve(&rb, &span);
+    uassert_int_equal(size, 20);
+    uassert_true(span == &pool[80]);
+    rt_memset(span, 'b', size);
+    rt_spsc_ringbuffer_commit(&rb, size);
+
+    /* the free space wrapped to the head is the next span */
+    size = rt_spsc_ringbuffer_reserve(&rb, &span);
+    uassert_int_equal(size, 50);
+    uassert_true(span == pool);
+    rt_memset(span, 'c', size);
+    rt_spsc_ringbuffer_commit(&rb, size);
+    uassert_int_equal(rt_spsc_ringbuffer_reserve(&rb, &span), 0);
+    uassert_null(span);
+
+    size = rt_spsc_ringbuffer_peek(&rb, &span);
+    uassert_int_equal(size, 50);
+    uassert_true(span == &pool[50]);
+    uassert_int_equal(span[49], 'b');
+    rt_spsc_ringbuffer_consume(&rb, size);
+
+    size = rt_spsc_ringbuffer_peek(&rb, &span);
+    uassert_int_equal(size, 50);
+    uassert_true(span == pool);
+    uassert_int_equal(span[0], 'c');
+    rt_spsc_ringbuffer_consume(&rb, size);
+    uassert_int_equal(rt_spsc_ringbuffer_peek(&rb, &span), 0);
+    uassert_null(span);
+}
+
+static void test_spsc_ringbuffer_large(void)
+{
+    struct rt_spsc_ringbuffer *rb;
+    rt_uint8_t *span;
+    rt_size_t size;
+
+    /* larger than the 32KiB of rt_ringbuffer */
+    rb = rt_spsc_ringbuffer_create(TEST_LARGE_SIZE);
+    uassert_not_null(rb);
+    if (rb == RT_NULL)
+    {
+        return;
+    }
+
+    size = rt_spsc_ringbuffer_reserve(rb, &span);
+    uassert_int_equal(size, TEST_LARGE_SIZE);
+    rt_memset(span, 0xa5, size);
+    rt_spsc_ringbuffer_commit(rb, size);
+    uassert_int_equal(rt_spsc_ringbuffer_data_len(rb), TEST_LARGE_SIZE);
+
+    size = rt_spsc_ringbuffer_peek(rb, &span);
+    uassert_int_equal(size, TEST_LARGE_SIZE);
+    uassert_int_equal(span[TEST_LARGE_SIZE - 1], 0xa5);
+    rt_spsc_ringbuffer_consume(rb, size);
+    uassert_int_equal(rt_spsc_ringbuffer_data_len(rb), 0);
+
+    rt_spsc_ringbuffer_destroy(rb);
+}
+
+static void producer_entry(void *parameter)
+{
+    rt_uint32_t sent = 0;
+    rt_uint8_t *span;
+    rt_size_t size, i;
+
+    while (sent < TEST_STREAM_SIZE)
+    {
+        size = rt_spsc_ringbuffer_reserve(stream_rb, &span);
+        if (size == 0)
+        {
+            rt_thread_yield();
+            continue;
+        }
+        if (size > TEST_STREAM_SIZE - sent)
+        {
+            size = TEST_STREAM_SIZE - sent;
+        }
+        for (i = 0; i < size; i++)
+        {
+            span[i] = (rt_uint8_t)(sent + i);
+        }
+        rt_spsc_ringbuffer_commit(stream_rb, size);
+        sent += size;
+    }
+
+    rt_sem_release(&sem_done);
+}
+
+static void consumer_entry(void *parameter)
+{
+    rt_uint32_t received = 0;
+    rt_uint8_t buffer[37];
+    rt_size_t size, i;
+
+    while (received < TEST_STREAM_SIZE)
+    {
+        size = rt_spsc_ringbuffer_get(stream_rb, buffer, sizeof(buffer));
+        if (size == 0)
+        {
+            rt_thread_yield();
+            continue;
+        }
+        for (i = 0; i < size; i++)
+        {
+            if (buffer[i] != (rt_uint8_t)(received + i))
+            {
+                stream_errors ++;
+            }
+        }
+        received += size;
+    }
+
+    rt_sem_release(&sem_done);
+}
+
+static void test_spsc_ringbuffer_stream(void)
+{
+    rt_thread_t producer, consumer;
+
+    stream_errors = 0;
+    stream_rb = rt_spsc_ringbuffer_create(TEST_BUFFER_SIZE);
+    uassert_not_null(stream_rb);
+    if (stream_rb == RT_NULL)
+    {
+        return;
+    }
+
+    /* the producer and the consumer run on different cpus if there are */
+    producer = rt_thread_create("spsc_p", producer_entry, RT_NULL, TEST_STACK_SIZE,
+                                rt_thread_self()->current_priority + 1, 5);
+    consumer = rt_thread_create("spsc_c", consumer_entry, RT_NULL, TEST_STACK_SIZE,
+                                rt_thread_self()->current_priority + 1, 5);
+    uassert_not_null(producer);
+    uassert_not_null(consumer);
+    if (producer == RT_NULL || consumer == RT_NULL)
+    {
+        goto __exit;
+    }
+#ifdef RT_USING_SMP
+    rt_thread_control(producer, RT_THREAD_CTRL_BIND_CPU, (void *)0);
+    rt_thread_control(consumer, RT_THREAD_CTRL_BIND_CPU, (void *)(RT_CPUS_NR - 1));
+#endif /* RT_USING_SMP */
+    rt_thread_startup(producer);
+    rt_thread_startup(consumer);
+
+    rt_sem_take(&sem_done, RT_WAITING_FOREVER);
+    rt_sem_take(&sem_done, RT_WAITING_FOREVER);
+    uassert_int_equal(stream_errors, 0);
+    uassert_int_equal(rt_spsc_ringbuffer_data_len(stream_rb), 0);
+    producer = consumer = RT_NULL;
+
+__exit:
+    if (producer != RT_NULL)
+    {
+        rt_thread_delete(producer);
+    }
+    if (consumer != RT_NULL)
+    {
+        rt_thread_delete(consumer);
+    }
+    rt_spsc_ringbuffer_destroy(stream_rb);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    return rt_sem_init(&sem_done, "spsc_done", 0, RT_IPC_FLAG_PRIO);
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    return rt_sem_detach(&sem_done);
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_spsc_ringbuffer_put_get);
+    UTEST_UNIT_RUN(test_spsc_ringbuffer_span);
+    UTEST_UNIT_RUN(test_spsc_ringbuffer_large);
+    UTEST_UNIT_RUN(test_spsc_ringbuffer_stream);
+}
+UTEST_TC_EXPORT(testcase, "testcases.drivers.ipc.spsc_ringbuffer_tc", utest_tc_init, utest_tc_cleanup, 10);
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "utest.h"
+
+#define WORK_STACK_SIZE     2048
+#define WORK_SLEEP_MS       50
+#define WORKERS             4
+
+static rt_uint8_t work_priority;
+static struct rt_semaphore done_sem;
+static struct rt_semaphore gate_sem;
+static volatile int order[RT_WORK_PRIORITY_NR];
+static volatile int order_index;
+
+static void sleep_work_func(struct rt_work *work, void *work_data)
+{
+    rt_thread_mdelay(WORK_SLEEP_MS);
+    rt_sem_release(&done_sem);
+}
+
+static void test_workqueue_workers(void)
+{
+    struct rt_workqueue *queue;
+    struct rt_work works[WORKERS];
+    rt_uint32_t done = 0, stolen = 0;
+    rt_tick_t start, cost;
+    int i;
+
+    queue = rt_workqueue_create_workers("wq", WORK_STACK_SIZE, work_priority, WORKERS);
+    uassert_not_null(queue);
+    if (queue == RT_NULL)
+    {
+        return;
+    }
+
+    /* the works behind a blocked one are taken by the other workers */
+    start = rt_tick_get();
+    for (i = 0; i < WORKERS; i++)
+    {
+        rt_work_init(&works[i], sleep_work_func, RT_NULL);
+        uassert_int_equal(rt_workqueue_submit_work(queue, &works[i], 0), RT_EOK);
+    }
+    for (i = 0; i < WORKERS; i++)
+    {
+        rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+    }
+    cost = rt_tick_get() - start;
+
+    for (i = 0; i < queue->nr_workers; i++)
+    {
+        done += queue->workers[i].done;
+        stolen += queue->workers[i].stolen;
+    }
+    LOG_I("%d works of %d ms on %d workers: %d ticks, %d stolen", WORKERS, WORK_SLEEP_MS,
+          WORKERS, cost, stolen);
+    uassert_true(cost < rt_tick_from_millisecond(WORK_SLEEP_MS * 2));
+    uassert_int_equal(done, WORKERS);
+    uassert_true(stolen > 0);
+
+    rt_workqueue_destroy(queue);
+}
+
+static void gate_work_func(struct rt_work *work, void *work_data)
+{
+    rt_sem_take(&gate_sem, RT_WAITING_FOREVER);
+}
+
+static void order_work_func(struct rt_work *work, void *work_data)
+{
+    order[order_index++] = (int)(rt_ubase_t)work_data;
+    rt_sem_release(&done_sem);
+}
+
+static void test_workqueue_priority(void)
+{
+    struct rt_workqueue *queue;
+    struct rt_work gate, works[RT_WORK_PRIORITY_NR];
+    int i;
+
+    queue = rt_workqueue_create("wq_prio", WORK_STACK_SIZE, work_priority);
+    uassert_not_null(queue);
+    if (queue == RT_NULL)
+    {
+        return;
+    }
+
+    /* the worker is held while the works are queued from the lowest lane */
+    rt_work_init(&gate, gate_work_func, RT_NULL);
+    rt_workqueue_submit_work(queue, &gate, 0);
+    rt_thread_mdelay(10);
+
+    order_index = 0;
+    for (i = RT_WORK_PRIORITY_NR - 1; i >= 0; i--)
+    {
+        rt_work_init(&works[i], order_work_func, (void *)(rt_ubase_t)i);
+        rt_work_set_priority(&works[i], i);
+        rt_workqueue_submit_work(queue, &works[i], 0);
+    }
+    rt_sem_release(&gate_sem);
+
+    for (i = 0; i < RT_WORK_PRIORITY_NR; i++)
+    {
+        rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+    }
+    for (i = 0; i < RT_WORK_PRIORITY_NR; i++)
+    {
+        uassert_int_equal(order[i], i);
+    }
+
+    rt_workqueue_destroy(queue);
+}
+
+static void *square_func(void *arg)
+{
+    rt_ubase_t value = (rt_ubase_t)arg;
+
+    rt_thread_mdelay(10);
+    return (void *)(value * value);
+}
+
+static void test_workqueue_future(void)
+{
+    struct rt_workqueue *queue;
+    struct rt_work_future futures[WORKERS];
+    void *result;
+    int i;
+
+    queue = rt_workqueue_create_workers("wq_fut", WORK_STACK_SIZE, work_priority, 0);
+    uassert_not_null(queue);
+    if (queue == RT_NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < WORKERS; i++)
+    {
+        rt_work_future_init(&futures[i], square_func, (void *)(rt_ubase_t)(i + 2));
+        uassert_int_equal(rt_workqueue_submit_future(queue, &futures[i]), RT_EOK);
+    }
+    for (i = 0; i < WORKERS; i++)
+    {
+        result = RT_NULL;
+        uassert_int_equal(rt_work_future_wait(&futures[i], RT_WAITING_FOREVER, &result), RT_EOK);
+        uassert_int_equal((rt_ubase_t)result, (i + 2) * (i + 2));
+    }
+
+    /* a future can be submitted again once done, but not while pending */
+    uassert_int_equal(rt_workqueue_submit_future(queue, &futures[0]), RT_EOK);
+    uassert_int_equal(rt_workqueue_submit_future(queue, &futures[0]), -RT_EBUSY);
+    uassert_int_equal(rt_work_future_wait(&futures[0], 0, RT_NULL), -RT_ETIMEOUT);
+    uassert_int_equal(rt_work_future_wait(&futures[0], RT_WAITING_FOREVER, &result), RT_EOK);
+    uassert_int_equal((rt_ubase_t)result, 4);
+
+    rt_workqueue_destroy(queue);
+}
+
+static void test_workqueue_cancel_sync(void)
+{
+    struct rt_workqueue *queue;
+    struct rt_work work;
+
+    queue = rt_workqueue_create_workers("wq_sync", WORK_STACK_SIZE, work_priority, 2);
+    uassert_not_null(queue);
+    if (queue == RT_NULL)
+    {
+        return;
+    }
+
+    /* the running work is waited for, and it's not run again */
+    rt_work_init(&work, sleep_work_func, RT_NULL);
+    rt_workqueue_submit_work(queue, &work, 0);
+    rt_thread_mdelay(10);
+    uassert_int_equal(rt_workqueue_submit_work(queue, &work, 0), -RT_EBUSY);
+    rt_workqueue_cancel_work_sync(queue, &work);
+    uassert_int_equal(rt_sem_trytake(&done_sem), RT_EOK);
+    uassert_int_equal(rt_sem_take(&done_sem, rt_tick_from_millisecond(WORK_SLEEP_MS * 2)), -RT_ETIMEOUT);
+
+    rt_workqueue_destroy(queue);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    /* the workers run before this thread */
+    work_priority = rt_thread_self()->current_priority - 1;
+    rt_sem_init(&done_sem, "wq_done", 0, RT_IPC_FLAG_PRIO);
+    rt_sem_init(&gate_sem, "wq_gate", 0, RT_IPC_FLAG_PRIO);
+
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_sem_detach(&done_sem);
+    rt_sem_detach(&gate_sem);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_workqueue_workers);
+    UTEST_UNIT_RUN(test_workqueue_priority);
+    UTEST_UNIT_RUN(test_workqueue_future);
+    UTEST_UNIT_RUN(test_workqueue_cancel_sync);
+}
+UTEST_TC_EXPORT(testcase, "testcases.drivers.ipc.workqueue_tc", utest_tc_init, utest_tc_cleanup, 10);
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <drivers/mmcsd_core.h>
+#include "utest.h"
+
+#define TC_SECTOR_SIZE      512
+#define TC_SECTOR_COUNT     (256 + RT_MMCSD_RA_MAX_BLKS * 2)
+#define TC_LARGE_BLKS       (RT_MMCSD_RA_MAX_BLKS + 1)
+
+/*
+ * The fake card in ram behind a fake host, the data of sector n is filled with
+ * the low byte of n, so the sector 0 has no partition table.
+ */
+static struct rt_mmcsd_host *tc_host;
+static struct rt_mmcsd_card tc_card;
+static rt_uint8_t *card_data;
+static rt_uint32_t card_reads, card_writes;
+static rt_device_t tc_dev;
+static rt_uint8_t buffer[TC_LARGE_BLKS * TC_SECTOR_SIZE];
+
+static void tc_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *req)
+{
+    struct rt_mmcsd_cmd *cmd = req->cmd;
+    struct rt_mmcsd_data *data = req->data;
+    rt_uint8_t *sector;
+
+    cmd->err = 0;
+    if (data != RT_NULL)
+    {
+        if (cmd->arg + data->blks > TC_SECTOR_COUNT)
+        {
+            data->err = -RT_EIO;
+        }
+        else
+        {
+            sector = card_data + cmd->arg * TC_SECTOR_SIZE;
+            if (data->flags & DATA_DIR_WRITE)
+            {
+                rt_memcpy(sector, data->buf, data->blks * TC_SECTOR_SIZE);
+                card_writes ++;
+            }
+            else
+            {
+                rt_memcpy(data->buf, sector, data->blks * TC_SECTOR_SIZE);
+                card_reads ++;
+            }
+        }
+    }
+
+    mmcsd_req_complete(host);
+}
+
+static void tc_set_iocfg(struct rt_mmcsd_host *host, struct rt_mmcsd_io_cfg *io_cfg)
+{
+}
+
+static const struct rt_mmcsd_host_ops tc_ops =
+{
+    tc_request,
+    tc_set_iocfg,
+    RT_NULL,
+    RT_NULL,
+};
+
+static rt_bool_t sector_check(rt_uint32_t sector, rt_uint8_t value)
+{
+    rt_memset(buffer, ~value, TC_SECTOR_SIZE);
+    if (rt_device_read(tc_dev, sector, buffer, 1) != 1)
+    {
+        return RT_FALSE;
+    }
+
+    return buffer[0] == value && buffer[TC_SECTOR_SIZE - 1] == value;
+}
+
+static void test_read_ahead_after_write(void)
+{
+    rt_uint32_t sector;
+
+    card_reads = card_writes = 0;
+
+    /* the write is kept in the merge buffer */
+    rt_memset(buffer, 0xa5, TC_SECTOR_SIZE);
+    uassert_int_equal(rt_device_write(tc_dev, 100, buffer, 1), 1);
+#if RT_MMCSD_WB_BLKS > 1 && !defined(RT_MMCSD_USING_BLK_THREAD)
+    uassert_int_equal(card_writes, 0);
+#endif
+
+    /* the window read ahead covers the merged sector */
+    for (sector = 96; sector < 100; sector++)
+    {
+        uassert_true(sector_check(sector, (rt_uint8_t)sector));
+    }
+    uassert_true(sector_check(100, 0xa5));
+    uassert_true(sector_check(101, 101));
+    uassert_int_equal(card_data[100 * TC_SECTOR_SIZE], 0xa5);
+
+    /* the sectors read ahead are dropped by the write in the window */
+    rt_memset(buffer, 0x5a, TC_SECTOR_SIZE);
+    uassert_int_equal(rt_device_write(tc_dev, 102, buffer, 1), 1);
+    uassert_true(sector_check(102, 0x5a));
+    uassert_true(sector_check(103, 103));
+
+    uassert_int_equal(rt_device_control(tc_dev, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL), RT_EOK);
+    uassert_int_equal(card_data[102 * TC_SECTOR_SIZE], 0x5a);
+}
+
+static void test_large_read_after_write(void)
+{
+    rt_uint32_t sector = 150;
+
+    /* the large read to the buffer of caller sees the merged sector */
+    rt_memset(buffer, 0x3c, TC_SECTOR_SIZE);
+    uassert_int_equal(rt_device_write(tc_dev, sector + 4, buffer, 1), 1);
+
+    rt_memset(buffer, 0, sizeof(buffer));
+    uassert_int_equal(rt_device_read(tc_dev, sector, buffer, TC_LARGE_BLKS), TC_LARGE_BLKS);
+    uassert_int_equal(buffer[3 * TC_SECTOR_SIZE], (rt_uint8_t)(sector + 3));
+    uassert_int_equal(buffer[4 * TC_SECTOR_SIZE], 0x3c);
+    uassert_int_equal(buffer[5 * TC_SECTOR_SIZE], (rt_uint8_t)(sector + 5));
+    uassert_int_equal(card_data[(sector + 4) * TC_SECTOR_SIZE], 0x3c);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    char name[RT_NAME_MAX];
+    rt_uint32_t sector;
+
+    card_data = (rt_uint8_t *)rt_malloc(TC_SECTOR_COUNT * TC_SECTOR_SIZE);
+    tc_host = mmcsd_alloc_host();
+    if (card_data == RT_NULL || tc_host == RT_NULL)
+    {
+        goto __err;
+    }
+    for (sector = 0; sector < TC_SECTOR_COUNT; sector++)
+    {
+        rt_memset(card_data + sector * TC_SECTOR_SIZE, (rt_uint8_t)sector, TC_SECTOR_SIZE);
+    }
+
+    /* a block-addressed card on a spi host, no status is polled after writes */
+    tc_host->ops = &tc_ops;
+    tc_host->flags = MMCSD_HOST_IS_SPI;
+    tc_host->io_cfg.clock = 25000000;
+    rt_memset(&tc_card, 0, sizeof(tc_card));
+    tc_card.host = tc_host;
+    tc_card.card_type = CARD_TYPE_MMC;
+    tc_card.flags = CARD_FLAG_SDHC;
+    tc_card.card_capacity = TC_SECTOR_COUNT * TC_SECTOR_SIZE / 1024;
+    tc_card.card_blksize = TC_SECTOR_SIZE;
+    tc_host->card = &tc_card;
+
+    if (rt_mmcsd_blk_probe(&tc_card) != RT_EOK)
+    {
+        goto __err;
+    }
+    rt_snprintf(name, sizeof(name), "sd%d", tc_host->id);
+    tc_dev = rt_device_find(name);
+    if (tc_dev == RT_NULL || rt_device_open(tc_dev, RT_DEVICE_OFLAG_RDWR) != RT_EOK)
+    {
+        rt_mmcsd_blk_remove(&tc_card);
+        goto __err;
+    }
+
+    return RT_EOK;
+
+__err:
+    if (tc_host != RT_NULL)
+    {
+        mmcsd_free_host(tc_host);
+        tc_host = RT_NULL;
+    }
+    rt_free(card_data);
+    card_data = RT_NULL;
+
+    return -RT_ERROR;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_device_close(tc_dev);
+    rt_mmcsd_blk_remove(&tc_card);
+    mmcsd_free_host(tc_host);
+    rt_free(card_data);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_read_ahead_after_write);
+    UTEST_UNIT_RUN(test_large_read_after_write);
+}
+UTEST_TC_EXPORT(testcase, "testcases.drivers.sdio.mmcsd_blk_queue_tc", utest_tc_init, utest_tc_cleanup, 10);
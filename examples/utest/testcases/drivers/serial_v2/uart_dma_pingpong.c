@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "utest.h"
+
+#define TC_UART_DEVICE_NAME     "uart_lb"
+#define TC_RX_BUFSZ             1024
+#define TC_OPEN_FLAG            (RT_DEVICE_FLAG_RX_BLOCKING | RT_DEVICE_FLAG_TX_BLOCKING | \
+                                 RT_DEVICE_FLAG_DMA_RX | RT_DEVICE_FLAG_DMA_TX)
+
+/*
+ * The loopback uart model, the line of tx is wired to rx. A buffer sent by the tx DMA
+ * is written into the circular rx DMA buffer one tick later, with the half transfer,
+ * transfer complete and idle line events as a real DMA does.
+ */
+struct loopback_uart
+{
+    struct rt_serial_device serial;
+    struct rt_timer timer;
+
+    rt_uint8_t *dma_buf;
+    rt_size_t dma_size;
+    rt_size_t dma_pos;
+
+    const rt_uint8_t *tx_buf;
+    rt_size_t tx_size;
+};
+
+static struct loopback_uart lb_uart;
+static struct rt_semaphore sem_desc;
+static rt_uint8_t tx_data[TC_RX_BUFSZ + 100];
+static rt_uint8_t rx_data[TC_RX_BUFSZ + 100];
+
+static rt_err_t lb_configure(struct rt_serial_device *serial, struct serial_configure *cfg)
+{
+    return RT_EOK;
+}
+
+static rt_err_t lb_control(struct rt_serial_device *serial, int cmd, void *arg)
+{
+    if (cmd == RT_DEVICE_CTRL_CLR_INT && (rt_ubase_t)arg == RT_DEVICE_FLAG_DMA_RX)
+    {
+        lb_uart.dma_buf = RT_NULL;
+    }
+
+    return RT_EOK;
+}
+
+static int lb_putc(struct rt_serial_device *serial, char c)
+{
+    return 1;
+}
+
+static int lb_getc(struct rt_serial_device *serial)
+{
+    return -1;
+}
+
+static rt_size_t lb_transmit(struct rt_serial_device *serial, rt_uint8_t *buf,
+                             rt_size_t size, rt_uint32_t tx_flag)
+{
+    lb_uart.tx_buf = buf;
+    lb_uart.tx_size = size;
+    rt_timer_start(&lb_uart.timer);
+
+    return size;
+}
+
+static rt_err_t lb_dma_rx_start(struct rt_serial_device *serial, rt_uint8_t *buf, rt_size_t size)
+{
+    lb_uart.dma_buf = buf;
+    lb_uart.dma_size = size;
+    lb_uart.dma_pos = 0;
+
+    return RT_EOK;
+}
+
+static const struct rt_uart_ops lb_ops =
+{
+    lb_configure,
+    lb_control,
+    lb_putc,
+    lb_getc,
+    lb_transmit,
+    lb_dma_rx_start,
+};
+
+static void lb_timeout(void *parameter)
+{
+    rt_size_t i, half;
+
+    half = lb_uart.dma_size / 2;
+    for (i = 0; i < lb_uart.tx_size && lb_uart.dma_buf != RT_NULL; i++)
+    {
+        lb_uart.dma_buf[lb_uart.dma_pos ++] = lb_uart.tx_buf[i];
+        if (lb_uart.dma_pos == half)
+        {
+            rt_hw_serial_isr(&lb_uart.serial, RT_SERIAL_EVENT_RX_DMA_HT);
+        }
+        else if (lb_uart.dma_pos == lb_uart.dma_size)
+        {
+            lb_uart.dma_pos = 0;
+            rt_hw_serial_isr(&lb_uart.serial, RT_SERIAL_EVENT_RX_DMA_TC);
+        }
+    }
+    /* the line is idle after the last byte */
+    if (lb_uart.dma_buf != RT_NULL && lb_uart.dma_pos != 0 && lb_uart.dma_pos != half)
+    {
+        rt_hw_serial_isr(&lb_uart.serial, RT_SERIAL_EVENT_RX_IDLE | (lb_uart.dma_pos << 8));
+    }
+
+    rt_hw_serial_isr(&lb_uart.serial, RT_SERIAL_EVENT_TX_DMADONE);
+}
+
+static void desc_done(struct rt_serial_device *serial, struct rt_serial_tx_desc *desc)
+{
+    rt_sem_release(&sem_desc);
+}
+
+static rt_device_t uart_open(rt_size_t rx_bufsz)
+{
+    rt_device_t dev = &lb_uart.serial.parent;
+
+    lb_uart.serial.config.rx_bufsz = rx_bufsz;
+    if (rt_device_open(dev, TC_OPEN_FLAG) != RT_EOK)
+    {
+        return RT_NULL;
+    }
+
+    return dev;
+}
+
+static rt_bool_t rx_check(rt_device_t dev, const rt_uint8_t *expect, rt_size_t size)
+{
+    rt_memset(rx_data, 0, size);
+    if (rt_device_read(dev, 0, rx_data, size) != size)
+    {
+        return RT_FALSE;
+    }
+
+    return rt_memcmp(rx_data, expect, size) == 0;
+}
+
+static void test_dma_chain_loopback(void)
+{
+    struct rt_serial_tx_desc desc[3];
+    rt_size_t sizes[3] = {100, 200, 300};
+    rt_size_t offset = 0;
+    rt_device_t dev;
+    int i;
+
+    dev = uart_open(TC_RX_BUFSZ);
+    uassert_not_null(dev);
+    if (dev == RT_NULL)
+    {
+        return;
+    }
+    uassert_true(dev->open_flag & RT_DEVICE_FLAG_DMA_RX);
+    uassert_true(dev->open_flag & RT_DEVICE_FLAG_DMA_TX);
+
+    /* the buffers are sent in place one after another, across the halves of rx DMA */
+    for (i = 0; i < 3; i++)
+    {
+        desc[i].next = (i < 2) ? &desc[i + 1] : RT_NULL;
+        desc[i].buf = &tx_data[offset];
+        desc[i].size = sizes[i];
+        desc[i].done = desc_done;
+        desc[i].user_data = RT_NULL;
+        offset += sizes[i];
+    }
+    uassert_int_equal(rt_device_control(dev, RT_SERIAL_CTRL_TX_CHAIN, &desc[0]), RT_EOK);
+    for (i = 0; i < 3; i++)
+    {
+        uassert_int_equal(rt_sem_take(&sem_desc, RT_TICK_PER_SECOND), RT_EOK);
+    }
+    uassert_true(rx_check(dev, tx_data, offset));
+
+    /* the write sends the buffer in place too */
+    uassert_int_equal(rt_device_write(dev, 0, &tx_data[7], 150), 150);
+    uassert_true(rx_check(dev, &tx_data[7], 150));
+
+    rt_device_close(dev);
+}
+
+static void test_dma_stat(void)
+{
+    struct rt_serial_stat stat;
+    rt_device_t dev;
+
+    dev = uart_open(TC_RX_BUFSZ);
+    uassert_not_null(dev);
+    if (dev == RT_NULL)
+    {
+        return;
+    }
+
+    uassert_int_equal(rt_device_write(dev, 0, tx_data, 500), 500);
+    uassert_true(rx_check(dev, tx_data, 500));
+    uassert_int_equal(rt_device_control(dev, RT_SERIAL_CTRL_GET_STAT, &stat), RT_EOK);
+    uassert_int_equal(stat.rx_bytes, 500);
+    uassert_int_equal(stat.tx_bytes, 500);
+    uassert_int_equal(stat.rx_overruns, 0);
+    uassert_true(stat.rx_bps > 0);
+
+    /* the bytes not fit in the rx fifo are counted as dropped */
+    uassert_int_equal(rt_device_write(dev, 0, tx_data, TC_RX_BUFSZ + 100), TC_RX_BUFSZ + 100);
+    uassert_true(rx_check(dev, tx_data, TC_RX_BUFSZ));
+    uassert_int_equal(rt_device_control(dev, RT_SERIAL_CTRL_GET_STAT, &stat), RT_EOK);
+    uassert_int_equal(stat.rx_bytes, 500 + TC_RX_BUFSZ);
+    uassert_true(stat.rx_overruns > 0);
+    uassert_int_equal(stat.rx_dropped, 100);
+
+    /* the rx DMA is restarted on error and works as before */
+    rt_hw_serial_isr(&lb_uart.serial, RT_SERIAL_EVENT_RX_DMA_ERR);
+    uassert_int_equal(rt_device_control(dev, RT_SERIAL_CTRL_GET_STAT, &stat), RT_EOK);
+    uassert_int_equal(stat.dma_restarts, 1);
+    uassert_int_equal(rt_device_write(dev, 0, &tx_data[3], 200), 200);
+    uassert_true(rx_check(dev, &tx_data[3], 200));
+
+    rt_device_close(dev);
+}
+
+static void test_dma_peek_consume(void)
+{
+    struct rt_serial_span span;
+    rt_device_t dev;
+
+    dev = uart_open(TC_RX_BUFSZ);
+    uassert_not_null(dev);
+    if (dev == RT_NULL)
+    {
+        return;
+    }
+
+    uassert_int_equal(rt_device_write(dev, 0, &tx_data[11], 50), 50);
+
+    /* the data is parsed in the rx fifo without copy */
+    uassert_int_equal(rt_device_control(dev, RT_SERIAL_CTRL_RX_PEEK, &span), RT_EOK);
+    uassert_int_equal(span.size, 50);
+    uassert_buf_equal(span.ptr, &tx_data[11], 50);
+    uassert_int_equal(rt_device_control(dev, RT_SERIAL_CTRL_RX_CONSUME, (void *)20), RT_EOK);
+
+    uassert_int_equal(rt_device_control(dev, RT_SERIAL_CTRL_RX_PEEK, &span), RT_EOK);
+    uassert_int_equal(span.size, 30);
+    uassert_buf_equal(span.ptr, &tx_data[31], 30);
+    uassert_int_equal(rt_device_control(dev, RT_SERIAL_CTRL_RX_CONSUME, (void *)30), RT_EOK);
+
+    uassert_int_equal(rt_device_control(dev, RT_SERIAL_CTRL_RX_PEEK, &span), RT_EOK);
+    uassert_int_equal(span.size, 0);
+
+    rt_device_close(dev);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    struct serial_configure config = RT_SERIAL_CONFIG_DEFAULT;
+    rt_size_t i;
+
+    for (i = 0; i < sizeof(tx_data); i++)
+    {
+        tx_data[i] = (rt_uint8_t)(i * 7 + 3);
+    }
+
+    rt_memset(&lb_uart, 0, sizeof(lb_uart));
+    lb_uart.serial.ops = &lb_ops;
+    lb_uart.serial.config = config;
+    rt_timer_init(&lb_uart.timer, "uart_lb", lb_timeout, RT_NULL, 1, RT_TIMER_FLAG_ONE_SHOT);
+    rt_sem_init(&sem_desc, "uart_lb", 0, RT_IPC_FLAG_PRIO);
+
+    return rt_hw_serial_register(&lb_uart.serial, TC_UART_DEVICE_NAME,
+                                 RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_DMA_RX | RT_DEVICE_FLAG_DMA_TX,
+                                 RT_NULL);
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_device_unregister(&lb_uart.serial.parent);
+    rt_timer_detach(&lb_uart.timer);
+    rt_sem_detach(&sem_desc);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_dma_chain_loopback);
+    UTEST_UNIT_RUN(test_dma_stat);
+    UTEST_UNIT_RUN(test_dma_peek_consume);
+}
+UTEST_TC_EXPORT(testcase, "testcases.drivers.serial_v2.uart_dma_pingpong", utest_tc_init, utest_tc_cleanup, 10);
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "utest.h"
+
+#define TC_BUS_NAME         "spi_tc"
+#define TC_MSG_NUM          6
+#define TC_MSG_SIZE         16
+#define TC_XFER_MS          2
+#define TC_TRACE_SIZE       32
+
+/*
+ * The software SPI bus, the data received is the inversion of the data sent,
+ * and each transfer takes some milliseconds as a DMA transfer does.
+ */
+struct trace_item
+{
+    struct rt_spi_device *device;
+    rt_uint8_t cs_take;
+    rt_uint8_t cs_release;
+};
+
+static struct rt_spi_bus tc_bus;
+static struct rt_spi_device tc_dev_a, tc_dev_b;
+static rt_bool_t tc_registered = RT_FALSE;
+
+static struct trace_item trace[TC_TRACE_SIZE];
+static volatile int trace_len;
+static struct rt_spi_device *done_order[TC_MSG_NUM * 2];
+static volatile int done_len;
+static struct rt_semaphore sem_done;
+
+static rt_err_t tc_configure(struct rt_spi_device *device, struct rt_spi_configuration *configuration)
+{
+    return RT_EOK;
+}
+
+static rt_uint32_t tc_xfer(struct rt_spi_device *device, struct rt_spi_message *message)
+{
+    const rt_uint8_t *send = (const rt_uint8_t *)message->send_buf;
+    rt_uint8_t *recv = (rt_uint8_t *)message->recv_buf;
+    rt_size_t i;
+
+    if (trace_len < TC_TRACE_SIZE)
+    {
+        trace[trace_len].device = device;
+        trace[trace_len].cs_take = message->cs_take;
+        trace[trace_len].cs_release = message->cs_release;
+        trace_len ++;
+    }
+
+    if (message->length == 0)
+    {
+        return 0;
+    }
+    /* nothing to send or receive is taken as a failure of the bus */
+    if (send == RT_NULL && recv == RT_NULL)
+    {
+        return 0;
+    }
+
+    rt_thread_mdelay(TC_XFER_MS);
+    for (i = 0; recv != RT_NULL && i < message->length; i++)
+    {
+        recv[i] = send ? (rt_uint8_t)~send[i] : 0xff;
+    }
+
+    return message->length;
+}
+
+static const struct rt_spi_ops tc_ops =
+{
+    tc_configure,
+    tc_xfer,
+};
+
+static void tc_done(struct rt_spi_device *device, struct rt_spi_async_message *async)
+{
+    if (done_len < TC_MSG_NUM * 2)
+    {
+        done_order[done_len ++] = device;
+    }
+    rt_sem_release(&sem_done);
+}
+
+static void tc_message_init(struct rt_spi_message *message, const void *send_buf, void *recv_buf,
+                            rt_size_t length, int cs_take, int cs_release)
+{
+    message->send_buf = send_buf;
+    message->recv_buf = recv_buf;
+    message->length = length;
+    message->next = RT_NULL;
+    message->cs_take = cs_take;
+    message->cs_release = cs_release;
+}
+
+static void tc_reset(void)
+{
+    trace_len = 0;
+    done_len = 0;
+    while (rt_sem_trytake(&sem_done) == RT_EOK);
+}
+
+static void test_spi_async_queue(void)
+{
+    static struct rt_spi_message message[TC_MSG_NUM * 2];
+    static struct rt_spi_async_message async[TC_MSG_NUM * 2];
+    static rt_uint8_t send[TC_MSG_NUM * 2][TC_MSG_SIZE], recv[TC_MSG_NUM * 2][TC_MSG_SIZE];
+    struct rt_spi_bus_stat stat;
+    int i, j, last_a = -1, first_b = -1;
+
+    tc_reset();
+    rt_spi_bus_get_stat(&tc_bus, &stat, RT_TRUE);
+
+    /* the messages of two devices are queued without waiting */
+    for (i = 0; i < TC_MSG_NUM * 2; i++)
+    {
+        rt_memset(send[i], i, TC_MSG_SIZE);
+        rt_memset(recv[i], 0, TC_MSG_SIZE);
+        tc_message_init(&message[i], send[i], recv[i], TC_MSG_SIZE, 1, 1);
+        rt_spi_async_message_init(&async[i], &message[i], tc_done, RT_NULL);
+        uassert_int_equal(rt_spi_transfer_message_async((i < TC_MSG_NUM) ? &tc_dev_a : &tc_dev_b,
+                                                        &async[i]), RT_EOK);
+    }
+    uassert_true(done_len < TC_MSG_NUM * 2);
+
+    for (i = 0; i < TC_MSG_NUM * 2; i++)
+    {
+        uassert_int_equal(rt_sem_take(&sem_done, RT_TICK_PER_SECOND), RT_EOK);
+    }
+    for (i = 0; i < TC_MSG_NUM * 2; i++)
+    {
+        uassert_int_equal(async[i].result, RT_EOK);
+        uassert_null(async[i].failed);
+        for (j = 0; j < TC_MSG_SIZE; j++)
+        {
+            if (recv[i][j] != (rt_uint8_t)~i)
+            {
+                break;
+            }
+        }
+        uassert_int_equal(j, TC_MSG_SIZE);
+    }
+
+    /* the devices are served in turn by batches */
+    for (i = 0; i < done_len; i++)
+    {
+        if (done_order[i] == &tc_dev_a)
+        {
+            last_a = i;
+        }
+        else if (first_b < 0)
+        {
+            first_b = i;
+        }
+    }
+    if (RT_SPI_ASYNC_BATCH < TC_MSG_NUM)
+    {
+        uassert_true(first_b >= 0 && first_b < last_a);
+    }
+
+    rt_spi_bus_get_stat(&tc_bus, &stat, RT_FALSE);
+    uassert_int_equal(stat.async_messages, TC_MSG_NUM * 2);
+    uassert_int_equal(stat.async_errors, 0);
+    uassert_int_equal(stat.async_bytes, TC_MSG_NUM * 2 * TC_MSG_SIZE);
+    uassert_int_equal(stat.async_queued, 0);
+    uassert_true(stat.async_queued_max > 1);
+    uassert_true(stat.busy_ticks > 0);
+}
+
+static void test_spi_async_cs_hold(void)
+{
+    struct rt_spi_message msg_a1, msg_a2, msg_b;
+    struct rt_spi_async_message async_a1, async_a2, async_b;
+    rt_uint8_t send[TC_MSG_SIZE], recv[TC_MSG_SIZE];
+
+    tc_reset();
+    rt_memset(send, 0x5a, sizeof(send));
+
+    /* the chip select of a is held between its two message lists */
+    tc_message_init(&msg_a1, send, RT_NULL, TC_MSG_SIZE, 1, 0);
+    tc_message_init(&msg_a2, RT_NULL, recv, TC_MSG_SIZE, 0, 1);
+    tc_message_init(&msg_b, send, recv, TC_MSG_SIZE, 1, 1);
+    rt_spi_async_message_init(&async_a1, &msg_a1, tc_done, RT_NULL);
+    rt_spi_async_message_init(&async_a2, &msg_a2, tc_done, RT_NULL);
+    rt_spi_async_message_init(&async_b, &msg_b, tc_done, RT_NULL);
+
+    uassert_int_equal(rt_spi_transfer_message_async(&tc_dev_a, &async_a1), RT_EOK);
+    uassert_int_equal(rt_spi_transfer_message_async(&tc_dev_b, &async_b), RT_EOK);
+    rt_thread_mdelay(TC_XFER_MS * 10);
+    uassert_int_equal(rt_spi_transfer_message_async(&tc_dev_a, &async_a2), RT_EOK);
+
+    uassert_int_equal(rt_sem_take(&sem_done, RT_TICK_PER_SECOND), RT_EOK);
+    uassert_int_equal(rt_sem_take(&sem_done, RT_TICK_PER_SECOND), RT_EOK);
+    uassert_int_equal(rt_sem_take(&sem_done, RT_TICK_PER_SECOND), RT_EOK);
+
+    uassert_int_equal(trace_len, 3);
+    uassert_true(trace[0].device == &tc_dev_a && trace[0].cs_take);
+    uassert_true(trace[1].device == &tc_dev_a && trace[1].cs_release);
+    uassert_true(trace[2].device == &tc_dev_b);
+}
+
+static void test_spi_async_sync_mix(void)
+{
+    struct rt_spi_message message[TC_MSG_NUM];
+    struct rt_spi_async_message async;
+    rt_uint8_t send[TC_MSG_SIZE], recv[TC_MSG_SIZE], sync_recv[TC_MSG_SIZE];
+    struct rt_spi_bus_stat stat;
+    int i;
+
+    tc_reset();
+    rt_spi_bus_get_stat(&tc_bus, &stat, RT_TRUE);
+    rt_memset(send, 0x33, sizeof(send));
+
+    /* a chained message list fails at the broken message */
+    for (i = 0; i < TC_MSG_NUM; i++)
+    {
+        tc_message_init(&message[i], send, recv, TC_MSG_SIZE, i == 0, i == TC_MSG_NUM - 1);
+        if (i > 0)
+        {
+            rt_spi_message_append(&message[0], &message[i]);
+        }
+    }
+    message[3].send_buf = RT_NULL;
+    message[3].recv_buf = RT_NULL;
+    rt_spi_async_message_init(&async, &message[0], tc_done, RT_NULL);
+    uassert_int_equal(rt_spi_transfer_message_async(&tc_dev_a, &async), RT_EOK);
+
+    /* the synchronous transfer is serialized with the async ones by the bus lock */
+    uassert_int_equal(rt_spi_transfer(&tc_dev_b, send, sync_recv, TC_MSG_SIZE), TC_MSG_SIZE);
+    uassert_int_equal(sync_recv[0], (rt_uint8_t)~0x33);
+
+    uassert_int_equal(rt_sem_take(&sem_done, RT_TICK_PER_SECOND), RT_EOK);
+    uassert_int_equal(async.result, -RT_EIO);
+    uassert_true(async.failed == &message[3]);
+
+    rt_spi_bus_get_stat(&tc_bus, &stat, RT_FALSE);
+    uassert_int_equal(stat.async_messages, 1);
+    uassert_int_equal(stat.async_errors, 1);
+    uassert_int_equal(stat.async_bytes, 3 * TC_MSG_SIZE);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    rt_sem_init(&sem_done, "spi_tc", 0, RT_IPC_FLAG_PRIO);
+
+    if (!tc_registered)
+    {
+        if (rt_spi_bus_register(&tc_bus, TC_BUS_NAME, &tc_ops) != RT_EOK ||
+            rt_spi_bus_attach_device(&tc_dev_a, "spi_tca", TC_BUS_NAME, RT_NULL) != RT_EOK ||
+            rt_spi_bus_attach_device(&tc_dev_b, "spi_tcb", TC_BUS_NAME, RT_NULL) != RT_EOK)
+        {
+            return -RT_ERROR;
+        }
+        tc_registered = RT_TRUE;
+    }
+
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    return rt_sem_detach(&sem_done);
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_spi_async_queue);
+    UTEST_UNIT_RUN(test_spi_async_cs_hold);
+    UTEST_UNIT_RUN(test_spi_async_sync_mix);
+}
+UTEST_TC_EXPORT(testcase, "testcases.drivers.spi.spi_async_tc", utest_tc_init, utest_tc_cleanup, 10);
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include "utest.h"
+
+#define TEST_STACK_SIZE     2048
+#define TEST_BUSY_TICKS     (RT_TICK_PER_SECOND / 10 + 1)
+#define TEST_SLEEP_ROUNDS   10
+
+static struct rt_semaphore sem_done;
+
+static void busy_entry(void *parameter)
+{
+    rt_tick_t start = rt_tick_get();
+
+    while (rt_tick_get() - start < TEST_BUSY_TICKS);
+
+    rt_sem_release(&sem_done);
+}
+
+static void sleep_entry(void *parameter)
+{
+    int i;
+
+    for (i = 0; i < TEST_SLEEP_ROUNDS; i++)
+    {
+        rt_thread_delay(1);
+    }
+
+    rt_sem_release(&sem_done);
+}
+
+static rt_thread_t _thread_run(void (*entry)(void *parameter), struct rt_thread_usage *usage)
+{
+    rt_thread_t tid;
+
+    tid = rt_thread_create("usage_th", entry, RT_NULL, TEST_STACK_SIZE,
+                           rt_thread_self()->current_priority + 1, 10);
+    if (tid == RT_NULL)
+    {
+        return RT_NULL;
+    }
+
+    /* the thread of lower priority exits after the usage is read */
+    rt_thread_startup(tid);
+    rt_sem_take(&sem_done, RT_WAITING_FOREVER);
+    rt_thread_get_usage(tid, usage);
+
+    return tid;
+}
+
+static void cpu_usage_busy_test(void)
+{
+    struct rt_thread_usage usage;
+
+    if (_thread_run(busy_entry, &usage) == RT_NULL)
+    {
+        uassert_true(RT_FALSE);
+        return;
+    }
+
+    /* the busy thread runs for the ticks without blocking */
+    uassert_true(usage.run_time > 0);
+    uassert_int_equal(usage.voluntary_switches, 0);
+    LOG_I("busy: run %d, irq %d, wait %d", (rt_uint32_t)usage.run_time,
+          (rt_uint32_t)usage.irq_time, (rt_uint32_t)usage.wait_time);
+}
+
+static void cpu_usage_sleep_test(void)
+{
+    struct rt_thread_usage usage;
+
+    if (_thread_run(sleep_entry, &usage) == RT_NULL)
+    {
+        uassert_true(RT_FALSE);
+        return;
+    }
+
+    /* every sleep is a voluntary switch */
+    uassert_true(usage.voluntary_switches >= TEST_SLEEP_ROUNDS);
+    LOG_I("sleep: run %d, switches %d/%d", (rt_uint32_t)usage.run_time,
+          usage.voluntary_switches, usage.involuntary_switches);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    return rt_sem_init(&sem_done, "usage", 0, RT_IPC_FLAG_PRIO);
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    return rt_sem_detach(&sem_done);
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(cpu_usage_busy_test);
+    UTEST_UNIT_RUN(cpu_usage_sleep_test);
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.cpu_usage_tc", utest_tc_init, utest_tc_cleanup, 10);
@@ -6,11 +6,16 @@
  * Change Logs:
  * Date           Author       Notes
  * 2021-08-15     liukang     the first version
+ * 2022-02-24     RT-Thread    add the tests of selective wakeup and send latency
+ * 2022-02-24     RT-Thread    add the test of wakeup in priority order
  */
 
 #include <rtthread.h>
 #include "utest.h"
 #include <stdlib.h>
+#ifdef RT_USING_CPUTIME
+#include <rtdevice.h>
+#endif /* RT_USING_CPUTIME */
 
 #define EVENT_FLAG3 (1 << 3)
 #define EVENT_FLAG5 (1 << 5)
@@ -312,6 +317,208 @@ static void test_dynamic_event_send_recv(void)
 
     return;
 }
+
+struct event_waiter
+{
+    rt_event_t event;
+    rt_uint32_t set;
+    rt_uint8_t option;
+    volatile rt_uint32_t recved;
+};
+
+static void waiter_entry(void *param)
+{
+    struct event_waiter *waiter = (struct event_waiter *)param;
+    rt_uint32_t recved = 0;
+
+    if (rt_event_recv(waiter->event, waiter->set, waiter->option,
+                      RT_WAITING_FOREVER, &recved) == RT_EOK)
+    {
+        waiter->recved = recved;
+    }
+}
+
+static rt_bool_t waiter_start(struct event_waiter *waiter, rt_uint8_t priority)
+{
+    rt_thread_t tid;
+
+    tid = rt_thread_create("waiter", waiter_entry, waiter, 512, priority, THREAD_TIMESLICE);
+    if (tid == RT_NULL)
+    {
+        return RT_FALSE;
+    }
+    rt_thread_startup(tid);
+
+    return RT_TRUE;
+}
+
+static void test_event_selective_wakeup(void)
+{
+    struct event_waiter waiters[4] =
+    {
+        {RT_NULL, EVENT_FLAG3, RT_EVENT_FLAG_OR, 0},
+        {RT_NULL, EVENT_FLAG5, RT_EVENT_FLAG_OR, 0},
+        {RT_NULL, (1 << 1) | (1 << 12), RT_EVENT_FLAG_AND, 0},
+        {RT_NULL, (1 << 2) | (1 << 20), RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, 0},
+    };
+    rt_event_t event;
+    int i;
+
+    event = rt_event_create("sel_event", RT_IPC_FLAG_PRIO);
+    uassert_not_null(event);
+    if (event == RT_NULL)
+    {
+        return;
+    }
+
+    /* the waiters of higher priority run and block at once */
+    for (i = 0; i < 4; i++)
+    {
+        waiters[i].event = event;
+        uassert_true(waiter_start(&waiters[i], rt_thread_self()->current_priority - 1));
+    }
+    rt_thread_mdelay(10);
+
+    /* only the waiter of the bit sent wakes up */
+    rt_event_send(event, EVENT_FLAG5);
+    rt_thread_mdelay(10);
+    uassert_int_equal(waiters[0].recved, 0);
+    uassert_int_equal(waiters[1].recved, EVENT_FLAG5);
+    uassert_int_equal(waiters[2].recved, 0);
+    uassert_int_equal(waiters[3].recved, 0);
+
+    /* the AND waiter wakes up with its last bit, not the lowest one */
+    rt_event_send(event, 1 << 1);
+    rt_thread_mdelay(10);
+    uassert_int_equal(waiters[2].recved, 0);
+    rt_event_send(event, 1 << 12);
+    rt_thread_mdelay(10);
+    uassert_int_equal(waiters[2].recved, (1 << 1) | (1 << 12));
+
+    /* the OR waiter wakes up with any of its bits */
+    rt_event_send(event, 1 << 20);
+    rt_thread_mdelay(10);
+    uassert_int_equal(waiters[3].recved, 1 << 20);
+    uassert_int_equal(waiters[0].recved, 0);
+
+    rt_event_send(event, EVENT_FLAG3);
+    rt_thread_mdelay(10);
+    uassert_int_equal(waiters[0].recved, EVENT_FLAG3);
+
+    rt_event_delete(event);
+}
+
+static void test_event_priority_wakeup(void)
+{
+    struct event_waiter low = {RT_NULL, (1 << 1) | EVENT_FLAG5, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, 0};
+    struct event_waiter high = {RT_NULL, EVENT_FLAG5, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, 0};
+    rt_uint8_t priority = rt_thread_self()->current_priority;
+    rt_event_t event;
+
+    event = rt_event_create("pri_event", RT_IPC_FLAG_PRIO);
+    uassert_not_null(event);
+    if (event == RT_NULL)
+    {
+        return;
+    }
+
+    /* the waiter of lower priority waits first, for a lower bit */
+    low.event = event;
+    high.event = event;
+    uassert_true(waiter_start(&low, priority - 1));
+    uassert_true(waiter_start(&high, priority - 2));
+    rt_thread_mdelay(10);
+
+    /* the bit cleared goes to the waiter of higher priority */
+    rt_event_send(event, EVENT_FLAG5);
+    rt_thread_mdelay(10);
+    uassert_int_equal(high.recved, EVENT_FLAG5);
+    uassert_int_equal(low.recved, 0);
+
+    rt_event_send(event, 1 << 1);
+    rt_thread_mdelay(10);
+    uassert_int_equal(low.recved, 1 << 1);
+
+    rt_event_delete(event);
+}
+
+static rt_uint64_t latency_clock(void)
+{
+#ifdef RT_USING_CPUTIME
+    if (clock_cpu_getres() > 0)
+    {
+        return clock_cpu_count();
+    }
+#endif /* RT_USING_CPUTIME */
+    return rt_tick_get();
+}
+
+#define LATENCY_SENDS       10000
+#define LATENCY_WAITERS_MAX 64
+
+static void test_event_send_latency(void)
+{
+    static struct event_waiter waiters[LATENCY_WAITERS_MAX];
+    static const int counts[] = {1, 16, LATENCY_WAITERS_MAX};
+    rt_event_t event;
+    rt_uint64_t start, cost;
+    int round, i, started, loop;
+
+    for (round = 0; round < sizeof(counts) / sizeof(counts[0]); round++)
+    {
+        event = rt_event_create("lat_event", RT_IPC_FLAG_PRIO);
+        uassert_not_null(event);
+        if (event == RT_NULL)
+        {
+            return;
+        }
+
+        /* the waiters wait for bit 1..31, none for bit 0 */
+        for (started = 0; started < counts[round]; started++)
+        {
+            waiters[started].event = event;
+            waiters[started].set = 1ul << (1 + started % 31);
+            waiters[started].option = RT_EVENT_FLAG_OR;
+            waiters[started].recved = 0;
+            if (!waiter_start(&waiters[started], rt_thread_self()->current_priority - 1))
+            {
+                break;
+            }
+        }
+        rt_thread_mdelay(10);
+
+        /* the send of bit 0 wakes up nobody, it's the cost of the search */
+        start = latency_clock();
+        for (loop = 0; loop < LATENCY_SENDS; loop++)
+        {
+            rt_event_send(event, 1);
+        }
+        cost = latency_clock() - start;
+
+#ifdef RT_USING_CPUTIME
+        if (clock_cpu_getres() > 0)
+        {
+            LOG_I("%d waiters: %d ns per send", started,
+                  (rt_uint32_t)(cost * clock_cpu_getres() / LATENCY_SENDS));
+        }
+        else
+#endif /* RT_USING_CPUTIME */
+        {
+            LOG_I("%d waiters: %d ticks per %d sends", started, (rt_uint32_t)cost, LATENCY_SENDS);
+        }
+
+        /* all the waiters wake up and exit */
+        rt_event_send(event, 0xFFFFFFFE);
+        rt_thread_mdelay(10);
+        for (i = 0; i < started; i++)
+        {
+            uassert_int_equal(waiters[i].recved, waiters[i].set);
+        }
+        uassert_int_equal(started, counts[round]);
+
+        rt_event_delete(event);
+    }
+}
 #endif
 
 static rt_err_t utest_tc_init(void)
@@ -339,6 +546,9 @@ static void testcase(void)
     UTEST_UNIT_RUN(test_event_create);
     UTEST_UNIT_RUN(test_event_delete);
     UTEST_UNIT_RUN(test_dynamic_event_send_recv);
+    UTEST_UNIT_RUN(test_event_selective_wakeup);
+    UTEST_UNIT_RUN(test_event_priority_wakeup);
+    UTEST_UNIT_RUN(test_event_send_latency);
 #endif
 }
 UTEST_TC_EXPORT(testcase, "src.ipc.event_tc", utest_tc_init, utest_tc_cleanup, 60);
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include "utest.h"
+#ifdef RT_USING_CPUTIME
+#include <rtdevice.h>
+#endif /* RT_USING_CPUTIME */
+
+/*
+ * Two threads switch to each other by the semaphores. In the integer round
+ * none of them uses the FPU, in the float round both keep a double in the
+ * registers across the switches, the results must be the same as computed
+ * without any switch. The cost per switch of the two rounds shows the saving
+ * of the lazy FPU context.
+ */
+
+#define TEST_ROUNDS         10000
+#define TEST_STACK_SIZE     2048
+
+static struct rt_semaphore sem_ping, sem_pong;
+static volatile rt_bool_t worker_fpu;
+static volatile double worker_result;
+
+static double _fpu_step(double acc, int i)
+{
+    return acc * 1.0000001 + (double)i * 0.5;
+}
+
+static void worker_entry(void *parameter)
+{
+    double acc = 1.0;
+    int i;
+
+    for (i = 0; i < TEST_ROUNDS; i++)
+    {
+        rt_sem_take(&sem_ping, RT_WAITING_FOREVER);
+        if (worker_fpu)
+        {
+            acc = _fpu_step(acc, i);
+        }
+        rt_sem_release(&sem_pong);
+    }
+
+    if (worker_fpu)
+    {
+        worker_result = acc;
+    }
+}
+
+static rt_uint64_t _now(void)
+{
+#ifdef RT_USING_CPUTIME
+    if (clock_cpu_getres() > 0)
+    {
+        return clock_cpu_gettime();
+    }
+#endif /* RT_USING_CPUTIME */
+    return rt_tick_get();
+}
+
+static rt_uint64_t _run(rt_bool_t fpu, double *result)
+{
+    rt_thread_t tid;
+    rt_uint64_t start;
+    double acc = 2.0;
+    int i;
+
+    worker_fpu = fpu;
+    tid = rt_thread_create("fpu_th", worker_entry, RT_NULL, TEST_STACK_SIZE,
+                           rt_thread_self()->current_priority, 10);
+    if (tid == RT_NULL)
+    {
+        *result = 0;
+        return 0;
+    }
+    rt_thread_startup(tid);
+
+    start = _now();
+    for (i = 0; i < TEST_ROUNDS; i++)
+    {
+        rt_sem_release(&sem_ping);
+        rt_sem_take(&sem_pong, RT_WAITING_FOREVER);
+        if (fpu)
+        {
+            acc = _fpu_step(acc, TEST_ROUNDS - i);
+        }
+    }
+    *result = acc;
+
+    return _now() - start;
+}
+
+static void fpu_switch_test(void)
+{
+    double expect_main = 2.0, expect_worker = 1.0, result;
+    rt_uint64_t cost_int, cost_fpu;
+    int i;
+
+    for (i = 0; i < TEST_ROUNDS; i++)
+    {
+        expect_worker = _fpu_step(expect_worker, i);
+        expect_main = _fpu_step(expect_main, TEST_ROUNDS - i);
+    }
+
+    cost_int = _run(RT_FALSE, &result);
+    /* wait for the worker to exit */
+    rt_thread_mdelay(10);
+
+    worker_result = 0;
+    cost_fpu = _run(RT_TRUE, &result);
+    rt_thread_mdelay(10);
+
+    uassert_true(result == expect_main);
+    uassert_true(worker_result == expect_worker);
+
+#ifdef RT_USING_CPUTIME
+    if (clock_cpu_getres() > 0)
+    {
+        /* two switches per round */
+        LOG_I("cost per switch: %d counts without FPU, %d counts with FPU",
+              (rt_uint32_t)(cost_int / (TEST_ROUNDS * 2)), (rt_uint32_t)(cost_fpu / (TEST_ROUNDS * 2)));
+        return;
+    }
+#endif /* RT_USING_CPUTIME */
+    LOG_I("cost of %d switches: %d ticks without FPU, %d ticks with FPU",
+          TEST_ROUNDS * 2, (rt_uint32_t)cost_int, (rt_uint32_t)cost_fpu);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    rt_sem_init(&sem_ping, "fpu_ping", 0, RT_IPC_FLAG_PRIO);
+    rt_sem_init(&sem_pong, "fpu_pong", 0, RT_IPC_FLAG_PRIO);
+
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_sem_detach(&sem_ping);
+    rt_sem_detach(&sem_pong);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(fpu_switch_test);
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.fpu_switch_tc", utest_tc_init, utest_tc_cleanup, 60);
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include "utest.h"
+
+/*
+ * One thread bound on each cpu takes and releases a mutex, or a semaphore
+ * used as a lock, around a short critical section for one round. The number
+ * of critical sections completed and the voluntary switches (with
+ * RT_USING_CPU_USAGE) are logged, run it with and without RT_USING_IPC_SPIN
+ * to compare.
+ */
+
+#define TEST_STACK_SIZE     2048
+#define TEST_ROUND_TICKS    (RT_TICK_PER_SECOND)
+#define TEST_HOLD_LOOPS     64
+
+static struct rt_mutex test_mutex;
+static struct rt_semaphore test_lock;
+static struct rt_semaphore sem_done;
+static volatile rt_bool_t test_running;
+static volatile rt_bool_t test_use_mutex;
+static volatile rt_uint32_t lock_holders;
+static volatile rt_uint32_t lock_count;
+static rt_uint32_t worker_ops[RT_CPUS_NR];
+static rt_uint32_t worker_switches[RT_CPUS_NR];
+static rt_uint32_t violations;
+
+static void worker_entry(void *parameter)
+{
+    int id = (int)(rt_ubase_t)parameter;
+    volatile int loop;
+    rt_uint32_t ops = 0;
+#ifdef RT_USING_CPU_USAGE
+    struct rt_thread_usage usage;
+#endif /* RT_USING_CPU_USAGE */
+
+    while (test_running)
+    {
+        if (test_use_mutex)
+        {
+            rt_mutex_take(&test_mutex, RT_WAITING_FOREVER);
+        }
+        else
+        {
+            rt_sem_take(&test_lock, RT_WAITING_FOREVER);
+        }
+
+        if (lock_holders ++ != 0)
+        {
+            violations ++;
+        }
+        for (loop = 0; loop < TEST_HOLD_LOOPS; loop ++);
+        lock_count ++;
+        lock_holders --;
+
+        if (test_use_mutex)
+        {
+            rt_mutex_release(&test_mutex);
+        }
+        else
+        {
+            rt_sem_release(&test_lock);
+        }
+        ops ++;
+    }
+
+    worker_ops[id] = ops;
+#ifdef RT_USING_CPU_USAGE
+    rt_thread_get_usage(rt_thread_self(), &usage);
+    worker_switches[id] = usage.voluntary_switches;
+#endif /* RT_USING_CPU_USAGE */
+
+    rt_sem_release(&sem_done);
+}
+
+static void _contend(rt_bool_t use_mutex)
+{
+    rt_thread_t tid;
+    rt_uint32_t ops = 0, switches = 0;
+    int cpu, started = 0;
+
+    test_use_mutex = use_mutex;
+    test_running = RT_TRUE;
+    lock_holders = 0;
+    lock_count = 0;
+    violations = 0;
+
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu++)
+    {
+        worker_ops[cpu] = 0;
+        worker_switches[cpu] = 0;
+
+        tid = rt_thread_create("spin_w", worker_entry, (void *)(rt_ubase_t)cpu, TEST_STACK_SIZE,
+                               rt_thread_self()->current_priority + 1, 5);
+        if (tid == RT_NULL)
+        {
+            break;
+        }
+        rt_thread_control(tid, RT_THREAD_CTRL_BIND_CPU, (void *)(rt_ubase_t)cpu);
+        rt_thread_startup(tid);
+        started ++;
+    }
+    uassert_int_equal(started, RT_CPUS_NR);
+
+    rt_thread_delay(TEST_ROUND_TICKS);
+    test_running = RT_FALSE;
+
+    for (cpu = 0; cpu < started; cpu++)
+    {
+        rt_sem_take(&sem_done, RT_WAITING_FOREVER);
+    }
+
+    for (cpu = 0; cpu < started; cpu++)
+    {
+        ops += worker_ops[cpu];
+        switches += worker_switches[cpu];
+    }
+
+    uassert_int_equal(violations, 0);
+    uassert_int_equal(lock_count, ops);
+    LOG_I("%s: %d critical sections in %d ticks, %d voluntary switches",
+          use_mutex ? "mutex" : "semaphore", ops, TEST_ROUND_TICKS, switches);
+}
+
+static void ipc_spin_mutex_test(void)
+{
+    _contend(RT_TRUE);
+}
+
+static void ipc_spin_sem_test(void)
+{
+    _contend(RT_FALSE);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    rt_mutex_init(&test_mutex, "spin_mtx", RT_IPC_FLAG_PRIO);
+    rt_sem_init(&test_lock, "spin_sem", 1, RT_IPC_FLAG_PRIO);
+    rt_sem_init(&sem_done, "spin_done", 0, RT_IPC_FLAG_PRIO);
+
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_mutex_detach(&test_mutex);
+    rt_sem_detach(&test_lock);
+    rt_sem_detach(&sem_done);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(ipc_spin_mutex_test);
+    UTEST_UNIT_RUN(ipc_spin_sem_test);
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.ipc_spin_tc", utest_tc_init, utest_tc_cleanup, 10);
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-21     RT-Thread    the first version
+ * 2022-02-24     RT-Thread    run the workers below the test thread
+ */
+
+#include <rtthread.h>
+#include "utest.h"
+
+/*
+ * This benchmark measures rt_malloc/rt_free throughput of small blocks from
+ * one thread and from one thread per cpu. On SMP (e.g. bsp/qemu-riscv-virt64
+ * with RT_USING_SMP and RT_USING_SLAB_AS_HEAP), compare the results with and
+ * without RT_USING_SLAB_MAGAZINE.
+ */
+
+#define THREAD_STACK_SIZE  2048
+#define THREAD_TIMESLICE   5
+
+/* ticks of each measurement round */
+#define TEST_ROUND_TICKS   (RT_TICK_PER_SECOND)
+/* blocks held by each thread */
+#define TEST_SLOTS         32
+#define TEST_SIZE_MAX      512
+
+#ifdef RT_USING_SMP
+#define TEST_THREAD_MAX    RT_CPUS_NR
+#else
+#define TEST_THREAD_MAX    2
+#endif /* RT_USING_SMP */
+
+struct bench_worker
+{
+    rt_thread_t tid;
+    volatile rt_uint32_t ops;
+    volatile rt_bool_t corrupted;
+};
+
+static struct bench_worker workers[TEST_THREAD_MAX];
+static struct rt_semaphore done_sem;
+static volatile rt_bool_t test_running;
+static rt_uint8_t test_priority;
+
+static void worker_entry(void *param)
+{
+    struct bench_worker *worker = (struct bench_worker *)param;
+    rt_uint8_t *slot[TEST_SLOTS] = {RT_NULL};
+    rt_uint32_t seed = (rt_uint32_t)(rt_ubase_t)param;
+    rt_size_t size;
+    int i;
+
+    while (test_running)
+    {
+        seed = seed * 1103515245 + 12345;
+        i = (seed >> 16) % TEST_SLOTS;
+        if (slot[i] != RT_NULL)
+        {
+            /* the block shall not be shared with other threads */
+            if (slot[i][0] != (rt_uint8_t)i)
+            {
+                worker->corrupted = RT_TRUE;
+            }
+            rt_free(slot[i]);
+            slot[i] = RT_NULL;
+        }
+        else
+        {
+            size = 16 + (seed >> 8) % (TEST_SIZE_MAX - 16);
+            slot[i] = (rt_uint8_t *)rt_malloc(size);
+            if (slot[i] != RT_NULL)
+            {
+                slot[i][0] = (rt_uint8_t)i;
+            }
+        }
+        worker->ops ++;
+    }
+
+    for (i = 0; i < TEST_SLOTS; i++)
+    {
+        rt_free(slot[i]);
+    }
+
+    rt_sem_release(&done_sem);
+}
+
+/*
+ * run nr threads for one round and return the number of malloc/free
+ */
+static rt_uint32_t malloc_bench(int nr)
+{
+    int i;
+    char name[RT_NAME_MAX];
+    rt_uint32_t total = 0;
+
+    test_running = RT_TRUE;
+    for (i = 0; i < nr; i++)
+    {
+        workers[i].ops = 0;
+        workers[i].corrupted = RT_FALSE;
+
+        /* the workers never block, the test thread shall preempt them to end the round */
+        rt_sprintf(name, "tmalloc%d", i);
+        workers[i].tid = rt_thread_create(name, worker_entry, &workers[i],
+                                          THREAD_STACK_SIZE, test_priority + 1, THREAD_TIMESLICE);
+        uassert_not_null(workers[i].tid);
+        if (workers[i].tid == RT_NULL)
+        {
+            return 0;
+        }
+#ifdef RT_USING_SMP
+        rt_thread_control(workers[i].tid, RT_THREAD_CTRL_BIND_CPU, (void *)(rt_ubase_t)i);
+#endif /* RT_USING_SMP */
+    }
+
+    for (i = 0; i < nr; i++)
+    {
+        rt_thread_startup(workers[i].tid);
+    }
+
+    rt_thread_delay(TEST_ROUND_TICKS);
+    test_running = RT_FALSE;
+
+    for (i = 0; i < nr; i++)
+    {
+        rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+    }
+
+    for (i = 0; i < nr; i++)
+    {
+        uassert_false(workers[i].corrupted);
+        total += workers[i].ops;
+    }
+
+    return total;
+}
+
+static void test_malloc_bench(void)
+{
+    rt_uint32_t single, multi;
+    rt_size_t used_before, used_after;
+
+    rt_memory_info(RT_NULL, &used_before, RT_NULL);
+
+    single = malloc_bench(1);
+    multi = malloc_bench(TEST_THREAD_MAX);
+
+    LOG_I("malloc/free in %d ticks: 1 thread %d, %d threads %d",
+          TEST_ROUND_TICKS, single, TEST_THREAD_MAX, multi);
+
+    rt_memory_info(RT_NULL, &used_after, RT_NULL);
+    LOG_I("heap used before %d, after %d", used_before, used_after);
+
+    uassert_true(single > 0);
+    uassert_true(multi > 0);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    test_priority = rt_thread_self()->current_priority;
+    rt_sem_init(&done_sem, "done", 0, RT_IPC_FLAG_PRIO);
+
+#ifdef RT_USING_SLAB_MAGAZINE
+    LOG_I("heap: slab with per-cpu magazines");
+#endif /* RT_USING_SLAB_MAGAZINE */
+
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_sem_detach(&done_sem);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_malloc_bench);
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.malloc_bench_tc", utest_tc_init, utest_tc_cleanup, 30);
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include <rthw.h>
+#include <stdlib.h>
+#include "utest.h"
+#ifdef RT_USING_CPUTIME
+#include <rtdevice.h>
+#endif /* RT_USING_CPUTIME */
+
+/*
+ * The test checks rt_memcpy/rt_memset/rt_memcmp against the bytewise loops on
+ * all the sizes and alignments of the heads and tails. The benchmark reports
+ * the bytes per cputime count (cycles with the cycle counter as cputime, e.g.
+ * DWT on Cortex-M), compare the results with and without RT_USING_CPU_MEMOPS.
+ */
+
+#define TEST_SIZE_MAX       300
+#define TEST_ALIGN_MAX      16
+#define TEST_BUF_SIZE       (4096 + 64)
+#define TEST_BENCH_ROUNDS   64
+
+static rt_uint8_t *buf_src, *buf_dst, *buf_ref;
+
+static void _ref_memcpy(rt_uint8_t *d, const rt_uint8_t *s, rt_size_t n)
+{
+    while (n--)
+        *d++ = *s++;
+}
+
+static void _ref_memset(rt_uint8_t *d, rt_uint8_t c, rt_size_t n)
+{
+    while (n--)
+        *d++ = c;
+}
+
+static int _ref_memcmp(const rt_uint8_t *s1, const rt_uint8_t *s2, rt_size_t n)
+{
+    for (; n > 0; s1++, s2++, n--)
+    {
+        if (*s1 != *s2)
+            return (int)*s1 - (int)*s2;
+    }
+
+    return 0;
+}
+
+static void _fill_random(rt_uint8_t *buf, rt_size_t n)
+{
+    while (n--)
+        *buf++ = (rt_uint8_t)rand();
+}
+
+static void memops_memcpy_test(void)
+{
+    rt_size_t size, so, doff;
+
+    for (size = 0; size < TEST_SIZE_MAX; size++)
+    {
+        for (so = 0; so < TEST_ALIGN_MAX; so++)
+        {
+            for (doff = 0; doff < TEST_ALIGN_MAX; doff++)
+            {
+                _fill_random(buf_src, TEST_SIZE_MAX + TEST_ALIGN_MAX);
+                _fill_random(buf_dst, TEST_SIZE_MAX + TEST_ALIGN_MAX * 2);
+                _ref_memcpy(buf_ref, buf_dst, TEST_SIZE_MAX + TEST_ALIGN_MAX * 2);
+                _ref_memcpy(buf_ref + doff, buf_src + so, size);
+
+                /* the bytes around the destination are not touched */
+                uassert_true(rt_memcpy(buf_dst + doff, buf_src + so, size) == buf_dst + doff);
+                if (_ref_memcmp(buf_dst, buf_ref, TEST_SIZE_MAX + TEST_ALIGN_MAX * 2) != 0)
+                {
+                    LOG_E("memcpy size %d, src offset %d, dst offset %d", size, so, doff);
+                    uassert_true(RT_FALSE);
+                    return;
+                }
+            }
+        }
+    }
+    uassert_true(RT_TRUE);
+}
+
+static void memops_memset_test(void)
+{
+    rt_size_t size, doff;
+    rt_uint8_t c;
+
+    for (size = 0; size < TEST_SIZE_MAX; size++)
+    {
+        for (doff = 0; doff < TEST_ALIGN_MAX; doff++)
+        {
+            c = (rt_uint8_t)rand();
+            _fill_random(buf_dst, TEST_SIZE_MAX + TEST_ALIGN_MAX * 2);
+            _ref_memcpy(buf_ref, buf_dst, TEST_SIZE_MAX + TEST_ALIGN_MAX * 2);
+            _ref_memset(buf_ref + doff, c, size);
+
+            /* only the low byte of the value is used */
+            uassert_true(rt_memset(buf_dst + doff, c | 0x100, size) == buf_dst + doff);
+            if (_ref_memcmp(buf_dst, buf_ref, TEST_SIZE_MAX + TEST_ALIGN_MAX * 2) != 0)
+            {
+                LOG_E("memset size %d, dst offset %d", size, doff);
+                uassert_true(RT_FALSE);
+                return;
+            }
+        }
+    }
+    uassert_true(RT_TRUE);
+}
+
+static void memops_memcmp_test(void)
+{
+    rt_size_t size, so, doff, k;
+    int expect, result;
+
+    for (size = 0; size < TEST_SIZE_MAX; size++)
+    {
+        for (so = 0; so < TEST_ALIGN_MAX; so++)
+        {
+            for (doff = 0; doff < TEST_ALIGN_MAX; doff++)
+            {
+                _fill_random(buf_src, TEST_SIZE_MAX + TEST_ALIGN_MAX);
+                _ref_memcpy(buf_dst + doff, buf_src + so, size);
+                uassert_int_equal(rt_memcmp(buf_dst + doff, buf_src + so, size), 0);
+                if (size == 0)
+                {
+                    continue;
+                }
+
+                /* the result is decided by the first different bytes */
+                k = rand() % size;
+                buf_dst[doff + k] ^= (rt_uint8_t)(rand() % 255 + 1);
+                if (rand() % 2)
+                {
+                    buf_dst[doff + rand() % (size - k) + k] ^= 0x80;
+                }
+                expect = _ref_memcmp(buf_dst + doff, buf_src + so, size);
+                result = rt_memcmp(buf_dst + doff, buf_src + so, size);
+                /* the standard library only keeps the sign */
+                if ((expect > 0) - (expect < 0) != (result > 0) - (result < 0))
+                {
+                    LOG_E("memcmp size %d, offset %d %d: %d != %d", size, so, doff, result, expect);
+                    uassert_true(RT_FALSE);
+                    return;
+                }
+            }
+        }
+    }
+    uassert_true(RT_TRUE);
+}
+
+#ifdef RT_USING_CPUTIME
+static const rt_size_t bench_sizes[] = {16, 64, 256, 1024, 4096};
+static const rt_size_t bench_aligns[][2] =
+{
+    /* source and destination offsets */
+    {0, 0}, {1, 0}, {0, 3}, {3, 1},
+};
+
+enum
+{
+    BENCH_MEMCPY,
+    BENCH_MEMSET,
+    BENCH_MEMCMP,
+    BENCH_MAX,
+};
+static const char *bench_names[BENCH_MAX] = {"memcpy", "memset", "memcmp"};
+
+static rt_uint64_t _bench_run(int op, rt_uint8_t *d, const rt_uint8_t *s, rt_size_t size)
+{
+    rt_base_t level;
+    rt_uint64_t start, best = (rt_uint64_t)-1, cost;
+    int round;
+
+    for (round = 0; round < TEST_BENCH_ROUNDS; round++)
+    {
+        level = rt_hw_interrupt_disable();
+        start = clock_cpu_gettime();
+        switch (op)
+        {
+        case BENCH_MEMCPY:
+            rt_memcpy(d, s, size);
+            break;
+        case BENCH_MEMSET:
+            rt_memset(d, round, size);
+            break;
+        default:
+            rt_memcmp(d, s, size);
+            break;
+        }
+        cost = clock_cpu_gettime() - start;
+        rt_hw_interrupt_enable(level);
+
+        /* the best round is the one without cache misses */
+        best = cost < best ? cost : best;
+    }
+
+    return best > 0 ? best : 1;
+}
+
+static void memops_bench(void)
+{
+    rt_uint64_t cost;
+    rt_uint32_t rate;
+    int op, i, j;
+
+    if (clock_cpu_getres() <= 0)
+    {
+        LOG_W("no cputime clock, skipped");
+        return;
+    }
+
+    _fill_random(buf_src, TEST_BUF_SIZE);
+    for (op = 0; op < BENCH_MAX; op++)
+    {
+        for (j = 0; j < sizeof(bench_aligns) / sizeof(bench_aligns[0]); j++)
+        {
+            /* memset has no source */
+            if (op == BENCH_MEMSET && bench_aligns[j][0] != 0)
+            {
+                continue;
+            }
+            for (i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++)
+            {
+                /* the memcmp compares the equal blocks to the end */
+                _ref_memcpy(buf_dst + bench_aligns[j][1], buf_src + bench_aligns[j][0], bench_sizes[i]);
+                cost = _bench_run(op, buf_dst + bench_aligns[j][1],
+                                  buf_src + bench_aligns[j][0], bench_sizes[i]);
+                rate = (rt_uint32_t)(bench_sizes[i] * 100 / cost);
+                LOG_I("%s %4d bytes, offset %d/%d: %6d counts, %d.%02d bytes/count",
+                      bench_names[op], bench_sizes[i], bench_aligns[j][0], bench_aligns[j][1],
+                      (rt_uint32_t)cost, rate / 100, rate % 100);
+            }
+        }
+    }
+    uassert_true(RT_TRUE);
+}
+#endif /* RT_USING_CPUTIME */
+
+static rt_err_t utest_tc_init(void)
+{
+    buf_src = rt_malloc(TEST_BUF_SIZE);
+    buf_dst = rt_malloc(TEST_BUF_SIZE);
+    buf_ref = rt_malloc(TEST_BUF_SIZE);
+    if (buf_src == RT_NULL || buf_dst == RT_NULL || buf_ref == RT_NULL)
+    {
+        rt_free(buf_src);
+        rt_free(buf_dst);
+        rt_free(buf_ref);
+        return -RT_ENOMEM;
+    }
+
+#ifdef RT_USING_CPU_MEMOPS
+    LOG_I("memory operations of cpu");
+#endif /* RT_USING_CPU_MEMOPS */
+
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_free(buf_src);
+    rt_free(buf_dst);
+    rt_free(buf_ref);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(memops_memcpy_test);
+    UTEST_UNIT_RUN(memops_memset_test);
+    UTEST_UNIT_RUN(memops_memcmp_test);
+#ifdef RT_USING_CPUTIME
+    UTEST_UNIT_RUN(memops_bench);
+#endif /* RT_USING_CPUTIME */
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.memops_tc", utest_tc_init, utest_tc_cleanup, 60);
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-23     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include "utest.h"
+
+/*
+ * The zero-copy message queue passes the buffers of a memory pool. The
+ * benchmark sends TEST_FRAME_SIZE frames from one thread to another, once
+ * copied by rt_mq_send/rt_mq_recv and once passed by the buffer pointers.
+ */
+
+#define THREAD_STACK_SIZE   2048
+#define THREAD_TIMESLICE    5
+
+#define TEST_FRAME_SIZE     1536
+#define TEST_MAX_MSGS       8
+#define TEST_BENCH_MSGS     20000
+
+static rt_mq_t test_mq;
+static rt_mp_t test_mp;
+static struct rt_semaphore done_sem;
+static rt_uint8_t test_priority;
+static volatile rt_bool_t frame_corrupted;
+
+static void test_mq_zerocopy_create(void)
+{
+    test_mq = rt_mq_create("zc_mq", sizeof(void *), TEST_MAX_MSGS, RT_IPC_FLAG_PRIO);
+    uassert_not_null(test_mq);
+    test_mp = rt_mp_create("zc_mp", TEST_MAX_MSGS, TEST_FRAME_SIZE + RT_MQ_BUFFER_HEADER_SIZE);
+    uassert_not_null(test_mp);
+
+    uassert_int_equal(rt_mq_attach_mempool(test_mq, test_mp), RT_EOK);
+}
+
+static void test_mq_zerocopy_send_recv(void)
+{
+    rt_uint8_t *buf[3];
+    void *recv;
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        buf[i] = rt_mq_buffer_alloc(test_mq, 0);
+        uassert_not_null(buf[i]);
+        rt_memset(buf[i], i, TEST_FRAME_SIZE);
+    }
+    uassert_int_equal(test_mp->block_free_count, TEST_MAX_MSGS - 3);
+
+    /* the urgent buffer is received first */
+    uassert_int_equal(rt_mq_send_buffer(test_mq, buf[1]), RT_EOK);
+    uassert_int_equal(rt_mq_send_buffer_wait(test_mq, buf[2], RT_WAITING_FOREVER), RT_EOK);
+    uassert_int_equal(rt_mq_urgent_buffer(test_mq, buf[0]), RT_EOK);
+
+    for (i = 0; i < 3; i++)
+    {
+        uassert_int_equal(rt_mq_recv_buffer(test_mq, &recv, RT_WAITING_FOREVER), RT_EOK);
+        uassert_true(recv == buf[i]);
+        uassert_int_equal(((rt_uint8_t *)recv)[TEST_FRAME_SIZE - 1], i);
+        rt_mq_buffer_release(recv);
+    }
+    uassert_int_equal(test_mp->block_free_count, TEST_MAX_MSGS);
+
+    /* no message */
+    uassert_int_equal(rt_mq_recv_buffer(test_mq, &recv, 0), -RT_ETIMEOUT);
+    uassert_int_equal(rt_mq_recv_buffer(test_mq, &recv, 2), -RT_ETIMEOUT);
+}
+
+static void test_mq_zerocopy_ref(void)
+{
+    void *buf;
+
+    buf = rt_mq_buffer_alloc(test_mq, 0);
+    uassert_not_null(buf);
+
+    /* the buffer is freed by the last reference */
+    rt_mq_buffer_ref(buf);
+    rt_mq_buffer_release(buf);
+    uassert_int_equal(test_mp->block_free_count, TEST_MAX_MSGS - 1);
+    rt_mq_buffer_release(buf);
+    uassert_int_equal(test_mp->block_free_count, TEST_MAX_MSGS);
+}
+
+static void test_mq_zerocopy_reset(void)
+{
+    void *buf;
+    int i;
+
+    /* fill the message queue, all the buffers are used */
+    for (i = 0; i < TEST_MAX_MSGS; i++)
+    {
+        buf = rt_mq_buffer_alloc(test_mq, 0);
+        uassert_not_null(buf);
+        uassert_int_equal(rt_mq_send_buffer(test_mq, buf), RT_EOK);
+    }
+    uassert_null(rt_mq_buffer_alloc(test_mq, 0));
+    uassert_int_equal(test_mq->entry, TEST_MAX_MSGS);
+
+    /* the queued buffers are released by reset */
+    uassert_int_equal(rt_mq_control(test_mq, RT_IPC_CMD_RESET, RT_NULL), RT_EOK);
+    uassert_int_equal(test_mq->entry, 0);
+    uassert_int_equal(test_mp->block_free_count, TEST_MAX_MSGS);
+}
+
+static void copy_recv_entry(void *param)
+{
+    rt_mq_t mq = (rt_mq_t)param;
+    rt_uint8_t frame[TEST_FRAME_SIZE];
+    int i;
+
+    for (i = 0; i < TEST_BENCH_MSGS; i++)
+    {
+        rt_mq_recv(mq, frame, sizeof(frame), RT_WAITING_FOREVER);
+        if (frame[0] != (rt_uint8_t)i)
+        {
+            frame_corrupted = RT_TRUE;
+        }
+    }
+
+    rt_sem_release(&done_sem);
+}
+
+static void zerocopy_recv_entry(void *param)
+{
+    rt_mq_t mq = (rt_mq_t)param;
+    rt_uint8_t *frame;
+    int i;
+
+    for (i = 0; i < TEST_BENCH_MSGS; i++)
+    {
+        rt_mq_recv_buffer(mq, (void **)&frame, RT_WAITING_FOREVER);
+        if (frame[0] != (rt_uint8_t)i)
+        {
+            frame_corrupted = RT_TRUE;
+        }
+        rt_mq_buffer_release(frame);
+    }
+
+    rt_sem_release(&done_sem);
+}
+
+static void test_mq_zerocopy_bench(void)
+{
+    static rt_uint8_t frame[TEST_FRAME_SIZE];
+    rt_mq_t copy_mq;
+    rt_thread_t tid;
+    rt_tick_t copy_tick, zc_tick;
+    rt_uint8_t *buf;
+    int i;
+
+    copy_mq = rt_mq_create("copy_mq", TEST_FRAME_SIZE, TEST_MAX_MSGS, RT_IPC_FLAG_PRIO);
+    uassert_not_null(copy_mq);
+    if (copy_mq == RT_NULL)
+    {
+        return;
+    }
+    frame_corrupted = RT_FALSE;
+
+    /* copying mode */
+    tid = rt_thread_create("mq_copy", copy_recv_entry, copy_mq,
+                           THREAD_STACK_SIZE + TEST_FRAME_SIZE, test_priority, THREAD_TIMESLICE);
+    uassert_not_null(tid);
+    rt_thread_startup(tid);
+    copy_tick = rt_tick_get();
+    for (i = 0; i < TEST_BENCH_MSGS; i++)
+    {
+        frame[0] = (rt_uint8_t)i;
+        rt_mq_send_wait(copy_mq, frame, sizeof(frame), RT_WAITING_FOREVER);
+    }
+    rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+    copy_tick = rt_tick_get() - copy_tick;
+
+    /* zero-copy mode */
+    tid = rt_thread_create("mq_zc", zerocopy_recv_entry, test_mq,
+                           THREAD_STACK_SIZE, test_priority, THREAD_TIMESLICE);
+    uassert_not_null(tid);
+    rt_thread_startup(tid);
+    zc_tick = rt_tick_get();
+    for (i = 0; i < TEST_BENCH_MSGS; i++)
+    {
+        buf = rt_mq_buffer_alloc(test_mq, RT_WAITING_FOREVER);
+        buf[0] = (rt_uint8_t)i;
+        rt_mq_send_buffer_wait(test_mq, buf, RT_WAITING_FOREVER);
+    }
+    rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+    zc_tick = rt_tick_get() - zc_tick;
+
+    LOG_I("%d frames of %d bytes: copy %d ticks, zero-copy %d ticks",
+          TEST_BENCH_MSGS, TEST_FRAME_SIZE, copy_tick, zc_tick);
+
+    uassert_false(frame_corrupted);
+    uassert_int_equal(test_mp->block_free_count, TEST_MAX_MSGS);
+
+    rt_mq_delete(copy_mq);
+}
+
+static void test_mq_zerocopy_delete(void)
+{
+    void *buf;
+
+    /* the queued buffer is released with the message queue */
+    buf = rt_mq_buffer_alloc(test_mq, 0);
+    uassert_not_null(buf);
+    uassert_int_equal(rt_mq_send_buffer(test_mq, buf), RT_EOK);
+
+    uassert_int_equal(rt_mq_delete(test_mq), RT_EOK);
+    uassert_int_equal(test_mp->block_free_count, TEST_MAX_MSGS);
+    uassert_int_equal(rt_mp_delete(test_mp), RT_EOK);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    test_priority = rt_thread_self()->current_priority - 1;
+    rt_sem_init(&done_sem, "done", 0, RT_IPC_FLAG_PRIO);
+
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_sem_detach(&done_sem);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_mq_zerocopy_create);
+    UTEST_UNIT_RUN(test_mq_zerocopy_send_recv);
+    UTEST_UNIT_RUN(test_mq_zerocopy_ref);
+    UTEST_UNIT_RUN(test_mq_zerocopy_reset);
+    UTEST_UNIT_RUN(test_mq_zerocopy_bench);
+    UTEST_UNIT_RUN(test_mq_zerocopy_delete);
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.mq_zerocopy_tc", utest_tc_init, utest_tc_cleanup, 60);
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ * 2022-02-24     RT-Thread    resume the throttled threads in the budget test
+ */
+
+#include <rtthread.h>
+#include "utest.h"
+
+/*
+ * Two threads of the deadline class and one thread of fixed priority spin
+ * forever, the system is overloaded. Each thread of the deadline class shall
+ * run for its runtime in every period, no more, and the rest of cpu is left to
+ * the thread of fixed priority.
+ */
+
+#define TEST_STACK_SIZE     2048
+#define TEST_WINDOW         (20 * 10)
+
+struct test_hog
+{
+    rt_thread_t tid;
+    rt_tick_t runtime;
+    rt_tick_t period;
+    rt_uint32_t ticks;
+};
+
+static struct rt_semaphore sem_done;
+static volatile rt_bool_t hog_measure;
+static volatile rt_bool_t hog_stop;
+
+static void hog_entry(void *parameter)
+{
+    struct test_hog *hog = (struct test_hog *)parameter;
+    rt_tick_t now, last = 0;
+
+    while (!hog_stop)
+    {
+        /* count the ticks in which the thread has run */
+        now = rt_tick_get();
+        if (now != last)
+        {
+            last = now;
+            if (hog_measure)
+            {
+                hog->ticks ++;
+            }
+        }
+    }
+
+    rt_sem_release(&sem_done);
+}
+
+static void sched_edf_admission_test(void)
+{
+    rt_thread_t tid1, tid2;
+    rt_uint8_t priority;
+    rt_tick_t runtime1 = RT_SCHED_EDF_UTIL_MAX / 2;
+    rt_tick_t runtime2 = RT_SCHED_EDF_UTIL_MAX - runtime1;
+
+    tid1 = rt_thread_create("edf_a1", hog_entry, RT_NULL, TEST_STACK_SIZE,
+                            rt_thread_self()->current_priority + 1, 10);
+    tid2 = rt_thread_create("edf_a2", hog_entry, RT_NULL, TEST_STACK_SIZE,
+                            rt_thread_self()->current_priority + 1, 10);
+    if (tid1 == RT_NULL || tid2 == RT_NULL)
+    {
+        uassert_true(RT_FALSE);
+        goto __exit;
+    }
+    priority = tid1->current_priority;
+
+    /* runtime <= deadline <= period */
+    uassert_int_equal(rt_thread_set_deadline(tid1, 5, 4, 10), -RT_EINVAL);
+    uassert_int_equal(rt_thread_set_deadline(tid1, 5, 10, 8), -RT_EINVAL);
+    uassert_int_equal(rt_thread_set_deadline(tid1, 5, 10, 0), -RT_EINVAL);
+
+    /* all the bandwidth is taken by the two reservations */
+    uassert_int_equal(rt_thread_set_deadline(tid1, runtime1, 100, 100), RT_EOK);
+    uassert_int_equal(tid1->current_priority, RT_SCHED_EDF_PRIORITY);
+    uassert_int_equal(rt_thread_set_deadline(tid2, runtime2 + 1, 100, 100), -RT_EFULL);
+    uassert_int_equal(rt_thread_set_deadline(tid2, runtime2, 100, 100), RT_EOK);
+
+    /* changing a reservation counts its own bandwidth only once */
+    uassert_int_equal(rt_thread_set_deadline(tid1, runtime1, 50, 100), RT_EOK);
+    uassert_int_equal(rt_thread_set_deadline(tid1, runtime1 + 1, 100, 100), -RT_EFULL);
+
+    /* leaving the class gets back the priority and the bandwidth */
+    uassert_int_equal(rt_thread_set_deadline(tid1, 0, 0, 0), RT_EOK);
+    uassert_int_equal(tid1->current_priority, priority);
+    uassert_int_equal(rt_thread_set_deadline(tid2, runtime1 + runtime2, 100, 100), RT_EOK);
+
+__exit:
+    /* the reservation is released as the thread is deleted */
+    if (tid2 != RT_NULL)
+    {
+        rt_thread_delete(tid2);
+    }
+    if (tid1 != RT_NULL)
+    {
+        uassert_int_equal(rt_thread_set_deadline(tid1, runtime1 + runtime2, 100, 100), RT_EOK);
+        rt_thread_delete(tid1);
+    }
+}
+
+static void sched_edf_budget_test(void)
+{
+    struct test_hog hogs[2] = {{RT_NULL, 3, 10, 0}, {RT_NULL, 4, 20, 0}};
+    struct test_hog busy = {RT_NULL, 0, 0, 0};
+    rt_tick_t start, window;
+    int i;
+
+    hog_measure = RT_FALSE;
+    hog_stop = RT_FALSE;
+
+    busy.tid = rt_thread_create("edf_busy", hog_entry, &busy, TEST_STACK_SIZE,
+                                rt_thread_self()->current_priority + 1, 10);
+    uassert_not_null(busy.tid);
+    if (busy.tid == RT_NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        hogs[i].tid = rt_thread_create("edf_hog", hog_entry, &hogs[i], TEST_STACK_SIZE,
+                                       rt_thread_self()->current_priority + 1, 10);
+        uassert_not_null(hogs[i].tid);
+        if (hogs[i].tid == RT_NULL)
+        {
+            hog_stop = RT_TRUE;
+            break;
+        }
+        uassert_int_equal(rt_thread_set_deadline(hogs[i].tid, hogs[i].runtime,
+                                                 hogs[i].period, hogs[i].period), RT_EOK);
+    }
+
+    rt_thread_startup(busy.tid);
+    for (i = 0; i < 2 && hogs[i].tid != RT_NULL; i++)
+    {
+        rt_thread_startup(hogs[i].tid);
+    }
+
+    /* this thread only runs while the threads of deadline class are throttled */
+    start = rt_tick_get();
+    hog_measure = RT_TRUE;
+    while (rt_tick_get() - start < TEST_WINDOW)
+    {
+        /* a resume shall not run a throttled thread before its replenishment */
+        for (i = 0; i < 2 && hogs[i].tid != RT_NULL; i++)
+        {
+            rt_thread_resume(hogs[i].tid);
+        }
+        rt_thread_delay(1);
+    }
+    hog_measure = RT_FALSE;
+    window = rt_tick_get() - start;
+    hog_stop = RT_TRUE;
+
+    for (i = 0; i < 2 && hogs[i].tid != RT_NULL; i++)
+    {
+        LOG_I("runtime %d period %d: ran %d of %d ticks", hogs[i].runtime, hogs[i].period,
+              hogs[i].ticks, window);
+        uassert_true(hogs[i].ticks >= hogs[i].runtime * (window / hogs[i].period - 1));
+        uassert_true(hogs[i].ticks <= hogs[i].runtime * (window / hogs[i].period + 2));
+        rt_sem_take(&sem_done, RT_TICK_PER_SECOND);
+    }
+
+    /* the rest of cpu is left to the thread of fixed priority */
+    LOG_I("fixed priority: ran %d of %d ticks", busy.ticks, window);
+    uassert_true(busy.ticks > 0);
+    rt_sem_take(&sem_done, RT_TICK_PER_SECOND);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    return rt_sem_init(&sem_done, "edf_done", 0, RT_IPC_FLAG_PRIO);
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    return rt_sem_detach(&sem_done);
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(sched_edf_admission_test);
+    UTEST_UNIT_RUN(sched_edf_budget_test);
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.sched_edf_tc", utest_tc_init, utest_tc_cleanup, 10);
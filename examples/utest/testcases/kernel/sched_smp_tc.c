@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-14     RT-Thread    the first version
+ * 2022-02-24     RT-Thread    add the test of IPI coalescing
+ * 2022-02-24     RT-Thread    run the ping-pong pairs below the test thread
+ */
+
+#include <rtthread.h>
+#include <rthw.h>
+#include "utest.h"
+
+#define THREAD_STACK_SIZE  1024
+#define THREAD_TIMESLICE   5
+
+/* ticks of each throughput round, and of the busy loops in the spread test */
+#define TEST_ROUND_TICKS   (RT_TICK_PER_SECOND)
+
+struct pingpong_pair
+{
+    struct rt_semaphore ping;
+    struct rt_semaphore pong;
+    rt_thread_t tid_ping;
+    rt_thread_t tid_pong;
+    volatile rt_uint32_t rounds;
+};
+
+static struct pingpong_pair pairs[RT_CPUS_NR];
+static struct rt_semaphore done_sem;
+static volatile rt_bool_t test_running;
+static volatile int spread_cpu[RT_CPUS_NR];
+static rt_uint8_t test_priority;
+
+static void ping_entry(void *param)
+{
+    struct pingpong_pair *pair = (struct pingpong_pair *)param;
+
+    while (test_running)
+    {
+        rt_sem_release(&pair->pong);
+        rt_sem_take(&pair->ping, RT_WAITING_FOREVER);
+        pair->rounds ++;
+    }
+
+    /* let the pong thread see test_running and quit */
+    rt_sem_release(&pair->pong);
+    rt_sem_release(&done_sem);
+}
+
+static void pong_entry(void *param)
+{
+    struct pingpong_pair *pair = (struct pingpong_pair *)param;
+
+    while (test_running)
+    {
+        rt_sem_take(&pair->pong, RT_WAITING_FOREVER);
+        rt_sem_release(&pair->ping);
+    }
+
+    rt_sem_release(&done_sem);
+}
+
+/*
+ * run nr ping-pong pairs of unbound threads for one round and return the
+ * number of completed round trips
+ */
+static rt_uint32_t pingpong_run(int nr)
+{
+    int i;
+    char name[RT_NAME_MAX];
+    rt_uint32_t total = 0;
+
+    test_running = RT_TRUE;
+    for (i = 0; i < nr; i++)
+    {
+        pairs[i].rounds = 0;
+        rt_sprintf(name, "ping%d", i);
+        rt_sem_init(&pairs[i].ping, name, 0, RT_IPC_FLAG_PRIO);
+        rt_sprintf(name, "pong%d", i);
+        rt_sem_init(&pairs[i].pong, name, 0, RT_IPC_FLAG_PRIO);
+
+        /* the pairs are always runnable, the test thread shall preempt them to end the round */
+        rt_sprintf(name, "tping%d", i);
+        pairs[i].tid_ping = rt_thread_create(name, ping_entry, &pairs[i],
+                                             THREAD_STACK_SIZE, test_priority + 1, THREAD_TIMESLICE);
+        rt_sprintf(name, "tpong%d", i);
+        pairs[i].tid_pong = rt_thread_create(name, pong_entry, &pairs[i],
+                                             THREAD_STACK_SIZE, test_priority + 1, THREAD_TIMESLICE);
+        uassert_not_null(pairs[i].tid_ping);
+        uassert_not_null(pairs[i].tid_pong);
+        if (pairs[i].tid_ping == RT_NULL || pairs[i].tid_pong == RT_NULL)
+        {
+            return 0;
+        }
+    }
+
+    for (i = 0; i < nr; i++)
+    {
+        rt_thread_startup(pairs[i].tid_pong);
+        rt_thread_startup(pairs[i].tid_ping);
+    }
+
+    rt_thread_delay(TEST_ROUND_TICKS);
+    test_running = RT_FALSE;
+
+    for (i = 0; i < nr; i++)
+    {
+        total += pairs[i].rounds;
+    }
+
+    /* two threads of each pair quit */
+    for (i = 0; i < nr * 2; i++)
+    {
+        rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+    }
+
+    for (i = 0; i < nr; i++)
+    {
+        rt_sem_detach(&pairs[i].ping);
+        rt_sem_detach(&pairs[i].pong);
+    }
+
+    return total;
+}
+
+static void test_switch_scaling(void)
+{
+    rt_uint32_t single, multi;
+
+    single = pingpong_run(1);
+    multi = pingpong_run(RT_CPUS_NR);
+
+    LOG_I("ping-pong round trips in %d ticks: 1 pair %d, %d pairs %d",
+          TEST_ROUND_TICKS, single, RT_CPUS_NR, multi);
+
+    uassert_true(single > 0);
+    /* independent pairs must not serialize on one lock */
+    uassert_true(multi > single * (RT_CPUS_NR / 2));
+}
+
+static void spread_entry(void *param)
+{
+    rt_tick_t start = rt_tick_get();
+
+    /* the last cpu seen is where the balancer settled this thread */
+    while (rt_tick_get() - start < TEST_ROUND_TICKS)
+    {
+        spread_cpu[(rt_ubase_t)param] = rt_hw_cpu_id();
+    }
+
+    rt_sem_release(&done_sem);
+}
+
+static void test_spread(void)
+{
+    int i, j;
+    char name[RT_NAME_MAX];
+    rt_thread_t tid;
+
+    /* all busy threads start from the ready queue of this cpu */
+    for (i = 0; i < RT_CPUS_NR; i++)
+    {
+        rt_sprintf(name, "tbusy%d", i);
+        spread_cpu[i] = -1;
+        tid = rt_thread_create(name, spread_entry, (void *)(rt_ubase_t)i,
+                               THREAD_STACK_SIZE, test_priority - 1, THREAD_TIMESLICE);
+        uassert_not_null(tid);
+        if (tid == RT_NULL)
+        {
+            return;
+        }
+        rt_thread_startup(tid);
+    }
+
+    for (i = 0; i < RT_CPUS_NR; i++)
+    {
+        rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+    }
+
+    /* every busy thread ends up on a cpu of its own */
+    for (i = 0; i < RT_CPUS_NR; i++)
+    {
+        uassert_true(spread_cpu[i] >= 0 && spread_cpu[i] < RT_CPUS_NR);
+        for (j = i + 1; j < RT_CPUS_NR; j++)
+        {
+            uassert_int_not_equal(spread_cpu[i], spread_cpu[j]);
+        }
+    }
+}
+
+#define IPI_WAITERS         16
+
+static struct rt_semaphore ipi_sem;
+static volatile rt_bool_t ipi_spinning;
+static volatile rt_bool_t ipi_release;
+static volatile rt_uint32_t ipi_woken;
+
+static void ipi_waiter_entry(void *param)
+{
+    rt_sem_take(&ipi_sem, RT_WAITING_FOREVER);
+    ipi_woken ++;
+    rt_sem_release(&done_sem);
+}
+
+static void ipi_spinner_entry(void *param)
+{
+    rt_base_t level;
+
+    /* the schedule IPIs stay pending on this cpu while it spins */
+    level = rt_hw_local_irq_disable();
+    ipi_spinning = RT_TRUE;
+    while (!ipi_release);
+    rt_hw_local_irq_enable(level);
+
+    rt_sem_release(&done_sem);
+}
+
+static void test_ipi_coalesce(void)
+{
+    int i;
+    rt_thread_t tid;
+    rt_uint32_t sent, coalesced;
+    struct rt_cpu *pcpu = rt_cpu_index(1);
+
+    rt_thread_control(rt_thread_self(), RT_THREAD_CTRL_BIND_CPU, (void *)0);
+    rt_sem_init(&ipi_sem, "ipi", 0, RT_IPC_FLAG_PRIO);
+    ipi_spinning = RT_FALSE;
+    ipi_release = RT_FALSE;
+    ipi_woken = 0;
+
+    /* the waiters on cpu 1 preempt the spinner there */
+    for (i = 0; i < IPI_WAITERS; i++)
+    {
+        tid = rt_thread_create("tipiw", ipi_waiter_entry, RT_NULL,
+                               THREAD_STACK_SIZE, test_priority - 2, THREAD_TIMESLICE);
+        uassert_not_null(tid);
+        if (tid == RT_NULL)
+        {
+            goto __exit;
+        }
+        rt_thread_control(tid, RT_THREAD_CTRL_BIND_CPU, (void *)1);
+        rt_thread_startup(tid);
+    }
+    rt_thread_mdelay(10);
+
+    tid = rt_thread_create("tipis", ipi_spinner_entry, RT_NULL,
+                           THREAD_STACK_SIZE, test_priority - 1, THREAD_TIMESLICE);
+    uassert_not_null(tid);
+    if (tid == RT_NULL)
+    {
+        goto __exit;
+    }
+    rt_thread_control(tid, RT_THREAD_CTRL_BIND_CPU, (void *)1);
+    rt_thread_startup(tid);
+    while (!ipi_spinning);
+
+    /* a burst of wakeups to cpu 1 sends one IPI */
+    sent = pcpu->ipi_sent;
+    coalesced = pcpu->ipi_coalesced;
+    for (i = 0; i < IPI_WAITERS; i++)
+    {
+        rt_sem_release(&ipi_sem);
+    }
+    sent = pcpu->ipi_sent - sent;
+    coalesced = pcpu->ipi_coalesced - coalesced;
+    ipi_release = RT_TRUE;
+
+    for (i = 0; i < IPI_WAITERS + 1; i++)
+    {
+        rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+    }
+
+    LOG_I("%d wakeups to cpu1: %d IPI sent, %d coalesced, %d received in total",
+          IPI_WAITERS, sent, coalesced, pcpu->ipi_received);
+    uassert_int_equal(sent, 1);
+    uassert_int_equal(coalesced, IPI_WAITERS - 1);
+    uassert_int_equal(ipi_woken, IPI_WAITERS);
+
+__exit:
+    rt_sem_detach(&ipi_sem);
+    rt_thread_control(rt_thread_self(), RT_THREAD_CTRL_BIND_CPU, (void *)RT_CPUS_NR);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    test_priority = rt_thread_self()->current_priority;
+    rt_sem_init(&done_sem, "done", 0, RT_IPC_FLAG_PRIO);
+
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_sem_detach(&done_sem);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_spread);
+    UTEST_UNIT_RUN(test_switch_scaling);
+    UTEST_UNIT_RUN(test_ipi_coalesce);
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.sched_smp_tc", utest_tc_init, utest_tc_cleanup, 30);
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include "utest.h"
+
+#define TEST_PRIORITY       (rt_thread_self()->current_priority - 1)
+#define TEST_RECYCLE_MS     20
+
+static struct rt_semaphore sem_go;
+static struct rt_semaphore sem_done;
+
+static void worker_entry(void *parameter)
+{
+    rt_sem_take(&sem_go, RT_WAITING_FOREVER);
+    rt_sem_release(&sem_done);
+}
+
+static void test_thread_cache_recycle(void)
+{
+    rt_thread_t tid1, tid2;
+
+    /* the stack is rounded up to the smallest class */
+    tid1 = rt_thread_create("tc_w1", worker_entry, RT_NULL, RT_THREAD_CACHE_MIN_STACK - 64,
+                            TEST_PRIORITY, 10);
+    uassert_not_null(tid1);
+    if (tid1 == RT_NULL)
+    {
+        return;
+    }
+    uassert_true(tid1->flags & RT_THREAD_FLAG_CACHED);
+    uassert_int_equal(tid1->stack_size, RT_THREAD_CACHE_MIN_STACK);
+    uassert_true((rt_uint8_t *)tid1->stack_addr > (rt_uint8_t *)tid1);
+
+    rt_thread_startup(tid1);
+    rt_sem_release(&sem_go);
+    rt_sem_take(&sem_done, RT_WAITING_FOREVER);
+    rt_thread_mdelay(TEST_RECYCLE_MS);
+
+    /* the block of the exited thread is taken again */
+    tid2 = rt_thread_create("tc_w2", worker_entry, RT_NULL, RT_THREAD_CACHE_MIN_STACK,
+                            TEST_PRIORITY, 10);
+    uassert_true(tid2 == tid1);
+    if (tid2 == RT_NULL)
+    {
+        return;
+    }
+    uassert_str_equal(tid2->name, "tc_w2");
+    uassert_true(rt_thread_find("tc_w1") == RT_NULL);
+    uassert_true(rt_thread_find("tc_w2") == tid2);
+
+    /* a thread not started is put back too */
+    rt_thread_delete(tid2);
+    rt_thread_mdelay(TEST_RECYCLE_MS);
+    uassert_true(rt_thread_find("tc_w2") == RT_NULL);
+}
+
+static void test_thread_cache_large(void)
+{
+    rt_uint32_t stack_size = (RT_THREAD_CACHE_MIN_STACK << (RT_THREAD_CACHE_CLASSES - 1)) + 64;
+    rt_thread_t tid;
+
+    /* the stack larger than the largest class is taken from the heap */
+    tid = rt_thread_create("tc_large", worker_entry, RT_NULL, stack_size, TEST_PRIORITY, 10);
+    uassert_not_null(tid);
+    if (tid == RT_NULL)
+    {
+        return;
+    }
+    uassert_false(tid->flags & RT_THREAD_FLAG_CACHED);
+    uassert_int_equal(tid->stack_size, stack_size);
+    rt_thread_delete(tid);
+    rt_thread_mdelay(TEST_RECYCLE_MS);
+
+    uassert_int_equal(rt_thread_cache_prewarm(stack_size, 1), -RT_EINVAL);
+}
+
+static void test_thread_cache_prewarm(void)
+{
+    rt_thread_t tids[RT_THREAD_CACHE_DEPTH];
+    rt_size_t total, used_before, used_after, max_used;
+    int i, created = 0;
+
+    uassert_int_equal(rt_thread_cache_prewarm(RT_THREAD_CACHE_MIN_STACK, RT_THREAD_CACHE_DEPTH), RT_EOK);
+
+    /* the threads of a prewarmed class take no memory from the heap */
+    rt_memory_info(&total, &used_before, &max_used);
+    for (i = 0; i < RT_THREAD_CACHE_DEPTH; i++)
+    {
+        tids[i] = rt_thread_create("tc_burst", worker_entry, RT_NULL, RT_THREAD_CACHE_MIN_STACK,
+                                   TEST_PRIORITY, 10);
+        if (tids[i] == RT_NULL)
+        {
+            break;
+        }
+        created ++;
+    }
+    rt_memory_info(&total, &used_after, &max_used);
+    uassert_int_equal(created, RT_THREAD_CACHE_DEPTH);
+    uassert_int_equal(used_after, used_before);
+
+    for (i = 0; i < created; i++)
+    {
+        rt_thread_startup(tids[i]);
+    }
+    for (i = 0; i < created; i++)
+    {
+        rt_sem_release(&sem_go);
+        rt_sem_take(&sem_done, RT_WAITING_FOREVER);
+    }
+    rt_thread_mdelay(TEST_RECYCLE_MS);
+
+    /* all of them are back to the class, nothing is freed to the heap */
+    rt_memory_info(&total, &used_after, &max_used);
+    uassert_int_equal(used_after, used_before);
+}
+
+static rt_err_t utest_tc_init(void)
+{
+    rt_sem_init(&sem_go, "tc_go", 0, RT_IPC_FLAG_PRIO);
+    rt_sem_init(&sem_done, "tc_done", 0, RT_IPC_FLAG_PRIO);
+
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    rt_sem_detach(&sem_go);
+    rt_sem_detach(&sem_done);
+
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_thread_cache_recycle);
+    UTEST_UNIT_RUN(test_thread_cache_large);
+    UTEST_UNIT_RUN(test_thread_cache_prewarm);
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.thread_cache_tc", utest_tc_init, utest_tc_cleanup, 10);
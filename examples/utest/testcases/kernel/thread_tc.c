@@ -7,6 +7,7 @@
  * Date           Author       Notes
  * 2021-09.01     yangjie      the firet version
  * 2021-10.11     mazhiyuan    add idle, yield, suspend, control, priority, delay_until
+ * 2022-02-24     RT-Thread    add stack watermark
  */
 
 #include <rtthread.h>
@@ -593,6 +594,88 @@ __exit:
 }
 #endif
 
+#ifdef RT_USING_STACK_WATERMARK
+#define WATERMARK_STACK_SIZE    2048
+#define WATERMARK_USED          1024
+
+ALIGN(RT_ALIGN_SIZE)
+static char thread10_stack[WATERMARK_STACK_SIZE];
+static struct rt_thread thread10;
+static volatile rt_bool_t thread10_used;
+static volatile rt_bool_t thread10_exit;
+static volatile rt_uint32_t thread10_sum;
+
+static void thread10_entry(void *parameter)
+{
+    volatile char buffer[WATERMARK_USED];
+    rt_uint32_t sum = 0;
+    int i;
+
+    for (i = 0; i < WATERMARK_USED; i++)
+    {
+        buffer[i] = (char)i;
+    }
+    /* read the buffer back, so it's not optimized out of the stack */
+    for (i = 0; i < WATERMARK_USED; i++)
+    {
+        sum += (rt_uint8_t)buffer[i];
+    }
+    thread10_sum = sum;
+    thread10_used = RT_TRUE;
+
+    while (!thread10_exit)
+    {
+        rt_thread_mdelay(1);
+    }
+}
+
+static void test_stack_watermark(void)
+{
+    rt_uint32_t mark, sum = 0;
+    rt_err_t ret_startup = -RT_ERROR;
+    int i;
+
+    thread10_used = RT_FALSE;
+    thread10_exit = RT_FALSE;
+    thread10_sum = 0;
+    rt_thread_init(&thread10, "thread10", thread10_entry, RT_NULL, thread10_stack,
+                   sizeof(thread10_stack), __current_thread->current_priority - 1, THREAD_TIMESLICE);
+
+    /* only the initial frame before the thread runs */
+    mark = rt_thread_stack_watermark(&thread10, 0);
+    uassert_true(mark < WATERMARK_USED);
+
+    ret_startup = rt_thread_startup(&thread10);
+    if (ret_startup != RT_EOK)
+    {
+        uassert_false(ret_startup != RT_EOK);
+        return;
+    }
+    while (!thread10_used)
+    {
+        rt_thread_mdelay(1);
+    }
+    for (i = 0; i < WATERMARK_USED; i++)
+    {
+        sum += (rt_uint8_t)i;
+    }
+    uassert_int_equal(thread10_sum, sum);
+
+    /* the buffer is found beyond the stack pointer of the last switch */
+    mark = rt_thread_stack_watermark(&thread10, 0);
+    uassert_true(mark >= WATERMARK_USED);
+    uassert_true(mark <= WATERMARK_STACK_SIZE);
+
+    /* the mark never goes back */
+    rt_thread_mdelay(10);
+    uassert_true(rt_thread_stack_watermark(&thread10, 1) >= mark);
+    uassert_true(thread10.stack_max_used >= mark);
+
+    thread10_exit = RT_TRUE;
+    rt_thread_mdelay(10);
+}
+#endif /* RT_USING_STACK_WATERMARK */
+
 static rt_err_t utest_tc_init(void)
 {
     __current_thread = rt_thread_self();
@@ -634,6 +717,10 @@ static void testcase(void)
     UTEST_UNIT_RUN(test_thread_priority);
     /* delay_until */
     UTEST_UNIT_RUN(test_delay_until);
+#ifdef RT_USING_STACK_WATERMARK
+    /* stack_watermark */
+    UTEST_UNIT_RUN(test_stack_watermark);
+#endif /* RT_USING_STACK_WATERMARK */
 }
 
 
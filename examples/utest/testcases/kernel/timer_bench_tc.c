@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-18     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include "utest.h"
+
+/*
+ * This benchmark measures the start/stop cost of one timer while the timer
+ * list already holds 10, 1k and 10k active timers. Build it once with the
+ * skip list and once with RT_USING_TIMER_WHEEL to compare the backends.
+ */
+
+/* ticks of each measurement round */
+#define TEST_ROUND_TICKS   (RT_TICK_PER_SECOND)
+/* the active timers never expire during the benchmark */
+#define TEST_TIMEOUT_BASE  (RT_TICK_PER_SECOND * 60)
+#define TEST_TIMEOUT_SPAN  (RT_TICK_PER_SECOND * 600)
+
+static const rt_uint32_t timer_nr[] = {10, 1000, 10000};
+
+static volatile rt_bool_t timer_fired;
+
+static void timeout_entry(void *param)
+{
+    timer_fired = RT_TRUE;
+}
+
+/* spread the timeout ticks over all levels of the timer list */
+static rt_tick_t bench_timeout(rt_uint32_t i)
+{
+    return TEST_TIMEOUT_BASE + (i * 7919) % TEST_TIMEOUT_SPAN;
+}
+
+static void timer_bench(rt_uint32_t nr, rt_uint8_t flag)
+{
+    struct rt_timer *timers;
+    struct rt_timer probe;
+    rt_tick_t tick, timeout;
+    rt_uint32_t i, ops;
+
+    timers = (struct rt_timer *)rt_malloc(sizeof(struct rt_timer) * nr);
+    if (timers == RT_NULL)
+    {
+        LOG_W("no memory for %d timers, skipped", nr);
+        return;
+    }
+
+    timer_fired = RT_FALSE;
+    for (i = 0; i < nr; i++)
+    {
+        timeout = bench_timeout(i);
+        rt_timer_init(&timers[i], "bench", timeout_entry, RT_NULL, timeout, flag);
+    }
+    rt_timer_init(&probe, "probe", timeout_entry, RT_NULL, TEST_TIMEOUT_BASE, flag);
+
+    /* fill the timer list */
+    tick = rt_tick_get();
+    for (i = 0; i < nr; i++)
+    {
+        uassert_int_equal(rt_timer_start(&timers[i]), RT_EOK);
+    }
+    tick = rt_tick_get() - tick;
+
+    /* start and stop the probe timer among the active timers */
+    ops = 0;
+    rt_thread_delay(1);
+    tick = rt_tick_get();
+    while (rt_tick_get() - tick < TEST_ROUND_TICKS)
+    {
+        timeout = bench_timeout(ops);
+        rt_timer_control(&probe, RT_TIMER_CTRL_SET_TIME, &timeout);
+        rt_timer_start(&probe);
+        rt_timer_stop(&probe);
+        ops ++;
+    }
+
+    LOG_I("%s timer, %5d active: start/stop %d ops/s",
+          (flag & RT_TIMER_FLAG_SOFT_TIMER) ? "soft" : "hard", nr,
+          ops * RT_TICK_PER_SECOND / TEST_ROUND_TICKS);
+
+    uassert_true(ops > 0);
+    uassert_false(timer_fired);
+
+    rt_timer_detach(&probe);
+    for (i = 0; i < nr; i++)
+    {
+        rt_timer_detach(&timers[i]);
+    }
+    rt_free(timers);
+}
+
+static void test_hard_timer_bench(void)
+{
+    int i;
+
+    for (i = 0; i < sizeof(timer_nr) / sizeof(timer_nr[0]); i++)
+    {
+        timer_bench(timer_nr[i], RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_HARD_TIMER);
+    }
+}
+
+#ifdef RT_USING_TIMER_SOFT
+static void test_soft_timer_bench(void)
+{
+    int i;
+
+    for (i = 0; i < sizeof(timer_nr) / sizeof(timer_nr[0]); i++)
+    {
+        timer_bench(timer_nr[i], RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_SOFT_TIMER);
+    }
+}
+#endif /* RT_USING_TIMER_SOFT */
+
+static rt_err_t utest_tc_init(void)
+{
+#ifdef RT_USING_TIMER_WHEEL
+    LOG_I("timer backend: timing wheel");
+#else
+    LOG_I("timer backend: skip list");
+#endif /* RT_USING_TIMER_WHEEL */
+
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(test_hard_timer_bench);
+#ifdef RT_USING_TIMER_SOFT
+    UTEST_UNIT_RUN(test_soft_timer_bench);
+#endif /* RT_USING_TIMER_SOFT */
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.timer_bench_tc", utest_tc_init, utest_tc_cleanup, 60);
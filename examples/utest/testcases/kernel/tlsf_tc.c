@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-22     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+#include <rthw.h>
+#include <stdlib.h>
+#include "utest.h"
+#ifdef RT_USING_CPUTIME
+#include <rtdevice.h>
+#endif /* RT_USING_CPUTIME */
+
+#define TEST_TLSF_SIZE      (256 * 1024)
+/* blocks held by the tests */
+#define TEST_SLOTS          256
+#define TEST_SIZE_MAX       512
+#define TEST_ALLOC_TIME     5
+#define TEST_LATENCY_ROUNDS 10000
+
+static rt_uint8_t *slot[TEST_SLOTS];
+static rt_size_t slot_size[TEST_SLOTS];
+
+static rt_bool_t _slot_check(int i)
+{
+    rt_size_t k;
+
+    for (k = 0; k < slot_size[i]; k++)
+    {
+        if (slot[i][k] != (rt_uint8_t)i)
+        {
+            return RT_FALSE;
+        }
+    }
+
+    return RT_TRUE;
+}
+
+static void tlsf_alloc_test(void)
+{
+    rt_uint8_t *buf, *ptr;
+    rt_tlsf_t heap;
+    rt_tick_t end;
+    rt_size_t size;
+    int i;
+
+    buf = rt_malloc(TEST_TLSF_SIZE);
+    uassert_not_null(buf);
+    if (buf == RT_NULL)
+    {
+        return;
+    }
+    heap = rt_tlsf_init("tlsf_tc", buf, TEST_TLSF_SIZE);
+    uassert_not_null(heap);
+    rt_memset(slot, 0, sizeof(slot));
+
+    end = rt_tick_get() + rt_tick_from_millisecond(TEST_ALLOC_TIME * 1000);
+    while (rt_tick_get() - end >= RT_TICK_MAX / 2)
+    {
+        i = rand() % TEST_SLOTS;
+        size = rand() % TEST_SIZE_MAX + 1;
+        if (slot[i] == RT_NULL)
+        {
+            ptr = rt_tlsf_alloc(heap, size);
+            if (ptr == RT_NULL)
+            {
+                continue;
+            }
+            uassert_int_equal(RT_ALIGN((rt_ubase_t)ptr, RT_ALIGN_SIZE), (rt_ubase_t)ptr);
+        }
+        else
+        {
+            uassert_true(_slot_check(i));
+            if (rand() % 4 != 0)
+            {
+                rt_tlsf_free(heap, slot[i]);
+                slot[i] = RT_NULL;
+                continue;
+            }
+
+            /* the content shall be kept by realloc */
+            ptr = rt_tlsf_realloc(heap, slot[i], size);
+            if (ptr == RT_NULL)
+            {
+                continue;
+            }
+            slot_size[i] = slot_size[i] < size ? slot_size[i] : size;
+            slot[i] = ptr;
+            uassert_true(_slot_check(i));
+        }
+
+        slot[i] = ptr;
+        slot_size[i] = size;
+        rt_memset(ptr, i, size);
+    }
+
+    for (i = 0; i < TEST_SLOTS; i++)
+    {
+        if (slot[i] != RT_NULL)
+        {
+            uassert_true(_slot_check(i));
+            rt_tlsf_free(heap, slot[i]);
+            slot[i] = RT_NULL;
+        }
+    }
+    uassert_int_equal(heap->used, 0);
+
+    /* the free blocks are merged back to one block */
+    ptr = rt_tlsf_alloc(heap, TEST_TLSF_SIZE / 2);
+    uassert_not_null(ptr);
+    rt_tlsf_free(heap, ptr);
+
+    rt_tlsf_detach(heap);
+    rt_free(buf);
+}
+
+#ifdef RT_USING_CPUTIME
+struct latency_ops
+{
+    const char *name;
+    rt_mem_t (*init)(const char *name, void *begin_addr, rt_size_t size);
+    rt_err_t (*detach)(rt_mem_t m);
+    void *(*alloc)(rt_mem_t m, rt_size_t size);
+    void (*free)(rt_mem_t m, void *ptr);
+};
+
+static void _tlsf_free(rt_mem_t m, void *ptr)
+{
+    rt_tlsf_free(m, ptr);
+}
+
+#ifdef RT_USING_SMALL_MEM
+static void _smem_free(rt_mem_t m, void *ptr)
+{
+    rt_smem_free(ptr);
+}
+#endif /* RT_USING_SMALL_MEM */
+
+static const struct latency_ops latency_ops[] =
+{
+    {"tlsf", rt_tlsf_init, rt_tlsf_detach, rt_tlsf_alloc, _tlsf_free},
+#ifdef RT_USING_SMALL_MEM
+    {"small", rt_smem_init, rt_smem_detach, rt_smem_alloc, _smem_free},
+#endif /* RT_USING_SMALL_MEM */
+};
+
+/*
+ * Measure the worst case of alloc and free on a fragmented pool, the pool is
+ * filled with blocks of random sizes and every other block is released first.
+ */
+static void mem_latency(const struct latency_ops *ops, rt_uint8_t *buf)
+{
+    rt_mem_t heap;
+    rt_base_t level;
+    rt_uint64_t start, cost;
+    rt_uint64_t alloc_max = 0, free_max = 0, alloc_sum = 0, free_sum = 0;
+    rt_uint32_t rounds = 0;
+    rt_size_t size;
+    void *ptr;
+    int i;
+
+    heap = ops->init(ops->name, buf, TEST_TLSF_SIZE);
+    uassert_not_null(heap);
+
+    srand(0);
+    for (i = 0; i < TEST_SLOTS; i++)
+    {
+        slot[i] = ops->alloc(heap, rand() % TEST_SIZE_MAX + 1);
+    }
+    for (i = 0; i < TEST_SLOTS; i += 2)
+    {
+        ops->free(heap, slot[i]);
+        slot[i] = RT_NULL;
+    }
+
+    while (rounds < TEST_LATENCY_ROUNDS)
+    {
+        i = (rand() % (TEST_SLOTS / 2)) * 2;
+        size = rand() % TEST_SIZE_MAX + 1;
+
+        level = rt_hw_interrupt_disable();
+        start = clock_cpu_gettime();
+        ptr = ops->alloc(heap, size);
+        cost = clock_cpu_gettime() - start;
+        rt_hw_interrupt_enable(level);
+        if (ptr == RT_NULL)
+        {
+            continue;
+        }
+        alloc_sum += cost;
+        alloc_max = cost > alloc_max ? cost : alloc_max;
+
+        /* keep the pool fragmented, release a block of the other half */
+        ops->free(heap, slot[i]);
+        slot[i] = ptr;
+
+        level = rt_hw_interrupt_disable();
+        start = clock_cpu_gettime();
+        ops->free(heap, slot[i + 1]);
+        cost = clock_cpu_gettime() - start;
+        rt_hw_interrupt_enable(level);
+        free_sum += cost;
+        free_max = cost > free_max ? cost : free_max;
+
+        slot[i + 1] = ops->alloc(heap, rand() % TEST_SIZE_MAX + 1);
+        rounds ++;
+    }
+
+    LOG_I("%-5s alloc avg %6d ns max %6d ns, free avg %6d ns max %6d ns", ops->name,
+          (rt_uint32_t)(alloc_sum * clock_cpu_getres() / rounds), (rt_uint32_t)(alloc_max * clock_cpu_getres()),
+          (rt_uint32_t)(free_sum * clock_cpu_getres() / rounds), (rt_uint32_t)(free_max * clock_cpu_getres()));
+
+    for (i = 0; i < TEST_SLOTS; i++)
+    {
+        ops->free(heap, slot[i]);
+        slot[i] = RT_NULL;
+    }
+    ops->detach(heap);
+}
+
+static void mem_latency_test(void)
+{
+    rt_uint8_t *buf;
+    int i;
+
+    if (clock_cpu_getres() <= 0)
+    {
+        LOG_W("no cputime clock, skipped");
+        return;
+    }
+
+    buf = rt_malloc(TEST_TLSF_SIZE);
+    uassert_not_null(buf);
+    if (buf == RT_NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < sizeof(latency_ops) / sizeof(latency_ops[0]); i++)
+    {
+        mem_latency(&latency_ops[i], buf);
+    }
+
+    rt_free(buf);
+}
+#endif /* RT_USING_CPUTIME */
+
+static rt_err_t utest_tc_init(void)
+{
+    return RT_EOK;
+}
+
+static rt_err_t utest_tc_cleanup(void)
+{
+    return RT_EOK;
+}
+
+static void testcase(void)
+{
+    UTEST_UNIT_RUN(tlsf_alloc_test);
+#ifdef RT_USING_CPUTIME
+    UTEST_UNIT_RUN(mem_latency_test);
+#endif /* RT_USING_CPUTIME */
+}
+UTEST_TC_EXPORT(testcase, "testcases.kernel.tlsf_tc", utest_tc_init, utest_tc_cleanup, 20);
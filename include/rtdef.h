@@ -41,6 +41,18 @@
  * 2022-01-01     Gabriel      improve hooking method
  * 2022-01-07     Gabriel      move some __on_rt_xxxxx_hook to dedicated c source files
  * 2022-01-12     Meco Man     remove RT_THREAD_BLOCK
+ * 2022-02-19     RT-Thread    add high resolution timer
+ * 2022-02-20     RT-Thread    add rt_atomic_t and the waiters of mutex
+ * 2022-02-22     RT-Thread    add rt_tlsf_t
+ * 2022-02-23     RT-Thread    add the name hash index of objects
+ * 2022-02-23     RT-Thread    add the memory pool of zero-copy message queue
+ * 2022-02-24     RT-Thread    add the cpu usage of threads
+ * 2022-02-24     RT-Thread    add the trace events of kernel
+ * 2022-02-24     RT-Thread    add the earliest deadline first class of threads
+ * 2022-02-24     RT-Thread    index the threads waiting on event by the bits
+ * 2022-02-24     RT-Thread    add the high-water mark of thread stack
+ * 2022-02-24     RT-Thread    coalesce the schedule IPIs and count them
+ * 2022-02-24     RT-Thread    add the flag of threads from the thread cache
  */
 
 #ifndef __RT_DEF_H__
@@ -98,6 +110,7 @@ typedef rt_uint32_t                     rt_tick_t;      /**< Type for tick count
 typedef rt_base_t                       rt_flag_t;      /**< Type for flags */
 typedef rt_ubase_t                      rt_dev_t;       /**< Type for device */
 typedef rt_base_t                       rt_off_t;       /**< Type for offset */
+typedef rt_base_t                       rt_atomic_t;    /**< Type for atomic variable */
 
 /* boolean type definitions */
 #define RT_TRUE                         1               /**< boolean true  */
@@ -388,6 +401,9 @@ struct rt_object
     void      *module_id;                               /**< id of application module */
 #endif
     rt_list_t  list;                                    /**< list node of kernel object */
+#ifdef RT_USING_OBJECT_HASH
+    rt_slist_t hash;                                    /**< node of the name hash index */
+#endif /* RT_USING_OBJECT_HASH */
 };
 typedef struct rt_object *rt_object_t;                  /**< Type for kernel objects. */
 
@@ -435,6 +451,9 @@ struct rt_object_information
     enum rt_object_class_type type;                     /**< object class type */
     rt_list_t                 object_list;              /**< object list */
     rt_size_t                 object_size;              /**< object size */
+#ifdef RT_USING_OBJECT_HASH
+    rt_slist_t                hash_list[RT_OBJECT_HASH_SIZE]; /**< object name hash index */
+#endif /* RT_USING_OBJECT_HASH */
 };
 
 /**
@@ -462,6 +481,26 @@ struct rt_object_information
     #define __on_rt_free_hook(rmem)                 __ON_HOOK_ARGS(rt_free_hook, (rmem))
 #endif
 
+/*
+ * trace events, the arguments are recorded as 32 bits
+ */
+#define RT_TRACE_SWITCH                 0x01            /**< arg0: thread switched out, arg1: thread switched in */
+#define RT_TRACE_IRQ_ENTER              0x02            /**< arg0: interrupt nest */
+#define RT_TRACE_IRQ_LEAVE              0x03            /**< arg0: interrupt nest */
+#define RT_TRACE_WAKEUP                 0x04            /**< arg0: thread made ready */
+#define RT_TRACE_IPC_TAKE               0x05            /**< arg0: ipc object, arg1: object class */
+#define RT_TRACE_IPC_TAKEN              0x06            /**< arg0: ipc object, arg1: object class */
+#define RT_TRACE_IPC_RELEASE            0x07            /**< arg0: ipc object, arg1: object class */
+#define RT_TRACE_TIMER_ENTER            0x08            /**< arg0: timer */
+#define RT_TRACE_TIMER_EXIT             0x09            /**< arg0: timer */
+#define RT_TRACE_USER                   0x80            /**< the first event of user */
+
+#ifdef RT_USING_TRACE
+    #define RT_TRACE_EVENT(event, arg0, arg1)       rt_trace_event((event), (rt_ubase_t)(arg0), (rt_ubase_t)(arg1))
+#else
+    #define RT_TRACE_EVENT(event, arg0, arg1)
+#endif /* RT_USING_TRACE */
+
 
 /**@}*/
 
@@ -515,6 +554,24 @@ struct rt_timer
 };
 typedef struct rt_timer *rt_timer_t;
 
+#ifdef RT_USING_HRTIMER
+/**
+ * high resolution timer structure
+ */
+struct rt_hrtimer
+{
+    rt_list_t        list;                              /**< the node of hrtimer list */
+    rt_uint8_t       flag;                              /**< RT_TIMER_FLAG_xxx */
+
+    void (*timeout_func)(void *parameter);              /**< timeout function */
+    void            *parameter;                         /**< timeout function's parameter */
+
+    rt_uint64_t      period;                            /**< timeout interval, in clock counts */
+    rt_uint64_t      timeout;                           /**< timeout clock count */
+};
+typedef struct rt_hrtimer *rt_hrtimer_t;
+#endif /* RT_USING_HRTIMER */
+
 /**@}*/
 
 /**
@@ -559,6 +616,11 @@ typedef siginfo_t rt_siginfo_t;
 #define RT_THREAD_STAT_SIGNAL_PENDING   0x40                /**< signals is held and it has not been procressed */
 #define RT_THREAD_STAT_SIGNAL_MASK      0xf0
 
+/**
+ * thread flag definitions
+ */
+#define RT_THREAD_FLAG_CACHED           0x01                /**< The thread is taken from the thread cache. */
+
 /**
  * thread control command definitions
  */
@@ -568,6 +630,12 @@ typedef siginfo_t rt_siginfo_t;
 #define RT_THREAD_CTRL_INFO             0x03                /**< Get thread information. */
 #define RT_THREAD_CTRL_BIND_CPU         0x04                /**< Set thread bind cpu. */
 
+/**
+ * thread deadline class state definitions
+ */
+#define RT_THREAD_EDF_ACTIVE            0x01                /**< The thread has a reservation. */
+#define RT_THREAD_EDF_THROTTLED         0x02                /**< The runtime of current period is used up. */
+
 #ifdef RT_USING_SMP
 
 #define RT_CPU_DETACHED                 RT_CPUS_NR          /**< The thread not running on cpu. */
@@ -591,6 +659,7 @@ struct rt_cpu
 
     rt_uint16_t irq_nest;
     rt_uint8_t  irq_switch_flag;
+    rt_uint8_t  ipi_pending;                            /**< a schedule IPI is sent and not handled yet */
 
     rt_uint8_t current_priority;
     rt_list_t priority_table[RT_THREAD_PRIORITY_MAX];
@@ -602,10 +671,52 @@ struct rt_cpu
 #endif
 
     rt_tick_t tick;
+#ifdef RT_USING_CPU_USAGE
+    rt_uint64_t irq_stamp;                              /**< the time entering interrupt */
+#endif /* RT_USING_CPU_USAGE */
+
+    rt_uint32_t ipi_sent;                               /**< schedule IPIs sent to the cpu */
+    rt_uint32_t ipi_coalesced;                          /**< wakeups covered by a pending IPI */
+    rt_uint32_t ipi_received;                           /**< schedule IPIs handled by the cpu */
 };
 
 #endif
 
+#ifdef RT_USING_CPU_USAGE
+/**
+ * CPU usage of thread, the time is in the counts of cputime clock with
+ * RT_USING_CPUTIME, otherwise in ticks.
+ */
+struct rt_thread_usage
+{
+    rt_uint64_t run_time;                               /**< running time, without interrupts */
+    rt_uint64_t irq_time;                               /**< time of the interrupts when running */
+    rt_uint64_t wait_time;                              /**< time waiting in the ready queue */
+    rt_uint64_t stamp;                                  /**< the time of last running or ready */
+    rt_uint32_t voluntary_switches;                     /**< switches out by blocking */
+    rt_uint32_t involuntary_switches;                   /**< switches out by preemption or yield */
+};
+#endif /* RT_USING_CPU_USAGE */
+
+#ifdef RT_USING_SCHED_EDF
+/**
+ * The reservation of a thread in the earliest deadline first class, in ticks
+ */
+struct rt_thread_edf
+{
+    rt_tick_t   runtime;                                /**< runtime of each period */
+    rt_tick_t   deadline;                               /**< relative deadline */
+    rt_tick_t   period;                                 /**< period */
+
+    rt_tick_t   abs_deadline;                           /**< absolute deadline of current period */
+    rt_tick_t   budget;                                 /**< runtime left in current period */
+    rt_uint8_t  stat;                                   /**< RT_THREAD_EDF_xxx */
+    rt_uint8_t  priority;                               /**< priority before joining the class */
+
+    struct rt_timer timer;                              /**< timer of replenishment */
+};
+#endif /* RT_USING_SCHED_EDF */
+
 /**
  * Thread structure
  */
@@ -638,6 +749,7 @@ struct rt_thread
 #ifdef RT_USING_SMP
     rt_uint8_t  bind_cpu;                               /**< thread is bind to cpu */
     rt_uint8_t  oncpu;                                  /**< process on cpu */
+    rt_uint8_t  ready_cpu;                              /**< cpu of the ready queue holding thread */
 
     rt_uint16_t scheduler_lock_nest;                    /**< scheduler lock count */
     rt_uint16_t cpus_lock_nest;                         /**< cpus lock count */
@@ -669,14 +781,25 @@ struct rt_thread
     void            *si_list;                           /**< the signal infor list */
 #endif
 
+#ifdef RT_USING_STACK_WATERMARK
+    rt_uint32_t stack_max_used;                         /**< high-water mark of stack in bytes */
+#endif /* RT_USING_STACK_WATERMARK */
+
     rt_ubase_t  init_tick;                              /**< thread's initialized tick */
     rt_ubase_t  remaining_tick;                         /**< remaining tick */
 
 #ifdef RT_USING_CPU_USAGE
-    rt_uint64_t  duration_tick;                          /**< cpu usage tick */
-#endif
+    struct rt_thread_usage usage;                       /**< cpu usage */
+#endif /* RT_USING_CPU_USAGE */
+
+#ifdef RT_USING_SCHED_EDF
+    struct rt_thread_edf edf;                           /**< reservation of deadline class */
+#endif /* RT_USING_SCHED_EDF */
 
     struct rt_timer thread_timer;                       /**< built-in thread timer */
+#ifdef RT_USING_HRTIMER
+    struct rt_hrtimer thread_hrtimer;                   /**< built-in thread timer for sub-tick timeout */
+#endif /* RT_USING_HRTIMER */
 
     void (*cleanup)(struct rt_thread *tid);             /**< cleanup function when thread exit */
 
@@ -747,6 +870,9 @@ struct rt_mutex
     rt_uint8_t           hold;                          /**< numbers of thread hold the mutex */
 
     struct rt_thread    *owner;                         /**< current owner of mutex */
+#ifdef RT_USING_HW_ATOMIC
+    rt_atomic_t          waiters;                       /**< the owner shall release in slow path */
+#endif /* RT_USING_HW_ATOMIC */
 };
 typedef struct rt_mutex *rt_mutex_t;
 #endif
@@ -767,6 +893,9 @@ struct rt_event
     struct rt_ipc_object parent;                        /**< inherit from ipc_object */
 
     rt_uint32_t          set;                           /**< event set */
+#ifdef RT_USING_EVENT_INDEX
+    rt_uint32_t          wait_set;                      /**< union of the sets waited by the suspended threads */
+#endif /* RT_USING_EVENT_INDEX */
 };
 typedef struct rt_event *rt_event_t;
 #endif
@@ -812,8 +941,17 @@ struct rt_messagequeue
     void                *msg_queue_free;                /**< pointer indicated the free node of queue */
 
     rt_list_t            suspend_sender_thread;         /**< sender thread suspended on this message queue */
+
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+    struct rt_mempool   *buffer_pool;                   /**< memory pool of the zero-copy buffers */
+#endif /* RT_USING_MESSAGEQUEUE_ZEROCOPY */
 };
 typedef struct rt_messagequeue *rt_mq_t;
+
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+/* the size reserved ahead of each zero-copy buffer in the memory pool block */
+#define RT_MQ_BUFFER_HEADER_SIZE        RT_ALIGN(sizeof(rt_atomic_t), RT_ALIGN_SIZE)
+#endif /* RT_USING_MESSAGEQUEUE_ZEROCOPY */
 #endif
 
 /**@}*/
@@ -853,6 +991,10 @@ typedef rt_mem_t rt_smem_t;
 typedef rt_mem_t rt_slab_t;
 #endif
 
+#ifdef RT_USING_TLSF
+typedef rt_mem_t rt_tlsf_t;
+#endif
+
 #ifdef RT_USING_MEMHEAP
 /**
  * memory item on the heap
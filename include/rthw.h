@@ -12,6 +12,10 @@
  * 2017-10-17     Hichard      add some macros
  * 2018-11-17     Jesven       add rt_hw_spinlock_t
  *                             add smp support
+ * 2022-02-20     RT-Thread    add atomic interfaces
+ * 2022-02-24     RT-Thread    add stack guard interface
+ * 2022-02-24     RT-Thread    rename the parameter new of compare-and-exchange to desired
+ * 2022-02-24     RT-Thread    add rt_hw_cpu_relax() for the busy-wait loops on SMP
  */
 
 #ifndef __RT_HW_H__
@@ -137,6 +141,40 @@ void rt_hw_exception_install(rt_err_t (*exception_handle)(void *context));
  */
 void rt_hw_us_delay(rt_uint32_t us);
 
+#ifdef RT_USING_HW_STACK_GUARD
+/*
+ * stack guard interface, it moves the guard to the stack of the thread to be
+ * switched in, called with interrupts disabled before the switch
+ */
+void rt_hw_stack_guard_switch(struct rt_thread *thread);
+#endif /* RT_USING_HW_STACK_GUARD */
+
+#ifdef RT_USING_TICKLESS
+/*
+ * tickless interfaces
+ */
+rt_tick_t rt_hw_tickless_idle(rt_tick_t timeout);
+#endif /* RT_USING_TICKLESS */
+
+#ifdef RT_USING_HW_ATOMIC
+/*
+ * atomic interfaces, the operations are sequentially consistent and return
+ * the old value of the atomic variable. A port shall order each operation
+ * with the memory accesses before and after it by full barriers (e.g. dmb
+ * on ARM, .aqrl on RISC-V), the lock-free fast path of mutex relies on it.
+ */
+rt_atomic_t rt_hw_atomic_load(volatile rt_atomic_t *ptr);
+void rt_hw_atomic_store(volatile rt_atomic_t *ptr, rt_atomic_t val);
+rt_atomic_t rt_hw_atomic_exchange(volatile rt_atomic_t *ptr, rt_atomic_t val);
+rt_atomic_t rt_hw_atomic_add(volatile rt_atomic_t *ptr, rt_atomic_t val);
+rt_atomic_t rt_hw_atomic_sub(volatile rt_atomic_t *ptr, rt_atomic_t val);
+rt_atomic_t rt_hw_atomic_and(volatile rt_atomic_t *ptr, rt_atomic_t val);
+rt_atomic_t rt_hw_atomic_or(volatile rt_atomic_t *ptr, rt_atomic_t val);
+rt_atomic_t rt_hw_atomic_xor(volatile rt_atomic_t *ptr, rt_atomic_t val);
+/* return RT_TRUE if *ptr is set to desired, otherwise the current value is stored to *old */
+rt_atomic_t rt_hw_atomic_compare_exchange_strong(volatile rt_atomic_t *ptr, rt_atomic_t *old, rt_atomic_t desired);
+#endif /* RT_USING_HW_ATOMIC */
+
 #ifdef RT_USING_SMP
 typedef union {
     unsigned long slock;
@@ -168,6 +206,24 @@ extern rt_hw_spinlock_t _rt_critical_lock;
 #define RT_DEFINE_SPINLOCK(x)  rt_hw_spinlock_t x = __RT_HW_SPIN_LOCK_UNLOCKED(x)
 #define RT_DECLARE_SPINLOCK(x)
 
+/**
+ *  the hint to cpu in a busy-wait loop, it's a compiler barrier as well
+ */
+#ifndef rt_hw_cpu_relax
+#if defined(__GNUC__) && (defined(__arm__) || defined(__aarch64__))
+#define rt_hw_cpu_relax()   __asm volatile ("yield" ::: "memory")
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define rt_hw_cpu_relax()   __asm volatile ("pause" ::: "memory")
+#elif defined(__GNUC__) && defined(__riscv)
+/* the pause of Zihintpause, a fence hint on the cpus without it */
+#define rt_hw_cpu_relax()   __asm volatile (".word 0x0100000f" ::: "memory")
+#elif defined(__GNUC__)
+#define rt_hw_cpu_relax()   __asm volatile ("" ::: "memory")
+#else
+#define rt_hw_cpu_relax()
+#endif /* defined(__GNUC__) && (defined(__arm__) || defined(__aarch64__)) */
+#endif /* rt_hw_cpu_relax */
+
 /**
  *  ipi function
  */
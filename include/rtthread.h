@@ -16,6 +16,12 @@
  * 2018-11-22     Jesven       add all cpu's lock and ipi handler
  * 2021-02-28     Meco Man     add RT_KSERVICE_USING_STDLIB
  * 2021-11-14     Meco Man     add rtlegacy.h for compatibility
+ * 2022-02-24     RT-Thread    add the cpu usage of threads
+ * 2022-02-24     RT-Thread    add the trace events of kernel
+ * 2022-02-24     RT-Thread    add the earliest deadline first class of threads
+ * 2022-02-24     RT-Thread    add the high-water mark of thread stack
+ * 2022-02-24     RT-Thread    add the thread cache of dynamic threads
+ * 2022-02-24     RT-Thread    add rt_hrtimer_ns_to_tick()
  */
 
 #ifndef __RT_THREAD_H__
@@ -53,12 +59,14 @@ void rt_object_init(struct rt_object         *object,
                     const char               *name);
 void rt_object_detach(rt_object_t object);
 #ifdef RT_USING_HEAP
+void rt_object_attach(rt_object_t object, enum rt_object_class_type type, const char *name);
 rt_object_t rt_object_allocate(enum rt_object_class_type type,
                                const char               *name);
 void rt_object_delete(rt_object_t object);
 #endif
 rt_bool_t rt_object_is_systemobject(rt_object_t object);
 rt_uint8_t rt_object_get_type(rt_object_t object);
+void rt_object_set_name(rt_object_t object, const char *name);
 rt_object_t rt_object_find(const char *name, rt_uint8_t type);
 
 #ifdef RT_USING_HOOK
@@ -83,6 +91,9 @@ void rt_object_put_sethook(void (*hook)(struct rt_object *object));
 rt_tick_t rt_tick_get(void);
 void rt_tick_set(rt_tick_t tick);
 void rt_tick_increase(void);
+#ifdef RT_USING_TICKLESS
+void rt_tick_compensate(rt_tick_t ticks);
+#endif /* RT_USING_TICKLESS */
 rt_tick_t  rt_tick_from_millisecond(rt_int32_t ms);
 rt_tick_t rt_tick_get_millisecond(void);
 #ifdef RT_USING_HOOK
@@ -119,6 +130,20 @@ void rt_timer_enter_sethook(void (*hook)(struct rt_timer *timer));
 void rt_timer_exit_sethook(void (*hook)(struct rt_timer *timer));
 #endif
 
+#ifdef RT_USING_HRTIMER
+/*
+ * high resolution timer interface, the time is in nanoseconds
+ */
+void rt_hrtimer_init(rt_hrtimer_t timer,
+                     void (*timeout)(void *parameter),
+                     void       *parameter,
+                     rt_uint8_t  flag);
+rt_err_t rt_hrtimer_start(rt_hrtimer_t timer, rt_uint64_t ns);
+rt_err_t rt_hrtimer_stop(rt_hrtimer_t timer);
+rt_uint64_t rt_hrtimer_get_ns(void);
+rt_tick_t rt_hrtimer_ns_to_tick(rt_uint64_t ns);
+#endif /* RT_USING_HRTIMER */
+
 /**@}*/
 
 /**
@@ -155,9 +180,26 @@ rt_err_t rt_thread_yield(void);
 rt_err_t rt_thread_delay(rt_tick_t tick);
 rt_err_t rt_thread_delay_until(rt_tick_t *tick, rt_tick_t inc_tick);
 rt_err_t rt_thread_mdelay(rt_int32_t ms);
+#ifdef RT_USING_HRTIMER
+rt_err_t rt_thread_udelay(rt_uint32_t us);
+#endif /* RT_USING_HRTIMER */
 rt_err_t rt_thread_control(rt_thread_t thread, int cmd, void *arg);
 rt_err_t rt_thread_suspend(rt_thread_t thread);
 rt_err_t rt_thread_resume(rt_thread_t thread);
+#ifdef RT_USING_CPU_USAGE
+rt_uint64_t rt_thread_usage_clock(void);
+rt_err_t rt_thread_get_usage(rt_thread_t thread, struct rt_thread_usage *usage);
+#endif /* RT_USING_CPU_USAGE */
+#ifdef RT_USING_SCHED_EDF
+rt_err_t rt_thread_set_deadline(rt_thread_t thread, rt_tick_t runtime, rt_tick_t deadline, rt_tick_t period);
+#endif /* RT_USING_SCHED_EDF */
+#ifdef RT_USING_STACK_WATERMARK
+rt_uint32_t rt_thread_stack_watermark(rt_thread_t thread, rt_size_t words);
+#endif /* RT_USING_STACK_WATERMARK */
+#ifdef RT_USING_THREAD_CACHE
+rt_err_t rt_thread_cache_prewarm(rt_uint32_t stack_size, rt_uint32_t count);
+void rt_thread_cache_put(rt_thread_t thread);
+#endif /* RT_USING_THREAD_CACHE */
 
 #ifdef RT_USING_SIGNALS
 void rt_thread_alloc_sig(rt_thread_t tid);
@@ -190,6 +232,9 @@ void rt_system_scheduler_start(void);
 void rt_schedule(void);
 void rt_schedule_insert_thread(struct rt_thread *thread);
 void rt_schedule_remove_thread(struct rt_thread *thread);
+#ifdef RT_USING_SCHED_EDF
+void rt_schedule_edf_tick(struct rt_thread *thread);
+#endif /* RT_USING_SCHED_EDF */
 
 void rt_enter_critical(void);
 void rt_exit_critical(void);
@@ -200,8 +245,13 @@ void rt_scheduler_sethook(void (*hook)(rt_thread_t from, rt_thread_t to));
 void rt_scheduler_switch_sethook(void (*hook)(struct rt_thread *tid));
 #endif
 
+#ifdef RT_USING_TRACE
+void rt_trace_event(rt_uint8_t event, rt_ubase_t arg0, rt_ubase_t arg1);
+#endif /* RT_USING_TRACE */
+
 #ifdef RT_USING_SMP
 void rt_scheduler_ipi_handler(int vector, void *param);
+void rt_scheduler_switch_finish(struct rt_cpu *pcpu);
 #endif
 
 /**@}*/
@@ -327,6 +377,21 @@ void rt_slab_page_free(rt_slab_t m, void *addr, rt_size_t npages);
 void *rt_slab_alloc(rt_slab_t m, rt_size_t size);
 void *rt_slab_realloc(rt_slab_t m, void *ptr, rt_size_t size);
 void rt_slab_free(rt_slab_t m, void *ptr);
+#ifdef RT_USING_SLAB_MAGAZINE
+void *rt_slab_magazine_alloc(rt_slab_t m, rt_size_t size);
+rt_err_t rt_slab_magazine_free(rt_slab_t m, void *ptr);
+#endif /* RT_USING_SLAB_MAGAZINE */
+#endif
+
+#ifdef RT_USING_TLSF
+/**
+ * TLSF object interface
+ */
+rt_tlsf_t rt_tlsf_init(const char *name, void *begin_addr, rt_size_t size);
+rt_err_t rt_tlsf_detach(rt_tlsf_t m);
+void *rt_tlsf_alloc(rt_tlsf_t m, rt_size_t size);
+void *rt_tlsf_realloc(rt_tlsf_t m, void *ptr, rt_size_t size);
+void rt_tlsf_free(rt_tlsf_t m, void *ptr);
 #endif
 
 /**@}*/
@@ -352,6 +417,9 @@ rt_err_t rt_sem_delete(rt_sem_t sem);
 #endif
 
 rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time);
+#ifdef RT_USING_HRTIMER
+rt_err_t rt_sem_take_ns(rt_sem_t sem, rt_uint64_t ns);
+#endif /* RT_USING_HRTIMER */
 rt_err_t rt_sem_trytake(rt_sem_t sem);
 rt_err_t rt_sem_release(rt_sem_t sem);
 rt_err_t rt_sem_control(rt_sem_t sem, int cmd, void *arg);
@@ -448,6 +516,16 @@ rt_err_t rt_mq_recv(rt_mq_t    mq,
                     rt_size_t  size,
                     rt_int32_t timeout);
 rt_err_t rt_mq_control(rt_mq_t mq, int cmd, void *arg);
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+rt_err_t rt_mq_attach_mempool(rt_mq_t mq, rt_mp_t mp);
+void *rt_mq_buffer_alloc(rt_mq_t mq, rt_int32_t timeout);
+void rt_mq_buffer_ref(void *buffer);
+void rt_mq_buffer_release(void *buffer);
+rt_err_t rt_mq_send_buffer(rt_mq_t mq, void *buffer);
+rt_err_t rt_mq_send_buffer_wait(rt_mq_t mq, void *buffer, rt_int32_t timeout);
+rt_err_t rt_mq_urgent_buffer(rt_mq_t mq, void *buffer);
+rt_err_t rt_mq_recv_buffer(rt_mq_t mq, void **buffer, rt_int32_t timeout);
+#endif /* RT_USING_MESSAGEQUEUE_ZEROCOPY */
 #endif
 
 /* defunct */
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-20     RT-Thread    the first version
+ * 2022-02-24     RT-Thread    rename the parameter new of compare-and-exchange to desired
+ */
+
+#include <rtthread.h>
+#include <rthw.h>
+
+#ifdef RT_USING_HW_ATOMIC
+/*
+ * The atomic operations are built on the exclusive access of ARMv7, the
+ * exclusive monitor is cleared on exception entry, so they are atomic to
+ * both interrupts and the other cores. Each operation is between two dmb,
+ * which make it sequentially consistent, on the failure of compare-and-exchange
+ * as well.
+ */
+#if defined(__CC_ARM)
+#define _atomic_ldrex(ptr)          ((rt_atomic_t)__ldrex(ptr))
+#define _atomic_strex(val, ptr)     __strex((unsigned int)(val), ptr)
+#define _atomic_dmb()               __dmb(0xF)
+#elif defined(__ICCARM__)
+#include <intrinsics.h>
+#define _atomic_ldrex(ptr)          ((rt_atomic_t)__LDREX((unsigned long *)(ptr)))
+#define _atomic_strex(val, ptr)     __STREX((unsigned long)(val), (unsigned long *)(ptr))
+#define _atomic_dmb()               __DMB()
+#else /* __GNUC__ and armclang */
+rt_inline rt_atomic_t _atomic_ldrex(volatile rt_atomic_t *ptr)
+{
+    rt_atomic_t val;
+
+    __asm volatile ("ldrex %0, [%1]" : "=r" (val) : "r" (ptr) : "memory");
+    return val;
+}
+
+rt_inline rt_uint32_t _atomic_strex(rt_atomic_t val, volatile rt_atomic_t *ptr)
+{
+    rt_uint32_t result;
+
+    __asm volatile ("strex %0, %2, [%1]" : "=&r" (result) : "r" (ptr), "r" (val) : "memory");
+    return result;
+}
+
+#define _atomic_dmb()               __asm volatile ("dmb" ::: "memory")
+#endif
+
+rt_atomic_t rt_hw_atomic_load(volatile rt_atomic_t *ptr)
+{
+    rt_atomic_t val;
+
+    _atomic_dmb();
+    val = *ptr;
+    _atomic_dmb();
+
+    return val;
+}
+
+void rt_hw_atomic_store(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    _atomic_dmb();
+    *ptr = val;
+    _atomic_dmb();
+}
+
+rt_atomic_t rt_hw_atomic_exchange(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    rt_atomic_t old;
+
+    _atomic_dmb();
+    do
+    {
+        old = _atomic_ldrex(ptr);
+    } while (_atomic_strex(val, ptr) != 0);
+    _atomic_dmb();
+
+    return old;
+}
+
+rt_atomic_t rt_hw_atomic_add(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    rt_atomic_t old;
+
+    _atomic_dmb();
+    do
+    {
+        old = _atomic_ldrex(ptr);
+    } while (_atomic_strex(old + val, ptr) != 0);
+    _atomic_dmb();
+
+    return old;
+}
+
+rt_atomic_t rt_hw_atomic_sub(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    rt_atomic_t old;
+
+    _atomic_dmb();
+    do
+    {
+        old = _atomic_ldrex(ptr);
+    } while (_atomic_strex(old - val, ptr) != 0);
+    _atomic_dmb();
+
+    return old;
+}
+
+rt_atomic_t rt_hw_atomic_and(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    rt_atomic_t old;
+
+    _atomic_dmb();
+    do
+    {
+        old = _atomic_ldrex(ptr);
+    } while (_atomic_strex(old & val, ptr) != 0);
+    _atomic_dmb();
+
+    return old;
+}
+
+rt_atomic_t rt_hw_atomic_or(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    rt_atomic_t old;
+
+    _atomic_dmb();
+    do
+    {
+        old = _atomic_ldrex(ptr);
+    } while (_atomic_strex(old | val, ptr) != 0);
+    _atomic_dmb();
+
+    return old;
+}
+
+rt_atomic_t rt_hw_atomic_xor(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    rt_atomic_t old;
+
+    _atomic_dmb();
+    do
+    {
+        old = _atomic_ldrex(ptr);
+    } while (_atomic_strex(old ^ val, ptr) != 0);
+    _atomic_dmb();
+
+    return old;
+}
+
+rt_atomic_t rt_hw_atomic_compare_exchange_strong(volatile rt_atomic_t *ptr, rt_atomic_t *old, rt_atomic_t desired)
+{
+    rt_atomic_t val;
+
+    _atomic_dmb();
+    do
+    {
+        val = _atomic_ldrex(ptr);
+        if (val != *old)
+        {
+            /* the open exclusive monitor is harmless, the next strex fails */
+            _atomic_dmb();
+            *old = val;
+
+            return RT_FALSE;
+        }
+    } while (_atomic_strex(desired, ptr) != 0);
+    _atomic_dmb();
+
+    return RT_TRUE;
+}
+#endif /* RT_USING_HW_ATOMIC */
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+
+#if defined(RT_USING_CPU_MEMOPS) && !defined(RT_KSERVICE_USING_TINY_SIZE)
+/*
+ * They override the weak rt_memcpy/rt_memset/rt_memcmp of kservice:
+ *  - NEON moves 64 bytes per loop on Cortex-A, the NEON registers are only
+ *    saved in context switch and interrupt entry with RT_USING_FPU.
+ *  - Helium (MVE) moves 16 bytes per loop on Armv8.1-M with predicated tails,
+ *    the registers are stacked with the FP context by the hardware.
+ *  - Otherwise the scalar path moves 8 words per loop, the source may be
+ *    unaligned on the cores which support unaligned LDR (e.g. Cortex-M7/M33).
+ */
+#if defined(__ARM_NEON) && defined(RT_USING_FPU)
+#include <arm_neon.h>
+#define MEMOPS_USING_NEON
+#elif defined(__ARM_FEATURE_MVE)
+#include <arm_mve.h>
+#define MEMOPS_USING_MVE
+#endif
+
+#if defined(__CC_ARM) || defined(__ICCARM__)
+typedef __packed rt_uint32_t _u32_unaligned_t;
+#else
+typedef rt_uint32_t _u32_unaligned_t __attribute__((aligned(1), may_alias));
+#endif
+
+#define _WORD_SIZE          (sizeof(rt_uint32_t))
+#define _UNALIGNED(x)       ((rt_ubase_t)(x) & (_WORD_SIZE - 1))
+
+#ifdef __ARM_FEATURE_UNALIGNED
+#define _WORD_ACCESS(a, b)  RT_TRUE
+#else
+#define _WORD_ACCESS(a, b)  ((_UNALIGNED(a) | _UNALIGNED(b)) == 0)
+#endif /* __ARM_FEATURE_UNALIGNED */
+
+#if !defined(MEMOPS_USING_NEON) && !defined(MEMOPS_USING_MVE)
+/* copy the words to the aligned d, s is unaligned only if the core allows */
+static rt_uint8_t *_memcpy_words(rt_uint8_t *d, const rt_uint8_t *s, rt_ubase_t *count)
+{
+    rt_uint32_t *wd = (rt_uint32_t *)d;
+    const _u32_unaligned_t *ws = (const _u32_unaligned_t *)s;
+    rt_ubase_t n = *count;
+
+    while (n >= _WORD_SIZE * 8)
+    {
+        wd[0] = ws[0]; wd[1] = ws[1]; wd[2] = ws[2]; wd[3] = ws[3];
+        wd[4] = ws[4]; wd[5] = ws[5]; wd[6] = ws[6]; wd[7] = ws[7];
+        wd += 8;
+        ws += 8;
+        n -= _WORD_SIZE * 8;
+    }
+    while (n >= _WORD_SIZE)
+    {
+        *wd++ = *ws++;
+        n -= _WORD_SIZE;
+    }
+
+    *count = n;
+    return (rt_uint8_t *)wd;
+}
+#endif /* !defined(MEMOPS_USING_NEON) && !defined(MEMOPS_USING_MVE) */
+
+#ifndef RT_KSERVICE_USING_STDLIB_MEMCPY
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count)
+{
+    rt_uint8_t *d = (rt_uint8_t *)dst;
+    const rt_uint8_t *s = (const rt_uint8_t *)src;
+
+#if defined(MEMOPS_USING_NEON)
+    while (count >= 64)
+    {
+        uint8x16_t v0 = vld1q_u8(s), v1 = vld1q_u8(s + 16);
+        uint8x16_t v2 = vld1q_u8(s + 32), v3 = vld1q_u8(s + 48);
+
+        vst1q_u8(d, v0);
+        vst1q_u8(d + 16, v1);
+        vst1q_u8(d + 32, v2);
+        vst1q_u8(d + 48, v3);
+        d += 64;
+        s += 64;
+        count -= 64;
+    }
+    while (count >= 16)
+    {
+        vst1q_u8(d, vld1q_u8(s));
+        d += 16;
+        s += 16;
+        count -= 16;
+    }
+#elif defined(MEMOPS_USING_MVE)
+    while (count > 0)
+    {
+        mve_pred16_t p = vctp8q(count);
+
+        vstrbq_p_u8(d, vldrbq_z_u8(s, p), p);
+        if (count <= 16)
+        {
+            return dst;
+        }
+        d += 16;
+        s += 16;
+        count -= 16;
+    }
+#else
+    if (count >= _WORD_SIZE * 2)
+    {
+        /* align the destination, the stores are the most expensive */
+        while (_UNALIGNED(d))
+        {
+            *d++ = *s++;
+            count --;
+        }
+        if (_WORD_ACCESS(d, s))
+        {
+            rt_uint8_t *end = _memcpy_words(d, s, &count);
+
+            s += end - d;
+            d = end;
+        }
+    }
+#endif
+
+    while (count--)
+    {
+        *d++ = *s++;
+    }
+
+    return dst;
+}
+RTM_EXPORT(rt_memcpy);
+#endif /* RT_KSERVICE_USING_STDLIB_MEMCPY */
+
+#ifndef RT_KSERVICE_USING_STDLIB_MEMSET
+void *rt_memset(void *s, int c, rt_ubase_t count)
+{
+    rt_uint8_t *d = (rt_uint8_t *)s;
+
+#if defined(MEMOPS_USING_NEON)
+    uint8x16_t v = vdupq_n_u8((rt_uint8_t)c);
+
+    while (count >= 64)
+    {
+        vst1q_u8(d, v);
+        vst1q_u8(d + 16, v);
+        vst1q_u8(d + 32, v);
+        vst1q_u8(d + 48, v);
+        d += 64;
+        count -= 64;
+    }
+    while (count >= 16)
+    {
+        vst1q_u8(d, v);
+        d += 16;
+        count -= 16;
+    }
+#elif defined(MEMOPS_USING_MVE)
+    uint8x16_t v = vdupq_n_u8((rt_uint8_t)c);
+
+    while (count > 0)
+    {
+        vstrbq_p_u8(d, v, vctp8q(count));
+        if (count <= 16)
+        {
+            return s;
+        }
+        d += 16;
+        count -= 16;
+    }
+#else
+    rt_uint32_t *wd;
+    rt_uint32_t w;
+
+    if (count >= _WORD_SIZE * 2)
+    {
+        while (_UNALIGNED(d))
+        {
+            *d++ = (rt_uint8_t)c;
+            count --;
+        }
+
+        w = (rt_uint8_t)c;
+        w |= w << 8;
+        w |= w << 16;
+        wd = (rt_uint32_t *)d;
+        while (count >= _WORD_SIZE * 8)
+        {
+            wd[0] = w; wd[1] = w; wd[2] = w; wd[3] = w;
+            wd[4] = w; wd[5] = w; wd[6] = w; wd[7] = w;
+            wd += 8;
+            count -= _WORD_SIZE * 8;
+        }
+        while (count >= _WORD_SIZE)
+        {
+            *wd++ = w;
+            count -= _WORD_SIZE;
+        }
+        d = (rt_uint8_t *)wd;
+    }
+#endif
+
+    while (count--)
+    {
+        *d++ = (rt_uint8_t)c;
+    }
+
+    return s;
+}
+RTM_EXPORT(rt_memset);
+#endif /* RT_KSERVICE_USING_STDLIB_MEMSET */
+
+#ifndef RT_KSERVICE_USING_STDLIB
+rt_int32_t rt_memcmp(const void *cs, const void *ct, rt_size_t count)
+{
+    const rt_uint8_t *s1 = (const rt_uint8_t *)cs;
+    const rt_uint8_t *s2 = (const rt_uint8_t *)ct;
+
+#if defined(MEMOPS_USING_NEON)
+    /* skip the equal blocks, the first different byte is found bytewise */
+    while (count >= 16)
+    {
+        uint64x2_t eq = vreinterpretq_u64_u8(vceqq_u8(vld1q_u8(s1), vld1q_u8(s2)));
+
+        if ((vgetq_lane_u64(eq, 0) & vgetq_lane_u64(eq, 1)) != ~(rt_uint64_t)0)
+        {
+            break;
+        }
+        s1 += 16;
+        s2 += 16;
+        count -= 16;
+    }
+#elif defined(MEMOPS_USING_MVE)
+    while (count > 0)
+    {
+        mve_pred16_t p = vctp8q(count);
+        mve_pred16_t ne = vcmpneq_m_u8(vldrbq_z_u8(s1, p), vldrbq_z_u8(s2, p), p);
+
+        if (ne != 0)
+        {
+            /* one predicate bit per byte lane */
+            count = __builtin_ctz(ne);
+            return (rt_int32_t)s1[count] - (rt_int32_t)s2[count];
+        }
+        if (count <= 16)
+        {
+            return 0;
+        }
+        s1 += 16;
+        s2 += 16;
+        count -= 16;
+    }
+#else
+    if (_WORD_ACCESS(s1, s2))
+    {
+        while (count >= _WORD_SIZE && *(const _u32_unaligned_t *)s1 == *(const _u32_unaligned_t *)s2)
+        {
+            s1 += _WORD_SIZE;
+            s2 += _WORD_SIZE;
+            count -= _WORD_SIZE;
+        }
+    }
+#endif
+
+    for (; count > 0; s1 ++, s2 ++, count --)
+    {
+        if (*s1 != *s2)
+        {
+            return (rt_int32_t)*s1 - (rt_int32_t)*s2;
+        }
+    }
+
+    return 0;
+}
+RTM_EXPORT(rt_memcmp);
+#endif /* RT_KSERVICE_USING_STDLIB */
+#endif /* defined(RT_USING_CPU_MEMOPS) && !defined(RT_KSERVICE_USING_TINY_SIZE) */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+
+#ifdef RT_USING_HW_STACK_GUARD
+#include <board.h>
+
+#if (RT_STACK_GUARD_SIZE < 32) || (RT_STACK_GUARD_SIZE & (RT_STACK_GUARD_SIZE - 1))
+#error "RT_STACK_GUARD_SIZE must be a power of 2 no less than 32"
+#endif
+
+/*
+ * The guard is the last region of the ARMv7-M MPU, it takes priority over the
+ * regions set by the BSP. It can't be accessed (AP = 0) nor executed, and
+ * PRIVDEFENA keeps the default memory map elsewhere for the privileged threads.
+ * HFNMIENA is left clear, so the MPU is off in the HardFault handler, which
+ * saves the context of the faulting thread on its stack.
+ */
+static rt_uint32_t _guard_region;
+static rt_uint32_t _guard_rasr;
+static rt_bool_t _guard_inited = RT_FALSE;
+
+static void _stack_guard_init(void)
+{
+    rt_uint32_t regions;
+
+    _guard_inited = RT_TRUE;
+
+    regions = (MPU->TYPE & MPU_TYPE_DREGION_Msk) >> MPU_TYPE_DREGION_Pos;
+    if (regions == 0)
+    {
+        /* no MPU, the guard is never set */
+        _guard_rasr = 0;
+        return;
+    }
+
+    _guard_region = regions - 1;
+    /* the region size is 2^(SIZE + 1) bytes */
+    _guard_rasr = MPU_RASR_XN_Msk |
+                  ((rt_uint32_t)(__rt_ffs(RT_STACK_GUARD_SIZE) - 2) << MPU_RASR_SIZE_Pos) |
+                  MPU_RASR_ENABLE_Msk;
+
+    MPU->CTRL |= MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk;
+    __DSB();
+    __ISB();
+}
+
+/**
+ * @brief This function will move the stack guard to the end of the thread stack,
+ *        the region is aligned to its size inside the stack. The guard is removed
+ *        for a stack too small to hold it.
+ *
+ * @param thread is the thread to be switched in.
+ */
+void rt_hw_stack_guard_switch(struct rt_thread *thread)
+{
+    rt_ubase_t base;
+
+    if (_guard_inited == RT_FALSE)
+    {
+        _stack_guard_init();
+    }
+    if (_guard_rasr == 0)
+    {
+        return;
+    }
+
+    base = RT_ALIGN((rt_ubase_t)thread->stack_addr, RT_STACK_GUARD_SIZE);
+
+    MPU->RNR = _guard_region;
+    if (base + RT_STACK_GUARD_SIZE <= (rt_ubase_t)thread->stack_addr + thread->stack_size)
+    {
+        MPU->RASR = 0;
+        MPU->RBAR = base;
+        MPU->RASR = _guard_rasr;
+    }
+    else
+    {
+        MPU->RASR = 0;
+    }
+    __DSB();
+    __ISB();
+}
+#endif /* RT_USING_HW_STACK_GUARD */
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-20     RT-Thread    the first version
+ * 2022-02-24     RT-Thread    rename the parameter new to desired, make the sc of compare-and-exchange .aqrl
+ */
+
+#include <rtthread.h>
+#include <rthw.h>
+
+#ifdef RT_USING_HW_ATOMIC
+/*
+ * The atomic operations are built on the "A" extension, the read-modify-write
+ * operations are single AMO instructions and compare-and-exchange is a LR/SC
+ * loop. All of the AMO, LR and SC instructions are .aqrl, which makes them
+ * sequentially consistent without any extra fence.
+ */
+#if __riscv_xlen == 64
+#define _ATOMIC_SUFFIX  ".d"
+#else
+#define _ATOMIC_SUFFIX  ".w"
+#endif
+
+#define _ATOMIC_AMO(op, ptr, val) ({                                    \
+    rt_atomic_t __old;                                                  \
+    __asm__ volatile ("amo" op _ATOMIC_SUFFIX ".aqrl %0, %2, %1"        \
+                      : "=r" (__old), "+A" (*(ptr))                     \
+                      : "r" (val)                                       \
+                      : "memory");                                      \
+    __old;                                                              \
+})
+
+rt_atomic_t rt_hw_atomic_load(volatile rt_atomic_t *ptr)
+{
+    return _ATOMIC_AMO("or", ptr, 0);
+}
+
+void rt_hw_atomic_store(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    _ATOMIC_AMO("swap", ptr, val);
+}
+
+rt_atomic_t rt_hw_atomic_exchange(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    return _ATOMIC_AMO("swap", ptr, val);
+}
+
+rt_atomic_t rt_hw_atomic_add(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    return _ATOMIC_AMO("add", ptr, val);
+}
+
+rt_atomic_t rt_hw_atomic_sub(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    return _ATOMIC_AMO("add", ptr, -val);
+}
+
+rt_atomic_t rt_hw_atomic_and(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    return _ATOMIC_AMO("and", ptr, val);
+}
+
+rt_atomic_t rt_hw_atomic_or(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    return _ATOMIC_AMO("or", ptr, val);
+}
+
+rt_atomic_t rt_hw_atomic_xor(volatile rt_atomic_t *ptr, rt_atomic_t val)
+{
+    return _ATOMIC_AMO("xor", ptr, val);
+}
+
+rt_atomic_t rt_hw_atomic_compare_exchange_strong(volatile rt_atomic_t *ptr, rt_atomic_t *old, rt_atomic_t desired)
+{
+    rt_atomic_t val;
+    rt_atomic_t result;
+
+    __asm__ volatile (
+        "1: lr" _ATOMIC_SUFFIX ".aqrl %0, (%2)\n"
+        "   bne %0, %3, 2f\n"
+        "   sc" _ATOMIC_SUFFIX ".aqrl %1, %4, (%2)\n"
+        "   bnez %1, 1b\n"
+        "2:\n"
+        : "=&r" (val), "=&r" (result)
+        : "r" (ptr), "r" (*old), "r" (desired)
+        : "memory");
+
+    if (val != *old)
+    {
+        *old = val;
+        return RT_FALSE;
+    }
+
+    return RT_TRUE;
+}
+#endif /* RT_USING_HW_ATOMIC */
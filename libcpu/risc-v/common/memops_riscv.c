@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-24     RT-Thread    the first version
+ */
+
+#include <rtthread.h>
+
+#if defined(RT_USING_CPU_MEMOPS) && !defined(RT_KSERVICE_USING_TINY_SIZE)
+/*
+ * They override the weak rt_memcpy/rt_memset/rt_memcmp of kservice:
+ *  - With the "V" extension 1.0, each loop moves one LMUL=8 register group,
+ *    the vector length is given by vsetvli so there is no scalar tail. It is
+ *    only used by the ports which save the vector registers in the context,
+ *    which select ARCH_RISCV_VECTOR.
+ *  - Otherwise the scalar path moves XLEN words. The misaligned accesses trap
+ *    or are emulated on most cores, so a misaligned source is read by aligned
+ *    words and shifted into place.
+ */
+#if defined(__riscv_vector) && defined(ARCH_RISCV_VECTOR)
+#define MEMOPS_USING_RVV
+#endif
+
+#define _WORD_SIZE          (sizeof(rt_ubase_t))
+#define _WORD_BITS          (_WORD_SIZE * 8)
+#define _UNALIGNED(x)       ((rt_ubase_t)(x) & (_WORD_SIZE - 1))
+
+#ifndef MEMOPS_USING_RVV
+/* copy the words to the aligned d, RISC-V is always little-endian */
+static rt_uint8_t *_memcpy_words(rt_uint8_t *d, const rt_uint8_t *s, rt_ubase_t *count)
+{
+    rt_ubase_t *wd = (rt_ubase_t *)d;
+    const rt_ubase_t *ws;
+    rt_ubase_t n = *count;
+    rt_ubase_t lo, hi, shift;
+
+    if (_UNALIGNED(s) == 0)
+    {
+        ws = (const rt_ubase_t *)s;
+        while (n >= _WORD_SIZE * 4)
+        {
+            wd[0] = ws[0];
+            wd[1] = ws[1];
+            wd[2] = ws[2];
+            wd[3] = ws[3];
+            wd += 4;
+            ws += 4;
+            n -= _WORD_SIZE * 4;
+        }
+        while (n >= _WORD_SIZE)
+        {
+            *wd++ = *ws++;
+            n -= _WORD_SIZE;
+        }
+    }
+    else
+    {
+        /* each aligned word read has at least one byte of the source */
+        shift = _UNALIGNED(s) * 8;
+        ws = (const rt_ubase_t *)(s - _UNALIGNED(s));
+        lo = *ws++;
+        while (n >= _WORD_SIZE)
+        {
+            hi = *ws++;
+            *wd++ = (lo >> shift) | (hi << (_WORD_BITS - shift));
+            lo = hi;
+            n -= _WORD_SIZE;
+        }
+    }
+
+    *count = n;
+    return (rt_uint8_t *)wd;
+}
+#endif /* MEMOPS_USING_RVV */
+
+#ifndef RT_KSERVICE_USING_STDLIB_MEMCPY
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count)
+{
+    rt_uint8_t *d = (rt_uint8_t *)dst;
+    const rt_uint8_t *s = (const rt_uint8_t *)src;
+
+#ifdef MEMOPS_USING_RVV
+    rt_ubase_t vl;
+
+    while (count > 0)
+    {
+        __asm__ volatile ("vsetvli %0, %1, e8, m8, ta, ma\n"
+                          "vle8.v  v8, (%2)\n"
+                          "vse8.v  v8, (%3)\n"
+                          : "=&r" (vl)
+                          : "r" (count), "r" (s), "r" (d)
+                          : "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15", "memory");
+        d += vl;
+        s += vl;
+        count -= vl;
+    }
+#else
+    rt_uint8_t *end;
+
+    if (count >= _WORD_SIZE * 2)
+    {
+        while (_UNALIGNED(d))
+        {
+            *d++ = *s++;
+            count --;
+        }
+
+        end = _memcpy_words(d, s, &count);
+        s += end - d;
+        d = end;
+    }
+
+    while (count--)
+    {
+        *d++ = *s++;
+    }
+#endif /* MEMOPS_USING_RVV */
+
+    return dst;
+}
+RTM_EXPORT(rt_memcpy);
+#endif /* RT_KSERVICE_USING_STDLIB_MEMCPY */
+
+#ifndef RT_KSERVICE_USING_STDLIB_MEMSET
+void *rt_memset(void *s, int c, rt_ubase_t count)
+{
+    rt_uint8_t *d = (rt_uint8_t *)s;
+
+#ifdef MEMOPS_USING_RVV
+    rt_ubase_t vl;
+
+    while (count > 0)
+    {
+        __asm__ volatile ("vsetvli %0, %1, e8, m8, ta, ma\n"
+                          "vmv.v.x v8, %2\n"
+                          "vse8.v  v8, (%3)\n"
+                          : "=&r" (vl)
+                          : "r" (count), "r" (c), "r" (d)
+                          : "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15", "memory");
+        d += vl;
+        count -= vl;
+    }
+#else
+    rt_ubase_t *wd;
+    rt_ubase_t w;
+
+    if (count >= _WORD_SIZE * 2)
+    {
+        while (_UNALIGNED(d))
+        {
+            *d++ = (rt_uint8_t)c;
+            count --;
+        }
+
+        /* replicate the byte to all the bytes of a word */
+        w = ((rt_ubase_t)-1 / 0xff) * (rt_uint8_t)c;
+        wd = (rt_ubase_t *)d;
+        while (count >= _WORD_SIZE * 4)
+        {
+            wd[0] = w;
+            wd[1] = w;
+            wd[2] = w;
+            wd[3] = w;
+            wd += 4;
+            count -= _WORD_SIZE * 4;
+        }
+        while (count >= _WORD_SIZE)
+        {
+            *wd++ = w;
+            count -= _WORD_SIZE;
+        }
+        d = (rt_uint8_t *)wd;
+    }
+
+    while (count--)
+    {
+        *d++ = (rt_uint8_t)c;
+    }
+#endif /* MEMOPS_USING_RVV */
+
+    return s;
+}
+RTM_EXPORT(rt_memset);
+#endif /* RT_KSERVICE_USING_STDLIB_MEMSET */
+
+#ifndef RT_KSERVICE_USING_STDLIB
+rt_int32_t rt_memcmp(const void *cs, const void *ct, rt_size_t count)
+{
+    const rt_uint8_t *s1 = (const rt_uint8_t *)cs;
+    const rt_uint8_t *s2 = (const rt_uint8_t *)ct;
+
+#ifdef MEMOPS_USING_RVV
+    rt_ubase_t vl;
+    long first;
+
+    while (count > 0)
+    {
+        /* the index of the first different byte, or -1 */
+        __asm__ volatile ("vsetvli %0, %2, e8, m8, ta, ma\n"
+                          "vle8.v   v8, (%3)\n"
+                          "vle8.v   v16, (%4)\n"
+                          "vmsne.vv v0, v8, v16\n"
+                          "vfirst.m %1, v0\n"
+                          : "=&r" (vl), "=r" (first)
+                          : "r" (count), "r" (s1), "r" (s2)
+                          : "v0", "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15",
+                            "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "memory");
+        if (first >= 0)
+        {
+            return (rt_int32_t)s1[first] - (rt_int32_t)s2[first];
+        }
+        s1 += vl;
+        s2 += vl;
+        count -= vl;
+    }
+#else
+    /* the words are compared if both can be aligned */
+    if (count >= _WORD_SIZE * 2 && _UNALIGNED(s1) == _UNALIGNED(s2))
+    {
+        while (_UNALIGNED(s1))
+        {
+            if (*s1 != *s2)
+            {
+                return (rt_int32_t)*s1 - (rt_int32_t)*s2;
+            }
+            s1 ++;
+            s2 ++;
+            count --;
+        }
+        while (count >= _WORD_SIZE && *(const rt_ubase_t *)s1 == *(const rt_ubase_t *)s2)
+        {
+            s1 += _WORD_SIZE;
+            s2 += _WORD_SIZE;
+            count -= _WORD_SIZE;
+        }
+    }
+
+    for (; count > 0; s1 ++, s2 ++, count --)
+    {
+        if (*s1 != *s2)
+        {
+            return (rt_int32_t)*s1 - (rt_int32_t)*s2;
+        }
+    }
+#endif /* MEMOPS_USING_RVV */
+
+    return 0;
+}
+RTM_EXPORT(rt_memcmp);
+#endif /* RT_KSERVICE_USING_STDLIB */
+#endif /* defined(RT_USING_CPU_MEMOPS) && !defined(RT_KSERVICE_USING_TINY_SIZE) */
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018/10/28     Bernard      The unify RISC-V porting code.
+ * 2022/02/16     RT-Thread    add tickless idle support
  */
 
 #include <rthw.h>
@@ -26,6 +27,50 @@ int tick_isr(void)
     return 0;
 }
 
+#ifdef RT_USING_TICKLESS
+/**
+ * This function stops the periodic tick, sleeps until the timeout-th tick or
+ * any interrupt, then restarts the periodic tick on the original tick boundary.
+ * It is invoked by the idle thread with interrupt disabled.
+ *
+ * @param timeout the ticks to the next deadline, RT_TICK_MAX for no deadline.
+ *
+ * @return the number of ticks passed during the sleep.
+ */
+rt_tick_t rt_hw_tickless_idle(rt_tick_t timeout)
+{
+    uint64_t core_id = current_coreid();
+    /* mtimecmp always holds the next periodic tick */
+    uint64_t next = clint->mtimecmp[core_id];
+    uint64_t now;
+    rt_tick_t elapsed = 0;
+
+    if (timeout == RT_TICK_MAX)
+    {
+        clint->mtimecmp[core_id] = UINT64_MAX;
+    }
+    else
+    {
+        clint->mtimecmp[core_id] = next + (timeout - 1) * tick_cycles;
+    }
+
+    /* a pending interrupt wakes up the hart even if it is disabled */
+    __asm__ volatile ("wfi");
+
+    now = clint->mtime;
+    if (now >= next)
+    {
+        elapsed = (now - next) / tick_cycles + 1;
+        next += elapsed * tick_cycles;
+    }
+
+    /* the periodic tick goes on, this also clears the pending one-shot */
+    clint->mtimecmp[core_id] = next;
+
+    return elapsed;
+}
+#endif /* RT_USING_TICKLESS */
+
 /* Sets and enable the timer interrupt */
 int rt_hw_tick_init(void)
 {
@@ -7,6 +7,7 @@
  * Date           Author       Notes
  * 2018/10/28     Bernard      The unify RISC-V porting code.
  * 2021-02-11     lizhirui     add gp support
+ * 2022-02-24     RT-Thread    add the lazy FPU context
  */
 
 #include <stddef.h>
@@ -15,6 +16,9 @@
 
 #include "cpuport.h"
 #include "stack.h"
+#ifdef ARCH_RISCV_FPU_LAZY
+#include "riscv.h"
+#endif /* ARCH_RISCV_FPU_LAZY */
 
 /**
  * @brief from thread used interrupt context switch
@@ -32,6 +36,29 @@ volatile rt_ubase_t  rt_interrupt_to_thread   = 0;
  */
 volatile rt_ubase_t rt_thread_switch_interrupt_flag = 0;
 
+#ifdef ARCH_RISCV_FPU_LAZY
+/*
+ * The FPU context of a thread is kept at the top of its stack instead of the
+ * stack frame. The registers are saved only when the thread is switched out
+ * with the dirty FPU state, and the FPU is turned off for the thread switched
+ * in, so the registers are restored by the trap of its first FPU instruction.
+ */
+struct rt_hw_fpu_context
+{
+    rv_floatreg_t f[32];
+    rt_ubase_t    fcsr;
+};
+
+#ifdef RISCV_S_MODE
+#define _fpu_enable()           set_csr(sstatus, XSTATUS_FS_CLEAN)
+#else
+#define _fpu_enable()           set_csr(mstatus, XSTATUS_FS_CLEAN)
+#endif /* RISCV_S_MODE */
+
+void rt_hw_fpu_context_save(struct rt_hw_fpu_context *context);
+void rt_hw_fpu_context_load(struct rt_hw_fpu_context *context);
+#endif /* ARCH_RISCV_FPU_LAZY */
+
 
 /**
  * This function will initialize thread stack
@@ -55,6 +82,11 @@ rt_uint8_t *rt_hw_stack_init(void       *tentry,
 
     stk  = stack_addr + sizeof(rt_ubase_t);
     stk  = (rt_uint8_t *)RT_ALIGN_DOWN((rt_ubase_t)stk, REGBYTES);
+#ifdef ARCH_RISCV_FPU_LAZY
+    /* the FPU context starts with all zero */
+    stk -= sizeof(struct rt_hw_fpu_context);
+    rt_memset(stk, 0, sizeof(struct rt_hw_fpu_context));
+#endif /* ARCH_RISCV_FPU_LAZY */
     stk -= sizeof(struct rt_hw_stack_frame);
 
     frame = (struct rt_hw_stack_frame *)stk;
@@ -71,7 +103,11 @@ rt_uint8_t *rt_hw_stack_init(void       *tentry,
     frame->user_sp_exc_stack = (rt_ubase_t)(((rt_ubase_t)stk) + sizeof(struct rt_hw_stack_frame));
 
 #ifndef RISCV_S_MODE
+#ifdef ARCH_RISCV_FPU_LAZY
+    frame->xstatus = 0x00001880;
+#else
     frame->xstatus = 0x00007880;
+#endif /* ARCH_RISCV_FPU_LAZY */
 #else
     frame->xstatus = 0x00040120;
 #endif
@@ -121,3 +157,60 @@ void *get_thread_kernel_stack_top(rt_thread_t thread)
 {
     return (void *)(((rt_size_t)thread -> stack_addr) + ((rt_size_t)thread -> stack_size));
 }
+
+#ifdef ARCH_RISCV_FPU_LAZY
+static struct rt_hw_fpu_context *_fpu_context(rt_thread_t thread)
+{
+    rt_ubase_t top = (rt_ubase_t)get_thread_kernel_stack_top(thread);
+
+    return (struct rt_hw_fpu_context *)(RT_ALIGN_DOWN(top, REGBYTES) - sizeof(struct rt_hw_fpu_context));
+}
+
+/**
+ * @brief Save the FPU context of the thread switched out if it is dirty, and
+ *        turn off the FPU for the thread switched in.
+ *
+ * @param from is the address of the sp of thread switched out, or 0.
+ *
+ * @param to is the address of the sp of thread switched in.
+ *
+ * @param xstatus is the status register of the thread switched out.
+ */
+void rt_hw_fpu_switch(rt_ubase_t from, rt_ubase_t to, rt_ubase_t xstatus)
+{
+    struct rt_hw_stack_frame *frame;
+
+    if (from != 0 && (xstatus & XSTATUS_FS) == XSTATUS_FS_DIRTY)
+    {
+        _fpu_enable();
+        rt_hw_fpu_context_save(_fpu_context(rt_thread_sp_to_thread((void *)from)));
+    }
+
+    frame = *(struct rt_hw_stack_frame **)to;
+    frame->xstatus &= ~(rt_ubase_t)XSTATUS_FS;
+}
+
+/**
+ * @brief Restore the FPU context on the illegal instruction trap of a thread
+ *        with the FPU turned off.
+ *
+ * @param frame is the stack frame of the trap.
+ *
+ * @return RT_EOK if the FPU context is restored, and the instruction shall be
+ *         executed again. Otherwise it is a real illegal instruction.
+ */
+rt_err_t rt_hw_fpu_restore(struct rt_hw_stack_frame *frame)
+{
+    /* the interrupt handlers shall not use the FPU */
+    if ((frame->xstatus & XSTATUS_FS) != 0 || rt_interrupt_get_nest() > 1 || rt_thread_self() == RT_NULL)
+    {
+        return -RT_ERROR;
+    }
+
+    _fpu_enable();
+    rt_hw_fpu_context_load(_fpu_context(rt_thread_self()));
+    frame->xstatus |= XSTATUS_FS_CLEAN;
+
+    return RT_EOK;
+}
+#endif /* ARCH_RISCV_FPU_LAZY */
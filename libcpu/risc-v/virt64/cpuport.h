@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-10-03     Bernard      The first version
+ * 2022-02-24     RT-Thread    add the lazy FPU context
  */
 
 #ifndef CPUPORT_H__
@@ -22,6 +23,26 @@
 // error here, not portable
 #endif
 
+#ifdef ARCH_RISCV_FPU
+#ifdef ARCH_RISCV_FPU_D
+#define FSTORE                  fsd
+#define FLOAD                   fld
+#define FREGBYTES               8
+#define rv_floatreg_t           rt_int64_t
+#endif
+#ifdef ARCH_RISCV_FPU_S
+#define FSTORE                  fsw
+#define FLOAD                   flw
+#define FREGBYTES               4
+#define rv_floatreg_t           rt_int32_t
+#endif
+#endif
+
+/* the FPU state of mstatus/sstatus */
+#define XSTATUS_FS              0x00006000
+#define XSTATUS_FS_CLEAN        0x00004000
+#define XSTATUS_FS_DIRTY        0x00006000
+
 #ifdef RISCV_U_MODE
 #define RISCV_USER_ENTRY 0xFFFFFFE000000000ULL
 #endif
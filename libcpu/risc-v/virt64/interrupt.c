@@ -7,6 +7,7 @@
  * Date           Author       Notes
  * 2018/10/01     Bernard      The first version
  * 2018/12/27     Jesven       Change irq enable/disable to cpu0
+ * 2022-02-24     RT-Thread    restore the lazy FPU context on illegal instruction
  */
 #include "tick.h"
 #include <plic.h>
@@ -218,6 +219,13 @@ void handle_trap(rt_size_t xcause,rt_size_t xtval,rt_size_t xepc,struct rt_hw_st
 #if defined(RT_USING_FINSH) && defined(MSH_USING_BUILT_IN_COMMANDS)
         extern long list_thread();
 #endif
+#ifdef ARCH_RISCV_FPU_LAZY
+        /* the first FPU instruction after the thread is switched in */
+        if (cause == CAUSE_ILLEGAL_INSTRUCTION && rt_hw_fpu_restore(sp) == RT_EOK)
+        {
+            return;
+        }
+#endif /* ARCH_RISCV_FPU_LAZY */
         rt_hw_interrupt_disable();
 
         rt_kprintf("xcause = %08x,xtval = %08x,xepc = %08x\n", xcause, xtval, xepc);
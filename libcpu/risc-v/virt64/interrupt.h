@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2021-05-20     bigmagic      The first version
+ * 2022-02-24     RT-Thread     add the lazy FPU context
  */
 
 #ifndef INTERRUPT_H__
@@ -23,5 +24,8 @@ void rt_hw_interrupt_mask(int vector);
 rt_isr_handler_t rt_hw_interrupt_install(int vector, rt_isr_handler_t handler,
         void *param, const char *name);
 void handle_trap(rt_size_t xcause,rt_size_t xtval,rt_size_t xepc,struct rt_hw_stack_frame *sp);
+#ifdef ARCH_RISCV_FPU_LAZY
+rt_err_t rt_hw_fpu_restore(struct rt_hw_stack_frame *frame);
+#endif /* ARCH_RISCV_FPU_LAZY */
 
 #endif
@@ -6,6 +6,8 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018/10/28     Bernard      The unify RISC-V porting code.
+ * 2022/02/16     RT-Thread    add tickless idle support
+ * 2022/02/24     RT-Thread    keep the next tick time of each hart
  */
 
 #include <rthw.h>
@@ -20,6 +22,18 @@
 
 static volatile uint64_t time_elapsed = 0;
 static volatile unsigned long tick_cycles = 0;
+#ifdef RT_USING_TICKLESS
+#ifdef RT_USING_SMP
+#define TICK_HART_NR    RT_CPUS_NR
+#define TICK_HART_ID()  __raw_hartid()
+#else
+#define TICK_HART_NR    1
+#define TICK_HART_ID()  0
+#endif /* RT_USING_SMP */
+
+/* the time of the next periodic tick of each hart */
+static volatile uint64_t tick_next[TICK_HART_NR];
+#endif /* RT_USING_TICKLESS */
 
 static uint64_t get_ticks()
 {
@@ -32,16 +46,75 @@ static uint64_t get_ticks()
 int tick_isr(void)
 {
     int tick_cycles = VIRT_CLINT_TIMEBASE_FREQ / RT_TICK_PER_SECOND;
+    uint64_t deadline;
+
     rt_tick_increase();
 #ifdef RISCV_S_MODE
-    sbi_set_timer(get_ticks() + tick_cycles);
+    deadline = get_ticks() + tick_cycles;
+    sbi_set_timer(deadline);
 #else
-    *(uint64_t*)CLINT_MTIMECMP(__raw_hartid()) = *(uint64_t*)CLINT_MTIME + tick_cycles;
+    deadline = *(uint64_t*)CLINT_MTIME + tick_cycles;
+    *(uint64_t*)CLINT_MTIMECMP(__raw_hartid()) = deadline;
 #endif
+#ifdef RT_USING_TICKLESS
+    tick_next[TICK_HART_ID()] = deadline;
+#endif /* RT_USING_TICKLESS */
 
     return 0;
 }
 
+#ifdef RT_USING_TICKLESS
+static void set_timer(uint64_t deadline)
+{
+#ifdef RISCV_S_MODE
+    sbi_set_timer(deadline);
+#else
+    *(uint64_t*)CLINT_MTIMECMP(__raw_hartid()) = deadline;
+#endif
+}
+
+/**
+ * This function stops the periodic tick, sleeps until the timeout-th tick or
+ * any interrupt, then restarts the periodic tick on the original tick boundary.
+ * It is invoked by the idle thread with interrupt disabled.
+ *
+ * @param timeout the ticks to the next deadline, RT_TICK_MAX for no deadline.
+ *
+ * @return the number of ticks passed during the sleep.
+ */
+rt_tick_t rt_hw_tickless_idle(rt_tick_t timeout)
+{
+    uint64_t cycles = VIRT_CLINT_TIMEBASE_FREQ / RT_TICK_PER_SECOND;
+    volatile uint64_t *next = &tick_next[TICK_HART_ID()];
+    uint64_t now;
+    rt_tick_t elapsed = 0;
+
+    if (timeout == RT_TICK_MAX)
+    {
+        set_timer(UINT64_MAX);
+    }
+    else
+    {
+        set_timer(*next + (timeout - 1) * cycles);
+    }
+
+    /* a pending interrupt wakes up the hart even if it is disabled */
+    __asm__ volatile ("wfi");
+
+    now = get_ticks();
+    if (now >= *next)
+    {
+        elapsed = (now - *next) / cycles + 1;
+        *next += elapsed * cycles;
+    }
+
+    /* the periodic tick goes on, this also clears the pending one-shot */
+    set_timer(*next);
+
+    return elapsed;
+}
+#endif /* RT_USING_TICKLESS */
+
 /* Sets and enable the timer interrupt */
 int rt_hw_tick_init(void)
 {
@@ -54,6 +127,9 @@ int rt_hw_tick_init(void)
     /* calculate the tick cycles */
     // tick_cycles = interval * sysctl_clock_get_freq(SYSCTL_CLOCK_CPU) / CLINT_CLOCK_DIV / 1000ULL - 1;
     tick_cycles = 40000;
+#ifdef RT_USING_TICKLESS
+    tick_next[TICK_HART_ID()] = get_ticks() + tick_cycles;
+#endif /* RT_USING_TICKLESS */
     /* Set timer */
     sbi_set_timer(get_ticks() + tick_cycles);
 
@@ -62,6 +138,9 @@ int rt_hw_tick_init(void)
 #else
     clear_csr(mie, MIP_MTIP);
     clear_csr(mip, MIP_MTIP);
+#ifdef RT_USING_TICKLESS
+    tick_next[TICK_HART_ID()] = *(uint64_t*)CLINT_MTIME + interval;
+#endif /* RT_USING_TICKLESS */
     *(uint64_t*)CLINT_MTIMECMP(__raw_hartid()) = *(uint64_t*)CLINT_MTIME + interval;
     set_csr(mie, MIP_MTIP);
 #endif
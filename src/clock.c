@@ -15,6 +15,8 @@
  * 2018-11-22     Jesven       add per cpu tick
  * 2020-12-29     Meco Man     implement rt_tick_get_millisecond()
  * 2021-06-01     Meco Man     add critical section projection for rt_tick_increase()
+ * 2022-02-16     RT-Thread    add rt_tick_compensate() for tickless idle
+ * 2022-02-24     RT-Thread    charge the budget of deadline class instead of time slice
  */
 
 #include <rthw.h>
@@ -111,6 +113,18 @@ void rt_tick_increase(void)
     // 每经过一个时钟节拍时，都会检查当前线程的时间片是否用完，以及是否有定时器超时
     thread = rt_thread_self();
 
+#ifdef RT_USING_SCHED_EDF
+    if (thread->edf.stat & RT_THREAD_EDF_ACTIVE)
+    {
+        /* the thread of deadline class runs by its budget, not the time slice */
+        rt_hw_interrupt_enable(level);
+        rt_schedule_edf_tick(thread);
+
+        rt_timer_check();
+        return;
+    }
+#endif /* RT_USING_SCHED_EDF */
+
     -- thread->remaining_tick;
     if (thread->remaining_tick == 0)
     {
@@ -129,6 +143,30 @@ void rt_tick_increase(void)
     rt_timer_check(); // 检查系统硬件定时器链表，如果有定时器超时，将调用相应的超时函数
 }
 
+#ifdef RT_USING_TICKLESS
+/**
+ * @brief    This function will catch up the ticks passed while the periodic tick
+ *           of current cpu was stopped by the tickless idle, in one step.
+ *
+ * @param    ticks is the number of ticks passed.
+ */
+void rt_tick_compensate(rt_tick_t ticks)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+#ifdef RT_USING_SMP
+    rt_cpu_self()->tick += ticks;
+#else
+    rt_tick += ticks;
+#endif /* RT_USING_SMP */
+    rt_hw_interrupt_enable(level);
+
+    /* the timers expired during the sleep */
+    rt_timer_check();
+}
+#endif /* RT_USING_TICKLESS */
+
 /**
  * @brief    This function will calculate the tick from millisecond.
  *
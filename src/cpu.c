@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-10-30     Bernard      The first version
+ * 2022-02-14     RT-Thread    release the ready queue lock after context switch
  */
 #include <rthw.h>
 #include <rtthread.h>
@@ -215,19 +216,18 @@ void rt_cpus_unlock(rt_base_t level)
 RTM_EXPORT(rt_cpus_unlock);
 
 /**
- * This function is invoked by scheduler.
- * It will restore the lock state to whatever the thread's counter expects.
- * If target thread not locked the cpus then unlock the cpus lock.
+ * This function is invoked by the context switch routine once the context of
+ * the previous thread is saved. It sets the new current thread and lets the
+ * scheduler release the ready queue of current cpu. The scheduler never
+ * switches a thread out while it holds the cpus lock, so there is no cpus
+ * lock state to hand over here.
  */
 void rt_cpus_lock_status_restore(struct rt_thread *thread)
 {
     struct rt_cpu* pcpu = rt_cpu_self();
 
     pcpu->current_thread = thread;
-    if (!thread->cpus_lock_nest)
-    {
-        rt_hw_spin_unlock(&_cpus_lock);
-    }
+    rt_scheduler_switch_finish(pcpu);
 }
 RTM_EXPORT(rt_cpus_lock_status_restore);
 
@@ -16,6 +16,9 @@
  * 2018-11-22     Jesven       add per cpu idle task
  *                             combine the code of primary and secondary cpu
  * 2021-11-15     THEWON       Remove duplicate work between idle and _thread_exit
+ * 2022-02-16     RT-Thread    add tickless idle
+ * 2022-02-24     RT-Thread    put the defunct threads back to the thread cache
+ * 2022-02-24     RT-Thread    clean up the defunct threads after they leave the cpu
  */
 
 #include <rthw.h>
@@ -205,6 +208,18 @@ static void rt_defunct_execute(void)
         {
             break;
         }
+#ifdef RT_USING_SMP
+        /* the exiting thread may still run on its stack on another cpu */
+        if (*(volatile rt_uint8_t *)&(thread->oncpu) != RT_CPU_DETACHED)
+        {
+            register rt_base_t level;
+
+            level = rt_hw_interrupt_disable();
+            rt_thread_defunct_enqueue(thread);
+            rt_hw_interrupt_enable(level);
+            break;
+        }
+#endif /* RT_USING_SMP */
 #ifdef RT_USING_MODULE
         module = (struct rt_dlmodule*)thread->module_id;
         if (module)
@@ -232,6 +247,14 @@ static void rt_defunct_execute(void)
         else
         {
 #ifdef RT_USING_HEAP
+#ifdef RT_USING_THREAD_CACHE
+            if (thread->flags & RT_THREAD_FLAG_CACHED)
+            {
+                /* put thread and its stack back to the thread cache */
+                rt_thread_cache_put(thread);
+                continue;
+            }
+#endif /* RT_USING_THREAD_CACHE */
             /* release thread's stack */
             RT_KERNEL_FREE(thread->stack_addr);
             /* delete thread object */
@@ -241,6 +264,90 @@ static void rt_defunct_execute(void)
     }
 }
 
+#ifdef RT_USING_TICKLESS
+#ifndef RT_TICKLESS_THRESHOLD
+#define RT_TICKLESS_THRESHOLD   2
+#endif /* RT_TICKLESS_THRESHOLD */
+
+#ifdef RT_USING_SMP
+/* never sleep with the cpus lock held */
+#define _tickless_lock()            rt_hw_local_irq_disable()
+#define _tickless_unlock(level)     rt_hw_local_irq_enable(level)
+#else
+extern rt_uint32_t rt_thread_ready_priority_group;
+#define _tickless_lock()            rt_hw_interrupt_disable()
+#define _tickless_unlock(level)     rt_hw_interrupt_enable(level)
+#endif /* RT_USING_SMP */
+
+static rt_uint32_t _tickless_sleep_count[_CPUS_NR];
+static rt_tick_t _tickless_skip_ticks[_CPUS_NR];
+
+/*
+ * stop the periodic tick of current cpu until the next timer deadline or
+ * any interrupt, then catch up the passed ticks. Return RT_FALSE if the tick
+ * keeps running.
+ */
+static rt_bool_t _idle_tickless(void)
+{
+    int cpu_id = 0;
+    rt_base_t level;
+    rt_tick_t timeout, elapsed;
+
+    level = _tickless_lock();
+
+#ifdef RT_USING_SMP
+    cpu_id = rt_hw_cpu_id();
+
+    /* the boot cpu keeps the periodic tick for the system time */
+    if (cpu_id == 0 || rt_cpu_self()->priority_group != 0)
+    {
+        _tickless_unlock(level);
+        return RT_FALSE;
+    }
+
+    /* the timer list is checked by the boot cpu, wake up on IPI only */
+    timeout = RT_TICK_MAX;
+#else
+    /* the other ready threads share cpu with idle by time slice */
+    if (rt_thread_ready_priority_group != 0)
+    {
+        _tickless_unlock(level);
+        return RT_FALSE;
+    }
+
+    timeout = rt_timer_next_timeout_tick();
+    if (timeout != RT_TICK_MAX)
+    {
+        timeout = timeout - rt_tick_get();
+        if (timeout >= RT_TICK_MAX / 2)
+        {
+            /* already expired */
+            timeout = 0;
+        }
+    }
+#endif /* RT_USING_SMP */
+
+    if (timeout < RT_TICKLESS_THRESHOLD)
+    {
+        _tickless_unlock(level);
+        return RT_FALSE;
+    }
+
+    elapsed = rt_hw_tickless_idle(timeout);
+    _tickless_sleep_count[cpu_id] ++;
+    _tickless_skip_ticks[cpu_id] += elapsed;
+
+    _tickless_unlock(level);
+
+    if (elapsed > 0)
+    {
+        rt_tick_compensate(elapsed);
+    }
+
+    return RT_TRUE;
+}
+#endif /* RT_USING_TICKLESS */
+
 static void rt_thread_idle_entry(void *parameter)
 {
 #ifdef RT_USING_SMP
@@ -248,7 +355,14 @@ static void rt_thread_idle_entry(void *parameter)
     {
         while (1)
         {
-            rt_hw_secondary_cpu_idle_exec();
+            /* pull the threads queued on busy cpus before sleeping */
+            rt_schedule();
+#ifdef RT_USING_TICKLESS
+            if (_idle_tickless() == RT_FALSE)
+#endif /* RT_USING_TICKLESS */
+            {
+                rt_hw_secondary_cpu_idle_exec();
+            }
         }
     }
 #endif /* RT_USING_SMP */
@@ -271,8 +385,15 @@ static void rt_thread_idle_entry(void *parameter)
 
 #ifndef RT_USING_SMP
         rt_defunct_execute();
+#else
+        /* pull the threads queued on busy cpus */
+        rt_schedule();
 #endif /* RT_USING_SMP */
 
+#ifdef RT_USING_TICKLESS
+        _idle_tickless();
+#endif /* RT_USING_TICKLESS */
+
 #ifdef RT_USING_PM
         void rt_system_power_manager(void);
         rt_system_power_manager();
@@ -351,3 +472,20 @@ rt_thread_t rt_thread_idle_gethandler(void)
 
     return (rt_thread_t)(&idle[id]);
 }
+
+#if defined(RT_USING_TICKLESS) && defined(RT_USING_FINSH)
+#include <finsh.h>
+
+static void tickless(void)
+{
+    int i;
+
+    rt_kprintf("cpu sleeps     skipped ticks\n");
+    rt_kprintf("--- ---------- -------------\n");
+    for (i = 0; i < _CPUS_NR; i++)
+    {
+        rt_kprintf("%3d %10d %13d\n", i, _tickless_sleep_count[i], _tickless_skip_ticks[i]);
+    }
+}
+MSH_CMD_EXPORT(tickless, show tickless idle statistics);
+#endif /* defined(RT_USING_TICKLESS) && defined(RT_USING_FINSH) */
@@ -41,6 +41,16 @@
  * 2021-05-30     Meco Man     implement rt_mutex_trytake()
  * 2022-01-07     Gabriel      Moving __on_rt_xxxxx_hook to ipc.c
  * 2022-01-24     THEWON       let rt_mutex_take return thread->error when using signal
+ * 2022-02-19     RT-Thread    add rt_sem_take_ns() with sub-tick timeout
+ * 2022-02-20     RT-Thread    add the lock-free fast path of mutex
+ * 2022-02-23     RT-Thread    add zero-copy message queue with the buffers of mempool
+ * 2022-02-24     RT-Thread    add the trace events of semaphore and mutex
+ * 2022-02-24     RT-Thread    add adaptive spinning of semaphore and mutex on SMP
+ * 2022-02-24     RT-Thread    index the threads waiting on event by the bits
+ * 2022-02-24     RT-Thread    keep the event waiters in the suspended list, skip the search by the bits
+ * 2022-02-24     RT-Thread    note the memory order the lock-free mutex relies on
+ * 2022-02-24     RT-Thread    convert the nanoseconds of rt_sem_take_ns() to ticks in 64-bit without hrtimer
+ * 2022-02-24     RT-Thread    relax the cpu in the spinning of semaphore and mutex
  */
 
 #include <rtthread.h>
@@ -453,30 +463,64 @@ RTM_EXPORT(rt_sem_delete);
 #endif /* RT_USING_HEAP */
 
 
+#ifdef RT_USING_IPC_SPIN
+/* the fields written by the other cpus are read from memory once per access */
+#define _IPC_READ_ONCE(type, x)     (*(volatile type *)&(x))
+
 /**
- * @brief    This function will take a semaphore, if the semaphore is unavailable, the thread shall wait for
- *           the semaphore up to a specified time.
+ * @brief   This function will check whether any other cpu is running a thread
+ *          but the idle thread, which may release the object being waited for.
  *
- * @note     When this function is called, the count value of the sem->value will decrease 1 until it is equal to 0.
- *           When the sem->value is 0, it means that the semaphore is unavailable. At this time, it will suspend the
- *           thread preparing to take the semaphore.
- *           On the contrary, the rt_sem_release() function will increase the count value of sem->value by 1 each time.
- *
- * @see      rt_sem_trytake()
- *
- * @param    sem is a pointer to a semaphore object.
- *
- * @param    time is a timeout period (unit: an OS tick). If the semaphore is unavailable, the thread will wait for
- *           the semaphore up to the amount of time specified by the argument.
- *           NOTE: Generally, we use the macro RT_WAITING_FOREVER to set this parameter, which means that when the
- *           semaphore is unavailable, the thread will be waitting forever.
+ * @return  Return RT_TRUE if another cpu is busy.
+ */
+static rt_bool_t _ipc_spin_cpus_busy(void)
+{
+    int cpu, cpu_id = rt_hw_cpu_id();
+
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+    {
+        if (cpu != cpu_id &&
+            _IPC_READ_ONCE(rt_uint8_t, rt_cpu_index(cpu)->current_priority) < RT_THREAD_PRIORITY_MAX - 1)
+        {
+            return RT_TRUE;
+        }
+    }
+
+    return RT_FALSE;
+}
+
+/**
+ * @brief   This function will spin a bounded number of loops on an unavailable
+ *          semaphore before the thread blocks on it, as long as other cpus are
+ *          busy and no thread is waiting in front.
  *
- * @return   Return the operation status. ONLY When the return value is RT_EOK, the operation is successful.
- *           If the return value is any other values, it means that the semaphore take failed.
+ * @param   sem is a pointer to a semaphore object.
+ */
+static void _sem_spin(rt_sem_t sem)
+{
+    rt_uint32_t loop;
+
+    for (loop = 0; loop < RT_IPC_SPIN_LOOPS; loop ++)
+    {
+        if (_IPC_READ_ONCE(rt_uint16_t, sem->value) > 0 ||
+            _IPC_READ_ONCE(rt_list_t *, sem->parent.suspend_thread.next) != &(sem->parent.suspend_thread) ||
+            !_ipc_spin_cpus_busy())
+        {
+            break;
+        }
+
+        rt_hw_cpu_relax();
+    }
+}
+#endif /* RT_USING_IPC_SPIN */
+
+/**
+ * @brief    [internal] The take function of semaphore, the thread waits for ticks of time, or nanoseconds of
+ *           ns on the thread hrtimer when time is RT_WAITING_FOREVER.
  *
- * @warning  This function can ONLY be called in the thread context. It MUST NOT BE called in interrupt context.
+ * @see      rt_sem_take()
  */
-rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
+static rt_err_t _rt_sem_take(rt_sem_t sem, rt_int32_t time, rt_uint64_t ns)
 {
     register rt_base_t temp;
     struct rt_thread *thread;
@@ -486,6 +530,15 @@ rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
     RT_ASSERT(rt_object_get_type(&sem->parent.parent) == RT_Object_Class_Semaphore);
 
     RT_OBJECT_HOOK_CALL(rt_object_trytake_hook, (&(sem->parent.parent)));
+    RT_TRACE_EVENT(RT_TRACE_IPC_TAKE, sem, RT_Object_Class_Semaphore);
+
+#ifdef RT_USING_IPC_SPIN
+    /* the semaphore may be released soon by a thread running on another cpu */
+    if (time != 0 || ns > 0)
+    {
+        _sem_spin(sem);
+    }
+#endif /* RT_USING_IPC_SPIN */
 
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
@@ -544,6 +597,21 @@ rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
                                  &time);
                 rt_timer_start(&(thread->thread_timer));
             }
+#ifdef RT_USING_HRTIMER
+            /* has sub-tick waiting time, start thread hrtimer */
+            else if (ns > 0)
+            {
+                if (rt_hrtimer_start(&(thread->thread_hrtimer), ns) != RT_EOK)
+                {
+                    /* no hrtimer, round up to ticks */
+                    time = (rt_int32_t)rt_hrtimer_ns_to_tick(ns);
+                    rt_timer_control(&(thread->thread_timer),
+                                     RT_TIMER_CTRL_SET_TIME,
+                                     &time);
+                    rt_timer_start(&(thread->thread_timer));
+                }
+            }
+#endif /* RT_USING_HRTIMER */
 
             /* enable interrupt */
             rt_hw_interrupt_enable(temp);
@@ -559,11 +627,63 @@ rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
     }
 
     RT_OBJECT_HOOK_CALL(rt_object_take_hook, (&(sem->parent.parent)));
+    RT_TRACE_EVENT(RT_TRACE_IPC_TAKEN, sem, RT_Object_Class_Semaphore);
 
     return RT_EOK;
 }
+
+/**
+ * @brief    This function will take a semaphore, if the semaphore is unavailable, the thread shall wait for
+ *           the semaphore up to a specified time.
+ *
+ * @note     When this function is called, the count value of the sem->value will decrease 1 until it is equal to 0.
+ *           When the sem->value is 0, it means that the semaphore is unavailable. At this time, it will suspend the
+ *           thread preparing to take the semaphore.
+ *           On the contrary, the rt_sem_release() function will increase the count value of sem->value by 1 each time.
+ *
+ * @see      rt_sem_trytake()
+ *
+ * @param    sem is a pointer to a semaphore object.
+ *
+ * @param    time is a timeout period (unit: an OS tick). If the semaphore is unavailable, the thread will wait for
+ *           the semaphore up to the amount of time specified by the argument.
+ *           NOTE: Generally, we use the macro RT_WAITING_FOREVER to set this parameter, which means that when the
+ *           semaphore is unavailable, the thread will be waitting forever.
+ *
+ * @return   Return the operation status. ONLY When the return value is RT_EOK, the operation is successful.
+ *           If the return value is any other values, it means that the semaphore take failed.
+ *
+ * @warning  This function can ONLY be called in the thread context. It MUST NOT BE called in interrupt context.
+ */
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
+{
+    return _rt_sem_take(sem, time, 0);
+}
 RTM_EXPORT(rt_sem_take);
 
+#ifdef RT_USING_HRTIMER
+/**
+ * @brief    This function will take a semaphore with a timeout in nanoseconds, which is shorter than one
+ *           OS tick or not a multiple of it. The timeout is handled by the thread hrtimer.
+ *
+ * @see      rt_sem_take()
+ *
+ * @param    sem is a pointer to a semaphore object.
+ *
+ * @param    ns is a timeout period (unit: nanosecond), 0 for no waiting.
+ *
+ * @return   Return the operation status. ONLY When the return value is RT_EOK, the operation is successful.
+ *           If the return value is any other values, it means that the semaphore take failed.
+ *
+ * @warning  This function can ONLY be called in the thread context. It MUST NOT BE called in interrupt context.
+ */
+rt_err_t rt_sem_take_ns(rt_sem_t sem, rt_uint64_t ns)
+{
+    return _rt_sem_take(sem, ns > 0 ? RT_WAITING_FOREVER : RT_WAITING_NO, ns);
+}
+RTM_EXPORT(rt_sem_take_ns);
+#endif /* RT_USING_HRTIMER */
+
 
 /**
  * @brief    This function will try to take a semaphore, if the semaphore is unavailable, the thread returns immediately.
@@ -608,6 +728,7 @@ rt_err_t rt_sem_release(rt_sem_t sem)
     RT_ASSERT(rt_object_get_type(&sem->parent.parent) == RT_Object_Class_Semaphore);
 
     RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(sem->parent.parent)));
+    RT_TRACE_EVENT(RT_TRACE_IPC_RELEASE, sem, RT_Object_Class_Semaphore);
 
     need_schedule = RT_FALSE;
 
@@ -709,6 +830,130 @@ RTM_EXPORT(rt_sem_control);
 
 /**@{*/
 
+#ifdef RT_USING_IPC_SPIN
+/**
+ * @brief   This function will spin a bounded number of loops on a mutex held by
+ *          another thread, while the owner is running on another cpu and is
+ *          likely to release it soon. It returns once the mutex is free, or the
+ *          owner is switched out, so the thread blocks only on a long hold.
+ *
+ * @param   mutex is a pointer to a mutex object.
+ *
+ * @param   thread is the thread to take the mutex.
+ */
+static void _mutex_spin(rt_mutex_t mutex, struct rt_thread *thread)
+{
+    struct rt_thread *owner;
+    rt_uint32_t loop;
+
+    for (loop = 0; loop < RT_IPC_SPIN_LOOPS; loop ++)
+    {
+#ifdef RT_USING_HW_ATOMIC
+        owner = (struct rt_thread *)rt_hw_atomic_load((volatile rt_atomic_t *)&(mutex->owner));
+#else
+        owner = _IPC_READ_ONCE(struct rt_thread *, mutex->owner);
+#endif /* RT_USING_HW_ATOMIC */
+        if (owner == RT_NULL || owner == thread ||
+            _IPC_READ_ONCE(rt_uint8_t, owner->oncpu) == RT_CPU_DETACHED)
+        {
+            break;
+        }
+
+        rt_hw_cpu_relax();
+    }
+}
+#endif /* RT_USING_IPC_SPIN */
+
+#ifdef RT_USING_HW_ATOMIC
+/*
+ * The owner of mutex is the atomic lock word. A free mutex is taken by the
+ * compare-and-exchange of the owner from RT_NULL without disabling interrupt,
+ * and released by the exchange of the owner to RT_NULL. The waiters flag is
+ * set in the slow path before a thread tries to take the mutex and suspends,
+ * so the owner sees it after the release and resumes the waiter in the slow
+ * path, where the priority inheritance is handled as well. The exchange of
+ * the owner and the load of the waiters flag (and the store of the flag and
+ * the load of the owner) shall not be reordered, which is guaranteed by the
+ * sequentially consistent rt_hw_atomic_* of the port.
+ */
+
+/**
+ * @brief   This function will try to take a free mutex for the thread.
+ *
+ * @param   mutex is a pointer to a mutex object.
+ *
+ * @param   thread is the thread to take the mutex.
+ *
+ * @return  Return RT_TRUE if the mutex is taken by the thread.
+ */
+static rt_bool_t _mutex_take_free(rt_mutex_t mutex, struct rt_thread *thread)
+{
+    rt_atomic_t owner = 0;
+    /* the priority may be inherited once the owner is set */
+    rt_uint8_t priority = thread->current_priority;
+
+    if (!rt_hw_atomic_compare_exchange_strong((volatile rt_atomic_t *)&(mutex->owner),
+                                              &owner, (rt_atomic_t)thread))
+    {
+        return RT_FALSE;
+    }
+
+    mutex->value             = 0;
+    mutex->original_priority = priority;
+    mutex->hold              = 1;
+
+    return RT_TRUE;
+}
+
+/**
+ * @brief   This function will hand over the released mutex to the first suspended thread,
+ *          it's invoked with interrupt disabled.
+ *
+ * @param   mutex is a pointer to a mutex object.
+ *
+ * @return  Return RT_TRUE if a suspended thread is resumed.
+ */
+static rt_bool_t _mutex_wakeup_waiter(rt_mutex_t mutex)
+{
+    struct rt_thread *thread, *owner;
+    rt_bool_t need_schedule = RT_FALSE;
+
+    if (!rt_list_isempty(&mutex->parent.suspend_thread))
+    {
+        /* get suspended thread */
+        thread = rt_list_entry(mutex->parent.suspend_thread.next,
+                               struct rt_thread,
+                               tlist);
+
+        if (_mutex_take_free(mutex, thread))
+        {
+            RT_DEBUG_LOG(RT_DEBUG_IPC, ("mutex_release: resume thread: %s\n",
+                                        thread->name));
+
+            /* resume thread */
+            _ipc_list_resume(&(mutex->parent.suspend_thread));
+
+            need_schedule = RT_TRUE;
+        }
+        else
+        {
+            /* taken in fast path, the new owner inherits the priority */
+            owner = (struct rt_thread *)rt_hw_atomic_load((volatile rt_atomic_t *)&(mutex->owner));
+            if (owner != RT_NULL && thread->current_priority < owner->current_priority)
+            {
+                rt_thread_control(owner,
+                                  RT_THREAD_CTRL_CHANGE_PRIORITY,
+                                  &thread->current_priority);
+            }
+        }
+    }
+
+    rt_hw_atomic_store(&(mutex->waiters), !rt_list_isempty(&mutex->parent.suspend_thread));
+
+    return need_schedule;
+}
+#endif /* RT_USING_HW_ATOMIC */
+
 /**
  * @brief    Initialize a static mutex object.
  *
@@ -751,6 +996,9 @@ rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag)
     mutex->owner = RT_NULL;
     mutex->original_priority = 0xFF;
     mutex->hold  = 0;
+#ifdef RT_USING_HW_ATOMIC
+    mutex->waiters = 0;
+#endif /* RT_USING_HW_ATOMIC */
 
     /* flag can only be RT_IPC_FLAG_PRIO. RT_IPC_FLAG_FIFO cannot solve the unbounded priority inversion problem */
     mutex->parent.parent.flag = RT_IPC_FLAG_PRIO;
@@ -835,6 +1083,9 @@ rt_mutex_t rt_mutex_create(const char *name, rt_uint8_t flag)
     mutex->owner              = RT_NULL;
     mutex->original_priority  = 0xFF;
     mutex->hold               = 0;
+#ifdef RT_USING_HW_ATOMIC
+    mutex->waiters            = 0;
+#endif /* RT_USING_HW_ATOMIC */
 
     /* flag can only be RT_IPC_FLAG_PRIO. RT_IPC_FLAG_FIFO cannot solve the unbounded priority inversion problem */
     mutex->parent.parent.flag = RT_IPC_FLAG_PRIO;
@@ -922,10 +1173,36 @@ rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
     /* get current thread */
     thread = rt_thread_self();
 
+#ifdef RT_USING_IPC_SPIN
+    /* wait for the owner running on another cpu, rather than blocking at once */
+    if (time != 0)
+    {
+        _mutex_spin(mutex, thread);
+    }
+#endif /* RT_USING_IPC_SPIN */
+
+#ifdef RT_USING_HW_ATOMIC
+    /* fast path, take the free mutex without disabling interrupt */
+    if (_mutex_take_free(mutex, thread))
+    {
+        RT_OBJECT_HOOK_CALL(rt_object_trytake_hook, (&(mutex->parent.parent)));
+        RT_TRACE_EVENT(RT_TRACE_IPC_TAKE, mutex, RT_Object_Class_Mutex);
+
+        /* reset thread error */
+        thread->error = RT_EOK;
+
+        RT_OBJECT_HOOK_CALL(rt_object_take_hook, (&(mutex->parent.parent)));
+        RT_TRACE_EVENT(RT_TRACE_IPC_TAKEN, mutex, RT_Object_Class_Mutex);
+
+        return RT_EOK;
+    }
+#endif /* RT_USING_HW_ATOMIC */
+
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
 
     RT_OBJECT_HOOK_CALL(rt_object_trytake_hook, (&(mutex->parent.parent)));
+    RT_TRACE_EVENT(RT_TRACE_IPC_TAKE, mutex, RT_Object_Class_Mutex);
 
     RT_DEBUG_LOG(RT_DEBUG_IPC,
                  ("mutex_take: current thread %s, mutex value: %d, hold: %d\n",
@@ -949,6 +1226,19 @@ rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
     }
     else
     {
+#ifdef RT_USING_HW_ATOMIC
+        /* the owner shall see the waiter if it releases the mutex after this */
+        if (time != 0)
+        {
+            rt_hw_atomic_store(&(mutex->waiters), 1);
+        }
+
+        if (_mutex_take_free(mutex, thread))
+        {
+            /* no waiter if the mutex is taken */
+            rt_hw_atomic_store(&(mutex->waiters), !rt_list_isempty(&mutex->parent.suspend_thread));
+        }
+#else
         /* The value of mutex is 1 in initial status. Therefore, if the
          * value is great than 0, it indicates the mutex is avaible.
          */
@@ -970,8 +1260,11 @@ rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
                 return -RT_EFULL; /* value overflowed */
             }
         }
+#endif /* RT_USING_HW_ATOMIC */
         else
         {
+            struct rt_thread *owner;
+
             /* no waiting, return with timeout */
             if (time == 0)
             {
@@ -989,11 +1282,18 @@ rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
                 RT_DEBUG_LOG(RT_DEBUG_IPC, ("mutex_take: suspend thread: %s\n",
                                             thread->name));
 
+#ifdef RT_USING_HW_ATOMIC
+                /* the owner may release the mutex in fast path at any time */
+                owner = (struct rt_thread *)rt_hw_atomic_load((volatile rt_atomic_t *)&(mutex->owner));
+#else
+                owner = mutex->owner;
+#endif /* RT_USING_HW_ATOMIC */
+
                 /* change the owner thread priority of mutex */
-                if (thread->current_priority < mutex->owner->current_priority)
+                if (owner != RT_NULL && thread->current_priority < owner->current_priority)
                 {
                     /* change the owner thread priority */
-                    rt_thread_control(mutex->owner,
+                    rt_thread_control(owner,
                                       RT_THREAD_CTRL_CHANGE_PRIORITY,
                                       &thread->current_priority);
                 }
@@ -1042,6 +1342,7 @@ rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
     rt_hw_interrupt_enable(temp);
 
     RT_OBJECT_HOOK_CALL(rt_object_take_hook, (&(mutex->parent.parent)));
+    RT_TRACE_EVENT(RT_TRACE_IPC_TAKEN, mutex, RT_Object_Class_Mutex);
 
     return RT_EOK;
 }
@@ -1087,6 +1388,9 @@ rt_err_t rt_mutex_release(rt_mutex_t mutex)
     register rt_base_t temp;
     struct rt_thread *thread;
     rt_bool_t need_schedule;
+#ifdef RT_USING_HW_ATOMIC
+    rt_uint8_t priority;
+#endif /* RT_USING_HW_ATOMIC */
 
     /* parameter check */
     RT_ASSERT(mutex != RT_NULL);
@@ -1100,6 +1404,52 @@ rt_err_t rt_mutex_release(rt_mutex_t mutex)
     /* get current thread */
     thread = rt_thread_self();
 
+#ifdef RT_USING_HW_ATOMIC
+    RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(mutex->parent.parent)));
+    RT_TRACE_EVENT(RT_TRACE_IPC_RELEASE, mutex, RT_Object_Class_Mutex);
+
+    /* mutex only can be released by owner */
+    if (thread != mutex->owner)
+    {
+        thread->error = -RT_ERROR;
+
+        return -RT_ERROR;
+    }
+
+    /* decrease hold */
+    if (mutex->hold > 1)
+    {
+        mutex->hold --;
+
+        return RT_EOK;
+    }
+
+    /* fast path, release the mutex without disabling interrupt */
+    priority = mutex->original_priority;
+    mutex->hold              = 0;
+    mutex->value             = 1;
+    mutex->original_priority = 0xff;
+    rt_hw_atomic_exchange((volatile rt_atomic_t *)&(mutex->owner), 0);
+
+    if (rt_hw_atomic_load(&(mutex->waiters)) == 0 && thread->current_priority == priority)
+    {
+        return RT_EOK;
+    }
+
+    /* slow path, there are waiters or the priority is inherited */
+    temp = rt_hw_interrupt_disable();
+
+    /* change the owner thread to original priority */
+    if (thread->current_priority != priority)
+    {
+        rt_thread_control(thread,
+                          RT_THREAD_CTRL_CHANGE_PRIORITY,
+                          &priority);
+    }
+
+    /* wakeup suspended thread */
+    need_schedule = _mutex_wakeup_waiter(mutex);
+#else
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
 
@@ -1108,6 +1458,7 @@ rt_err_t rt_mutex_release(rt_mutex_t mutex)
                   thread->name, mutex->value, mutex->hold));
 
     RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(mutex->parent.parent)));
+    RT_TRACE_EVENT(RT_TRACE_IPC_RELEASE, mutex, RT_Object_Class_Mutex);
 
     /* mutex only can be released by owner */
     if (thread != mutex->owner)
@@ -1181,6 +1532,7 @@ rt_err_t rt_mutex_release(rt_mutex_t mutex)
             mutex->original_priority = 0xff;
         }
     }
+#endif /* RT_USING_HW_ATOMIC */
 
     /* enable interrupt */
     rt_hw_interrupt_enable(temp);
@@ -1228,6 +1580,86 @@ RTM_EXPORT(rt_mutex_control);
 
 /**@{*/
 
+/**
+ * @brief    This function will resume the suspended threads of event, which are
+ *           satisfied by the event set, in the order of the suspended list. The
+ *           interrupt shall be disabled.
+ *
+ * @param    event is a pointer to the event object.
+ *
+ * @param    waiting is a pointer to save the union of the sets the threads left in
+ *           the list wait for.
+ *
+ * @param    need_schedule is set to RT_TRUE if any thread is resumed.
+ *
+ * @return   Return RT_EOK, or -RT_EINVAL if a thread waits with a wrong option.
+ */
+static rt_err_t _event_list_wakeup(rt_event_t event, rt_uint32_t *waiting, rt_bool_t *need_schedule)
+{
+    struct rt_list_node *n;
+    struct rt_thread *thread;
+    register rt_base_t status;
+    rt_list_t *list = &(event->parent.suspend_thread);
+
+    *waiting = 0;
+
+    /* search thread list to resume thread */
+    n = list->next;
+    while (n != list)
+    {
+        /* get thread */
+        thread = rt_list_entry(n, struct rt_thread, tlist);
+
+        status = -RT_ERROR;
+        if (thread->event_info & RT_EVENT_FLAG_AND)
+        {
+            if ((thread->event_set & event->set) == thread->event_set)
+            {
+                /* received an AND event */
+                status = RT_EOK;
+            }
+        }
+        else if (thread->event_info & RT_EVENT_FLAG_OR)
+        {
+            if (thread->event_set & event->set)
+            {
+                /* save the received event set */
+                thread->event_set = thread->event_set & event->set;
+
+                /* received an OR event */
+                status = RT_EOK;
+            }
+        }
+        else
+        {
+            return -RT_EINVAL;
+        }
+
+        /* move node to the next */
+        n = n->next;
+
+        /* condition is satisfied, resume thread */
+        if (status == RT_EOK)
+        {
+            /* clear event */
+            if (thread->event_info & RT_EVENT_FLAG_CLEAR)
+                event->set &= ~thread->event_set;
+
+            /* resume thread, and thread list breaks out */
+            rt_thread_resume(thread);
+
+            /* need do a scheduling */
+            *need_schedule = RT_TRUE;
+        }
+        else
+        {
+            *waiting |= thread->event_set;
+        }
+    }
+
+    return RT_EOK;
+}
+
 /**
  * @brief    The function will initialize a static event object.
  *
@@ -1276,6 +1708,9 @@ rt_err_t rt_event_init(rt_event_t event, const char *name, rt_uint8_t flag)
 
     /* initialize ipc object */
     _ipc_object_init(&(event->parent));
+#ifdef RT_USING_EVENT_INDEX
+    event->wait_set = 0;
+#endif /* RT_USING_EVENT_INDEX */
 
     /* initialize event */
     event->set = 0;
@@ -1367,6 +1802,9 @@ rt_event_t rt_event_create(const char *name, rt_uint8_t flag)
 
     /* initialize ipc object */
     _ipc_object_init(&(event->parent));
+#ifdef RT_USING_EVENT_INDEX
+    event->wait_set = 0;
+#endif /* RT_USING_EVENT_INDEX */
 
     /* initialize event */
     event->set = 0;
@@ -1434,11 +1872,10 @@ RTM_EXPORT(rt_event_delete);
  */
 rt_err_t rt_event_send(rt_event_t event, rt_uint32_t set)
 {
-    struct rt_list_node *n;
-    struct rt_thread *thread;
     register rt_ubase_t level;
-    register rt_base_t status;
+    rt_err_t result;
     rt_bool_t need_schedule;
+    rt_uint32_t waiting;
 
     /* parameter check */
     RT_ASSERT(event != RT_NULL);
@@ -1448,6 +1885,7 @@ rt_err_t rt_event_send(rt_event_t event, rt_uint32_t set)
         return -RT_ERROR;
 
     need_schedule = RT_FALSE;
+    result = RT_EOK;
 
     /* disable interrupt */
     level = rt_hw_interrupt_disable();
@@ -1457,65 +1895,28 @@ rt_err_t rt_event_send(rt_event_t event, rt_uint32_t set)
 
     RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(event->parent.parent)));
 
-    if (!rt_list_isempty(&event->parent.suspend_thread))
+#ifdef RT_USING_EVENT_INDEX
+    /*
+     * The threads are searched in the order of the suspended list (FIFO or
+     * priority) only if any of them waits for the bits sent, the union of the
+     * sets waited is shrunk to the threads left by the search. A thread gone
+     * by timeout leaves a wider union until then, which only costs a search.
+     */
+    if (event->wait_set & set)
     {
-        /* search thread list to resume thread */
-        n = event->parent.suspend_thread.next;
-        while (n != &(event->parent.suspend_thread))
-        {
-            /* get thread */
-            thread = rt_list_entry(n, struct rt_thread, tlist);
-
-            status = -RT_ERROR;
-            if (thread->event_info & RT_EVENT_FLAG_AND)
-            {
-                if ((thread->event_set & event->set) == thread->event_set)
-                {
-                    /* received an AND event */
-                    status = RT_EOK;
-                }
-            }
-            else if (thread->event_info & RT_EVENT_FLAG_OR)
-            {
-                if (thread->event_set & event->set)
-                {
-                    /* save the received event set */
-                    thread->event_set = thread->event_set & event->set;
-
-                    /* received an OR event */
-                    status = RT_EOK;
-                }
-            }
-            else
-            {
-                /* enable interrupt */
-                rt_hw_interrupt_enable(level);
-
-                return -RT_EINVAL;
-            }
-
-            /* move node to the next */
-            n = n->next;
-
-            /* condition is satisfied, resume thread */
-            if (status == RT_EOK)
-            {
-                /* clear event */
-                if (thread->event_info & RT_EVENT_FLAG_CLEAR)
-                    event->set &= ~thread->event_set;
-
-                /* resume thread, and thread list breaks out */
-                rt_thread_resume(thread);
-
-                /* need do a scheduling */
-                need_schedule = RT_TRUE;
-            }
-        }
+        result = _event_list_wakeup(event, &waiting, &need_schedule);
+        event->wait_set = waiting;
     }
+#else
+    result = _event_list_wakeup(event, &waiting, &need_schedule);
+#endif /* RT_USING_EVENT_INDEX */
 
     /* enable interrupt */
     rt_hw_interrupt_enable(level);
 
+    if (result != RT_EOK)
+        return result;
+
     /* do a schedule */
     if (need_schedule == RT_TRUE)
         rt_schedule();
@@ -1640,6 +2041,9 @@ rt_err_t rt_event_recv(rt_event_t   event,
         _ipc_list_suspend(&(event->parent.suspend_thread),
                             thread,
                             event->parent.parent.flag);
+#ifdef RT_USING_EVENT_INDEX
+        event->wait_set |= set;
+#endif /* RT_USING_EVENT_INDEX */
 
         /* if there is a waiting timeout, active thread timer */
         if (timeout > 0)
@@ -1710,6 +2114,9 @@ rt_err_t rt_event_control(rt_event_t event, int cmd, void *arg)
 
         /* resume all waiting thread */
         _ipc_list_resume_all(&event->parent.suspend_thread);
+#ifdef RT_USING_EVENT_INDEX
+        event->wait_set = 0;
+#endif /* RT_USING_EVENT_INDEX */
 
         /* initialize event set */
         event->set = 0;
@@ -2429,6 +2836,75 @@ struct rt_mq_message
 };
 
 
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+/*
+ * The buffer of zero-copy message queue is a block of the attached memory
+ * pool with the reference count ahead of it, only the buffer pointer is
+ * passed through the message queue.
+ */
+struct rt_mq_buffer
+{
+    rt_atomic_t ref;                                    /**< reference count of buffer */
+};
+
+#define _MQ_BUFFER_HEAD(buffer) \
+    ((struct rt_mq_buffer *)((rt_uint8_t *)(buffer) - RT_MQ_BUFFER_HEADER_SIZE))
+
+rt_inline rt_atomic_t _mq_buffer_ref_add(struct rt_mq_buffer *head, rt_atomic_t val)
+{
+#ifdef RT_USING_HW_ATOMIC
+    return rt_hw_atomic_add(&(head->ref), val);
+#else
+    register rt_base_t level;
+    rt_atomic_t ref;
+
+    level = rt_hw_interrupt_disable();
+    ref = head->ref;
+    head->ref = ref + val;
+    rt_hw_interrupt_enable(level);
+
+    return ref;
+#endif /* RT_USING_HW_ATOMIC */
+}
+
+/**
+ * @brief    Release the buffers of all the messages in a zero-copy message
+ *           queue, the messages are put back to the free list.
+ *
+ * @param    mq is a pointer to the messagequeue object.
+ */
+static void _mq_buffer_release_all(rt_mq_t mq)
+{
+    register rt_base_t level;
+    struct rt_mq_message *msg;
+
+    if (mq->buffer_pool == RT_NULL)
+    {
+        return;
+    }
+
+    level = rt_hw_interrupt_disable();
+    while (mq->msg_queue_head != RT_NULL)
+    {
+        msg = (struct rt_mq_message *)mq->msg_queue_head;
+        mq->msg_queue_head = msg->next;
+        if (mq->msg_queue_tail == msg)
+            mq->msg_queue_tail = RT_NULL;
+        if (mq->entry > 0)
+            mq->entry --;
+        rt_hw_interrupt_enable(level);
+
+        /* it may resume the threads waiting on the memory pool */
+        rt_mq_buffer_release(*(void **)(msg + 1));
+
+        level = rt_hw_interrupt_disable();
+        msg->next = (struct rt_mq_message *)mq->msg_queue_free;
+        mq->msg_queue_free = msg;
+    }
+    rt_hw_interrupt_enable(level);
+}
+#endif /* RT_USING_MESSAGEQUEUE_ZEROCOPY */
+
 /**
  * @brief    Initialize a static messagequeue object.
  *
@@ -2521,6 +2997,10 @@ rt_err_t rt_mq_init(rt_mq_t     mq,
     /* initialize an additional list of sender suspend thread */
     rt_list_init(&(mq->suspend_sender_thread));
 
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+    mq->buffer_pool = RT_NULL;
+#endif /* RT_USING_MESSAGEQUEUE_ZEROCOPY */
+
     return RT_EOK;
 }
 RTM_EXPORT(rt_mq_init);
@@ -2551,6 +3031,10 @@ rt_err_t rt_mq_detach(rt_mq_t mq)
     RT_ASSERT(rt_object_get_type(&mq->parent.parent) == RT_Object_Class_MessageQueue);
     RT_ASSERT(rt_object_is_systemobject(&mq->parent.parent));
 
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+    _mq_buffer_release_all(mq);
+#endif /* RT_USING_MESSAGEQUEUE_ZEROCOPY */
+
     /* resume all suspended thread */
     _ipc_list_resume_all(&mq->parent.suspend_thread);
     /* also resume all message queue private suspended thread */
@@ -2688,6 +3172,10 @@ rt_err_t rt_mq_delete(rt_mq_t mq)
 
     RT_DEBUG_NOT_IN_INTERRUPT;
 
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+    _mq_buffer_release_all(mq);
+#endif /* RT_USING_MESSAGEQUEUE_ZEROCOPY */
+
     /* resume all suspended thread */
     _ipc_list_resume_all(&(mq->parent.suspend_thread));
     /* also resume all message queue private suspended thread */
@@ -3223,6 +3711,11 @@ rt_err_t rt_mq_control(rt_mq_t mq, int cmd, void *arg)
 
     if (cmd == RT_IPC_CMD_RESET)
     {
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+        /* the queued buffers are dropped */
+        _mq_buffer_release_all(mq);
+#endif /* RT_USING_MESSAGEQUEUE_ZEROCOPY */
+
         /* disable interrupt */
         level = rt_hw_interrupt_disable();
 
@@ -3263,6 +3756,189 @@ rt_err_t rt_mq_control(rt_mq_t mq, int cmd, void *arg)
 }
 RTM_EXPORT(rt_mq_control);
 
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+/**
+ * @brief    This function will attach a memory pool to a messagequeue object, so
+ *           that the messagequeue passes the buffers of the memory pool instead
+ *           of copying the messages.
+ *
+ * @note     The message size of the messagequeue shall be able to hold a pointer,
+ *           and each buffer can hold (block size - RT_MQ_BUFFER_HEADER_SIZE) bytes.
+ *
+ * @param    mq is a pointer to the messagequeue object.
+ *
+ * @param    mp is a pointer to the memory pool object of the buffers.
+ *
+ * @return   Return the operation status. When the return value is RT_EOK, the operation is successful.
+ *           If the return value is -RT_ERROR, the messagequeue or the memory pool is too small.
+ */
+rt_err_t rt_mq_attach_mempool(rt_mq_t mq, rt_mp_t mp)
+{
+    /* parameter check */
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(rt_object_get_type(&mq->parent.parent) == RT_Object_Class_MessageQueue);
+    RT_ASSERT(mp != RT_NULL);
+
+    if (mq->msg_size < sizeof(void *) || mp->block_size <= RT_MQ_BUFFER_HEADER_SIZE)
+    {
+        return -RT_ERROR;
+    }
+
+    mq->buffer_pool = mp;
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_mq_attach_mempool);
+
+/**
+ * @brief    This function will allocate a buffer from the memory pool attached to
+ *           the messagequeue, the reference count of the buffer is 1.
+ *
+ * @param    mq is a pointer to the messagequeue object.
+ *
+ * @param    timeout is a timeout period (unit: an OS tick) to wait for a free buffer.
+ *
+ * @return   Return the buffer, or RT_NULL if there is no free buffer before timeout.
+ */
+void *rt_mq_buffer_alloc(rt_mq_t mq, rt_int32_t timeout)
+{
+    struct rt_mq_buffer *head;
+
+    /* parameter check */
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(mq->buffer_pool != RT_NULL);
+
+    head = (struct rt_mq_buffer *)rt_mp_alloc(mq->buffer_pool, timeout);
+    if (head == RT_NULL)
+    {
+        return RT_NULL;
+    }
+    head->ref = 1;
+
+    return (rt_uint8_t *)head + RT_MQ_BUFFER_HEADER_SIZE;
+}
+RTM_EXPORT(rt_mq_buffer_alloc);
+
+/**
+ * @brief    This function will take one more reference of a buffer, e.g. to send
+ *           the same buffer to another messagequeue.
+ *
+ * @param    buffer is the buffer allocated by rt_mq_buffer_alloc().
+ */
+void rt_mq_buffer_ref(void *buffer)
+{
+    RT_ASSERT(buffer != RT_NULL);
+
+    _mq_buffer_ref_add(_MQ_BUFFER_HEAD(buffer), 1);
+}
+RTM_EXPORT(rt_mq_buffer_ref);
+
+/**
+ * @brief    This function will drop one reference of a buffer, the buffer is put
+ *           back to its memory pool when the last reference is dropped.
+ *
+ * @param    buffer is the buffer allocated by rt_mq_buffer_alloc().
+ *
+ * @warning  This function can be called in interrupt context and thread context.
+ */
+void rt_mq_buffer_release(void *buffer)
+{
+    struct rt_mq_buffer *head;
+
+    RT_ASSERT(buffer != RT_NULL);
+
+    head = _MQ_BUFFER_HEAD(buffer);
+    RT_ASSERT(head->ref > 0);
+
+    if (_mq_buffer_ref_add(head, -1) == 1)
+    {
+        rt_mp_free(head);
+    }
+}
+RTM_EXPORT(rt_mq_buffer_release);
+
+/**
+ * @brief    This function will send a buffer to the zero-copy messagequeue object,
+ *           the reference of the caller is passed to the receiver.
+ *
+ * @note     It's the same as rt_mq_send_wait() except that only the buffer pointer is
+ *           queued. On failure, the caller still owns the buffer.
+ *
+ * @param    mq is a pointer to the messagequeue object to be sent.
+ *
+ * @param    buffer is the buffer allocated by rt_mq_buffer_alloc().
+ *
+ * @param    timeout is a timeout period (unit: an OS tick).
+ *
+ * @return   Return the operation status. When the return value is RT_EOK, the operation is successful.
+ *           If the return value is -RT_EFULL or any other values, the buffer is not sent.
+ *
+ * @warning  This function can be called in interrupt context and thread context.
+ */
+rt_err_t rt_mq_send_buffer_wait(rt_mq_t mq, void *buffer, rt_int32_t timeout)
+{
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(mq->buffer_pool != RT_NULL);
+    RT_ASSERT(buffer != RT_NULL);
+
+    return rt_mq_send_wait(mq, &buffer, sizeof(buffer), timeout);
+}
+RTM_EXPORT(rt_mq_send_buffer_wait);
+
+/**
+ * @brief    This function will send a buffer to the zero-copy messagequeue object
+ *           without waiting.
+ *
+ * @see      rt_mq_send_buffer_wait()
+ */
+rt_err_t rt_mq_send_buffer(rt_mq_t mq, void *buffer)
+{
+    return rt_mq_send_buffer_wait(mq, buffer, 0);
+}
+RTM_EXPORT(rt_mq_send_buffer);
+
+/**
+ * @brief    This function will send an urgent buffer to the head of the zero-copy
+ *           messagequeue object.
+ *
+ * @see      rt_mq_urgent()
+ */
+rt_err_t rt_mq_urgent_buffer(rt_mq_t mq, void *buffer)
+{
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(mq->buffer_pool != RT_NULL);
+    RT_ASSERT(buffer != RT_NULL);
+
+    return rt_mq_urgent(mq, &buffer, sizeof(buffer));
+}
+RTM_EXPORT(rt_mq_urgent_buffer);
+
+/**
+ * @brief    This function will receive a buffer from the zero-copy messagequeue
+ *           object, the receiver shall release the buffer by rt_mq_buffer_release().
+ *
+ * @see      rt_mq_recv()
+ *
+ * @param    mq is a pointer to the messagequeue object to be received.
+ *
+ * @param    buffer is used to return the received buffer.
+ *
+ * @param    timeout is a timeout period (unit: an OS tick).
+ *
+ * @return   Return the operation status. When the return value is RT_EOK, the operation is successful.
+ *           If the return value is any other values, no buffer is received.
+ */
+rt_err_t rt_mq_recv_buffer(rt_mq_t mq, void **buffer, rt_int32_t timeout)
+{
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(mq->buffer_pool != RT_NULL);
+    RT_ASSERT(buffer != RT_NULL);
+
+    return rt_mq_recv(mq, buffer, sizeof(*buffer), timeout);
+}
+RTM_EXPORT(rt_mq_recv_buffer);
+#endif /* RT_USING_MESSAGEQUEUE_ZEROCOPY */
+
 /**@}*/
 #endif /* RT_USING_MESSAGEQUEUE */
 
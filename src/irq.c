@@ -11,6 +11,8 @@
  * 2018-11-22     Jesven       rt_interrupt_get_nest function add disable irq
  * 2021-08-15     Supperthomas fix the comment
  * 2022-01-07     Gabriel      Moving __on_rt_xxxxx_hook to irq.c
+ * 2022-02-24     RT-Thread    account the interrupt time of threads
+ * 2022-02-24     RT-Thread    add the trace events of interrupt
  */
 
 #include <rthw.h>
@@ -65,10 +67,47 @@ void rt_interrupt_leave_sethook(void (*hook)(void))
 
 #ifdef RT_USING_SMP
 #define rt_interrupt_nest rt_cpu_self()->irq_nest
+/* the nest counter is per cpu, masking local interrupt is enough */
+#define _irq_nest_lock()            rt_hw_local_irq_disable()
+#define _irq_nest_unlock(level)     rt_hw_local_irq_enable(level)
 #else
 volatile rt_uint8_t rt_interrupt_nest = 0;
+#define _irq_nest_lock()            rt_hw_interrupt_disable()
+#define _irq_nest_unlock(level)     rt_hw_interrupt_enable(level)
 #endif /* RT_USING_SMP */
 
+#ifdef RT_USING_CPU_USAGE
+#ifdef RT_USING_SMP
+#define _irq_stamp rt_cpu_self()->irq_stamp
+#else
+static rt_uint64_t _irq_stamp;
+#endif /* RT_USING_SMP */
+
+/*
+ * the time of interrupts is charged to the thread running when the outermost
+ * interrupt leaves, and taken out of its running time.
+ */
+static void _irq_usage_leave(void)
+{
+    rt_uint64_t now = rt_thread_usage_clock();
+    struct rt_thread *thread = rt_thread_self();
+
+    if (thread != RT_NULL)
+    {
+        thread->usage.irq_time += now - _irq_stamp;
+        if (thread->usage.stamp < _irq_stamp)
+        {
+            thread->usage.stamp += now - _irq_stamp;
+        }
+        else
+        {
+            /* switched in during the interrupt */
+            thread->usage.stamp = now;
+        }
+    }
+}
+#endif /* RT_USING_CPU_USAGE */
+
 
 /**
  * @brief This function will be invoked by BSP, when enter interrupt service routine
@@ -81,10 +120,17 @@ void rt_interrupt_enter(void)
 {
     rt_base_t level;
 
-    level = rt_hw_interrupt_disable();
+    level = _irq_nest_lock();
     rt_interrupt_nest ++;
+#ifdef RT_USING_CPU_USAGE
+    if (rt_interrupt_nest == 1)
+    {
+        _irq_stamp = rt_thread_usage_clock();
+    }
+#endif /* RT_USING_CPU_USAGE */
+    RT_TRACE_EVENT(RT_TRACE_IRQ_ENTER, rt_interrupt_nest, 0);
     RT_OBJECT_HOOK_CALL(rt_interrupt_enter_hook,());
-    rt_hw_interrupt_enable(level);
+    _irq_nest_unlock(level);
 
     RT_DEBUG_LOG(RT_DEBUG_IRQ, ("irq has come..., irq current nest:%d\n",
                                 rt_interrupt_nest));
@@ -106,10 +152,17 @@ void rt_interrupt_leave(void)
     RT_DEBUG_LOG(RT_DEBUG_IRQ, ("irq is going to leave, irq current nest:%d\n",
                                 rt_interrupt_nest));
 
-    level = rt_hw_interrupt_disable();
+    level = _irq_nest_lock();
     RT_OBJECT_HOOK_CALL(rt_interrupt_leave_hook,());
+    RT_TRACE_EVENT(RT_TRACE_IRQ_LEAVE, rt_interrupt_nest, 0);
+#ifdef RT_USING_CPU_USAGE
+    if (rt_interrupt_nest == 1)
+    {
+        _irq_usage_leave();
+    }
+#endif /* RT_USING_CPU_USAGE */
     rt_interrupt_nest --;
-    rt_hw_interrupt_enable(level);
+    _irq_nest_unlock(level);
 }
 RTM_EXPORT(rt_interrupt_leave);
 
@@ -127,9 +180,9 @@ RT_WEAK rt_uint8_t rt_interrupt_get_nest(void)
     rt_uint8_t ret;
     rt_base_t level;
 
-    level = rt_hw_interrupt_disable();
+    level = _irq_nest_lock();
     ret = rt_interrupt_nest;
-    rt_hw_interrupt_enable(level);
+    _irq_nest_unlock(level);
     return ret;
 }
 RTM_EXPORT(rt_interrupt_get_nest);
@@ -20,6 +20,9 @@
  * 2021-02-28     Meco Man     add RT_KSERVICE_USING_STDLIB
  * 2021-12-20     Meco Man     implement rt_strcpy()
  * 2022-01-07     Gabriel      add __on_rt_assert_hook
+ * 2022-02-21     RT-Thread    allocate small blocks from slab magazines without heap lock
+ * 2022-02-22     RT-Thread    add TLSF as system heap
+ * 2022-02-24     RT-Thread    make rt_memcmp weak for the memory operations of cpu
  */
 
 #include <rtthread.h>
@@ -342,7 +345,7 @@ RTM_EXPORT(rt_memmove);
  *         If the result > 0, cs is greater than ct.
  *         If the result = 0, cs is equal to ct.
  */
-rt_int32_t rt_memcmp(const void *cs, const void *ct, rt_size_t count)
+RT_WEAK rt_int32_t rt_memcmp(const void *cs, const void *ct, rt_size_t count)
 {
     const unsigned char *su1, *su2;
     int res = 0;
@@ -1439,6 +1442,27 @@ rt_inline void _slab_info(rt_size_t *total,
 #define _MEM_FREE(_ptr) \
     rt_slab_free(system_heap, _ptr)
 #define _MEM_INFO       _slab_info
+#elif defined(RT_USING_TLSF_AS_HEAP)
+static rt_tlsf_t system_heap;
+rt_inline void _tlsf_info(rt_size_t *total,
+    rt_size_t *used, rt_size_t *max_used)
+{
+    if (total)
+        *total = system_heap->total;
+    if (used)
+        *used = system_heap->used;
+    if (max_used)
+        *max_used = system_heap->max;
+}
+#define _MEM_INIT(_name, _start, _size) \
+    system_heap = rt_tlsf_init(_name, _start, _size)
+#define _MEM_MALLOC(_size)  \
+    rt_tlsf_alloc(system_heap, _size)
+#define _MEM_REALLOC(_ptr, _newsize)    \
+    rt_tlsf_realloc(system_heap, _ptr, _newsize)
+#define _MEM_FREE(_ptr) \
+    rt_tlsf_free(system_heap, _ptr)
+#define _MEM_INFO       _tlsf_info
 #else
 #define _MEM_INIT(...)
 #define _MEM_MALLOC(...)     RT_NULL
@@ -1479,12 +1503,19 @@ RT_WEAK void *rt_malloc(rt_size_t size)
     rt_base_t level;
     void *ptr;
 
-    /* Enter critical zone */
-    level = _heap_lock();
-    /* allocate memory block from system heap */
-    ptr = _MEM_MALLOC(size);
-    /* Exit critical zone */
-    _heap_unlock(level);
+#ifdef RT_USING_SLAB_MAGAZINE
+    /* allocate memory block from the magazines of this cpu */
+    ptr = rt_slab_magazine_alloc(system_heap, size);
+    if (ptr == RT_NULL)
+#endif /* RT_USING_SLAB_MAGAZINE */
+    {
+        /* Enter critical zone */
+        level = _heap_lock();
+        /* allocate memory block from system heap */
+        ptr = _MEM_MALLOC(size);
+        /* Exit critical zone */
+        _heap_unlock(level);
+    }
     /* call 'rt_malloc' hook */
     RT_OBJECT_HOOK_CALL(rt_malloc_hook, (ptr, size));
     return ptr;
@@ -1555,6 +1586,11 @@ RT_WEAK void rt_free(void *rmem)
 
     /* call 'rt_free' hook */
     RT_OBJECT_HOOK_CALL(rt_free_hook, (rmem));
+#ifdef RT_USING_SLAB_MAGAZINE
+    /* release memory block to the magazines of this cpu */
+    if (rt_slab_magazine_free(system_heap, rmem) == RT_EOK)
+        return;
+#endif /* RT_USING_SLAB_MAGAZINE */
     /* Enter critical zone */
     level = _heap_lock();
     _MEM_FREE(rmem);
@@ -12,6 +12,8 @@
  * 2010-10-14     Bernard      fix rt_realloc issue when realloc a NULL pointer.
  * 2017-07-14     armink       fix rt_realloc issue when new size is 0
  * 2018-10-02     Bernard      Add 64bit support
+ * 2022-02-22     RT-Thread    skip the memory objects of other algorithms in memcheck
+ * 2022-02-24     RT-Thread    check and trace the tlsf objects in memcheck and memtrace
  */
 
 /*
@@ -501,6 +503,11 @@ RTM_EXPORT(rt_smem_free);
 #include <finsh.h>
 
 #ifdef RT_USING_MEMTRACE
+#ifdef RT_USING_TLSF
+int tlsfcheck(int argc, char *argv[]);
+int tlsftrace(int argc, char **argv);
+#endif /* RT_USING_TLSF */
+
 int memcheck(int argc, char *argv[])
 {
     int position;
@@ -526,6 +533,9 @@ int memcheck(int argc, char *argv[])
             continue;
         /* mem object */
         m = (struct rt_small_mem *)object;
+        /* the other memory algorithms have their own commands */
+        if (rt_strcmp(m->parent.algorithm, "small") != 0)
+            continue;
         /* check mem */
         for (mem = (struct rt_small_mem_item *)m->heap_ptr; mem != m->heap_end; mem = (struct rt_small_mem_item *)&m->heap_ptr[mem->next])
         {
@@ -537,7 +547,12 @@ int memcheck(int argc, char *argv[])
     }
     rt_hw_interrupt_enable(level);
 
+#ifdef RT_USING_TLSF
+    /* the tlsf objects are walked by the checker of tlsf */
+    return tlsfcheck(argc, argv);
+#else
     return 0;
+#endif /* RT_USING_TLSF */
 __exit:
     rt_kprintf("Memory block wrong:\n");
     rt_kprintf("   name: %s\n", m->parent.parent.name);
@@ -572,6 +587,9 @@ int memtrace(int argc, char **argv)
             continue;
         /* mem object */
         m = (struct rt_small_mem *)object;
+        /* the other memory algorithms have their own commands */
+        if (rt_strcmp(m->parent.algorithm, "small") != 0)
+            continue;
         /* show memory information */
         rt_kprintf("\nmemory heap address:\n");
         rt_kprintf("name    : %s\n", m->parent.parent.name);
@@ -601,7 +619,13 @@ int memtrace(int argc, char **argv)
                 rt_kprintf("\n");
         }
     }
+
+#ifdef RT_USING_TLSF
+    /* the tlsf objects are dumped by the tracer of tlsf */
+    return tlsftrace(argc, argv);
+#else
     return 0;
+#endif /* RT_USING_TLSF */
 }
 MSH_CMD_EXPORT(memtrace, dump memory trace information);
 #endif /* RT_USING_MEMTRACE */
@@ -14,6 +14,9 @@
  * 2017-12-10     Bernard      Add object_info enum.
  * 2018-01-25     Bernard      Fix the object find issue when enable MODULE.
  * 2022-01-07     Gabriel      Moving __on_rt_xxxxx_hook to object.c
+ * 2022-02-23     RT-Thread    add the name hash index for rt_object_find
+ * 2022-02-24     RT-Thread    add rt_object_attach for the thread cache
+ * 2022-02-24     RT-Thread    add rt_object_set_name to rename the hashed object
  */
 
 #include <rtthread.h>
@@ -366,6 +369,86 @@ int rt_object_get_pointers(enum rt_object_class_type type, rt_object_t *pointers
 }
 RTM_EXPORT(rt_object_get_pointers);
 
+#ifdef RT_USING_OBJECT_HASH
+/*
+ * The hash index has its own lock, the lookup doesn't lock the scheduler or
+ * the other cpus, and it's never held while taking another lock.
+ */
+#ifdef RT_USING_SMP
+static rt_hw_spinlock_t _object_hash_spinlock;
+#endif /* RT_USING_SMP */
+
+rt_inline rt_base_t _object_hash_lock(void)
+{
+#ifdef RT_USING_SMP
+    rt_base_t level;
+
+    level = rt_hw_local_irq_disable();
+    rt_hw_spin_lock(&_object_hash_spinlock);
+
+    return level;
+#else
+    return rt_hw_interrupt_disable();
+#endif /* RT_USING_SMP */
+}
+
+rt_inline void _object_hash_unlock(rt_base_t level)
+{
+#ifdef RT_USING_SMP
+    rt_hw_spin_unlock(&_object_hash_spinlock);
+    rt_hw_local_irq_enable(level);
+#else
+    rt_hw_interrupt_enable(level);
+#endif /* RT_USING_SMP */
+}
+
+/*
+ * Get the hash bucket of the name, only the first RT_NAME_MAX characters
+ * are used as the object name is truncated to them.
+ */
+rt_inline rt_slist_t *_object_hash_bucket(struct rt_object_information *information,
+                                          const char *name)
+{
+    rt_uint32_t hash = 5381;
+    int index;
+
+    for (index = 0; index < RT_NAME_MAX && name[index] != '\0'; index ++)
+    {
+        hash = (hash << 5) + hash + (rt_uint8_t)name[index];
+    }
+
+    return &(information->hash_list[hash % RT_OBJECT_HASH_SIZE]);
+}
+
+static void _object_hash_insert(struct rt_object_information *information,
+                                struct rt_object *object)
+{
+    rt_slist_t *bucket;
+    rt_base_t level;
+
+    bucket = _object_hash_bucket(information, object->name);
+
+    level = _object_hash_lock();
+    /* the latest object is found first, the same as the object list */
+    rt_slist_insert(bucket, &(object->hash));
+    _object_hash_unlock(level);
+}
+
+static void _object_hash_remove(struct rt_object_information *information,
+                                struct rt_object *object)
+{
+    rt_slist_t *bucket;
+    rt_base_t level;
+
+    bucket = _object_hash_bucket(information, object->name);
+
+    level = _object_hash_lock();
+    /* nothing is done for the objects of modules, they are not indexed */
+    rt_slist_remove(bucket, &(object->hash));
+    _object_hash_unlock(level);
+}
+#endif /* RT_USING_OBJECT_HASH */
+
 /**
  * @brief This function will initialize an object and add it to object system
  *        management.
@@ -433,6 +516,9 @@ void rt_object_init(struct rt_object         *object,
     {
         /* insert object into information object list */
         rt_list_insert_after(&(information->object_list), &(object->list)); // 插入
+#ifdef RT_USING_OBJECT_HASH
+        _object_hash_insert(information, object);
+#endif /* RT_USING_OBJECT_HASH */
     }
 
     /* unlock interrupt */
@@ -448,12 +534,19 @@ void rt_object_init(struct rt_object         *object,
 void rt_object_detach(rt_object_t object)
 {
     register rt_base_t temp;
+#ifdef RT_USING_OBJECT_HASH
+    struct rt_object_information *information;
+#endif /* RT_USING_OBJECT_HASH */
 
     /* object check */
     RT_ASSERT(object != RT_NULL);
 
     RT_OBJECT_HOOK_CALL(rt_object_detach_hook, (object)); // 调用 rt_object_detach_hook 函数
 
+#ifdef RT_USING_OBJECT_HASH
+    information = rt_object_get_information((enum rt_object_class_type)rt_object_get_type(object));
+#endif /* RT_USING_OBJECT_HASH */
+
     /* reset object type */
     object->type = 0;
 
@@ -462,6 +555,9 @@ void rt_object_detach(rt_object_t object)
 
     /* remove from old list */
     rt_list_remove(&(object->list)); // 从全局 object manger 中删除
+#ifdef RT_USING_OBJECT_HASH
+    _object_hash_remove(information, object);
+#endif /* RT_USING_OBJECT_HASH */
 
     /* unlock interrupt */
     rt_hw_interrupt_enable(temp); // 开中断
@@ -469,39 +565,28 @@ void rt_object_detach(rt_object_t object)
 
 #ifdef RT_USING_HEAP
 /**
- * @brief This function will allocate an object from object system.
+ * @brief This function will attach a dynamic object to object system, the memory
+ *        of object is given by the caller and it's not freed by rt_object_detach.
+ *
+ * @param object is the zeroed object to be attached, which is of the object size
+ *        of its type.
  *
  * @param type is the type of object.
  *
  * @param name is the object name. In system, the object's name must be unique.
- *
- * @return object
  */
-rt_object_t rt_object_allocate(enum rt_object_class_type type, const char *name)
+void rt_object_attach(rt_object_t object, enum rt_object_class_type type, const char *name)
 {
-    struct rt_object *object;
     register rt_base_t temp;
     struct rt_object_information *information;
 #ifdef RT_USING_MODULE
     struct rt_dlmodule *module = dlmodule_self();
 #endif /* RT_USING_MODULE */
 
-    RT_DEBUG_NOT_IN_INTERRUPT;
-
     /* get object information */
     information = rt_object_get_information(type);
     RT_ASSERT(information != RT_NULL);
 
-    object = (struct rt_object *)RT_KERNEL_MALLOC(information->object_size);
-    if (object == RT_NULL)
-    {
-        /* no memory can be allocated */
-        return RT_NULL;
-    }
-
-    /* clean memory data of object */
-    rt_memset(object, 0x0, information->object_size);
-
     /* initialize object's parameters */
 
     /* set object type */
@@ -529,10 +614,46 @@ rt_object_t rt_object_allocate(enum rt_object_class_type type, const char *name)
     {
         /* insert object into information object list */
         rt_list_insert_after(&(information->object_list), &(object->list));
+#ifdef RT_USING_OBJECT_HASH
+        _object_hash_insert(information, object);
+#endif /* RT_USING_OBJECT_HASH */
     }
 
     /* unlock interrupt */
     rt_hw_interrupt_enable(temp);
+}
+
+/**
+ * @brief This function will allocate an object from object system.
+ *
+ * @param type is the type of object.
+ *
+ * @param name is the object name. In system, the object's name must be unique.
+ *
+ * @return object
+ */
+rt_object_t rt_object_allocate(enum rt_object_class_type type, const char *name)
+{
+    struct rt_object *object;
+    struct rt_object_information *information;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    /* get object information */
+    information = rt_object_get_information(type);
+    RT_ASSERT(information != RT_NULL);
+
+    object = (struct rt_object *)RT_KERNEL_MALLOC(information->object_size);
+    if (object == RT_NULL)
+    {
+        /* no memory can be allocated */
+        return RT_NULL;
+    }
+
+    /* clean memory data of object */
+    rt_memset(object, 0x0, information->object_size);
+
+    rt_object_attach(object, type, name);
 
     /* return object */
     return object;
@@ -546,6 +667,9 @@ rt_object_t rt_object_allocate(enum rt_object_class_type type, const char *name)
 void rt_object_delete(rt_object_t object)
 {
     register rt_base_t temp;
+#ifdef RT_USING_OBJECT_HASH
+    struct rt_object_information *information;
+#endif /* RT_USING_OBJECT_HASH */
 
     /* object check */
     RT_ASSERT(object != RT_NULL);
@@ -553,6 +677,10 @@ void rt_object_delete(rt_object_t object)
 
     RT_OBJECT_HOOK_CALL(rt_object_detach_hook, (object));
 
+#ifdef RT_USING_OBJECT_HASH
+    information = rt_object_get_information((enum rt_object_class_type)rt_object_get_type(object));
+#endif /* RT_USING_OBJECT_HASH */
+
     /* reset object type */
     object->type = RT_Object_Class_Null;
 
@@ -561,6 +689,9 @@ void rt_object_delete(rt_object_t object)
 
     /* remove from old list */
     rt_list_remove(&(object->list));
+#ifdef RT_USING_OBJECT_HASH
+    _object_hash_remove(information, object);
+#endif /* RT_USING_OBJECT_HASH */
 
     /* unlock interrupt */
     rt_hw_interrupt_enable(temp);
@@ -608,6 +739,56 @@ rt_uint8_t rt_object_get_type(rt_object_t object)
     // 把 RT_Object_Class_Static 位统一设置为0
 }
 
+/**
+ * @brief This function will change the name of object. The object is filed
+ *        under its new name, so it can be found by rt_object_find after that.
+ *
+ * @param object is the specified object to be renamed.
+ *
+ * @param name is the new name of object.
+ */
+void rt_object_set_name(rt_object_t object, const char *name)
+{
+    register rt_base_t temp;
+#ifdef RT_USING_OBJECT_HASH
+    struct rt_object_information *information;
+    rt_bool_t hashed = RT_TRUE;
+#endif /* RT_USING_OBJECT_HASH */
+
+    /* object check */
+    RT_ASSERT(object != RT_NULL);
+    RT_ASSERT(name != RT_NULL);
+
+#ifdef RT_USING_OBJECT_HASH
+    information = rt_object_get_information((enum rt_object_class_type)rt_object_get_type(object));
+    RT_ASSERT(information != RT_NULL);
+#ifdef RT_USING_MODULE
+    /* the objects of modules are not indexed */
+    hashed = (object->module_id == RT_NULL);
+#endif /* RT_USING_MODULE */
+#endif /* RT_USING_OBJECT_HASH */
+
+    /* lock interrupt */
+    temp = rt_hw_interrupt_disable();
+
+#ifdef RT_USING_OBJECT_HASH
+    if (hashed)
+    {
+        _object_hash_remove(information, object);
+    }
+#endif /* RT_USING_OBJECT_HASH */
+    rt_strncpy(object->name, name, RT_NAME_MAX);
+#ifdef RT_USING_OBJECT_HASH
+    if (hashed)
+    {
+        _object_hash_insert(information, object);
+    }
+#endif /* RT_USING_OBJECT_HASH */
+
+    /* unlock interrupt */
+    rt_hw_interrupt_enable(temp);
+}
+
 /**
  * @brief This function will find specified name object from object
  *        container.
@@ -624,8 +805,13 @@ rt_uint8_t rt_object_get_type(rt_object_t object)
 rt_object_t rt_object_find(const char *name, rt_uint8_t type)
 {
     struct rt_object *object = RT_NULL;
-    struct rt_list_node *node = RT_NULL;
     struct rt_object_information *information = RT_NULL;
+#ifdef RT_USING_OBJECT_HASH
+    rt_slist_t *bucket, *hash_node;
+    rt_base_t level;
+#else
+    struct rt_list_node *node = RT_NULL;
+#endif /* RT_USING_OBJECT_HASH */
 
     information = rt_object_get_information((enum rt_object_class_type)type);
 
@@ -635,6 +821,24 @@ rt_object_t rt_object_find(const char *name, rt_uint8_t type)
     /* which is invoke in interrupt status */
     RT_DEBUG_NOT_IN_INTERRUPT;
 
+#ifdef RT_USING_OBJECT_HASH
+    bucket = _object_hash_bucket(information, name);
+
+    level = _object_hash_lock();
+    rt_slist_for_each(hash_node, bucket)
+    {
+        object = rt_slist_entry(hash_node, struct rt_object, hash);
+        if (rt_strncmp(object->name, name, RT_NAME_MAX) == 0)
+        {
+            _object_hash_unlock(level);
+
+            return object;
+        }
+    }
+    _object_hash_unlock(level);
+
+    return RT_NULL;
+#else
     /* enter critical */
     rt_enter_critical();
 
@@ -655,6 +859,7 @@ rt_object_t rt_object_find(const char *name, rt_uint8_t type)
     rt_exit_critical();
 
     return RT_NULL;
+#endif /* RT_USING_OBJECT_HASH */
 }
 
 /**@}*/
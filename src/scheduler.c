@@ -28,6 +28,14 @@
  *                             in smp version, rt_hw_context_switch_interrupt maybe switch to
  *                             new task directly
  * 2022-01-07     Gabriel      Moving __on_rt_xxxxx_hook to scheduler.c
+ * 2022-02-14     RT-Thread    keep unbound threads in per cpu ready queues with
+ *                             their own locks, pull work from busy cpus
+ * 2022-02-24     RT-Thread    account the cpu usage of threads in switches
+ * 2022-02-24     RT-Thread    add the trace events of switch and wakeup
+ * 2022-02-24     RT-Thread    add the earliest deadline first class
+ * 2022-02-24     RT-Thread    sample the stack high-water mark and move the stack guard in switches
+ * 2022-02-24     RT-Thread    coalesce the schedule IPIs of remote wakeups
+ * 2022-02-24     RT-Thread    call the hooks and logs of switches out of the ready queue lock
  */
 
 #include <rtthread.h>
@@ -126,44 +134,474 @@ static void _rt_scheduler_stack_check(struct rt_thread *thread)
 }
 #endif /* RT_USING_OVERFLOW_CHECK */
 
+#if defined(RT_USING_STACK_WATERMARK) || defined(RT_USING_HW_STACK_GUARD)
 /*
- * get the highest priority thread in ready queue
+ * the stack of the thread to be switched in: its high-water mark is updated by
+ * the stack pointer saved when it was switched out and a bounded scan, then the
+ * guard is moved onto its end
  */
+static void _scheduler_stack_switch(struct rt_thread *to_thread)
+{
+#ifdef RT_USING_STACK_WATERMARK
+    rt_thread_stack_watermark(to_thread, RT_STACK_WATERMARK_SCAN);
+#endif /* RT_USING_STACK_WATERMARK */
+#ifdef RT_USING_HW_STACK_GUARD
+    rt_hw_stack_guard_switch(to_thread);
+#endif /* RT_USING_HW_STACK_GUARD */
+}
+#else
+#define _scheduler_stack_switch(to_thread)
+#endif /* defined(RT_USING_STACK_WATERMARK) || defined(RT_USING_HW_STACK_GUARD) */
+
+#ifdef RT_USING_CPU_USAGE
+/*
+ * account the running time of the thread switched out since it was switched
+ * in, and the waiting time of the thread switched in since it was ready.
+ */
+static void _scheduler_usage_switch(struct rt_thread *from, struct rt_thread *to, rt_bool_t voluntary, rt_uint64_t now)
+{
+    from->usage.run_time += now - from->usage.stamp;
+    from->usage.stamp = now;
+    if (voluntary)
+    {
+        from->usage.voluntary_switches ++;
+    }
+    else
+    {
+        from->usage.involuntary_switches ++;
+    }
+
+    to->usage.wait_time += now - to->usage.stamp;
+    to->usage.stamp = now;
+}
+#endif /* RT_USING_CPU_USAGE */
+
+#ifdef RT_USING_SCHED_EDF
+/* whether the absolute deadline of thread a is earlier than the one of b */
+#define _EDF_BEFORE(a, b)   ((rt_int32_t)((a)->edf.abs_deadline - (b)->edf.abs_deadline) < 0)
+
+/*
+ * insert a thread to a ready queue. The threads of deadline class are kept in
+ * the order of their absolute deadlines, ahead of the others of same priority.
+ */
+static void _scheduler_queue_insert(rt_list_t *queue, struct rt_thread *thread)
+{
+    rt_list_t *node = queue;
+    struct rt_thread *entry;
+
+    if (thread->edf.stat & RT_THREAD_EDF_ACTIVE)
+    {
+        for (node = queue->next; node != queue; node = node->next)
+        {
+            entry = rt_list_entry(node, struct rt_thread, tlist);
+            if (!(entry->edf.stat & RT_THREAD_EDF_ACTIVE) || _EDF_BEFORE(thread, entry))
+            {
+                break;
+            }
+        }
+    }
+
+    rt_list_insert_before(node, &(thread->tlist));
+}
+
+/*
+ * whether the ready thread preempts the running thread of the same priority,
+ * which is only true for an earlier deadline.
+ */
+static rt_bool_t _scheduler_edf_preempt(struct rt_thread *current_thread, struct rt_thread *thread)
+{
+    if (!(thread->edf.stat & RT_THREAD_EDF_ACTIVE))
+    {
+        return RT_FALSE;
+    }
+
+    return !(current_thread->edf.stat & RT_THREAD_EDF_ACTIVE) || _EDF_BEFORE(thread, current_thread);
+}
+
+/*
+ * the rule of constant bandwidth server when a suspended thread wakes up: a
+ * new period begins if the deadline has passed, or the budget left would use
+ * more than the reserved bandwidth before the deadline.
+ */
+static void _scheduler_edf_wakeup(struct rt_thread *thread)
+{
+    rt_tick_t now, left;
+
+    if (!(thread->edf.stat & RT_THREAD_EDF_ACTIVE) ||
+        (thread->stat & RT_THREAD_STAT_MASK) != RT_THREAD_SUSPEND)
+    {
+        return;
+    }
+
+    now  = rt_tick_get();
+    left = thread->edf.abs_deadline - now;
+    if ((rt_int32_t)left <= 0 ||
+        (rt_uint64_t)thread->edf.budget * thread->edf.period > (rt_uint64_t)left * thread->edf.runtime)
+    {
+        thread->edf.abs_deadline = now + thread->edf.deadline;
+        thread->edf.budget = thread->edf.runtime;
+    }
+}
+#else
+#define _scheduler_queue_insert(queue, thread)          rt_list_insert_before(queue, &((thread)->tlist))
+#define _scheduler_edf_preempt(current_thread, thread)  RT_FALSE
+#define _scheduler_edf_wakeup(thread)
+#endif /* RT_USING_SCHED_EDF */
+
 #ifdef RT_USING_SMP
-static struct rt_thread* _scheduler_get_highest_priority_thread(rt_ubase_t *highest_prio)
+/*
+ * Every cpu owns a ready queue (pcpu->priority_table) protected by its own
+ * spinlock, so making a thread ready or picking the next thread only contends
+ * with the cpus touching the same queue. The queue lock of the switching cpu
+ * is held across the context switch and released in rt_scheduler_switch_finish()
+ * once the context of the previous thread has been saved.
+ *
+ * Lock order: _cpus_lock (rt_hw_interrupt_disable) is taken before any queue
+ * lock, and two queue locks are taken in the order of cpu index. Nothing that
+ * may take _cpus_lock, such as the hooks, rt_kprintf and the clock drivers,
+ * is called with a queue lock held: the clock is read before the lock, and
+ * the hooks and logs of a switch run after rt_scheduler_switch_finish().
+ */
+static rt_hw_spinlock_t _cpu_rq_lock[RT_CPUS_NR];
+
+/* the thread switched out by each cpu, detached when the switch is finished */
+static struct rt_thread *_cpu_prev_thread[RT_CPUS_NR];
+/* the thread stolen by each cpu, logged after the queue lock is released */
+static struct rt_thread *_cpu_stolen_thread[RT_CPUS_NR];
+
+#ifdef RT_USING_CPU_USAGE
+#define _scheduler_usage_clock()    rt_thread_usage_clock()
+#else
+#define _scheduler_usage_clock()    0
+#endif /* RT_USING_CPU_USAGE */
+
+static void _rq_enqueue(struct rt_cpu *pcpu, struct rt_thread *thread)
 {
-    register struct rt_thread *highest_priority_thread;
-    register rt_ubase_t highest_ready_priority, local_highest_ready_priority;
-    struct rt_cpu* pcpu = rt_cpu_self();
+#if RT_THREAD_PRIORITY_MAX > 32
+    pcpu->ready_table[thread->number] |= thread->high_mask;
+#endif /* RT_THREAD_PRIORITY_MAX > 32 */
+    pcpu->priority_group |= thread->number_mask;
+
+    _scheduler_queue_insert(&(pcpu->priority_table[thread->current_priority]), thread);
+}
+
+static void _rq_dequeue(struct rt_cpu *pcpu, struct rt_thread *thread)
+{
+    rt_list_remove(&(thread->tlist));
+    if (rt_list_isempty(&(pcpu->priority_table[thread->current_priority])))
+    {
+#if RT_THREAD_PRIORITY_MAX > 32
+        pcpu->ready_table[thread->number] &= ~thread->high_mask;
+        if (pcpu->ready_table[thread->number] == 0)
+        {
+            pcpu->priority_group &= ~thread->number_mask;
+        }
+#else
+        pcpu->priority_group &= ~thread->number_mask;
+#endif /* RT_THREAD_PRIORITY_MAX > 32 */
+    }
+}
+
+/*
+ * get the highest ready priority of a cpu, RT_THREAD_PRIORITY_MAX when the
+ * ready queue is empty. It may be used without the queue lock as a hint.
+ */
+static rt_ubase_t _rq_highest_priority(struct rt_cpu *pcpu)
+{
+    rt_uint32_t priority_group = pcpu->priority_group;
 #if RT_THREAD_PRIORITY_MAX > 32
     register rt_ubase_t number;
+#endif /* RT_THREAD_PRIORITY_MAX > 32 */
 
-    number = __rt_ffs(rt_thread_ready_priority_group) - 1;
-    highest_ready_priority = (number << 3) + __rt_ffs(rt_thread_ready_table[number]) - 1;
-    number = __rt_ffs(pcpu->priority_group) - 1;
-    local_highest_ready_priority = (number << 3) + __rt_ffs(pcpu->ready_table[number]) - 1;
+    if (priority_group == 0)
+    {
+        return RT_THREAD_PRIORITY_MAX;
+    }
+
+#if RT_THREAD_PRIORITY_MAX > 32
+    number = __rt_ffs(priority_group) - 1;
+    return (number << 3) + __rt_ffs(pcpu->ready_table[number]) - 1;
 #else
-    highest_ready_priority = __rt_ffs(rt_thread_ready_priority_group) - 1;
-    local_highest_ready_priority = __rt_ffs(pcpu->priority_group) - 1;
+    return __rt_ffs(priority_group) - 1;
 #endif /* RT_THREAD_PRIORITY_MAX > 32 */
+}
+
+static struct rt_thread* _scheduler_get_highest_priority_thread(struct rt_cpu *pcpu, rt_ubase_t *highest_prio)
+{
+    register rt_ubase_t highest_ready_priority;
+
+    highest_ready_priority = _rq_highest_priority(pcpu);
+    *highest_prio = highest_ready_priority;
 
     /* get highest ready priority thread */
-    if (highest_ready_priority < local_highest_ready_priority)
+    return rt_list_entry(pcpu->priority_table[highest_ready_priority].next,
+                         struct rt_thread,
+                         tlist);
+}
+
+/*
+ * the priority the cpu will run without help from other cpus
+ */
+static rt_ubase_t _scheduler_local_priority(struct rt_cpu *pcpu, struct rt_thread *current_thread)
+{
+    rt_ubase_t priority;
+
+    priority = _rq_highest_priority(pcpu);
+    if ((current_thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_RUNNING &&
+        current_thread->current_priority < priority)
+    {
+        priority = current_thread->current_priority;
+    }
+
+    return priority;
+}
+
+/*
+ * move one unbound ready thread, which has a higher priority than anything
+ * the local cpu would run, from the ready queue of victim to the local one.
+ * Both queue locks are held by the caller.
+ */
+static void _scheduler_steal_thread(int victim, int cpu_id, struct rt_thread *current_thread)
+{
+    rt_ubase_t priority, local_priority;
+    struct rt_cpu *pcpu = rt_cpu_index(cpu_id);
+    struct rt_cpu *vcpu = rt_cpu_index(victim);
+    struct rt_thread *thread;
+    rt_list_t *node;
+
+    local_priority = _scheduler_local_priority(pcpu, current_thread);
+
+    for (priority = _rq_highest_priority(vcpu); priority < local_priority; priority ++)
+    {
+        rt_list_for_each(node, &(vcpu->priority_table[priority]))
+        {
+            thread = rt_list_entry(node, struct rt_thread, tlist);
+            if (thread->bind_cpu == RT_CPUS_NR && thread->oncpu == RT_CPU_DETACHED)
+            {
+                _rq_dequeue(vcpu, thread);
+                thread->ready_cpu = cpu_id;
+                _rq_enqueue(pcpu, thread);
+                _cpu_stolen_thread[cpu_id] = thread;
+                return;
+            }
+        }
+    }
+}
+
+/*
+ * lock the ready queue of the local cpu. If another cpu has queued a thread
+ * with a higher priority than the local cpu is going to run, pull it over
+ * first, so idle or underloaded cpus take work from busy ones.
+ */
+static void _scheduler_lock_and_pull(int cpu_id, struct rt_thread *current_thread)
+{
+    int cpu, index, victim = -1;
+    rt_ubase_t priority, remote_priority;
+
+    /* a lock-free peek, the decision is checked again under the locks */
+    priority = _scheduler_local_priority(rt_cpu_index(cpu_id), current_thread);
+    for (index = 1; index < RT_CPUS_NR; index ++)
+    {
+        cpu = (cpu_id + index) % RT_CPUS_NR;
+
+        remote_priority = _rq_highest_priority(rt_cpu_index(cpu));
+        if (remote_priority < priority)
+        {
+            priority = remote_priority;
+            victim = cpu;
+        }
+    }
+
+    if (victim < 0)
+    {
+        rt_hw_spin_lock(&_cpu_rq_lock[cpu_id]);
+        return;
+    }
+
+    /* take the two queue locks in cpu index order */
+    if (victim < cpu_id)
     {
-        *highest_prio = highest_ready_priority;
-        highest_priority_thread = rt_list_entry(rt_thread_priority_table[highest_ready_priority].next,
-                                  struct rt_thread,
-                                  tlist);
+        rt_hw_spin_lock(&_cpu_rq_lock[victim]);
+        rt_hw_spin_lock(&_cpu_rq_lock[cpu_id]);
     }
     else
     {
-        *highest_prio = local_highest_ready_priority;
-        highest_priority_thread = rt_list_entry(pcpu->priority_table[local_highest_ready_priority].next,
-                                  struct rt_thread,
-                                  tlist);
+        rt_hw_spin_lock(&_cpu_rq_lock[cpu_id]);
+        rt_hw_spin_lock(&_cpu_rq_lock[victim]);
     }
 
-    return highest_priority_thread;
+    _scheduler_steal_thread(victim, cpu_id, current_thread);
+
+    rt_hw_spin_unlock(&_cpu_rq_lock[victim]);
+}
+
+/*
+ * select the next thread of the local cpu with its ready queue locked, now is
+ * the usage clock read before the lock.
+ *
+ * @return the thread to switch to, or RT_NULL if current thread keeps running.
+ */
+static struct rt_thread *_scheduler_next_thread(int cpu_id, struct rt_thread *current_thread, rt_uint64_t now)
+{
+    rt_ubase_t highest_ready_priority;
+    struct rt_thread *to_thread;
+    struct rt_cpu *pcpu = rt_cpu_index(cpu_id);
+#ifdef RT_USING_CPU_USAGE
+    /* the thread blocked gives up cpu by itself */
+    rt_bool_t voluntary = (current_thread->stat & RT_THREAD_STAT_MASK) != RT_THREAD_RUNNING;
+#endif /* RT_USING_CPU_USAGE */
+
+    if (pcpu->priority_group == 0)
+    {
+        return RT_NULL;
+    }
+
+    to_thread = _scheduler_get_highest_priority_thread(pcpu, &highest_ready_priority);
+    if ((current_thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_RUNNING)
+    {
+        if (current_thread->current_priority < highest_ready_priority)
+        {
+            to_thread = current_thread;
+        }
+        else if (current_thread->current_priority == highest_ready_priority && (current_thread->stat & RT_THREAD_STAT_YIELD_MASK) == 0 &&
+                 !_scheduler_edf_preempt(current_thread, to_thread))
+        {
+            to_thread = current_thread;
+        }
+        else
+        {
+            /* put current thread back to the local ready queue */
+            current_thread->stat = RT_THREAD_READY | (current_thread->stat & ~RT_THREAD_STAT_MASK);
+            current_thread->ready_cpu = cpu_id;
+            _rq_enqueue(pcpu, current_thread);
+        }
+        current_thread->stat &= ~RT_THREAD_STAT_YIELD_MASK;
+    }
+
+    if (to_thread == current_thread)
+    {
+        pcpu->current_priority = current_thread->current_priority;
+        return RT_NULL;
+    }
+
+    _rq_dequeue(pcpu, to_thread);
+    to_thread->oncpu = cpu_id;
+    to_thread->stat = RT_THREAD_RUNNING | (to_thread->stat & ~RT_THREAD_STAT_MASK);
+    pcpu->current_priority = (rt_uint8_t)highest_ready_priority;
+#ifdef RT_USING_CPU_USAGE
+    _scheduler_usage_switch(current_thread, to_thread, voluntary, now);
+#else
+    RT_UNUSED(now);
+#endif /* RT_USING_CPU_USAGE */
+
+    /* current thread is detached after its context is saved */
+    _cpu_prev_thread[cpu_id] = current_thread;
+
+    return to_thread;
+}
+
+/*
+ * the work of a scheduling which may take the cpus lock, it's done with the
+ * ready queue of the local cpu unlocked. from_thread is RT_NULL if there is
+ * no switch.
+ */
+static void _scheduler_switch_notify(int cpu_id, struct rt_thread *from_thread, struct rt_thread *to_thread)
+{
+    struct rt_cpu *pcpu = rt_cpu_index(cpu_id);
+
+    if (_cpu_stolen_thread[cpu_id] != RT_NULL)
+    {
+        RT_DEBUG_LOG(RT_DEBUG_SCHEDULER, ("cpu%d steal thread[%.*s]\n",
+                                          cpu_id, RT_NAME_MAX, _cpu_stolen_thread[cpu_id]->name));
+        _cpu_stolen_thread[cpu_id] = RT_NULL;
+    }
+
+    if (from_thread == RT_NULL)
+    {
+        return;
+    }
+
+    RT_OBJECT_HOOK_CALL(rt_scheduler_hook, (from_thread, to_thread));
+    RT_TRACE_EVENT(RT_TRACE_SWITCH, from_thread, to_thread);
+
+    RT_DEBUG_LOG(RT_DEBUG_SCHEDULER,
+            ("[%d]switch to priority#%d "
+             "thread:%.*s(sp:0x%08x), "
+             "from thread:%.*s(sp: 0x%08x)\n",
+             pcpu->irq_nest, pcpu->current_priority,
+             RT_NAME_MAX, to_thread->name, to_thread->sp,
+             RT_NAME_MAX, from_thread->name, from_thread->sp));
+
+#ifdef RT_USING_OVERFLOW_CHECK
+    _rt_scheduler_stack_check(to_thread);
+#endif /* RT_USING_OVERFLOW_CHECK */
+
+    RT_OBJECT_HOOK_CALL(rt_scheduler_switch_hook, (from_thread));
+}
+
+/**
+ * @brief This function is invoked by the context switch routine after the context
+ *        of the previous thread is saved. It detaches the previous thread from
+ *        current cpu and unlocks the ready queue of current cpu, then calls the
+ *        scheduler hooks of the switch in the context of the new thread.
+ *
+ * @param pcpu is the current cpu.
+ *
+ * @note  Please do not invoke this function in user application.
+ */
+void rt_scheduler_switch_finish(struct rt_cpu *pcpu)
+{
+    int cpu_id = pcpu - rt_cpu_index(0);
+    struct rt_thread *from_thread = _cpu_prev_thread[cpu_id];
+
+    if (from_thread != RT_NULL)
+    {
+        from_thread->oncpu = RT_CPU_DETACHED;
+        _cpu_prev_thread[cpu_id] = RT_NULL;
+    }
+
+    rt_hw_spin_unlock(&_cpu_rq_lock[cpu_id]);
+
+    _scheduler_switch_notify(cpu_id, from_thread, pcpu->current_thread);
+}
+
+/*
+ * select the cpu whose ready queue an unbound thread is inserted to: the cpu
+ * it ran on last if it preempts the thread running there, otherwise the cpu
+ * running the lowest priority thread.
+ */
+static int _scheduler_select_cpu(struct rt_thread *thread, int cpu_id)
+{
+    int cpu, target;
+    rt_uint8_t lowest_priority;
+
+    if (thread->bind_cpu != RT_CPUS_NR)
+    {
+        return thread->bind_cpu;
+    }
+
+    target = thread->ready_cpu;
+    if (target == RT_CPUS_NR)
+    {
+        target = cpu_id;
+    }
+
+    lowest_priority = rt_cpu_index(target)->current_priority;
+    if (thread->current_priority < lowest_priority)
+    {
+        return target;
+    }
+
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+    {
+        if (rt_cpu_index(cpu)->current_priority > lowest_priority)
+        {
+            lowest_priority = rt_cpu_index(cpu)->current_priority;
+            target = cpu;
+        }
+    }
+
+    return target;
 }
 #else
 static struct rt_thread* _scheduler_get_highest_priority_thread(rt_ubase_t *highest_prio)
@@ -222,6 +660,10 @@ void rt_system_scheduler_init(void)
         }
 
         pcpu->irq_switch_flag = 0;
+        pcpu->ipi_pending = 0;
+        pcpu->ipi_sent = 0;
+        pcpu->ipi_coalesced = 0;
+        pcpu->ipi_received = 0;
         pcpu->current_priority = RT_THREAD_PRIORITY_MAX - 1;
         pcpu->current_thread = RT_NULL;
         pcpu->priority_group = 0;
@@ -229,6 +671,9 @@ void rt_system_scheduler_init(void)
 #if RT_THREAD_PRIORITY_MAX > 32
         rt_memset(pcpu->ready_table, 0, sizeof(pcpu->ready_table));
 #endif /* RT_THREAD_PRIORITY_MAX > 32 */
+
+        rt_hw_spin_lock_init(&_cpu_rq_lock[cpu]);
+        _cpu_prev_thread[cpu] = RT_NULL;
     }
 #endif /* RT_USING_SMP */
 
@@ -249,22 +694,47 @@ void rt_system_scheduler_start(void)
 {
     register struct rt_thread *to_thread;
     rt_ubase_t highest_ready_priority;
+#ifdef RT_USING_SMP
+    int cpu_id = rt_hw_cpu_id();
+    struct rt_cpu *pcpu = rt_cpu_index(cpu_id);
+    rt_uint64_t now = _scheduler_usage_clock();
 
-    to_thread = _scheduler_get_highest_priority_thread(&highest_ready_priority);
+    /* released by rt_scheduler_switch_finish() */
+    rt_hw_spin_lock(&_cpu_rq_lock[cpu_id]);
 
-#ifdef RT_USING_SMP
-    to_thread->oncpu = rt_hw_cpu_id();
+    to_thread = _scheduler_get_highest_priority_thread(pcpu, &highest_ready_priority);
+    to_thread->oncpu = cpu_id;
+    pcpu->current_priority = (rt_uint8_t)highest_ready_priority;
+
+    _rq_dequeue(pcpu, to_thread);
+    to_thread->stat = RT_THREAD_RUNNING;
+#ifdef RT_USING_CPU_USAGE
+    to_thread->usage.stamp = now;
+#else
+    RT_UNUSED(now);
+#endif /* RT_USING_CPU_USAGE */
+
+    /* the cpus lock taken by the boot code is not carried into the first thread */
+    rt_hw_spin_unlock(&_cpus_lock);
+
+    _scheduler_stack_switch(to_thread);
+
+    /* switch to new thread */
+    rt_hw_context_switch_to((rt_ubase_t)&to_thread->sp, to_thread);
 #else
+    to_thread = _scheduler_get_highest_priority_thread(&highest_ready_priority);
+
     rt_current_thread = to_thread;
-#endif /* RT_USING_SMP */
 
     rt_schedule_remove_thread(to_thread);
     to_thread->stat = RT_THREAD_RUNNING;
+#ifdef RT_USING_CPU_USAGE
+    to_thread->usage.stamp = rt_thread_usage_clock();
+#endif /* RT_USING_CPU_USAGE */
+
+    _scheduler_stack_switch(to_thread);
 
     /* switch to new thread */
-#ifdef RT_USING_SMP
-    rt_hw_context_switch_to((rt_ubase_t)&to_thread->sp, to_thread);
-#else
     rt_hw_context_switch_to((rt_ubase_t)&to_thread->sp);
 #endif /* RT_USING_SMP */
 
@@ -290,12 +760,15 @@ void rt_system_scheduler_start(void)
  */
 void rt_scheduler_ipi_handler(int vector, void *param)
 {
+    rt_cpu_self()->ipi_received ++;
+
     rt_schedule();
 }
 
 /**
  * @brief This function will perform one scheduling. It will select one thread
- *        with the highest priority level in global ready queue or local ready queue,
+ *        with the highest priority level in the ready queue of current cpu,
+ *        pulling a higher priority thread from other cpus if there is one,
  *        then switch to it.
  */
 void rt_schedule(void)
@@ -306,8 +779,8 @@ void rt_schedule(void)
     struct rt_cpu    *pcpu;
     int cpu_id;
 
-    /* disable interrupt */
-    level  = rt_hw_interrupt_disable();
+    /* disable local interrupt, the ready queue is protected by its own lock */
+    level  = rt_hw_local_irq_disable();
 
     cpu_id = rt_hw_cpu_id();
     pcpu   = rt_cpu_index(cpu_id);
@@ -317,7 +790,7 @@ void rt_schedule(void)
     if (pcpu->irq_nest)
     {
         pcpu->irq_switch_flag = 1;
-        rt_hw_interrupt_enable(level);
+        rt_hw_local_irq_enable(level);
         goto __exit;
     }
 
@@ -333,82 +806,53 @@ void rt_schedule(void)
     }
 #endif /* RT_USING_SIGNALS */
 
-    if (current_thread->scheduler_lock_nest == 1) /* whether lock scheduler */
+    if (current_thread->scheduler_lock_nest == 0) /* whether lock scheduler */
     {
-        rt_ubase_t highest_ready_priority;
-
-        if (rt_thread_ready_priority_group != 0 || pcpu->priority_group != 0)
-        {
-            to_thread = _scheduler_get_highest_priority_thread(&highest_ready_priority);
-            current_thread->oncpu = RT_CPU_DETACHED;
-            if ((current_thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_RUNNING)
-            {
-                if (current_thread->current_priority < highest_ready_priority)
-                {
-                    to_thread = current_thread;
-                }
-                else if (current_thread->current_priority == highest_ready_priority && (current_thread->stat & RT_THREAD_STAT_YIELD_MASK) == 0)
-                {
-                    to_thread = current_thread;
-                }
-                else
-                {
-                    rt_schedule_insert_thread(current_thread);
-                }
-                current_thread->stat &= ~RT_THREAD_STAT_YIELD_MASK;
-            }
-            to_thread->oncpu = cpu_id;
-            if (to_thread != current_thread)
-            {
-                /* if the destination thread is not the same as current thread */
-                pcpu->current_priority = (rt_uint8_t)highest_ready_priority;
+        rt_uint64_t now = _scheduler_usage_clock();
 
-                RT_OBJECT_HOOK_CALL(rt_scheduler_hook, (current_thread, to_thread));
-
-                rt_schedule_remove_thread(to_thread);
-                to_thread->stat = RT_THREAD_RUNNING | (to_thread->stat & ~RT_THREAD_STAT_MASK);
+        _scheduler_lock_and_pull(cpu_id, current_thread);
+        /* the threads queued by other cpus are seen now */
+        pcpu->ipi_pending = 0;
 
-                /* switch to new thread */
-                RT_DEBUG_LOG(RT_DEBUG_SCHEDULER,
-                        ("[%d]switch to priority#%d "
-                         "thread:%.*s(sp:0x%08x), "
-                         "from thread:%.*s(sp: 0x%08x)\n",
-                         pcpu->irq_nest, highest_ready_priority,
-                         RT_NAME_MAX, to_thread->name, to_thread->sp,
-                         RT_NAME_MAX, current_thread->name, current_thread->sp));
-
-#ifdef RT_USING_OVERFLOW_CHECK
-                _rt_scheduler_stack_check(to_thread);
-#endif /* RT_USING_OVERFLOW_CHECK */
-
-                RT_OBJECT_HOOK_CALL(rt_scheduler_switch_hook, (current_thread));
+        to_thread = _scheduler_next_thread(cpu_id, current_thread, now);
+        if (to_thread != RT_NULL)
+        {
+            _scheduler_stack_switch(to_thread);
 
-                rt_hw_context_switch((rt_ubase_t)&current_thread->sp,
-                        (rt_ubase_t)&to_thread->sp, to_thread); // libcpu 实现
-            }
+            /* switch to new thread, the hooks are called when it's finished */
+            rt_hw_context_switch((rt_ubase_t)&current_thread->sp,
+                    (rt_ubase_t)&to_thread->sp, to_thread);
+        }
+        else
+        {
+            rt_hw_spin_unlock(&_cpu_rq_lock[cpu_id]);
+            _scheduler_switch_notify(cpu_id, RT_NULL, RT_NULL);
         }
     }
 
     /* enable interrupt */
-    rt_hw_interrupt_enable(level);
+    rt_hw_local_irq_enable(level);
 
 #ifdef RT_USING_SIGNALS
     /* check stat of thread for signal */
-    level = rt_hw_interrupt_disable();
     if (current_thread->stat & RT_THREAD_STAT_SIGNAL_PENDING)
     {
         extern void rt_thread_handle_sig(rt_bool_t clean_state);
 
-        current_thread->stat &= ~RT_THREAD_STAT_SIGNAL_PENDING;
+        level = rt_hw_interrupt_disable();
+        if (current_thread->stat & RT_THREAD_STAT_SIGNAL_PENDING)
+        {
+            current_thread->stat &= ~RT_THREAD_STAT_SIGNAL_PENDING;
 
-        rt_hw_interrupt_enable(level);
+            rt_hw_interrupt_enable(level);
 
-        /* check signal status */
-        rt_thread_handle_sig(RT_TRUE);
-    }
-    else
-    {
-        rt_hw_interrupt_enable(level);
+            /* check signal status */
+            rt_thread_handle_sig(RT_TRUE);
+        }
+        else
+        {
+            rt_hw_interrupt_enable(level);
+        }
     }
 #endif /* RT_USING_SIGNALS */
 
@@ -447,7 +891,8 @@ void rt_schedule(void)
                 {
                     to_thread = rt_current_thread;
                 }
-                else if (rt_current_thread->current_priority == highest_ready_priority && (rt_current_thread->stat & RT_THREAD_STAT_YIELD_MASK) == 0)
+                else if (rt_current_thread->current_priority == highest_ready_priority && (rt_current_thread->stat & RT_THREAD_STAT_YIELD_MASK) == 0 &&
+                         !_scheduler_edf_preempt(rt_current_thread, to_thread))
                 {
                     to_thread = rt_current_thread;
                 }
@@ -464,8 +909,13 @@ void rt_schedule(void)
                 rt_current_priority = (rt_uint8_t)highest_ready_priority;
                 from_thread         = rt_current_thread;
                 rt_current_thread   = to_thread;
+#ifdef RT_USING_CPU_USAGE
+                /* the thread not put back to ready queue has blocked */
+                _scheduler_usage_switch(from_thread, to_thread, !need_insert_from_thread, rt_thread_usage_clock());
+#endif /* RT_USING_CPU_USAGE */
 
                 RT_OBJECT_HOOK_CALL(rt_scheduler_hook, (from_thread, to_thread));
+                RT_TRACE_EVENT(RT_TRACE_SWITCH, from_thread, to_thread);
 
                 if (need_insert_from_thread)
                 {
@@ -487,6 +937,7 @@ void rt_schedule(void)
 #ifdef RT_USING_OVERFLOW_CHECK
                 _rt_scheduler_stack_check(to_thread);
 #endif /* RT_USING_OVERFLOW_CHECK */
+                _scheduler_stack_switch(to_thread);
 
                 if (rt_interrupt_nest == 0)
                 {
@@ -559,7 +1010,7 @@ void rt_scheduler_do_irq_switch(void *context)
     struct rt_thread *to_thread;
     struct rt_thread *current_thread;
 
-    level = rt_hw_interrupt_disable();
+    level = rt_hw_local_irq_disable();
 
     cpu_id = rt_hw_cpu_id();
     pcpu   = rt_cpu_index(cpu_id);
@@ -579,65 +1030,37 @@ void rt_scheduler_do_irq_switch(void *context)
 
     if (pcpu->irq_switch_flag == 0)
     {
-        rt_hw_interrupt_enable(level);
+        rt_hw_local_irq_enable(level);
         return;
     }
 
-    if (current_thread->scheduler_lock_nest == 1 && pcpu->irq_nest == 0)
+    if (current_thread->scheduler_lock_nest == 0 && pcpu->irq_nest == 0)
     {
-        rt_ubase_t highest_ready_priority;
+        rt_uint64_t now = _scheduler_usage_clock();
 
         /* clear irq switch flag */
         pcpu->irq_switch_flag = 0;
 
-        if (rt_thread_ready_priority_group != 0 || pcpu->priority_group != 0)
-        {
-            to_thread = _scheduler_get_highest_priority_thread(&highest_ready_priority);
-            current_thread->oncpu = RT_CPU_DETACHED;
-            if ((current_thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_RUNNING)
-            {
-                if (current_thread->current_priority < highest_ready_priority)
-                {
-                    to_thread = current_thread;
-                }
-                else if (current_thread->current_priority == highest_ready_priority && (current_thread->stat & RT_THREAD_STAT_YIELD_MASK) == 0)
-                {
-                    to_thread = current_thread;
-                }
-                else
-                {
-                    rt_schedule_insert_thread(current_thread);
-                }
-                current_thread->stat &= ~RT_THREAD_STAT_YIELD_MASK;
-            }
-            to_thread->oncpu = cpu_id;
-            if (to_thread != current_thread)
-            {
-                /* if the destination thread is not the same as current thread */
-
-                pcpu->current_priority = (rt_uint8_t)highest_ready_priority;
-
-                RT_OBJECT_HOOK_CALL(rt_scheduler_hook, (current_thread, to_thread));
-
-                rt_schedule_remove_thread(to_thread);
-                to_thread->stat = RT_THREAD_RUNNING | (to_thread->stat & ~RT_THREAD_STAT_MASK);
+        _scheduler_lock_and_pull(cpu_id, current_thread);
+        /* the threads queued by other cpus are seen now */
+        pcpu->ipi_pending = 0;
 
-#ifdef RT_USING_OVERFLOW_CHECK
-                _rt_scheduler_stack_check(to_thread);
-#endif /* RT_USING_OVERFLOW_CHECK */
-                RT_DEBUG_LOG(RT_DEBUG_SCHEDULER, ("switch in interrupt\n"));
-
-                current_thread->cpus_lock_nest--;
-                current_thread->scheduler_lock_nest--;
-
-                RT_OBJECT_HOOK_CALL(rt_scheduler_switch_hook, (current_thread));
+        to_thread = _scheduler_next_thread(cpu_id, current_thread, now);
+        if (to_thread != RT_NULL)
+        {
+            _scheduler_stack_switch(to_thread);
 
-                rt_hw_context_switch_interrupt(context, (rt_ubase_t)&current_thread->sp,
-                        (rt_ubase_t)&to_thread->sp, to_thread);
-            }
+            /* switch in interrupt, the hooks are called when it's finished */
+            rt_hw_context_switch_interrupt(context, (rt_ubase_t)&current_thread->sp,
+                    (rt_ubase_t)&to_thread->sp, to_thread);
+        }
+        else
+        {
+            rt_hw_spin_unlock(&_cpu_rq_lock[cpu_id]);
+            _scheduler_switch_notify(cpu_id, RT_NULL, RT_NULL);
         }
     }
-    rt_hw_interrupt_enable(level);
+    rt_hw_local_irq_enable(level);
 }
 #endif /* RT_USING_SMP */
 
@@ -653,66 +1076,87 @@ void rt_scheduler_do_irq_switch(void *context)
 void rt_schedule_insert_thread(struct rt_thread *thread)
 {
     int cpu_id;
-    int bind_cpu;
-    rt_uint32_t cpu_mask;
+    int target;
+    struct rt_cpu *pcpu;
     register rt_base_t level;
+    rt_uint64_t now;
 
     RT_ASSERT(thread != RT_NULL);
 
     /* disable interrupt */
-    level = rt_hw_interrupt_disable();
+    level = rt_hw_local_irq_disable();
 
-    /* it should be RUNNING thread */
-    if (thread->oncpu != RT_CPU_DETACHED)
+    cpu_id = rt_hw_cpu_id();
+    now = _scheduler_usage_clock();
+
+__retry:
+    target = thread->oncpu;
+    if (target != RT_CPU_DETACHED)
     {
+        /* it should be RUNNING thread, the lock keeps it on that cpu */
+        rt_hw_spin_lock(&_cpu_rq_lock[target]);
+        if (thread->oncpu != target)
+        {
+            rt_hw_spin_unlock(&_cpu_rq_lock[target]);
+            goto __retry;
+        }
+
         thread->stat = RT_THREAD_RUNNING | (thread->stat & ~RT_THREAD_STAT_MASK);
+        rt_hw_spin_unlock(&_cpu_rq_lock[target]);
         goto __exit;
     }
 
-    /* READY thread, insert to ready queue */
-    thread->stat = RT_THREAD_READY | (thread->stat & ~RT_THREAD_STAT_MASK);
+    /* READY thread, insert to the ready queue of the selected cpu */
+    target = _scheduler_select_cpu(thread, cpu_id);
+    pcpu   = rt_cpu_index(target);
 
-    cpu_id   = rt_hw_cpu_id();
-    bind_cpu = thread->bind_cpu ;
-
-    /* insert thread to ready list */
-    if (bind_cpu == RT_CPUS_NR)
+    rt_hw_spin_lock(&_cpu_rq_lock[target]);
+    if (thread->oncpu != RT_CPU_DETACHED)
     {
-#if RT_THREAD_PRIORITY_MAX > 32
-        rt_thread_ready_table[thread->number] |= thread->high_mask;
-#endif /* RT_THREAD_PRIORITY_MAX > 32 */
-        rt_thread_ready_priority_group |= thread->number_mask;
-
-        rt_list_insert_before(&(rt_thread_priority_table[thread->current_priority]),
-                              &(thread->tlist));
-        cpu_mask = RT_CPU_MASK ^ (1 << cpu_id);
-        rt_hw_ipi_send(RT_SCHEDULE_IPI, cpu_mask);
+        rt_hw_spin_unlock(&_cpu_rq_lock[target]);
+        goto __retry;
     }
-    else
-    {
-        struct rt_cpu *pcpu = rt_cpu_index(bind_cpu);
-
-#if RT_THREAD_PRIORITY_MAX > 32
-        pcpu->ready_table[thread->number] |= thread->high_mask;
-#endif /* RT_THREAD_PRIORITY_MAX > 32 */
-        pcpu->priority_group |= thread->number_mask;
 
-        rt_list_insert_before(&(rt_cpu_index(bind_cpu)->priority_table[thread->current_priority]),
-                              &(thread->tlist));
+    _scheduler_edf_wakeup(thread);
+    thread->stat = RT_THREAD_READY | (thread->stat & ~RT_THREAD_STAT_MASK);
+    thread->ready_cpu = target;
+#ifdef RT_USING_CPU_USAGE
+    thread->usage.stamp = now;
+#else
+    RT_UNUSED(now);
+#endif /* RT_USING_CPU_USAGE */
+    _rq_enqueue(pcpu, thread);
 
-        if (cpu_id != bind_cpu)
+    /*
+     * kick the target cpu only if the thread preempts the one running there.
+     * One IPI is enough until the target locks its queue again, so a burst of
+     * wakeups to the same cpu is coalesced into the IPI pending there.
+     */
+    if (target != cpu_id && (thread->current_priority < pcpu->current_priority ||
+        (thread->current_priority == pcpu->current_priority && pcpu->current_thread != RT_NULL &&
+         _scheduler_edf_preempt(pcpu->current_thread, thread))))
+    {
+        if (pcpu->ipi_pending)
+        {
+            pcpu->ipi_coalesced ++;
+        }
+        else
         {
-            cpu_mask = 1 << bind_cpu;
-            rt_hw_ipi_send(RT_SCHEDULE_IPI, cpu_mask);
+            pcpu->ipi_pending = 1;
+            pcpu->ipi_sent ++;
+            rt_hw_ipi_send(RT_SCHEDULE_IPI, 1 << target);
         }
     }
 
-    RT_DEBUG_LOG(RT_DEBUG_SCHEDULER, ("insert thread[%.*s], the priority: %d\n",
-                                      RT_NAME_MAX, thread->name, thread->current_priority));
+    rt_hw_spin_unlock(&_cpu_rq_lock[target]);
+
+    RT_TRACE_EVENT(RT_TRACE_WAKEUP, thread, target);
+    RT_DEBUG_LOG(RT_DEBUG_SCHEDULER, ("insert thread[%.*s] to cpu%d, the priority: %d\n",
+                                      RT_NAME_MAX, thread->name, target, thread->current_priority));
 
 __exit:
     /* enable interrupt */
-    rt_hw_interrupt_enable(level);
+    rt_hw_local_irq_enable(level);
 }
 #else
 void rt_schedule_insert_thread(struct rt_thread *thread)
@@ -732,10 +1176,14 @@ void rt_schedule_insert_thread(struct rt_thread *thread)
     }
 
     /* READY thread, insert to ready queue */
+    _scheduler_edf_wakeup(thread);
     thread->stat = RT_THREAD_READY | (thread->stat & ~RT_THREAD_STAT_MASK);
+#ifdef RT_USING_CPU_USAGE
+    thread->usage.stamp = rt_thread_usage_clock();
+#endif /* RT_USING_CPU_USAGE */
+    RT_TRACE_EVENT(RT_TRACE_WAKEUP, thread, 0);
     /* insert thread to ready list */
-    rt_list_insert_before(&(rt_thread_priority_table[thread->current_priority]),
-                          &(thread->tlist));
+    _scheduler_queue_insert(&(rt_thread_priority_table[thread->current_priority]), thread);
 
     RT_DEBUG_LOG(RT_DEBUG_SCHEDULER, ("insert thread[%.*s], the priority: %d\n",
                                       RT_NAME_MAX, thread->name, thread->current_priority));
@@ -762,54 +1210,43 @@ __exit:
 #ifdef RT_USING_SMP
 void rt_schedule_remove_thread(struct rt_thread *thread)
 {
+    int cpu;
     register rt_base_t level;
 
     RT_ASSERT(thread != RT_NULL);
 
     /* disable interrupt */
-    level = rt_hw_interrupt_disable();
+    level = rt_hw_local_irq_disable();
 
     RT_DEBUG_LOG(RT_DEBUG_SCHEDULER, ("remove thread[%.*s], the priority: %d\n",
                                       RT_NAME_MAX, thread->name,
                                       thread->current_priority));
 
-    /* remove thread from ready list */
-    rt_list_remove(&(thread->tlist));
-    if (thread->bind_cpu == RT_CPUS_NR)
+    /* the thread has never been in a ready queue */
+    cpu = thread->ready_cpu;
+    if (cpu == RT_CPUS_NR)
     {
-        if (rt_list_isempty(&(rt_thread_priority_table[thread->current_priority])))
-        {
-#if RT_THREAD_PRIORITY_MAX > 32
-            rt_thread_ready_table[thread->number] &= ~thread->high_mask;
-            if (rt_thread_ready_table[thread->number] == 0)
-            {
-                rt_thread_ready_priority_group &= ~thread->number_mask;
-            }
-#else
-            rt_thread_ready_priority_group &= ~thread->number_mask;
-#endif /* RT_THREAD_PRIORITY_MAX > 32 */
-        }
+        rt_list_remove(&(thread->tlist));
+        goto __exit;
     }
-    else
-    {
-        struct rt_cpu *pcpu = rt_cpu_index(thread->bind_cpu);
 
-        if (rt_list_isempty(&(pcpu->priority_table[thread->current_priority])))
-        {
-#if RT_THREAD_PRIORITY_MAX > 32
-            pcpu->ready_table[thread->number] &= ~thread->high_mask;
-            if (pcpu->ready_table[thread->number] == 0)
-            {
-                pcpu->priority_group &= ~thread->number_mask;
-            }
-#else
-            pcpu->priority_group &= ~thread->number_mask;
-#endif /* RT_THREAD_PRIORITY_MAX > 32 */
-        }
+    /* the ready queue of the thread may change while other cpu steals it */
+    rt_hw_spin_lock(&_cpu_rq_lock[cpu]);
+    while (thread->ready_cpu != cpu)
+    {
+        rt_hw_spin_unlock(&_cpu_rq_lock[cpu]);
+        cpu = thread->ready_cpu;
+        rt_hw_spin_lock(&_cpu_rq_lock[cpu]);
     }
 
+    /* remove thread from ready list */
+    _rq_dequeue(rt_cpu_index(cpu), thread);
+
+    rt_hw_spin_unlock(&_cpu_rq_lock[cpu]);
+
+__exit:
     /* enable interrupt */
-    rt_hw_interrupt_enable(level);
+    rt_hw_local_irq_enable(level);
 }
 #else
 void rt_schedule_remove_thread(struct rt_thread *thread)
@@ -845,6 +1282,64 @@ void rt_schedule_remove_thread(struct rt_thread *thread)
 }
 #endif /* RT_USING_SMP */
 
+#ifdef RT_USING_SCHED_EDF
+/**
+ * @brief This function will charge one tick to the budget of a running thread in
+ *        the deadline class. The thread is throttled until its next period when
+ *        the budget is used up.
+ *
+ * @param thread is the thread running on current cpu.
+ *
+ * @note  Please do not invoke this function in user application.
+ */
+void rt_schedule_edf_tick(struct rt_thread *thread)
+{
+    register rt_base_t level;
+    rt_tick_t now, replenish;
+
+    RT_ASSERT(thread != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+
+    if (thread->edf.budget > 0)
+    {
+        thread->edf.budget --;
+    }
+
+    if (thread->edf.budget > 0 || !(thread->edf.stat & RT_THREAD_EDF_ACTIVE) ||
+        (thread->stat & RT_THREAD_STAT_MASK) != RT_THREAD_RUNNING)
+    {
+        rt_hw_interrupt_enable(level);
+        return;
+    }
+
+    now = rt_tick_get();
+    replenish = thread->edf.abs_deadline - thread->edf.deadline + thread->edf.period - now;
+    if ((rt_int32_t)replenish <= 0)
+    {
+        /* the period is over, begin the next one and let earlier deadlines run */
+        thread->edf.abs_deadline = now + thread->edf.deadline;
+        thread->edf.budget = thread->edf.runtime;
+    }
+    else
+    {
+        RT_DEBUG_LOG(RT_DEBUG_SCHEDULER, ("throttle thread[%.*s] for %d ticks\n",
+                                          RT_NAME_MAX, thread->name, replenish));
+
+        rt_schedule_remove_thread(thread);
+        thread->stat = RT_THREAD_SUSPEND | (thread->stat & ~RT_THREAD_STAT_MASK);
+        thread->edf.stat |= RT_THREAD_EDF_THROTTLED;
+
+        rt_timer_control(&(thread->edf.timer), RT_TIMER_CTRL_SET_TIME, &replenish);
+        rt_timer_start(&(thread->edf.timer));
+    }
+
+    rt_hw_interrupt_enable(level);
+
+    rt_schedule();
+}
+#endif /* RT_USING_SCHED_EDF */
+
 /**
  * @brief This function will lock the thread scheduler.
  */
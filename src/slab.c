@@ -13,6 +13,7 @@
  * 2010-07-13     Bernard      fix RT_ALIGN issue found by kuronca
  * 2010-10-23     yi.qiu       add module memory allocator
  * 2010-12-18     yi.qiu       fix zone release bug
+ * 2022-02-21     RT-Thread    add per-cpu magazines and depot
  */
 
 /*
@@ -183,6 +184,43 @@ struct rt_slab_page
 
 #define RT_SLAB_NZONES                  72              /* number of zones */
 
+#ifdef RT_USING_SLAB_MAGAZINE
+/*
+ * Per-cpu magazines in front of the zones, in the style of Bonwick's slab
+ * magazines. Each cpu holds a loaded and a previous magazine of chunks for
+ * each small zone, which are accessed with only the local interrupt disabled.
+ * The previous magazine is always full or empty. When both magazines of a cpu
+ * can not serve the request, a full magazine is exchanged for an empty one
+ * (or the other way round) in the depot, the only shared state of this layer.
+ */
+#ifndef RT_SLAB_MAGAZINE_SIZE
+#define RT_SLAB_MAGAZINE_SIZE           16              /* rounds of magazine */
+#endif
+#define RT_SLAB_MAGAZINE_NZONES         40              /* zones of chunk size up to 1KB */
+#define RT_SLAB_MAGAZINE_MAX            (RT_CPUS_NR * 3) /* maximum magazines of a zone */
+
+struct rt_slab_magazine
+{
+    struct rt_slab_magazine *next;                      /**< link of depot */
+    rt_uint32_t              rounds;                    /**< number of chunks */
+    void                    *round[RT_SLAB_MAGAZINE_SIZE];
+};
+
+struct rt_slab_cpu_cache
+{
+    struct rt_slab_magazine *loaded;                    /**< magazine to alloc and free */
+    struct rt_slab_magazine *previous;                  /**< full or empty magazine */
+};
+
+struct rt_slab_depot
+{
+    struct rt_slab_magazine *full;                      /**< list of full magazines */
+    struct rt_slab_magazine *empty;                     /**< list of empty magazines */
+    rt_uint16_t              nmagazine;                 /**< number of magazines of zone */
+    rt_uint16_t              grow;                      /**< an empty magazine is wanted */
+};
+#endif /* RT_USING_SLAB_MAGAZINE */
+
 /*
  * slab object
  */
@@ -199,6 +237,11 @@ struct rt_slab
     rt_uint32_t                 zone_limit;
     rt_uint32_t                 zone_page_cnt;
     struct rt_slab_page        *page_list;
+#ifdef RT_USING_SLAB_MAGAZINE
+    rt_hw_spinlock_t            depot_lock;
+    struct rt_slab_depot        depot[RT_SLAB_MAGAZINE_NZONES];
+    struct rt_slab_cpu_cache    cpu_cache[RT_CPUS_NR][RT_SLAB_MAGAZINE_NZONES];
+#endif /* RT_USING_SLAB_MAGAZINE */
 };
 
 /**
@@ -351,6 +394,9 @@ rt_slab_t rt_slab_init(const char *name, void *begin_addr, rt_size_t size)
     slab->parent.max = 0;
     slab->heap_start = begin_align;
     slab->heap_end = end_align;
+#ifdef RT_USING_SLAB_MAGAZINE
+    rt_hw_spin_lock_init(&slab->depot_lock);
+#endif /* RT_USING_SLAB_MAGAZINE */
 
     /* init pages */
     rt_slab_page_init(slab, (void *)slab->heap_start, npages);
@@ -471,20 +517,10 @@ rt_inline int zoneindex(rt_size_t *bytes)
 
 /**@{*/
 
-/**
- * @brief This function will allocate a block from slab object.
- *
- * @note the RT_NULL is returned if
- *         - the nbytes is less than zero.
- *         - there is no nbytes sized memory valid in system.
- *
- * @param m the slab memory management object.
- *
- * @param size is the size of memory to be allocated.
- *
- * @return the allocated memory.
+/*
+ * Allocate a block from the zones of slab object.
  */
-void *rt_slab_alloc(rt_slab_t m, rt_size_t size)
+static void *_slab_alloc(rt_slab_t m, rt_size_t size)
 {
     struct rt_slab_zone *z;
     rt_int32_t zi;
@@ -651,7 +687,6 @@ void *rt_slab_alloc(rt_slab_t m, rt_size_t size)
 
     return chunk;
 }
-RTM_EXPORT(rt_slab_alloc);
 
 /**
  * @brief This function will change the size of previously allocated memory block.
@@ -725,15 +760,10 @@ void *rt_slab_realloc(rt_slab_t m, void *ptr, rt_size_t size)
 }
 RTM_EXPORT(rt_slab_realloc);
 
-/**
- * @brief This function will release the previous allocated memory block by rt_slab_alloc.
- *
- * @note The released memory block is taken back to system heap.
- *
- * @param m the slab memory management object.
- * @param ptr is the address of memory which will be released
+/*
+ * Release the block to the zones of slab object.
  */
-void rt_slab_free(rt_slab_t m, void *ptr)
+static void _slab_free(rt_slab_t m, void *ptr)
 {
     struct rt_slab_zone *z;
     struct rt_slab_chunk *chunk;
@@ -851,6 +881,335 @@ void rt_slab_free(rt_slab_t m, void *ptr)
         }
     }
 }
+
+#ifdef RT_USING_SLAB_MAGAZINE
+rt_inline rt_base_t _slab_depot_lock(struct rt_slab *slab)
+{
+    rt_base_t level;
+
+    /* the depot is also used by the interrupts of this cpu */
+    level = rt_hw_local_irq_disable();
+    rt_hw_spin_lock(&slab->depot_lock);
+
+    return level;
+}
+
+rt_inline void _slab_depot_unlock(struct rt_slab *slab, rt_base_t level)
+{
+    rt_hw_spin_unlock(&slab->depot_lock);
+    rt_hw_local_irq_enable(level);
+}
+
+/*
+ * Get the magazine zone index of a small chunk, -1 for the others.
+ */
+rt_inline int _slab_magazine_index(struct rt_slab *slab, void *ptr)
+{
+    struct rt_slab_zone *z;
+    struct rt_slab_memusage *kup;
+
+    kup = btokup((rt_ubase_t)ptr & ~RT_MM_PAGE_MASK);
+    if (kup->type != PAGE_TYPE_SMALL)
+        return -1;
+
+    z = (struct rt_slab_zone *)(((rt_ubase_t)ptr & ~RT_MM_PAGE_MASK) -
+                      kup->size * RT_MM_PAGE_SIZE);
+    RT_ASSERT(z->z_magic == ZALLOC_SLAB_MAGIC);
+
+    if (z->z_zoneindex >= RT_SLAB_MAGAZINE_NZONES)
+        return -1;
+
+    return z->z_zoneindex;
+}
+
+/*
+ * Give the depot an empty magazine if a free of the zone of ptr has missed
+ * the magazines for lack of it. It's invoked with the slab locked.
+ */
+static void _slab_depot_grow(struct rt_slab *slab, void *ptr)
+{
+    struct rt_slab_magazine *mag;
+    struct rt_slab_depot *depot;
+    rt_base_t level;
+    int zi;
+
+    if (ptr == RT_NULL)
+        return;
+
+    zi = _slab_magazine_index(slab, ptr);
+    if (zi < 0 || slab->depot[zi].grow == 0)
+        return;
+
+    mag = (struct rt_slab_magazine *)_slab_alloc(&slab->parent, sizeof(struct rt_slab_magazine));
+    if (mag == RT_NULL)
+        return;
+    mag->rounds = 0;
+
+    depot = &slab->depot[zi];
+    level = _slab_depot_lock(slab);
+    depot->grow = 0;
+    if (depot->nmagazine < RT_SLAB_MAGAZINE_MAX)
+    {
+        mag->next = depot->empty;
+        depot->empty = mag;
+        depot->nmagazine ++;
+        mag = RT_NULL;
+    }
+    _slab_depot_unlock(slab, level);
+
+    if (mag != RT_NULL)
+        _slab_free(&slab->parent, mag);
+}
+
+/*
+ * Release the chunks of full magazines and all magazines in depot to the
+ * zones, it's invoked with the slab locked when the memory is exhausted.
+ * The magazines loaded by cpus are left as they are.
+ *
+ * Return the number of released magazines.
+ */
+static rt_uint32_t _slab_depot_drain(struct rt_slab *slab)
+{
+    struct rt_slab_magazine *list, *mag;
+    rt_base_t level;
+    rt_uint32_t count = 0;
+    int zi;
+
+    for (zi = 0; zi < RT_SLAB_MAGAZINE_NZONES; zi ++)
+    {
+        level = _slab_depot_lock(slab);
+        /* join the full and empty lists */
+        list = slab->depot[zi].full;
+        for (mag = slab->depot[zi].empty; mag != RT_NULL; mag = slab->depot[zi].empty)
+        {
+            slab->depot[zi].empty = mag->next;
+            mag->next = list;
+            list = mag;
+            slab->depot[zi].nmagazine --;
+        }
+        for (mag = slab->depot[zi].full; mag != RT_NULL; mag = mag->next)
+        {
+            slab->depot[zi].nmagazine --;
+        }
+        slab->depot[zi].full = RT_NULL;
+        _slab_depot_unlock(slab, level);
+
+        while (list != RT_NULL)
+        {
+            mag  = list;
+            list = mag->next;
+
+            while (mag->rounds > 0)
+            {
+                _slab_free(&slab->parent, mag->round[-- mag->rounds]);
+            }
+            _slab_free(&slab->parent, mag);
+            count ++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief This function will allocate a block from the magazines of current cpu.
+ *        It doesn't lock the slab, and only the depot is locked when a full
+ *        magazine is needed.
+ *
+ * @param m the slab memory management object.
+ *
+ * @param size is the size of memory to be allocated.
+ *
+ * @return the allocated memory, RT_NULL if the magazines are empty and the block
+ *         shall be allocated by rt_slab_alloc().
+ */
+void *rt_slab_magazine_alloc(rt_slab_t m, rt_size_t size)
+{
+    struct rt_slab *slab = (struct rt_slab *)m;
+    struct rt_slab_cpu_cache *cache;
+    struct rt_slab_magazine *mag;
+    struct rt_slab_depot *depot;
+    rt_base_t level;
+    void *ptr = RT_NULL;
+    int zi;
+
+    if (size == 0 || size >= slab->zone_limit)
+        return RT_NULL;
+
+    zi = zoneindex(&size);
+    if (zi >= RT_SLAB_MAGAZINE_NZONES)
+        return RT_NULL;
+
+    level = rt_hw_local_irq_disable();
+
+    cache = &slab->cpu_cache[rt_hw_cpu_id()][zi];
+    if (cache->loaded == RT_NULL || cache->loaded->rounds == 0)
+    {
+        if (cache->previous != RT_NULL && cache->previous->rounds > 0)
+        {
+            /* the previous is full, exchange it with the loaded one */
+            mag = cache->loaded;
+            cache->loaded = cache->previous;
+            cache->previous = mag;
+        }
+        else
+        {
+            /* get a full magazine from depot, and return the empty one */
+            depot = &slab->depot[zi];
+            rt_hw_spin_lock(&slab->depot_lock);
+            if (depot->full != RT_NULL)
+            {
+                if (cache->previous != RT_NULL)
+                {
+                    cache->previous->next = depot->empty;
+                    depot->empty = cache->previous;
+                }
+                cache->previous = cache->loaded;
+                cache->loaded = depot->full;
+                depot->full = depot->full->next;
+            }
+            rt_hw_spin_unlock(&slab->depot_lock);
+        }
+    }
+
+    mag = cache->loaded;
+    if (mag != RT_NULL && mag->rounds > 0)
+    {
+        ptr = mag->round[-- mag->rounds];
+    }
+
+    rt_hw_local_irq_enable(level);
+
+    return ptr;
+}
+RTM_EXPORT(rt_slab_magazine_alloc);
+
+/**
+ * @brief This function will release a block to the magazines of current cpu.
+ *        It doesn't lock the slab, and only the depot is locked when an empty
+ *        magazine is needed.
+ *
+ * @param m the slab memory management object.
+ *
+ * @param ptr is the address of memory which will be released.
+ *
+ * @return RT_EOK if the block is released, otherwise the block shall be released
+ *         by rt_slab_free().
+ */
+rt_err_t rt_slab_magazine_free(rt_slab_t m, void *ptr)
+{
+    struct rt_slab *slab = (struct rt_slab *)m;
+    struct rt_slab_cpu_cache *cache;
+    struct rt_slab_magazine *mag;
+    struct rt_slab_depot *depot;
+    rt_err_t result = -RT_EFULL;
+    rt_base_t level;
+    int zi;
+
+    if (ptr == RT_NULL)
+        return -RT_ERROR;
+
+    zi = _slab_magazine_index(slab, ptr);
+    if (zi < 0)
+        return -RT_ERROR;
+
+    level = rt_hw_local_irq_disable();
+
+    cache = &slab->cpu_cache[rt_hw_cpu_id()][zi];
+    if (cache->loaded == RT_NULL || cache->loaded->rounds == RT_SLAB_MAGAZINE_SIZE)
+    {
+        if (cache->previous != RT_NULL && cache->previous->rounds == 0)
+        {
+            /* the previous is empty, exchange it with the loaded one */
+            mag = cache->loaded;
+            cache->loaded = cache->previous;
+            cache->previous = mag;
+        }
+        else
+        {
+            /* get an empty magazine from depot, and return the full one */
+            depot = &slab->depot[zi];
+            rt_hw_spin_lock(&slab->depot_lock);
+            if (depot->empty != RT_NULL)
+            {
+                if (cache->previous != RT_NULL)
+                {
+                    cache->previous->next = depot->full;
+                    depot->full = cache->previous;
+                }
+                cache->previous = cache->loaded;
+                cache->loaded = depot->empty;
+                depot->empty = depot->empty->next;
+            }
+            else if (depot->nmagazine < RT_SLAB_MAGAZINE_MAX)
+            {
+                /* the slow path of free will make a new one */
+                depot->grow = 1;
+            }
+            rt_hw_spin_unlock(&slab->depot_lock);
+        }
+    }
+
+    mag = cache->loaded;
+    if (mag != RT_NULL && mag->rounds < RT_SLAB_MAGAZINE_SIZE)
+    {
+        mag->round[mag->rounds ++] = ptr;
+        result = RT_EOK;
+    }
+
+    rt_hw_local_irq_enable(level);
+
+    return result;
+}
+RTM_EXPORT(rt_slab_magazine_free);
+#endif /* RT_USING_SLAB_MAGAZINE */
+
+/**
+ * @brief This function will allocate a block from slab object.
+ *
+ * @note the RT_NULL is returned if
+ *         - the nbytes is less than zero.
+ *         - there is no nbytes sized memory valid in system.
+ *
+ * @param m the slab memory management object.
+ *
+ * @param size is the size of memory to be allocated.
+ *
+ * @return the allocated memory.
+ */
+void *rt_slab_alloc(rt_slab_t m, rt_size_t size)
+{
+    void *ptr;
+
+    ptr = _slab_alloc(m, size);
+#ifdef RT_USING_SLAB_MAGAZINE
+    /* the chunks cached in depot are given back to zones when memory is exhausted */
+    if (ptr == RT_NULL && size != 0 && _slab_depot_drain((struct rt_slab *)m) > 0)
+    {
+        ptr = _slab_alloc(m, size);
+    }
+#endif /* RT_USING_SLAB_MAGAZINE */
+
+    return ptr;
+}
+RTM_EXPORT(rt_slab_alloc);
+
+/**
+ * @brief This function will release the previous allocated memory block by rt_slab_alloc.
+ *
+ * @note The released memory block is taken back to system heap.
+ *
+ * @param m the slab memory management object.
+ * @param ptr is the address of memory which will be released
+ */
+void rt_slab_free(rt_slab_t m, void *ptr)
+{
+#ifdef RT_USING_SLAB_MAGAZINE
+    _slab_depot_grow((struct rt_slab *)m, ptr);
+#endif /* RT_USING_SLAB_MAGAZINE */
+
+    _slab_free(m, ptr);
+}
 RTM_EXPORT(rt_slab_free);
 
 #endif /* defined (RT_USING_SLAB) */
@@ -31,6 +31,13 @@
  * 2021-12-27     Meco Man     remove .init_priority
  * 2022-01-07     Gabriel      Moving __on_rt_xxxxx_hook to thread.c
  * 2022-01-24     THEWON       let rt_thread_sleep return thread->error when using signal
+ * 2022-02-19     RT-Thread    add sub-tick sleep with the thread hrtimer
+ * 2022-02-24     RT-Thread    add the cpu usage of threads
+ * 2022-02-24     RT-Thread    add the earliest deadline first class
+ * 2022-02-24     RT-Thread    add the high-water mark of thread stack
+ * 2022-02-24     RT-Thread    add the thread cache of dynamic threads
+ * 2022-02-24     RT-Thread    leave the throttled EDF thread to its replenishment on resume
+ * 2022-02-24     RT-Thread    convert the nanoseconds of sleep to ticks in 64-bit without hrtimer
  */
 
 
@@ -42,6 +49,9 @@ RT-Thread 的线程调度器是抢占式的，主要的工作就是从就绪线
 #include <rthw.h>
 #include <rtthread.h>
 #include <stddef.h>
+#if defined(RT_USING_CPU_USAGE) && defined(RT_USING_CPUTIME)
+#include <rtdevice.h>
+#endif /* defined(RT_USING_CPU_USAGE) && defined(RT_USING_CPUTIME) */
 
 #ifndef __on_rt_thread_inited_hook
     #define __on_rt_thread_inited_hook(thread)      __ON_HOOK_ARGS(rt_thread_inited_hook, (thread))
@@ -94,6 +104,60 @@ void rt_thread_inited_sethook(void (*hook)(rt_thread_t thread))
 
 #endif /* RT_USING_HOOK */
 
+#ifdef RT_USING_SCHED_EDF
+#if RT_SCHED_EDF_PRIORITY >= RT_THREAD_PRIORITY_MAX
+#error "RT_SCHED_EDF_PRIORITY shall be less than RT_THREAD_PRIORITY_MAX"
+#endif /* RT_SCHED_EDF_PRIORITY >= RT_THREAD_PRIORITY_MAX */
+
+/* the bandwidth of a reservation, runtime/period in 16.16 fixed point */
+#define _EDF_BANDWIDTH(runtime, period) ((rt_uint32_t)(((rt_uint64_t)(runtime) << 16) / (period)))
+#define _EDF_BANDWIDTH_MAX              ((rt_uint32_t)(((rt_uint64_t)RT_SCHED_EDF_UTIL_MAX << 16) / 100))
+
+/* the sum of bandwidth of all reservations */
+static rt_uint32_t _edf_bandwidth = 0;
+
+/*
+ * the timeout function of replenishment, the throttled thread is ready for
+ * its next period.
+ */
+static void _thread_edf_replenish(void *parameter)
+{
+    struct rt_thread *thread;
+    register rt_base_t level;
+
+    thread = (struct rt_thread *)parameter;
+    RT_ASSERT(thread != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+
+    if (thread->edf.stat & RT_THREAD_EDF_THROTTLED)
+    {
+        thread->edf.stat &= ~RT_THREAD_EDF_THROTTLED;
+
+        /* the new period begins as it wakes up */
+        rt_list_remove(&(thread->tlist));
+        rt_schedule_insert_thread(thread);
+    }
+
+    rt_hw_interrupt_enable(level);
+
+    rt_schedule();
+}
+
+/*
+ * release the reservation of a thread, the interrupt shall be disabled.
+ */
+static void _thread_edf_leave(struct rt_thread *thread)
+{
+    if (thread->edf.stat & RT_THREAD_EDF_ACTIVE)
+    {
+        _edf_bandwidth -= _EDF_BANDWIDTH(thread->edf.runtime, thread->edf.period);
+        rt_timer_detach(&(thread->edf.timer));
+        thread->edf.stat = 0;
+    }
+}
+#endif /* RT_USING_SCHED_EDF */
+
 static void _thread_exit(void)
 {
     struct rt_thread *thread;
@@ -110,6 +174,12 @@ static void _thread_exit(void)
 
     /* remove it from timer list */
     rt_timer_detach(&thread->thread_timer);
+#ifdef RT_USING_HRTIMER
+    rt_hrtimer_stop(&thread->thread_hrtimer);
+#endif /* RT_USING_HRTIMER */
+#ifdef RT_USING_SCHED_EDF
+    _thread_edf_leave(thread);
+#endif /* RT_USING_SCHED_EDF */
 
     /* change stat */
     thread->stat = RT_THREAD_CLOSE;
@@ -209,6 +279,10 @@ static rt_err_t _thread_init(struct rt_thread *thread,
     thread->high_mask = 0;
 #endif /* RT_THREAD_PRIORITY_MAX > 32 */
 
+#ifdef RT_USING_STACK_WATERMARK
+    thread->stack_max_used = 0;
+#endif /* RT_USING_STACK_WATERMARK */
+
     /* tick init */
     thread->init_tick      = tick;
     thread->remaining_tick = tick;
@@ -221,6 +295,7 @@ static rt_err_t _thread_init(struct rt_thread *thread,
     /* not bind on any cpu */
     thread->bind_cpu = RT_CPUS_NR;
     thread->oncpu = RT_CPU_DETACHED;
+    thread->ready_cpu = RT_CPUS_NR;
 
     /* lock init */
     thread->scheduler_lock_nest = 0;
@@ -239,6 +314,12 @@ static rt_err_t _thread_init(struct rt_thread *thread,
                   thread,
                   0,
                   RT_TIMER_FLAG_ONE_SHOT);
+#ifdef RT_USING_HRTIMER
+    rt_hrtimer_init(&(thread->thread_hrtimer),
+                    _thread_timeout,
+                    thread,
+                    RT_TIMER_FLAG_ONE_SHOT);
+#endif /* RT_USING_HRTIMER */
 
     /* initialize signal */
 #ifdef RT_USING_SIGNALS
@@ -257,8 +338,12 @@ static rt_err_t _thread_init(struct rt_thread *thread,
 #endif /* RT_USING_LWP */
 
 #ifdef RT_USING_CPU_USAGE
-    thread->duration_tick = 0;
-#endif
+    rt_memset(&thread->usage, 0, sizeof(thread->usage));
+#endif /* RT_USING_CPU_USAGE */
+
+#ifdef RT_USING_SCHED_EDF
+    rt_memset(&thread->edf, 0, sizeof(thread->edf));
+#endif /* RT_USING_SCHED_EDF */
 
 
 #ifdef RT_USING_MODULE
@@ -421,6 +506,12 @@ rt_err_t rt_thread_detach(rt_thread_t thread)
 
     /* release thread timer */
     rt_timer_detach(&(thread->thread_timer));
+#ifdef RT_USING_HRTIMER
+    rt_hrtimer_stop(&(thread->thread_hrtimer));
+#endif /* RT_USING_HRTIMER */
+#ifdef RT_USING_SCHED_EDF
+    _thread_edf_leave(thread);
+#endif /* RT_USING_SCHED_EDF */
 
     /* change stat */
     thread->stat = RT_THREAD_CLOSE;
@@ -435,6 +526,241 @@ rt_err_t rt_thread_detach(rt_thread_t thread)
 }
 RTM_EXPORT(rt_thread_detach);
 
+#ifdef RT_USING_THREAD_CACHE
+#ifndef RT_THREAD_CACHE_MIN_STACK
+#define RT_THREAD_CACHE_MIN_STACK   512
+#endif /* RT_THREAD_CACHE_MIN_STACK */
+#ifndef RT_THREAD_CACHE_CLASSES
+#define RT_THREAD_CACHE_CLASSES     4
+#endif /* RT_THREAD_CACHE_CLASSES */
+#ifndef RT_THREAD_CACHE_DEPTH
+#define RT_THREAD_CACHE_DEPTH       4
+#endif /* RT_THREAD_CACHE_DEPTH */
+
+/* the stack of a cached thread follows its thread control block in one block */
+#define _THREAD_CACHE_TCB_SIZE      RT_ALIGN(sizeof(struct rt_thread), RT_ALIGN_SIZE)
+#define _THREAD_CACHE_STACK(index)  ((rt_uint32_t)RT_THREAD_CACHE_MIN_STACK << (index))
+
+struct _thread_cache
+{
+    rt_list_t   free_list;                              /* the free blocks, linked by tlist */
+    rt_uint32_t free_count;
+    rt_uint32_t hit;
+    rt_uint32_t miss;
+};
+
+static struct _thread_cache _thread_cache[RT_THREAD_CACHE_CLASSES];
+static rt_bool_t _thread_cache_inited = RT_FALSE;
+
+/* get the smallest class holding the stack, -1 if it's too large */
+static int _thread_cache_index(rt_uint32_t stack_size)
+{
+    int index;
+
+    for (index = 0; index < RT_THREAD_CACHE_CLASSES; index++)
+    {
+        if (stack_size <= _THREAD_CACHE_STACK(index))
+        {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+/* it must be called with interrupt disabled */
+static void _thread_cache_init(void)
+{
+    int index;
+
+    if (_thread_cache_inited == RT_FALSE)
+    {
+        for (index = 0; index < RT_THREAD_CACHE_CLASSES; index++)
+        {
+            rt_list_init(&(_thread_cache[index].free_list));
+        }
+        _thread_cache_inited = RT_TRUE;
+    }
+}
+
+/* take a free block of the class or allocate a new one */
+static struct rt_thread *_thread_cache_take(int index)
+{
+    struct _thread_cache *cache = &_thread_cache[index];
+    struct rt_thread *thread = RT_NULL;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    _thread_cache_init();
+    if (!rt_list_isempty(&(cache->free_list)))
+    {
+        thread = rt_list_entry(cache->free_list.next, struct rt_thread, tlist);
+        rt_list_remove(&(thread->tlist));
+        cache->free_count --;
+        cache->hit ++;
+    }
+    else
+    {
+        cache->miss ++;
+    }
+    rt_hw_interrupt_enable(level);
+
+    if (thread == RT_NULL)
+    {
+        thread = (struct rt_thread *)RT_KERNEL_MALLOC(_THREAD_CACHE_TCB_SIZE + _THREAD_CACHE_STACK(index));
+    }
+
+    return thread;
+}
+
+/* give a block back to the class, or to the heap if the class is full. The last
+ * block given is taken first, its stack may still be in the cache of cpu */
+static void _thread_cache_give(int index, struct rt_thread *thread)
+{
+    struct _thread_cache *cache = &_thread_cache[index];
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    _thread_cache_init();
+    if (cache->free_count < RT_THREAD_CACHE_DEPTH)
+    {
+        rt_list_insert_after(&(cache->free_list), &(thread->tlist));
+        cache->free_count ++;
+        thread = RT_NULL;
+    }
+    rt_hw_interrupt_enable(level);
+
+    if (thread != RT_NULL)
+    {
+        RT_KERNEL_FREE(thread);
+    }
+}
+
+/**
+ * @brief   This function will fill the thread cache of a stack size in advance, so the
+ *          threads created later take no memory from the heap.
+ *
+ * @param   stack_size is the stack size of the threads, it's rounded up to its class.
+ *
+ * @param   count is the number of free blocks to be kept in the class, no more than
+ *          RT_THREAD_CACHE_DEPTH.
+ *
+ * @return  Return the operation status. If the return value is RT_EOK, the function is successfully executed.
+ *          If the return value is -RT_EINVAL, the stack is larger than the largest class.
+ *          If the return value is -RT_ENOMEM, there is no memory for the blocks.
+ */
+rt_err_t rt_thread_cache_prewarm(rt_uint32_t stack_size, rt_uint32_t count)
+{
+    struct _thread_cache *cache;
+    struct rt_thread *thread;
+    rt_base_t level;
+    rt_uint32_t free_count;
+    int index;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    index = _thread_cache_index(stack_size);
+    if (index < 0)
+    {
+        return -RT_EINVAL;
+    }
+    cache = &_thread_cache[index];
+
+    if (count > RT_THREAD_CACHE_DEPTH)
+    {
+        count = RT_THREAD_CACHE_DEPTH;
+    }
+
+    while (1)
+    {
+        level = rt_hw_interrupt_disable();
+        _thread_cache_init();
+        free_count = cache->free_count;
+        rt_hw_interrupt_enable(level);
+
+        if (free_count >= count)
+        {
+            break;
+        }
+
+        thread = (struct rt_thread *)RT_KERNEL_MALLOC(_THREAD_CACHE_TCB_SIZE + _THREAD_CACHE_STACK(index));
+        if (thread == RT_NULL)
+        {
+            return -RT_ENOMEM;
+        }
+        _thread_cache_give(index, thread);
+    }
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_thread_cache_prewarm);
+
+/**
+ * @brief   This function will put a defunct thread taken from the thread cache back to
+ *          its class, it's called in the cleanup of defunct threads.
+ *
+ * @param   thread is the defunct thread with RT_THREAD_FLAG_CACHED, it shall have
+ *          left the cpu on SMP.
+ */
+void rt_thread_cache_put(rt_thread_t thread)
+{
+    int index;
+
+    RT_ASSERT(thread != RT_NULL);
+    RT_ASSERT(thread->flags & RT_THREAD_FLAG_CACHED);
+#ifdef RT_USING_SMP
+    /* the stack shall not be reused while the thread still runs on it */
+    RT_ASSERT(thread->oncpu == RT_CPU_DETACHED);
+#endif /* RT_USING_SMP */
+
+    index = _thread_cache_index(thread->stack_size);
+    RT_ASSERT(index >= 0 && thread->stack_size == _THREAD_CACHE_STACK(index));
+
+    /* the memory of thread is kept by the cache */
+    rt_object_detach((rt_object_t)thread);
+    _thread_cache_give(index, thread);
+}
+
+#if RT_THREAD_CACHE_PREWARM > 0
+static int _thread_cache_prewarm_init(void)
+{
+    int index;
+
+    for (index = 0; index < RT_THREAD_CACHE_CLASSES; index++)
+    {
+        rt_thread_cache_prewarm(_THREAD_CACHE_STACK(index), RT_THREAD_CACHE_PREWARM);
+    }
+
+    return 0;
+}
+INIT_PREV_EXPORT(_thread_cache_prewarm_init);
+#endif /* RT_THREAD_CACHE_PREWARM > 0 */
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+
+static void thread_cache(void)
+{
+    struct _thread_cache stat;
+    rt_base_t level;
+    int index;
+
+    rt_kprintf("stack      free hit        miss\n");
+    rt_kprintf("---------- ---- ---------- ----------\n");
+    for (index = 0; index < RT_THREAD_CACHE_CLASSES; index++)
+    {
+        level = rt_hw_interrupt_disable();
+        stat = _thread_cache[index];
+        rt_hw_interrupt_enable(level);
+
+        rt_kprintf("%-10d %4d %10d %10d\n", _THREAD_CACHE_STACK(index),
+                   stat.free_count, stat.hit, stat.miss);
+    }
+}
+MSH_CMD_EXPORT(thread_cache, show the thread cache of stack-size classes);
+#endif /* RT_USING_FINSH */
+#endif /* RT_USING_THREAD_CACHE */
+
 #ifdef RT_USING_HEAP
 /**
  * @brief   This function will create a thread object and allocate thread object memory.
@@ -446,7 +772,8 @@ RTM_EXPORT(rt_thread_detach);
  *
  * @param   parameter is the parameter of thread enter function.
  *
- * @param   stack_size is the size of thread stack.
+ * @param   stack_size is the size of thread stack. With RT_USING_THREAD_CACHE, it's rounded
+ *          up to the stack size of its class.
  *
  * @param   priority is the priority of thread.
  *
@@ -464,19 +791,42 @@ rt_thread_t rt_thread_create(const char *name,
 {
     struct rt_thread *thread;
     void *stack_start;
+#ifdef RT_USING_THREAD_CACHE
+    int index;
 
-    thread = (struct rt_thread *)rt_object_allocate(RT_Object_Class_Thread,
-                                                    name);
-    if (thread == RT_NULL)
-        return RT_NULL;
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    index = _thread_cache_index(stack_size);
+    if (index >= 0)
+    {
+        /* the thread control block and the stack in one block of the class */
+        thread = _thread_cache_take(index);
+        if (thread == RT_NULL)
+            return RT_NULL;
+
+        rt_memset(thread, 0x0, sizeof(struct rt_thread));
+        rt_object_attach((rt_object_t)thread, RT_Object_Class_Thread, name);
+        thread->flags |= RT_THREAD_FLAG_CACHED;
 
-    stack_start = (void *)RT_KERNEL_MALLOC(stack_size);
-    if (stack_start == RT_NULL)
+        stack_start = (rt_uint8_t *)thread + _THREAD_CACHE_TCB_SIZE;
+        stack_size = _THREAD_CACHE_STACK(index);
+    }
+    else
+#endif /* RT_USING_THREAD_CACHE */
     {
-        /* allocate stack failure */
-        rt_object_delete((rt_object_t)thread);
+        thread = (struct rt_thread *)rt_object_allocate(RT_Object_Class_Thread,
+                                                        name);
+        if (thread == RT_NULL)
+            return RT_NULL;
 
-        return RT_NULL;
+        stack_start = (void *)RT_KERNEL_MALLOC(stack_size);
+        if (stack_start == RT_NULL)
+        {
+            /* allocate stack failure */
+            rt_object_delete((rt_object_t)thread);
+
+            return RT_NULL;
+        }
     }
 
     _thread_init(thread,
@@ -524,6 +874,12 @@ rt_err_t rt_thread_delete(rt_thread_t thread)
 
     /* release thread timer */
     rt_timer_detach(&(thread->thread_timer));
+#ifdef RT_USING_HRTIMER
+    rt_hrtimer_stop(&(thread->thread_hrtimer));
+#endif /* RT_USING_HRTIMER */
+#ifdef RT_USING_SCHED_EDF
+    _thread_edf_leave(thread);
+#endif /* RT_USING_SCHED_EDF */
 
     /* change stat */
     thread->stat = RT_THREAD_CLOSE;
@@ -556,9 +912,10 @@ rt_err_t rt_thread_yield(void)
     lock = rt_hw_interrupt_disable();
     thread->remaining_tick = thread->init_tick;
     thread->stat |= RT_THREAD_STAT_YIELD;
-    rt_schedule();
     rt_hw_interrupt_enable(lock);
 
+    rt_schedule();
+
     return RT_EOK;
 }
 RTM_EXPORT(rt_thread_yield);
@@ -607,6 +964,58 @@ rt_err_t rt_thread_sleep(rt_tick_t tick)
     return thread->error;
 }
 
+#ifdef RT_USING_HRTIMER
+/**
+ * @brief   This function will let current thread sleep for some nanoseconds,
+ *          the thread hrtimer will awaken this thread. If there is no hrtimer,
+ *          the sleep time is rounded up to ticks.
+ *
+ * @param   ns is the sleep nanoseconds.
+ *
+ * @return  Return the operation status. If the return value is RT_EOK, the function is successfully executed.
+ *          If the return value is any other values, it means this operation failed.
+ */
+static rt_err_t _thread_sleep_ns(rt_uint64_t ns)
+{
+    register rt_base_t temp;
+    struct rt_thread *thread;
+    rt_tick_t tick;
+
+    /* set to current thread */
+    thread = rt_thread_self();
+    RT_ASSERT(thread != RT_NULL);
+    RT_ASSERT(rt_object_get_type((rt_object_t)thread) == RT_Object_Class_Thread);
+
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
+
+    /* reset thread error */
+    thread->error = RT_EOK;
+
+    /* suspend thread */
+    rt_thread_suspend(thread);
+
+    /* start the thread hrtimer, or the thread timer without hrtimer */
+    if (rt_hrtimer_start(&(thread->thread_hrtimer), ns) != RT_EOK)
+    {
+        tick = rt_hrtimer_ns_to_tick(ns);
+        rt_timer_control(&(thread->thread_timer), RT_TIMER_CTRL_SET_TIME, &tick);
+        rt_timer_start(&(thread->thread_timer));
+    }
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(temp);
+
+    rt_schedule();
+
+    /* clear error number of this thread to RT_EOK */
+    if (thread->error == -RT_ETIMEOUT)
+        thread->error = RT_EOK;
+
+    return thread->error;
+}
+#endif /* RT_USING_HRTIMER */
+
 /**
  * @brief   This function will let current thread delay for some ticks.
  *
@@ -698,12 +1107,37 @@ rt_err_t rt_thread_mdelay(rt_int32_t ms) // 延时运行
 {
     rt_tick_t tick;
 
+#ifdef RT_USING_HRTIMER
+    /* the delay is not a multiple of tick, sleep on the hrtimer */
+    if (ms > 0 && ((rt_uint64_t)ms * RT_TICK_PER_SECOND) % 1000 != 0)
+    {
+        return _thread_sleep_ns((rt_uint64_t)ms * 1000000);
+    }
+#endif /* RT_USING_HRTIMER */
+
     tick = rt_tick_from_millisecond(ms);
 
     return rt_thread_sleep(tick);
 }
 RTM_EXPORT(rt_thread_mdelay);
 
+#ifdef RT_USING_HRTIMER
+/**
+ * @brief   This function will let current thread delay for some microseconds,
+ *          the thread is suspended on the hrtimer instead of busy waiting.
+ *
+ * @param   us is the delay us time.
+ *
+ * @return  Return the operation status. If the return value is RT_EOK, the function is successfully executed.
+ *          If the return value is any other values, it means this operation failed.
+ */
+rt_err_t rt_thread_udelay(rt_uint32_t us)
+{
+    return _thread_sleep_ns((rt_uint64_t)us * 1000);
+}
+RTM_EXPORT(rt_thread_udelay);
+#endif /* RT_USING_HRTIMER */
+
 /**
  * @brief   This function will control thread behaviors according to control command.
  *
@@ -869,6 +1303,9 @@ rt_err_t rt_thread_suspend(rt_thread_t thread) // 线程挂起
 
     /* stop thread timer anyway */
     rt_timer_stop(&(thread->thread_timer)); // 停止定时器
+#ifdef RT_USING_HRTIMER
+    rt_hrtimer_stop(&(thread->thread_hrtimer));
+#endif /* RT_USING_HRTIMER */
 
     /* enable interrupt */
     rt_hw_interrupt_enable(temp);
@@ -887,6 +1324,8 @@ RTM_EXPORT(rt_thread_suspend);
  *
  * @return  Return the operation status. If the return value is RT_EOK, the function is successfully executed.
  *          If the return value is any other values, it means this operation failed.
+ *          A thread throttled by its EDF budget is not resumed, -RT_EBUSY is returned
+ *          and the thread is resumed by the replenishment of its next period.
  */
 rt_err_t rt_thread_resume(rt_thread_t thread) // 线程重启
 {
@@ -909,10 +1348,25 @@ rt_err_t rt_thread_resume(rt_thread_t thread) // 线程重启
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
 
+#ifdef RT_USING_SCHED_EDF
+    /* the budget of the period is used up, the replenish timer will resume it */
+    if (thread->edf.stat & RT_THREAD_EDF_THROTTLED)
+    {
+        rt_hw_interrupt_enable(temp);
+
+        RT_DEBUG_LOG(RT_DEBUG_THREAD, ("thread resume: thread throttled\n"));
+
+        return -RT_EBUSY;
+    }
+#endif /* RT_USING_SCHED_EDF */
+
     /* remove from suspend list */
     rt_list_remove(&(thread->tlist)); // 先删除
 
     rt_timer_stop(&thread->thread_timer);
+#ifdef RT_USING_HRTIMER
+    rt_hrtimer_stop(&thread->thread_hrtimer);
+#endif /* RT_USING_HRTIMER */
 
     /* insert to schedule ready list */
     rt_schedule_insert_thread(thread); // 再重新加入
@@ -925,6 +1379,252 @@ rt_err_t rt_thread_resume(rt_thread_t thread) // 线程重启
 }
 RTM_EXPORT(rt_thread_resume);
 
+#ifdef RT_USING_CPU_USAGE
+/**
+ * @brief   This function will return the clock of the cpu usage, it's the counts
+ *          of cputime clock with RT_USING_CPUTIME, otherwise the ticks.
+ *
+ * @return  Return the current time of the cpu usage clock.
+ */
+rt_uint64_t rt_thread_usage_clock(void)
+{
+#ifdef RT_USING_CPUTIME
+    return clock_cpu_count();
+#else
+    return rt_tick_get();
+#endif /* RT_USING_CPUTIME */
+}
+RTM_EXPORT(rt_thread_usage_clock);
+
+/**
+ * @brief   This function will get the cpu usage of a thread. The time of the
+ *          thread running now is accounted until the current time.
+ *
+ * @param   thread is the thread to be queried.
+ *
+ * @param   usage is the buffer to save the usage.
+ *
+ * @return  Return the operation status. If the return value is RT_EOK, the function is successfully executed.
+ */
+rt_err_t rt_thread_get_usage(rt_thread_t thread, struct rt_thread_usage *usage)
+{
+    rt_base_t level;
+    rt_uint64_t now;
+
+    /* thread check */
+    RT_ASSERT(thread != RT_NULL);
+    RT_ASSERT(rt_object_get_type((rt_object_t)thread) == RT_Object_Class_Thread);
+    RT_ASSERT(usage != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    now = rt_thread_usage_clock();
+    *usage = thread->usage;
+    if ((thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_RUNNING && now > usage->stamp)
+    {
+        usage->run_time += now - usage->stamp;
+        usage->stamp = now;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_thread_get_usage);
+#endif /* RT_USING_CPU_USAGE */
+
+#ifdef RT_USING_SCHED_EDF
+/**
+ * @brief   This function will reserve the runtime in every period for a thread in
+ *          the earliest deadline first class. The thread runs at RT_SCHED_EDF_PRIORITY,
+ *          ahead of the threads with later deadlines, and it is throttled until
+ *          the next period once the runtime is used up.
+ *
+ * @param   thread is the thread to be set.
+ *
+ * @param   runtime is the ticks reserved in each period, 0 to leave the class and
+ *          get back the priority before joining.
+ *
+ * @param   deadline is the relative deadline in ticks, runtime <= deadline <= period.
+ *
+ * @param   period is the period in ticks.
+ *
+ * @return  Return the operation status. If the return value is RT_EOK, the function is successfully executed.
+ *          If the return value is -RT_EINVAL, the parameters are invalid.
+ *          If the return value is -RT_EFULL, the sum of runtime/period of all reservations
+ *          would exceed RT_SCHED_EDF_UTIL_MAX percent.
+ */
+rt_err_t rt_thread_set_deadline(rt_thread_t thread, rt_tick_t runtime, rt_tick_t deadline, rt_tick_t period)
+{
+    register rt_base_t level;
+    rt_uint32_t bandwidth = 0, old_bandwidth = 0;
+    rt_uint8_t priority;
+    rt_bool_t throttled;
+
+    /* parameter check */
+    RT_ASSERT(thread != RT_NULL);
+    RT_ASSERT(rt_object_get_type((rt_object_t)thread) == RT_Object_Class_Thread);
+
+    if (runtime != 0)
+    {
+        if (period == 0 || runtime > deadline || deadline > period)
+        {
+            return -RT_EINVAL;
+        }
+        bandwidth = _EDF_BANDWIDTH(runtime, period);
+    }
+
+    level = rt_hw_interrupt_disable();
+
+    if ((thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_CLOSE)
+    {
+        rt_hw_interrupt_enable(level);
+        return -RT_ERROR;
+    }
+
+    if (thread->edf.stat & RT_THREAD_EDF_ACTIVE)
+    {
+        old_bandwidth = _EDF_BANDWIDTH(thread->edf.runtime, thread->edf.period);
+    }
+
+    /* admission control */
+    if (_edf_bandwidth - old_bandwidth + bandwidth > _EDF_BANDWIDTH_MAX)
+    {
+        rt_hw_interrupt_enable(level);
+        return -RT_EFULL;
+    }
+
+    if (runtime == 0)
+    {
+        if (thread->edf.stat & RT_THREAD_EDF_ACTIVE)
+        {
+            priority  = thread->edf.priority;
+            throttled = (thread->edf.stat & RT_THREAD_EDF_THROTTLED) ? RT_TRUE : RT_FALSE;
+
+            _thread_edf_leave(thread);
+            rt_thread_control(thread, RT_THREAD_CTRL_CHANGE_PRIORITY, &priority);
+            if (throttled)
+            {
+                /* no longer limited by the budget */
+                rt_list_remove(&(thread->tlist));
+                rt_schedule_insert_thread(thread);
+            }
+        }
+    }
+    else
+    {
+        if (!(thread->edf.stat & RT_THREAD_EDF_ACTIVE))
+        {
+            thread->edf.priority = thread->current_priority;
+            rt_timer_init(&(thread->edf.timer),
+                          thread->name,
+                          _thread_edf_replenish,
+                          thread,
+                          0,
+                          RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_HARD_TIMER);
+        }
+
+        _edf_bandwidth = _edf_bandwidth - old_bandwidth + bandwidth;
+
+        thread->edf.runtime  = runtime;
+        thread->edf.deadline = deadline;
+        thread->edf.period   = period;
+        thread->edf.abs_deadline = rt_tick_get() + deadline;
+        thread->edf.budget   = runtime;
+        thread->edf.stat    |= RT_THREAD_EDF_ACTIVE;
+
+        priority = RT_SCHED_EDF_PRIORITY;
+        rt_thread_control(thread, RT_THREAD_CTRL_CHANGE_PRIORITY, &priority);
+    }
+
+    rt_hw_interrupt_enable(level);
+
+    if (rt_thread_self() != RT_NULL)
+    {
+        rt_schedule();
+    }
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_thread_set_deadline);
+#endif /* RT_USING_SCHED_EDF */
+
+#ifdef RT_USING_STACK_WATERMARK
+/* a word of the '#' fill pattern, the stack beyond it has never been touched */
+#define _STACK_FILL_WORD    0x23232323
+
+/**
+ * @brief   This function will update the high-water mark of the thread stack. The
+ *          stack pointer saved in the last switch is sampled, then the words beyond
+ *          the mark are scanned until a word of the '#' fill pattern, so only the
+ *          stack used since the last update is scanned.
+ *
+ * @note    The mark only grows. It's called in each switch with interrupts disabled
+ *          and it can be called without lock, a racing update is found again by the
+ *          next one.
+ *
+ * @param   thread is the thread to be updated.
+ *
+ * @param   words is the maximum number of words to be scanned, 0 for no limit.
+ *
+ * @return  Return the high-water mark of the thread stack in bytes.
+ */
+rt_uint32_t rt_thread_stack_watermark(rt_thread_t thread, rt_size_t words)
+{
+    rt_ubase_t addr, bound, used;
+    rt_uint32_t mark;
+
+    RT_ASSERT(thread != RT_NULL);
+
+    mark = thread->stack_max_used;
+
+#ifdef ARCH_CPU_STACK_GROWS_UPWARD
+    used = (rt_ubase_t)thread->sp - (rt_ubase_t)thread->stack_addr;
+#else
+    used = (rt_ubase_t)thread->stack_addr + thread->stack_size - (rt_ubase_t)thread->sp;
+#endif /* ARCH_CPU_STACK_GROWS_UPWARD */
+    if (used <= thread->stack_size && used > mark)
+    {
+        mark = used;
+    }
+
+#ifdef ARCH_CPU_STACK_GROWS_UPWARD
+    addr  = RT_ALIGN((rt_ubase_t)thread->stack_addr + mark, sizeof(rt_uint32_t));
+    bound = RT_ALIGN_DOWN((rt_ubase_t)thread->stack_addr + thread->stack_size, sizeof(rt_uint32_t));
+    while (addr + sizeof(rt_uint32_t) <= bound && *(rt_uint32_t *)addr != _STACK_FILL_WORD)
+    {
+        addr += sizeof(rt_uint32_t);
+        mark = addr - (rt_ubase_t)thread->stack_addr;
+
+        if (words != 0 && --words == 0)
+        {
+            break;
+        }
+    }
+#else
+    addr  = RT_ALIGN_DOWN((rt_ubase_t)thread->stack_addr + thread->stack_size - mark, sizeof(rt_uint32_t));
+    bound = RT_ALIGN((rt_ubase_t)thread->stack_addr, sizeof(rt_uint32_t));
+    while (addr >= bound + sizeof(rt_uint32_t) &&
+           *(rt_uint32_t *)(addr - sizeof(rt_uint32_t)) != _STACK_FILL_WORD)
+    {
+        addr -= sizeof(rt_uint32_t);
+        mark = (rt_ubase_t)thread->stack_addr + thread->stack_size - addr;
+
+        if (words != 0 && --words == 0)
+        {
+            break;
+        }
+    }
+#endif /* ARCH_CPU_STACK_GROWS_UPWARD */
+
+    if (mark > thread->stack_max_used)
+    {
+        thread->stack_max_used = mark;
+    }
+
+    return mark;
+}
+RTM_EXPORT(rt_thread_stack_watermark);
+#endif /* RT_USING_STACK_WATERMARK */
+
 /**
  * @brief   This function will find the specified thread.
  *
@@ -18,6 +18,8 @@
  *                             timeout function.
  * 2021-08-15     supperthomas add the comment
  * 2022-01-07     Gabriel      Moving __on_rt_xxxxx_hook to timer.c
+ * 2022-02-18     RT-Thread    add hierarchical timing wheel backend
+ * 2022-02-24     RT-Thread    add the trace events of timer
  */
 
 /*
@@ -34,9 +36,39 @@
 #include <rtthread.h>
 #include <rthw.h>
 
+#ifdef RT_USING_TIMER_WHEEL
+#ifndef RT_TIMER_WHEEL_BITS
+#define RT_TIMER_WHEEL_BITS             6
+#endif /* RT_TIMER_WHEEL_BITS */
+
+#define RT_TIMER_WHEEL_SLOTS            (1UL << RT_TIMER_WHEEL_BITS)
+#define RT_TIMER_WHEEL_MASK             (RT_TIMER_WHEEL_SLOTS - 1)
+/* the levels to cover the 32 bits tick */
+#define RT_TIMER_WHEEL_LEVEL            ((32 + RT_TIMER_WHEEL_BITS - 1) / RT_TIMER_WHEEL_BITS)
+
+/*
+ * hierarchical timing wheel, the slot of level n holds the timers expire in
+ * the (n + 1)th round of RT_TIMER_WHEEL_BITS bits from the base tick. The
+ * timers of an upper level slot are cascaded to the lower levels when the
+ * base tick reaches the round boundary of this slot.
+ */
+struct rt_timer_wheel
+{
+    rt_tick_t   base;                   /**< the next tick to be processed */
+    rt_list_t   expired;                /**< the timers to be called */
+
+    /* a set bit means that the slot may hold timers */
+    rt_uint32_t bitmap[RT_TIMER_WHEEL_LEVEL][RT_TIMER_WHEEL_SLOTS / 32];
+    rt_list_t   slot[RT_TIMER_WHEEL_LEVEL][RT_TIMER_WHEEL_SLOTS];
+};
+
+/* hard timer wheel */
+static struct rt_timer_wheel _timer_list[1];
+#else
 /* hard timer list */
 static rt_list_t _timer_list[RT_TIMER_SKIP_LIST_LEVEL]; 
 // 跳表, 定时器按 tick 从小到大排序，使用跳表可以快速插入, 删除,查找
+#endif /* RT_USING_TIMER_WHEEL */
 
 #ifdef RT_USING_TIMER_SOFT
 
@@ -53,8 +85,13 @@ static rt_list_t _timer_list[RT_TIMER_SKIP_LIST_LEVEL];
 
 /* soft timer status */
 static rt_uint8_t _soft_timer_status = RT_SOFT_TIMER_IDLE;
+#ifdef RT_USING_TIMER_WHEEL
+/* soft timer wheel */
+static struct rt_timer_wheel _soft_timer_list[1];
+#else
 /* soft timer list */
 static rt_list_t _soft_timer_list[RT_TIMER_SKIP_LIST_LEVEL];
+#endif /* RT_USING_TIMER_WHEEL */
 static struct rt_thread _timer_thread; // 时间管理线程
 ALIGN(RT_ALIGN_SIZE)
 static rt_uint8_t _timer_thread_stack[RT_TIMER_THREAD_STACK_SIZE];
@@ -178,6 +215,333 @@ static void _timer_init(rt_timer_t timer,			// 定时器句柄，指向要初始
     }
 }
 
+/**
+ * @brief Remove the timer
+ *
+ * @param timer the point of the timer
+ */
+rt_inline void _timer_remove(rt_timer_t timer)
+{
+    int i;
+
+    for (i = 0; i < RT_TIMER_SKIP_LIST_LEVEL; i++) // 从跳表中删除
+    {
+        rt_list_remove(&timer->row[i]);
+    }
+}
+
+#ifdef RT_USING_TIMER_WHEEL
+/**
+ * @brief Move all timers of the list to an empty list
+ *
+ * @param from is the list to be moved
+ *
+ * @param to is the empty list
+ */
+rt_inline void _timer_list_splice(rt_list_t *from, rt_list_t *to)
+{
+    if (!rt_list_isempty(from))
+    {
+        to->next = from->next;
+        to->prev = from->prev;
+        to->next->prev = to;
+        to->prev->next = to;
+        rt_list_init(from);
+    }
+}
+
+/**
+ * @brief Add the timer to the slot of the wheel by its timeout tick
+ *
+ * @param wheel is the timer wheel
+ *
+ * @param timer the point of the timer
+ */
+static void _timer_wheel_add(struct rt_timer_wheel *wheel, rt_timer_t timer)
+{
+    rt_tick_t delta;
+    rt_uint32_t index;
+    int lvl = 0;
+
+    delta = timer->timeout_tick - wheel->base;
+    if (delta < RT_TICK_MAX / 2)
+    {
+        /* find the level in which the timeout tick is in one round */
+        while (lvl < RT_TIMER_WHEEL_LEVEL - 1 &&
+               delta >= ((rt_tick_t)1 << (RT_TIMER_WHEEL_BITS * (lvl + 1))))
+        {
+            lvl ++;
+        }
+        index = (timer->timeout_tick >> (RT_TIMER_WHEEL_BITS * lvl)) & RT_TIMER_WHEEL_MASK;
+    }
+    else
+    {
+        /* already timeout, it will be handled with the base tick */
+        index = wheel->base & RT_TIMER_WHEEL_MASK;
+    }
+
+    /* the timer started early will be called early in the same slot */
+    rt_list_insert_before(&wheel->slot[lvl][index],
+                          &(timer->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
+    wheel->bitmap[lvl][index >> 5] |= 1UL << (index & 0x1f);
+}
+
+/**
+ * @brief Find the first slot holding timers from the index in one round
+ *
+ * @param wheel is the timer wheel
+ *
+ * @param lvl is the level of the wheel
+ *
+ * @param index is the slot index to start with
+ *
+ * @return the slot index, -1 if all slots of the level are empty
+ */
+static int _timer_wheel_find(struct rt_timer_wheel *wheel, int lvl, rt_uint32_t index)
+{
+    rt_uint32_t n, i, bits;
+
+    for (n = 0; n < RT_TIMER_WHEEL_SLOTS; )
+    {
+        i = (index + n) & RT_TIMER_WHEEL_MASK;
+        bits = wheel->bitmap[lvl][i >> 5] >> (i & 0x1f);
+        if (bits == 0)
+        {
+            /* skip to the next bitmap word */
+            n += 32 - (i & 0x1f);
+            continue;
+        }
+
+        i += __rt_ffs((int)bits) - 1;
+        if (!rt_list_isempty(&wheel->slot[lvl][i]))
+        {
+            return i;
+        }
+
+        /* all timers of this slot have been removed */
+        wheel->bitmap[lvl][i >> 5] &= ~(1UL << (i & 0x1f));
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Find the first tick from the base tick to handle a slot holding
+ *        timers, it's the timeout tick for the lowest level and the
+ *        cascading tick for the upper levels.
+ *
+ * @param wheel is the timer wheel
+ *
+ * @param next_tick is the next tick to handle the wheel
+ *
+ * @return Return the operation status. If the return value is RT_EOK, the function is successfully executed.
+ *         If the return value is any other values, it means the wheel is empty.
+ */
+static rt_err_t _timer_wheel_next(struct rt_timer_wheel *wheel, rt_tick_t *next_tick)
+{
+    int lvl, index;
+    rt_uint32_t shift;
+    rt_tick_t start, tick;
+    rt_err_t result = -RT_ERROR;
+
+    for (lvl = 0; lvl < RT_TIMER_WHEEL_LEVEL; lvl++)
+    {
+        shift = RT_TIMER_WHEEL_BITS * lvl;
+
+        /* the first round boundary of this level from the base tick */
+        start = (wheel->base + ((rt_tick_t)1 << shift) - 1) & ~(((rt_tick_t)1 << shift) - 1);
+        index = _timer_wheel_find(wheel, lvl, (start >> shift) & RT_TIMER_WHEEL_MASK);
+        if (index < 0)
+        {
+            continue;
+        }
+
+        tick = start + ((((rt_tick_t)index - (start >> shift)) & RT_TIMER_WHEEL_MASK) << shift);
+        if (result != RT_EOK || tick - wheel->base < *next_tick - wheel->base)
+        {
+            *next_tick = tick;
+            result = RT_EOK;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Re-add the timers of the slot in the current round to the lower levels
+ *
+ * @param wheel is the timer wheel
+ *
+ * @param lvl is the level to be cascaded
+ */
+static void _timer_wheel_cascade(struct rt_timer_wheel *wheel, int lvl)
+{
+    struct rt_timer *t;
+    rt_uint32_t index;
+    rt_list_t list;
+
+    rt_list_init(&list);
+
+    index = (wheel->base >> (RT_TIMER_WHEEL_BITS * lvl)) & RT_TIMER_WHEEL_MASK;
+    _timer_list_splice(&wheel->slot[lvl][index], &list);
+    wheel->bitmap[lvl][index >> 5] &= ~(1UL << (index & 0x1f));
+
+    while (!rt_list_isempty(&list))
+    {
+        t = rt_list_entry(list.next, struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
+        rt_list_remove(&(t->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
+        _timer_wheel_add(wheel, t);
+    }
+}
+
+/**
+ * @brief Advance the base tick of the wheel to the current tick, and move the
+ *        timers of the first timeout slot to the expired list.
+ *
+ * @param wheel is the timer wheel
+ *
+ * @param current_tick is the current tick
+ *
+ * @return RT_TRUE if there are timeout timers
+ */
+static rt_bool_t _timer_wheel_collect(struct rt_timer_wheel *wheel, rt_tick_t current_tick)
+{
+    rt_tick_t next_tick;
+    rt_uint32_t index;
+    int lvl;
+
+    while (_timer_wheel_next(wheel, &next_tick) == RT_EOK &&
+           (current_tick - next_tick) < RT_TICK_MAX / 2)
+    {
+        /* the slots before next tick are all empty, skip them */
+        wheel->base = next_tick;
+
+        /* cascade the upper levels on the round boundary */
+        for (lvl = 1; lvl < RT_TIMER_WHEEL_LEVEL; lvl++)
+        {
+            if (wheel->base & (((rt_tick_t)1 << (RT_TIMER_WHEEL_BITS * lvl)) - 1))
+            {
+                break;
+            }
+            _timer_wheel_cascade(wheel, lvl);
+        }
+
+        index = wheel->base & RT_TIMER_WHEEL_MASK;
+        wheel->base ++;
+        if (!rt_list_isempty(&wheel->slot[0][index]))
+        {
+            _timer_list_splice(&wheel->slot[0][index], &wheel->expired);
+            wheel->bitmap[0][index >> 5] &= ~(1UL << (index & 0x1f));
+
+            return RT_TRUE;
+        }
+    }
+
+    /* nothing timeout until the current tick */
+    if ((current_tick - wheel->base) < RT_TICK_MAX / 2)
+    {
+        wheel->base = current_tick + 1;
+    }
+
+    return RT_FALSE;
+}
+
+/**
+ * @brief  Find the next emtpy timer ticks
+ *
+ * @param wheel is the timer wheel
+ *
+ * @param timeout_tick is the next timer's ticks
+ *
+ * @return  Return the operation status. If the return value is RT_EOK, the function is successfully executed.
+ *          If the return value is any other values, it means this operation failed.
+ */
+static rt_err_t _timer_list_next_timeout(struct rt_timer_wheel *wheel, rt_tick_t *timeout_tick)
+{
+    struct rt_timer *timer;
+    register rt_base_t level;
+    rt_err_t result;
+
+    /* disable interrupt */
+    level = rt_hw_interrupt_disable();
+
+    if (!rt_list_isempty(&wheel->expired))
+    {
+        timer = rt_list_entry(wheel->expired.next,
+                              struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
+        *timeout_tick = timer->timeout_tick;
+        result = RT_EOK;
+    }
+    else
+    {
+        /* the cascading tick of upper levels is earlier than the timeout tick */
+        result = _timer_wheel_next(wheel, timeout_tick);
+    }
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(level);
+
+    return result;
+}
+
+/**
+ * @brief Insert the timer to the timer wheel
+ *
+ * @param wheel is the timer wheel
+ *
+ * @param timer the point of the timer
+ */
+static void _timer_list_insert(struct rt_timer_wheel *wheel, rt_timer_t timer)
+{
+    _timer_wheel_add(wheel, timer);
+}
+
+/**
+ * @brief Get the first timeout timer of the timer wheel
+ *
+ * @param wheel is the timer wheel
+ *
+ * @param current_tick is the current tick
+ *
+ * @return the timeout timer, RT_NULL if there is no timeout timer
+ */
+static struct rt_timer *_timer_list_expired(struct rt_timer_wheel *wheel, rt_tick_t current_tick)
+{
+    if (rt_list_isempty(&wheel->expired) &&
+        _timer_wheel_collect(wheel, current_tick) == RT_FALSE)
+    {
+        return RT_NULL;
+    }
+
+    return rt_list_entry(wheel->expired.next,
+                         struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
+}
+
+/**
+ * @brief Initialize the timer wheel
+ *
+ * @param wheel is the timer wheel
+ */
+static void _timer_list_init(struct rt_timer_wheel *wheel)
+{
+    int lvl, i;
+
+    wheel->base = rt_tick_get();
+    rt_list_init(&wheel->expired);
+
+    for (lvl = 0; lvl < RT_TIMER_WHEEL_LEVEL; lvl++)
+    {
+        for (i = 0; i < RT_TIMER_WHEEL_SLOTS / 32; i++)
+        {
+            wheel->bitmap[lvl][i] = 0;
+        }
+        for (i = 0; i < RT_TIMER_WHEEL_SLOTS; i++)
+        {
+            rt_list_init(&wheel->slot[lvl][i]);
+        }
+    }
+}
+#else
 /**
  * @brief  Find the next emtpy timer ticks
  *
@@ -216,21 +580,133 @@ static rt_err_t _timer_list_next_timeout(rt_list_t timer_list[], rt_tick_t *time
 }
 
 /**
- * @brief Remove the timer
+ * @brief Insert the timer to the timer list in the order of timeout tick
+ *
+ * @param timer_list is the array of time list
  *
  * @param timer the point of the timer
  */
-rt_inline void _timer_remove(rt_timer_t timer)
+static void _timer_list_insert(rt_list_t timer_list[], rt_timer_t timer)
+{
+    unsigned int row_lvl;
+    rt_list_t *row_head[RT_TIMER_SKIP_LIST_LEVEL]; // 指向指针的指针
+    unsigned int tst_nr;
+    static unsigned int random_nr;
+
+    // 按照超时顺序插入到 rt_timer_list 队列链表，先找到位置
+    row_head[0]  = &timer_list[0]; // rt_list_t row_head[RT_TIMER_SKIP_LIST_LEVEL]
+    for (row_lvl = 0; row_lvl < RT_TIMER_SKIP_LIST_LEVEL; row_lvl++)
+    {
+        for (; row_head[row_lvl] != timer_list[row_lvl].prev;
+             row_head[row_lvl]  = row_head[row_lvl]->next)
+        {
+            struct rt_timer *t;
+            rt_list_t *p = row_head[row_lvl]->next; // row_head[i] 为 i 层的前屈
+
+            /* fix up the entry pointer */
+            t = rt_list_entry(p, struct rt_timer, row[row_lvl]);
+
+            /* If we have two timers that timeout at the same time, it's
+             * preferred that the timer inserted early get called early.
+             * So insert the new timer to the end the the some-timeout timer
+             * list.
+             */
+            if ((t->timeout_tick - timer->timeout_tick) == 0)
+            {
+                continue; // 可能多个函数同时超时，新来的就放后面
+            }
+            else if ((t->timeout_tick - timer->timeout_tick) < RT_TICK_MAX / 2)
+            {
+                // 按照 time-current_tick 排序
+                /*
+                NOTE: The max timeout tick should be no more than (RT_TICK_MAX/2 - 1)
+                t->timeout_tick - timer->timeout_tick > 0                            ;; %RT_TICK_MAX
+                t->timeout_tick - timer->timeout_tick < RT_TICK_MAX / 2
+                */
+                break;
+                /*
+                为什么定时器里判断超时的条件是((current_tick - t→timeout_tick) < RT_TICK_MAX/2)
+                系统时钟溢出后会自动回绕。取定时器比较最大值是定时器最大值的一半，即RT_TICK_MAX/2
+                在比较两个定时器值时，值是32位无符号数，相减运算将会自动回绕
+                */
+            }
+        }
+        if (row_lvl != RT_TIMER_SKIP_LIST_LEVEL - 1) // 
+            row_head[row_lvl + 1] = row_head[row_lvl] + 1;// &timer_list[0]+1 --> &timer_list[1]
+    }
+
+    /* Interestingly, this super simple timer insert counter works very very
+     * well on distributing the list height uniformly. By means of "very very
+     * well", I mean it beats the randomness of timer->timeout_tick very easily
+     * (actually, the timeout_tick is not random and easy to be attacked). */
+    random_nr++;
+    tst_nr = random_nr;
+
+    rt_list_insert_after(row_head[RT_TIMER_SKIP_LIST_LEVEL - 1],
+                         &(timer->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
+    for (row_lvl = 2; row_lvl <= RT_TIMER_SKIP_LIST_LEVEL; row_lvl++)
+    {
+        if (!(tst_nr & RT_TIMER_SKIP_LIST_MASK))
+            rt_list_insert_after(row_head[RT_TIMER_SKIP_LIST_LEVEL - row_lvl],
+                                 &(timer->row[RT_TIMER_SKIP_LIST_LEVEL - row_lvl]));
+        else
+            break;
+        /* Shift over the bits we have tested. Works well with 1 bit and 2
+         * bits. */
+        tst_nr >>= (RT_TIMER_SKIP_LIST_MASK + 1) >> 1;
+    }
+}
+
+/**
+ * @brief Get the first timer of the timer list if it is timeout
+ *
+ * @param timer_list is the array of time list
+ *
+ * @param current_tick is the current tick
+ *
+ * @return the timeout timer, RT_NULL if there is no timeout timer
+ */
+static struct rt_timer *_timer_list_expired(rt_list_t timer_list[], rt_tick_t current_tick)
+{
+    struct rt_timer *t;
+
+    if (rt_list_isempty(&timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1]))
+    {
+        return RT_NULL;
+    }
+
+    t = rt_list_entry(timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1].next,
+                      struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
+
+    /*
+     * It supposes that the new tick shall less than the half duration of
+     * tick max.
+     */
+    if ((current_tick - t->timeout_tick) < RT_TICK_MAX / 2)
+    {
+        return t;
+    }
+
+    return RT_NULL;
+}
+
+/**
+ * @brief Initialize the timer list
+ *
+ * @param timer_list is the array of time list
+ */
+static void _timer_list_init(rt_list_t timer_list[])
 {
     int i;
 
-    for (i = 0; i < RT_TIMER_SKIP_LIST_LEVEL; i++) // 从跳表中删除
+    for (i = 0; i < RT_TIMER_SKIP_LIST_LEVEL; i++)
     {
-        rt_list_remove(&timer->row[i]);
+        rt_list_init(timer_list + i);
     }
 }
+#endif /* RT_USING_TIMER_WHEEL */
 
-#if RT_DEBUG_TIMER
+#if RT_DEBUG_TIMER && !defined(RT_USING_TIMER_WHEEL)
 /**
  * @brief The number of timer
  *
@@ -269,7 +745,7 @@ void rt_timer_dump(rt_list_t timer_heads[])
     }
     rt_kprintf("\n");
 }
-#endif /* RT_DEBUG_TIMER */
+#endif /* RT_DEBUG_TIMER && !RT_USING_TIMER_WHEEL */
 
 /**
  * @addtogroup Clock
@@ -435,13 +911,8 @@ RTM_EXPORT(rt_timer_delete);
  */
 rt_err_t rt_timer_start(rt_timer_t timer) // 定时器启动函数
 {
-    unsigned int row_lvl;
-    rt_list_t *timer_list;
     register rt_base_t level;
     register rt_bool_t need_schedule;
-    rt_list_t *row_head[RT_TIMER_SKIP_LIST_LEVEL]; // 指向指针的指针
-    unsigned int tst_nr;
-    static unsigned int random_nr;
 
     /* parameter check */
     RT_ASSERT(timer != RT_NULL);
@@ -465,76 +936,13 @@ rt_err_t rt_timer_start(rt_timer_t timer) // 定时器启动函数
     {
         /* insert timer to soft timer list */
 	// SOFT 模式被启用后，系统会在初始化时创建一个 timer 线程，然后 SOFT_TIMER 模式的定时器超时函数在都会在 timer 线程的上下文环境中执行
-        timer_list = _soft_timer_list;
+        _timer_list_insert(_soft_timer_list, timer);
     }
     else
 #endif /* RT_USING_TIMER_SOFT */
     {
         /* insert timer to system timer list */
-        timer_list = _timer_list;
-    }
-
-    // 按照超时顺序插入到 rt_timer_list 队列链表，先找到位置
-    row_head[0]  = &timer_list[0]; // rt_list_t row_head[RT_TIMER_SKIP_LIST_LEVEL]
-    for (row_lvl = 0; row_lvl < RT_TIMER_SKIP_LIST_LEVEL; row_lvl++)
-    {
-        for (; row_head[row_lvl] != timer_list[row_lvl].prev;
-             row_head[row_lvl]  = row_head[row_lvl]->next)
-        {
-            struct rt_timer *t;
-            rt_list_t *p = row_head[row_lvl]->next; // row_head[i] 为 i 层的前屈
-
-            /* fix up the entry pointer */
-            t = rt_list_entry(p, struct rt_timer, row[row_lvl]);
-
-            /* If we have two timers that timeout at the same time, it's
-             * preferred that the timer inserted early get called early.
-             * So insert the new timer to the end the the some-timeout timer
-             * list.
-             */
-            if ((t->timeout_tick - timer->timeout_tick) == 0)
-            {
-                continue; // 可能多个函数同时超时，新来的就放后面
-            }
-            else if ((t->timeout_tick - timer->timeout_tick) < RT_TICK_MAX / 2)
-            {
-                // 按照 time-current_tick 排序
-                /*
-                NOTE: The max timeout tick should be no more than (RT_TICK_MAX/2 - 1)
-                t->timeout_tick - timer->timeout_tick > 0                            ;; %RT_TICK_MAX
-                t->timeout_tick - timer->timeout_tick < RT_TICK_MAX / 2
-                */
-                break;
-                /*
-                为什么定时器里判断超时的条件是((current_tick - t→timeout_tick) < RT_TICK_MAX/2)
-                系统时钟溢出后会自动回绕。取定时器比较最大值是定时器最大值的一半，即RT_TICK_MAX/2
-                在比较两个定时器值时，值是32位无符号数，相减运算将会自动回绕
-                */
-            }
-        }
-        if (row_lvl != RT_TIMER_SKIP_LIST_LEVEL - 1) // 
-            row_head[row_lvl + 1] = row_head[row_lvl] + 1;// &timer_list[0]+1 --> &timer_list[1]
-    }
-
-    /* Interestingly, this super simple timer insert counter works very very
-     * well on distributing the list height uniformly. By means of "very very
-     * well", I mean it beats the randomness of timer->timeout_tick very easily
-     * (actually, the timeout_tick is not random and easy to be attacked). */
-    random_nr++;
-    tst_nr = random_nr;
-
-    rt_list_insert_after(row_head[RT_TIMER_SKIP_LIST_LEVEL - 1],
-                         &(timer->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
-    for (row_lvl = 2; row_lvl <= RT_TIMER_SKIP_LIST_LEVEL; row_lvl++)
-    {
-        if (!(tst_nr & RT_TIMER_SKIP_LIST_MASK))
-            rt_list_insert_after(row_head[RT_TIMER_SKIP_LIST_LEVEL - row_lvl],
-                                 &(timer->row[RT_TIMER_SKIP_LIST_LEVEL - row_lvl]));
-        else
-            break;
-        /* Shift over the bits we have tested. Works well with 1 bit and 2
-         * bits. */
-        tst_nr >>= (RT_TIMER_SKIP_LIST_MASK + 1) >> 1;
+        _timer_list_insert(_timer_list, timer);
     }
 
     timer->parent.flag |= RT_TIMER_FLAG_ACTIVATED;
@@ -685,51 +1093,42 @@ void rt_timer_check(void)
     /* disable interrupt */
     level = rt_hw_interrupt_disable();
 
-    while (!rt_list_isempty(&_timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1]))
+    while ((t = _timer_list_expired(_timer_list, current_tick)) != RT_NULL)
     {
-        t = rt_list_entry(_timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1].next,
-                          struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
-
-        /*
-         * It supposes that the new tick shall less than the half duration of
-         * tick max.
-         */
-        if ((current_tick - t->timeout_tick) < RT_TICK_MAX / 2)
-        {
-            RT_OBJECT_HOOK_CALL(rt_timer_enter_hook, (t));
+        RT_OBJECT_HOOK_CALL(rt_timer_enter_hook, (t));
+        RT_TRACE_EVENT(RT_TRACE_TIMER_ENTER, t, 0);
 
-            /* remove timer from timer list firstly */
-            _timer_remove(t);
-            if (!(t->parent.flag & RT_TIMER_FLAG_PERIODIC))
-            {
-                t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
-            }
-            /* add timer to temporary list  */
-            rt_list_insert_after(&list, &(t->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
-            /* call timeout function */
-            t->timeout_func(t->parameter);
+        /* remove timer from timer list firstly */
+        _timer_remove(t);
+        if (!(t->parent.flag & RT_TIMER_FLAG_PERIODIC))
+        {
+            t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
+        }
+        /* add timer to temporary list  */
+        rt_list_insert_after(&list, &(t->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
+        /* call timeout function */
+        t->timeout_func(t->parameter);
 
-            /* re-get tick */
-            current_tick = rt_tick_get();
+        /* re-get tick */
+        current_tick = rt_tick_get();
 
-            RT_OBJECT_HOOK_CALL(rt_timer_exit_hook, (t));
-            RT_DEBUG_LOG(RT_DEBUG_TIMER, ("current tick: %d\n", current_tick));
+        RT_OBJECT_HOOK_CALL(rt_timer_exit_hook, (t));
+        RT_TRACE_EVENT(RT_TRACE_TIMER_EXIT, t, 0);
+        RT_DEBUG_LOG(RT_DEBUG_TIMER, ("current tick: %d\n", current_tick));
 
-            /* Check whether the timer object is detached or started again */
-            if (rt_list_isempty(&list))
-            {
-                continue;
-            }
-            rt_list_remove(&(t->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
-            if ((t->parent.flag & RT_TIMER_FLAG_PERIODIC) &&  // 周期性定时器
-                (t->parent.flag & RT_TIMER_FLAG_ACTIVATED))
-            {
-                /* start it */
-                t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
-                rt_timer_start(t);
-            }
+        /* Check whether the timer object is detached or started again */
+        if (rt_list_isempty(&list))
+        {
+            continue;
+        }
+        rt_list_remove(&(t->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
+        if ((t->parent.flag & RT_TIMER_FLAG_PERIODIC) &&  // 周期性定时器
+            (t->parent.flag & RT_TIMER_FLAG_ACTIVATED))
+        {
+            /* start it */
+            t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
+            rt_timer_start(t);
         }
-        else break;
     }
 
     /* enable interrupt */
@@ -769,59 +1168,55 @@ void rt_soft_timer_check(void)
     /* disable interrupt */
     level = rt_hw_interrupt_disable();
 
-    while (!rt_list_isempty(&_soft_timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1]))
+    while (1)
     {
-        t = rt_list_entry(_soft_timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1].next,
-                            struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
-
         current_tick = rt_tick_get();
-
-        /*
-         * It supposes that the new tick shall less than the half duration of
-         * tick max.
-         */
-        if ((current_tick - t->timeout_tick) < RT_TICK_MAX / 2)
+        t = _timer_list_expired(_soft_timer_list, current_tick);
+        if (t == RT_NULL)
         {
-            RT_OBJECT_HOOK_CALL(rt_timer_enter_hook, (t));
+            break; /* not check anymore */
+        }
 
-            /* remove timer from timer list firstly */
-            _timer_remove(t);
-            if (!(t->parent.flag & RT_TIMER_FLAG_PERIODIC))
-            {
-                t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
-            }
-            /* add timer to temporary list  */
-            rt_list_insert_after(&list, &(t->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
+        RT_OBJECT_HOOK_CALL(rt_timer_enter_hook, (t));
+        RT_TRACE_EVENT(RT_TRACE_TIMER_ENTER, t, 0);
 
-            _soft_timer_status = RT_SOFT_TIMER_BUSY;
-            /* enable interrupt */
-            rt_hw_interrupt_enable(level);
+        /* remove timer from timer list firstly */
+        _timer_remove(t);
+        if (!(t->parent.flag & RT_TIMER_FLAG_PERIODIC))
+        {
+            t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
+        }
+        /* add timer to temporary list  */
+        rt_list_insert_after(&list, &(t->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
 
-            /* call timeout function */
-            t->timeout_func(t->parameter);
+        _soft_timer_status = RT_SOFT_TIMER_BUSY;
+        /* enable interrupt */
+        rt_hw_interrupt_enable(level);
 
-            RT_OBJECT_HOOK_CALL(rt_timer_exit_hook, (t));
-            RT_DEBUG_LOG(RT_DEBUG_TIMER, ("current tick: %d\n", current_tick));
+        /* call timeout function */
+        t->timeout_func(t->parameter);
 
-            /* disable interrupt */
-            level = rt_hw_interrupt_disable();
+        RT_OBJECT_HOOK_CALL(rt_timer_exit_hook, (t));
+        RT_TRACE_EVENT(RT_TRACE_TIMER_EXIT, t, 0);
+        RT_DEBUG_LOG(RT_DEBUG_TIMER, ("current tick: %d\n", current_tick));
 
-            _soft_timer_status = RT_SOFT_TIMER_IDLE;
-            /* Check whether the timer object is detached or started again */
-            if (rt_list_isempty(&list))
-            {
-                continue;
-            }
-            rt_list_remove(&(t->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
-            if ((t->parent.flag & RT_TIMER_FLAG_PERIODIC) &&
-                (t->parent.flag & RT_TIMER_FLAG_ACTIVATED))
-            {
-                /* start it */
-                t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
-                rt_timer_start(t);
-            }
+        /* disable interrupt */
+        level = rt_hw_interrupt_disable();
+
+        _soft_timer_status = RT_SOFT_TIMER_IDLE;
+        /* Check whether the timer object is detached or started again */
+        if (rt_list_isempty(&list))
+        {
+            continue;
+        }
+        rt_list_remove(&(t->row[RT_TIMER_SKIP_LIST_LEVEL - 1]));
+        if ((t->parent.flag & RT_TIMER_FLAG_PERIODIC) &&
+            (t->parent.flag & RT_TIMER_FLAG_ACTIVATED))
+        {
+            /* start it */
+            t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
+            rt_timer_start(t);
         }
-        else break; /* not check anymore */
     }
     /* enable interrupt */
     rt_hw_interrupt_enable(level);
@@ -875,12 +1270,7 @@ static void _timer_thread_entry(void *parameter) // 系统 timer 管理线程入
 // 在系统启动时需要初始化定时器管理系统。可以通过下面的函数接口完成
 void rt_system_timer_init(void)
 {
-    int i;
-
-    for (i = 0; i < sizeof(_timer_list) / sizeof(_timer_list[0]); i++)
-    {
-        rt_list_init(_timer_list + i);
-    }
+    _timer_list_init(_timer_list);
 }
 
 /**
@@ -892,14 +1282,7 @@ void rt_system_timer_init(void)
 void rt_system_timer_thread_init(void)
 {
 #ifdef RT_USING_TIMER_SOFT
-    int i;
-
-    for (i = 0;
-         i < sizeof(_soft_timer_list) / sizeof(_soft_timer_list[0]);
-         i++)
-    {
-        rt_list_init(_soft_timer_list + i);
-    }
+    _timer_list_init(_soft_timer_list);
 
     /* start software timer thread */
     rt_thread_init(&_timer_thread,
@@ -0,0 +1,787 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2022-02-22     RT-Thread    the first version
+ * 2022-02-24     RT-Thread    provide memcheck and memtrace without the small memory
+ */
+
+/*
+ * TLSF (Two-Level Segregated Fit) memory allocator, as described in
+ * "TLSF: a New Dynamic Memory Allocator for Real-Time Systems" by M. Masmano,
+ * I. Ripoll, A. Crespo and J. Real.
+ *
+ * The free blocks are kept in segregated lists indexed by two levels: the
+ * first level is the power of two of the block size, the second level splits
+ * each power of two range linearly. Two bitmaps tell which lists are not
+ * empty, so both allocation and free run in constant time with a few bit
+ * scans, no matter how fragmented the heap is.
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+
+#if defined (RT_USING_TLSF)
+
+/* log2 of the number of second level lists in one first level range */
+#ifndef RT_TLSF_SL_INDEX_COUNT_LOG2
+#define RT_TLSF_SL_INDEX_COUNT_LOG2     4
+#endif
+
+#if RT_ALIGN_SIZE == 4
+#define TLSF_ALIGN_SIZE_LOG2    2
+#elif RT_ALIGN_SIZE == 8
+#define TLSF_ALIGN_SIZE_LOG2    3
+#elif RT_ALIGN_SIZE == 16
+#define TLSF_ALIGN_SIZE_LOG2    4
+#else
+#error "TLSF: RT_ALIGN_SIZE shall be 4, 8 or 16"
+#endif
+
+/* the blocks shall be smaller than 1 << TLSF_FL_INDEX_MAX */
+#ifdef ARCH_CPU_64BIT
+#define TLSF_FL_INDEX_MAX       32
+#else
+#define TLSF_FL_INDEX_MAX       30
+#endif /* ARCH_CPU_64BIT */
+
+#define TLSF_SL_INDEX_COUNT     (1 << RT_TLSF_SL_INDEX_COUNT_LOG2)
+#define TLSF_FL_INDEX_SHIFT     (RT_TLSF_SL_INDEX_COUNT_LOG2 + TLSF_ALIGN_SIZE_LOG2)
+#define TLSF_FL_INDEX_COUNT     (TLSF_FL_INDEX_MAX - TLSF_FL_INDEX_SHIFT + 1)
+/* the blocks smaller than it are all in the first level list 0 */
+#define TLSF_SMALL_BLOCK_SIZE   ((rt_size_t)1 << TLSF_FL_INDEX_SHIFT)
+
+/*
+ * block header, the free list links are only valid for free blocks and they
+ * are overlapped with the user data of used blocks.
+ */
+struct rt_tlsf_block
+{
+    struct rt_tlsf_block   *prev_phys;      /**< previous physical block */
+    rt_size_t               size;           /**< block size with header, and the flags */
+#ifdef RT_USING_MEMTRACE
+    rt_uint8_t              thread[4];      /**< thread name */
+#endif /* RT_USING_MEMTRACE */
+    struct rt_tlsf_block   *next_free;      /**< next free block */
+    struct rt_tlsf_block   *prev_free;      /**< previous free block */
+};
+
+#define TLSF_BLOCK_FREE         ((rt_size_t)0x1)
+#define TLSF_BLOCK_PREV_FREE    ((rt_size_t)0x2)
+#define TLSF_BLOCK_FLAGS        (TLSF_BLOCK_FREE | TLSF_BLOCK_PREV_FREE)
+
+#define TLSF_BLOCK_HEADER       RT_ALIGN((rt_size_t)&(((struct rt_tlsf_block *)0)->next_free), RT_ALIGN_SIZE)
+#define TLSF_BLOCK_MIN          RT_ALIGN(sizeof(struct rt_tlsf_block), RT_ALIGN_SIZE)
+
+#define TLSF_BLOCK_SIZE(b)      ((b)->size & ~TLSF_BLOCK_FLAGS)
+#define TLSF_BLOCK_NEXT(b)      ((struct rt_tlsf_block *)((rt_uint8_t *)(b) + TLSF_BLOCK_SIZE(b)))
+#define TLSF_BLOCK_MEM(b)       ((void *)((rt_uint8_t *)(b) + TLSF_BLOCK_HEADER))
+#define TLSF_MEM_BLOCK(p)       ((struct rt_tlsf_block *)((rt_uint8_t *)(p) - TLSF_BLOCK_HEADER))
+
+/*
+ * the control structure of TLSF, it's placed at the beginning of the memory
+ */
+struct rt_tlsf
+{
+    struct rt_memory        parent;                         /**< inherit from rt_memory */
+    struct rt_tlsf_block   *block_start;                    /**< the first block */
+    struct rt_tlsf_block   *block_end;                      /**< the sentinel block of size 0 */
+
+    rt_uint32_t             fl_bitmap;                      /**< the non-empty first level ranges */
+    rt_uint32_t             sl_bitmap[TLSF_FL_INDEX_COUNT]; /**< the non-empty second level lists */
+    struct rt_tlsf_block   *blocks[TLSF_FL_INDEX_COUNT][TLSF_SL_INDEX_COUNT];
+};
+
+#ifdef RT_USING_MEMTRACE
+rt_inline void _tlsf_setname(struct rt_tlsf_block *block, const char *name)
+{
+    int index;
+
+    for (index = 0; index < sizeof(block->thread); index ++)
+    {
+        if (name[index] == '\0') break;
+        block->thread[index] = name[index];
+    }
+
+    for (; index < sizeof(block->thread); index ++)
+    {
+        block->thread[index] = ' ';
+    }
+}
+#endif /* RT_USING_MEMTRACE */
+
+/**
+ * @brief Find the most significant bit set in constant time.
+ *
+ * @param word is the value to be scanned, it shall not be 0.
+ *
+ * @return the index of the most significant bit set.
+ */
+rt_inline int _tlsf_fls(rt_size_t word)
+{
+    int bit = 0;
+
+#ifdef ARCH_CPU_64BIT
+    if (word & 0xffffffff00000000UL) { word >>= 32; bit += 32; }
+#endif /* ARCH_CPU_64BIT */
+    if (word & 0xffff0000) { word >>= 16; bit += 16; }
+    if (word & 0xff00) { word >>= 8; bit += 8; }
+    if (word & 0xf0) { word >>= 4; bit += 4; }
+    if (word & 0xc) { word >>= 2; bit += 2; }
+    if (word & 0x2) { bit += 1; }
+
+    return bit;
+}
+
+/**
+ * @brief Get the lists which a free block of the size belongs to.
+ */
+rt_inline void _tlsf_mapping_insert(rt_size_t size, int *fli, int *sli)
+{
+    int fl, sl;
+
+    if (size < TLSF_SMALL_BLOCK_SIZE)
+    {
+        fl = 0;
+        sl = (int)(size >> TLSF_ALIGN_SIZE_LOG2);
+    }
+    else
+    {
+        fl = _tlsf_fls(size);
+        sl = (int)(size >> (fl - RT_TLSF_SL_INDEX_COUNT_LOG2)) ^ TLSF_SL_INDEX_COUNT;
+        fl -= TLSF_FL_INDEX_SHIFT - 1;
+    }
+
+    *fli = fl;
+    *sli = sl;
+}
+
+/**
+ * @brief Get the first lists whose blocks are all large enough for the size.
+ */
+rt_inline void _tlsf_mapping_search(rt_size_t size, int *fli, int *sli)
+{
+    if (size >= TLSF_SMALL_BLOCK_SIZE)
+    {
+        /* round up to the next list */
+        size += ((rt_size_t)1 << (_tlsf_fls(size) - RT_TLSF_SL_INDEX_COUNT_LOG2)) - 1;
+    }
+
+    _tlsf_mapping_insert(size, fli, sli);
+}
+
+/**
+ * @brief Find a free block from the lists of (fli, sli) or the larger ones.
+ *
+ * @return the free block, or RT_NULL if there is no block large enough.
+ */
+static struct rt_tlsf_block *_tlsf_search_suitable(struct rt_tlsf *tlsf, int *fli, int *sli)
+{
+    int fl = *fli;
+    rt_uint32_t fl_map, sl_map;
+
+    sl_map = tlsf->sl_bitmap[fl] & ((~(rt_uint32_t)0) << *sli);
+    if (sl_map == 0)
+    {
+        /* no block in this first level range, try the larger ranges */
+        fl_map = tlsf->fl_bitmap & ((~(rt_uint32_t)0) << (fl + 1));
+        if (fl_map == 0)
+        {
+            return RT_NULL;
+        }
+
+        fl = __rt_ffs((int)fl_map) - 1;
+        sl_map = tlsf->sl_bitmap[fl];
+    }
+
+    *fli = fl;
+    *sli = __rt_ffs((int)sl_map) - 1;
+
+    return tlsf->blocks[fl][*sli];
+}
+
+static void _tlsf_insert_free(struct rt_tlsf *tlsf, struct rt_tlsf_block *block)
+{
+    int fl, sl;
+
+    _tlsf_mapping_insert(TLSF_BLOCK_SIZE(block), &fl, &sl);
+
+    block->prev_free = RT_NULL;
+    block->next_free = tlsf->blocks[fl][sl];
+    if (block->next_free != RT_NULL)
+    {
+        block->next_free->prev_free = block;
+    }
+    tlsf->blocks[fl][sl] = block;
+
+    tlsf->fl_bitmap |= (rt_uint32_t)1 << fl;
+    tlsf->sl_bitmap[fl] |= (rt_uint32_t)1 << sl;
+}
+
+static void _tlsf_remove_free(struct rt_tlsf *tlsf, struct rt_tlsf_block *block)
+{
+    int fl, sl;
+
+    if (block->next_free != RT_NULL)
+    {
+        block->next_free->prev_free = block->prev_free;
+    }
+
+    if (block->prev_free != RT_NULL)
+    {
+        block->prev_free->next_free = block->next_free;
+        return;
+    }
+
+    /* it's the head of the list */
+    _tlsf_mapping_insert(TLSF_BLOCK_SIZE(block), &fl, &sl);
+    tlsf->blocks[fl][sl] = block->next_free;
+    if (block->next_free == RT_NULL)
+    {
+        tlsf->sl_bitmap[fl] &= ~((rt_uint32_t)1 << sl);
+        if (tlsf->sl_bitmap[fl] == 0)
+        {
+            tlsf->fl_bitmap &= ~((rt_uint32_t)1 << fl);
+        }
+    }
+}
+
+/**
+ * @brief Split the tail of a used block to a free block, the free block is
+ *        merged with the next block if it's free as well.
+ *
+ * @param tlsf is the TLSF object.
+ *
+ * @param block is the used block.
+ *
+ * @param size is the new size of the used block.
+ */
+static void _tlsf_block_trim(struct rt_tlsf *tlsf, struct rt_tlsf_block *block, rt_size_t size)
+{
+    struct rt_tlsf_block *rest, *next;
+    rt_size_t block_size = TLSF_BLOCK_SIZE(block);
+
+    if (block_size - size < TLSF_BLOCK_MIN)
+    {
+        return;
+    }
+
+    rest = (struct rt_tlsf_block *)((rt_uint8_t *)block + size);
+    rest->prev_phys = block;
+    rest->size = (block_size - size) | TLSF_BLOCK_FREE;
+    block->size = size | (block->size & TLSF_BLOCK_FLAGS);
+    tlsf->parent.used -= block_size - size;
+
+    next = TLSF_BLOCK_NEXT(rest);
+    if (next->size & TLSF_BLOCK_FREE)
+    {
+        _tlsf_remove_free(tlsf, next);
+        rest->size += TLSF_BLOCK_SIZE(next);
+        next = TLSF_BLOCK_NEXT(rest);
+    }
+    next->prev_phys = rest;
+    next->size |= TLSF_BLOCK_PREV_FREE;
+
+    _tlsf_insert_free(tlsf, rest);
+}
+
+/**
+ * @brief Get the block size for the request size, 0 if it's 0 or too large.
+ */
+rt_inline rt_size_t _tlsf_adjust_size(struct rt_tlsf *tlsf, rt_size_t size)
+{
+    if (size == 0 || size > tlsf->parent.total)
+    {
+        return 0;
+    }
+
+    size = RT_ALIGN(size, RT_ALIGN_SIZE) + TLSF_BLOCK_HEADER;
+    if (size < TLSF_BLOCK_MIN)
+    {
+        size = TLSF_BLOCK_MIN;
+    }
+
+    return size;
+}
+
+/**
+ * @brief This function will initialize the TLSF memory management algorithm.
+ *
+ * @param name is the name of the TLSF memory management object.
+ *
+ * @param begin_addr the beginning address of memory.
+ *
+ * @param size is the size of the memory.
+ *
+ * @return Return a pointer to the memory object. When the return value is RT_NULL, it means the init failed.
+ */
+rt_tlsf_t rt_tlsf_init(const char *name, void *begin_addr, rt_size_t size)
+{
+    struct rt_tlsf *tlsf;
+    struct rt_tlsf_block *block;
+    rt_ubase_t begin_align, end_align;
+    rt_size_t block_size;
+
+    /* the control structure is placed at the beginning of the memory */
+    tlsf = (struct rt_tlsf *)RT_ALIGN((rt_ubase_t)begin_addr, RT_ALIGN_SIZE);
+    begin_align = RT_ALIGN((rt_ubase_t)tlsf + sizeof(*tlsf), RT_ALIGN_SIZE);
+    end_align   = RT_ALIGN_DOWN((rt_ubase_t)begin_addr + size, RT_ALIGN_SIZE);
+
+    /* one free block and the sentinel block at least */
+    if (end_align <= begin_align ||
+        end_align - begin_align < TLSF_BLOCK_MIN + TLSF_BLOCK_HEADER)
+    {
+        return RT_NULL;
+    }
+
+    block_size = end_align - begin_align - TLSF_BLOCK_HEADER;
+    if (block_size >= ((rt_size_t)1 << TLSF_FL_INDEX_MAX))
+    {
+        /* the rest is not managed */
+        block_size = ((rt_size_t)1 << TLSF_FL_INDEX_MAX) - RT_ALIGN_SIZE;
+    }
+
+    rt_memset(tlsf, 0, sizeof(*tlsf));
+    rt_object_init(&(tlsf->parent.parent), RT_Object_Class_Memory, name);
+    tlsf->parent.algorithm = "tlsf";
+    tlsf->parent.address = begin_align;
+    tlsf->parent.total = block_size;
+
+    /* the whole memory is one free block */
+    block = (struct rt_tlsf_block *)begin_align;
+    block->prev_phys = RT_NULL;
+    block->size = block_size | TLSF_BLOCK_FREE;
+    tlsf->block_start = block;
+
+    /* the sentinel block is always used, so that nothing is merged with it */
+    tlsf->block_end = TLSF_BLOCK_NEXT(block);
+    tlsf->block_end->prev_phys = block;
+    tlsf->block_end->size = TLSF_BLOCK_PREV_FREE;
+#ifdef RT_USING_MEMTRACE
+    _tlsf_setname(block, "    ");
+    _tlsf_setname(tlsf->block_end, "END ");
+#endif /* RT_USING_MEMTRACE */
+
+    _tlsf_insert_free(tlsf, block);
+
+    RT_DEBUG_LOG(RT_DEBUG_MEM, ("tlsf init, begin address 0x%x, size %d\n",
+                                begin_align, block_size));
+
+    return &tlsf->parent;
+}
+RTM_EXPORT(rt_tlsf_init);
+
+/**
+ * @brief This function will remove a TLSF memory object from the system.
+ *
+ * @param m the TLSF memory management object.
+ *
+ * @return RT_EOK
+ */
+rt_err_t rt_tlsf_detach(rt_tlsf_t m)
+{
+    RT_ASSERT(m != RT_NULL);
+    RT_ASSERT(rt_object_get_type(&m->parent) == RT_Object_Class_Memory);
+    RT_ASSERT(rt_object_is_systemobject(&m->parent));
+
+    rt_object_detach(&(m->parent));
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_tlsf_detach);
+
+/**
+ * @addtogroup MM
+ */
+
+/**@{*/
+
+/**
+ * @brief Allocate a block of memory with a minimum of 'size' bytes in
+ *        constant time.
+ *
+ * @param m the TLSF memory management object.
+ *
+ * @param size is the minimum size of the requested block in bytes.
+ *
+ * @return the pointer to allocated memory or NULL if no free memory was found.
+ */
+void *rt_tlsf_alloc(rt_tlsf_t m, rt_size_t size)
+{
+    struct rt_tlsf *tlsf;
+    struct rt_tlsf_block *block;
+    int fl, sl;
+
+    RT_ASSERT(m != RT_NULL);
+    RT_ASSERT(rt_object_get_type(&m->parent) == RT_Object_Class_Memory);
+    RT_ASSERT(rt_object_is_systemobject(&m->parent));
+
+    tlsf = (struct rt_tlsf *)m;
+
+    size = _tlsf_adjust_size(tlsf, size);
+    if (size == 0)
+    {
+        return RT_NULL;
+    }
+
+    _tlsf_mapping_search(size, &fl, &sl);
+    if (fl >= TLSF_FL_INDEX_COUNT)
+    {
+        return RT_NULL;
+    }
+
+    block = _tlsf_search_suitable(tlsf, &fl, &sl);
+    if (block == RT_NULL)
+    {
+        RT_DEBUG_LOG(RT_DEBUG_MEM, ("tlsf: no memory for %d\n", size));
+        return RT_NULL;
+    }
+
+    /* take the whole block, then give the tail back */
+    _tlsf_remove_free(tlsf, block);
+    block->size &= ~TLSF_BLOCK_FREE;
+    TLSF_BLOCK_NEXT(block)->size &= ~TLSF_BLOCK_PREV_FREE;
+    tlsf->parent.used += TLSF_BLOCK_SIZE(block);
+
+    _tlsf_block_trim(tlsf, block, size);
+
+    if (tlsf->parent.used > tlsf->parent.max)
+    {
+        tlsf->parent.max = tlsf->parent.used;
+    }
+
+#ifdef RT_USING_MEMTRACE
+    if (rt_thread_self())
+        _tlsf_setname(block, rt_thread_self()->name);
+    else
+        _tlsf_setname(block, "NONE");
+#endif /* RT_USING_MEMTRACE */
+
+    RT_DEBUG_LOG(RT_DEBUG_MEM, ("tlsf: allocate block 0x%x, size %d\n",
+                                block, TLSF_BLOCK_SIZE(block)));
+
+    return TLSF_BLOCK_MEM(block);
+}
+RTM_EXPORT(rt_tlsf_alloc);
+
+/**
+ * @brief This function will change the size of previously allocated memory block.
+ *
+ * @param m the TLSF memory management object.
+ *
+ * @param ptr is the pointer to memory allocated by rt_tlsf_alloc.
+ *
+ * @param size is the new size of the memory block.
+ *
+ * @return the new pointer, or RT_NULL on failure with the old block untouched.
+ */
+void *rt_tlsf_realloc(rt_tlsf_t m, void *ptr, rt_size_t size)
+{
+    struct rt_tlsf *tlsf;
+    struct rt_tlsf_block *block, *next;
+    rt_size_t block_size, adjust;
+    void *new_ptr;
+
+    if (ptr == RT_NULL)
+    {
+        return rt_tlsf_alloc(m, size);
+    }
+
+    if (size == 0)
+    {
+        rt_tlsf_free(m, ptr);
+        return RT_NULL;
+    }
+
+    RT_ASSERT(m != RT_NULL);
+    RT_ASSERT(rt_object_get_type(&m->parent) == RT_Object_Class_Memory);
+    RT_ASSERT(rt_object_is_systemobject(&m->parent));
+
+    tlsf = (struct rt_tlsf *)m;
+    block = TLSF_MEM_BLOCK(ptr);
+    RT_ASSERT((block->size & TLSF_BLOCK_FREE) == 0);
+
+    adjust = _tlsf_adjust_size(tlsf, size);
+    if (adjust == 0)
+    {
+        return RT_NULL;
+    }
+
+    block_size = TLSF_BLOCK_SIZE(block);
+    next = TLSF_BLOCK_NEXT(block);
+    if (adjust > block_size)
+    {
+        if (!(next->size & TLSF_BLOCK_FREE) ||
+            block_size + TLSF_BLOCK_SIZE(next) < adjust)
+        {
+            /* it can't grow in place */
+            new_ptr = rt_tlsf_alloc(m, size);
+            if (new_ptr != RT_NULL)
+            {
+                rt_memcpy(new_ptr, ptr, block_size - TLSF_BLOCK_HEADER);
+                rt_tlsf_free(m, ptr);
+            }
+
+            return new_ptr;
+        }
+
+        /* absorb the next free block */
+        _tlsf_remove_free(tlsf, next);
+        block->size += TLSF_BLOCK_SIZE(next);
+        tlsf->parent.used += TLSF_BLOCK_SIZE(next);
+        next = TLSF_BLOCK_NEXT(block);
+        next->prev_phys = block;
+        next->size &= ~TLSF_BLOCK_PREV_FREE;
+    }
+
+    _tlsf_block_trim(tlsf, block, adjust);
+
+    if (tlsf->parent.used > tlsf->parent.max)
+    {
+        tlsf->parent.max = tlsf->parent.used;
+    }
+
+    return ptr;
+}
+RTM_EXPORT(rt_tlsf_realloc);
+
+/**
+ * @brief This function will release the previously allocated memory block in
+ *        constant time, the block is merged with the adjacent free blocks.
+ *
+ * @param m the TLSF memory management object.
+ *
+ * @param ptr is the address of memory which will be released.
+ */
+void rt_tlsf_free(rt_tlsf_t m, void *ptr)
+{
+    struct rt_tlsf *tlsf;
+    struct rt_tlsf_block *block, *prev, *next;
+
+    if (ptr == RT_NULL)
+    {
+        return;
+    }
+
+    RT_ASSERT(m != RT_NULL);
+    RT_ASSERT(rt_object_get_type(&m->parent) == RT_Object_Class_Memory);
+    RT_ASSERT(rt_object_is_systemobject(&m->parent));
+
+    tlsf = (struct rt_tlsf *)m;
+    block = TLSF_MEM_BLOCK(ptr);
+    RT_ASSERT((rt_uint8_t *)block >= (rt_uint8_t *)tlsf->block_start);
+    RT_ASSERT((rt_uint8_t *)block < (rt_uint8_t *)tlsf->block_end);
+    /* double free */
+    RT_ASSERT((block->size & TLSF_BLOCK_FREE) == 0);
+
+    RT_DEBUG_LOG(RT_DEBUG_MEM, ("tlsf: release block 0x%x, size %d\n",
+                                block, TLSF_BLOCK_SIZE(block)));
+
+    tlsf->parent.used -= TLSF_BLOCK_SIZE(block);
+    block->size |= TLSF_BLOCK_FREE;
+#ifdef RT_USING_MEMTRACE
+    _tlsf_setname(block, "    ");
+#endif /* RT_USING_MEMTRACE */
+
+    /* merge with the previous free block */
+    if (block->size & TLSF_BLOCK_PREV_FREE)
+    {
+        prev = block->prev_phys;
+        _tlsf_remove_free(tlsf, prev);
+        prev->size += TLSF_BLOCK_SIZE(block);
+        block = prev;
+    }
+
+    /* merge with the next free block */
+    next = TLSF_BLOCK_NEXT(block);
+    if (next->size & TLSF_BLOCK_FREE)
+    {
+        _tlsf_remove_free(tlsf, next);
+        block->size += TLSF_BLOCK_SIZE(next);
+        next = TLSF_BLOCK_NEXT(block);
+    }
+    next->prev_phys = block;
+    next->size |= TLSF_BLOCK_PREV_FREE;
+
+    _tlsf_insert_free(tlsf, block);
+}
+RTM_EXPORT(rt_tlsf_free);
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+
+/**
+ * @brief Walk all physical blocks of the TLSF object.
+ *
+ * @return the first broken block, or RT_NULL if the blocks are all right.
+ */
+static struct rt_tlsf_block *_tlsf_check(struct rt_tlsf *tlsf)
+{
+    struct rt_tlsf_block *block, *next;
+    rt_size_t size;
+
+    for (block = tlsf->block_start; block != tlsf->block_end; block = next)
+    {
+        size = TLSF_BLOCK_SIZE(block);
+        if (size < TLSF_BLOCK_MIN ||
+            size > (rt_size_t)((rt_uint8_t *)tlsf->block_end - (rt_uint8_t *)block))
+        {
+            return block;
+        }
+
+        next = TLSF_BLOCK_NEXT(block);
+        if (next->prev_phys != block)
+        {
+            return block;
+        }
+
+        /* the flag of the next block shall match, and no free neighbours */
+        if (!(block->size & TLSF_BLOCK_FREE) != !(next->size & TLSF_BLOCK_PREV_FREE))
+        {
+            return block;
+        }
+        if ((block->size & TLSF_BLOCK_FREE) && (next->size & TLSF_BLOCK_FREE))
+        {
+            return block;
+        }
+    }
+
+    return RT_NULL;
+}
+
+static struct rt_tlsf *_tlsf_object(struct rt_object *object)
+{
+    struct rt_memory *m = (struct rt_memory *)object;
+
+    if (m->algorithm == RT_NULL || rt_strcmp(m->algorithm, "tlsf") != 0)
+    {
+        return RT_NULL;
+    }
+
+    return (struct rt_tlsf *)m;
+}
+
+int tlsfcheck(int argc, char *argv[])
+{
+    rt_base_t level;
+    struct rt_tlsf *tlsf;
+    struct rt_tlsf_block *block;
+    struct rt_object_information *information;
+    struct rt_list_node *node;
+    struct rt_object *object;
+    char *name;
+
+    name = argc > 1 ? argv[1] : RT_NULL;
+    level = rt_hw_interrupt_disable();
+    information = rt_object_get_information(RT_Object_Class_Memory);
+    for (node = information->object_list.next;
+         node != &(information->object_list);
+         node  = node->next)
+    {
+        object = rt_list_entry(node, struct rt_object, list);
+        if (name != RT_NULL && rt_strncmp(name, object->name, RT_NAME_MAX) != 0)
+            continue;
+
+        tlsf = _tlsf_object(object);
+        if (tlsf == RT_NULL)
+            continue;
+
+        block = _tlsf_check(tlsf);
+        if (block != RT_NULL)
+        {
+            rt_hw_interrupt_enable(level);
+
+            rt_kprintf("Memory block wrong:\n");
+            rt_kprintf("   name: %s\n", object->name);
+            rt_kprintf("address: 0x%08x\n", block);
+            rt_kprintf("   prev: 0x%08x\n", block->prev_phys);
+            rt_kprintf("   size: 0x%08x\n", block->size);
+
+            return 0;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    return 0;
+}
+MSH_CMD_EXPORT(tlsfcheck, check memory for tlsf);
+
+int tlsftrace(int argc, char **argv)
+{
+    struct rt_tlsf *tlsf;
+    struct rt_tlsf_block *block;
+    struct rt_object_information *information;
+    struct rt_list_node *node;
+    struct rt_object *object;
+    rt_size_t size;
+    char *name;
+
+    name = argc > 1 ? argv[1] : RT_NULL;
+    information = rt_object_get_information(RT_Object_Class_Memory);
+    for (node = information->object_list.next;
+         node != &(information->object_list);
+         node  = node->next)
+    {
+        object = rt_list_entry(node, struct rt_object, list);
+        if (name != RT_NULL && rt_strncmp(name, object->name, RT_NAME_MAX) != 0)
+            continue;
+
+        tlsf = _tlsf_object(object);
+        if (tlsf == RT_NULL)
+            continue;
+
+        rt_kprintf("\nmemory heap address:\n");
+        rt_kprintf("name    : %s\n", object->name);
+        rt_kprintf("total   : %d\n", tlsf->parent.total);
+        rt_kprintf("used    : %d\n", tlsf->parent.used);
+        rt_kprintf("max_used: %d\n", tlsf->parent.max);
+        rt_kprintf("begin   : 0x%08x\n", tlsf->block_start);
+        rt_kprintf("end     : 0x%08x\n", tlsf->block_end);
+        rt_kprintf("\n--memory item information --\n");
+        for (block = tlsf->block_start; block != tlsf->block_end; block = TLSF_BLOCK_NEXT(block))
+        {
+            size = TLSF_BLOCK_SIZE(block) - TLSF_BLOCK_HEADER;
+
+            rt_kprintf("[0x%08x - ", block);
+            if (size < 1024)
+                rt_kprintf("%5d", size);
+            else if (size < 1024 * 1024)
+                rt_kprintf("%4dK", size / 1024);
+            else
+                rt_kprintf("%4dM", size / (1024 * 1024));
+
+#ifdef RT_USING_MEMTRACE
+            rt_kprintf("] %c%c%c%c", block->thread[0], block->thread[1], block->thread[2], block->thread[3]);
+#else
+            rt_kprintf("]");
+#endif /* RT_USING_MEMTRACE */
+            rt_kprintf("%s\n", (block->size & TLSF_BLOCK_FREE) ? " free" : "");
+        }
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(tlsftrace, dump memory trace for tlsf);
+
+#if defined(RT_USING_MEMTRACE) && !defined(RT_USING_SMALL_MEM)
+/* mem.c isn't built, the memory commands check and dump the tlsf objects */
+int memcheck(int argc, char *argv[])
+{
+    return tlsfcheck(argc, argv);
+}
+MSH_CMD_EXPORT(memcheck, check memory data);
+
+int memtrace(int argc, char **argv)
+{
+    return tlsftrace(argc, argv);
+}
+MSH_CMD_EXPORT(memtrace, dump memory trace information);
+#endif /* defined(RT_USING_MEMTRACE) && !defined(RT_USING_SMALL_MEM) */
+#endif /* RT_USING_FINSH */
+
+/**@}*/
+
+#endif /* defined (RT_USING_TLSF) */
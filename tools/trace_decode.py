@@ -0,0 +1,263 @@
+#
+# Copyright (c) 2006-2022, RT-Thread Development Team
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Change Logs:
+# Date           Author       Notes
+# 2022-02-24     RT-Thread    the first version
+#
+
+"""
+Decode the dump of kernel trace (RT_USING_TRACE).
+
+The input is the file written by "trace dump <file>", or the console log of
+"trace dump" which has the "#T:" hex lines. The output is the Chrome trace
+(open it in chrome://tracing or https://ui.perfetto.dev), the text listing of
+records, or the summary of the latencies.
+
+    python trace_decode.py trace.bin -o trace.json
+    python trace_decode.py console.log --format text
+    python trace_decode.py console.log --format summary
+"""
+
+import sys
+import json
+import struct
+import argparse
+
+TRACE_MAGIC = b'RTTRACE'
+
+# the events of rtdef.h
+EVENT_SWITCH = 0x01
+EVENT_IRQ_ENTER = 0x02
+EVENT_IRQ_LEAVE = 0x03
+EVENT_WAKEUP = 0x04
+EVENT_IPC_TAKE = 0x05
+EVENT_IPC_TAKEN = 0x06
+EVENT_IPC_RELEASE = 0x07
+EVENT_TIMER_ENTER = 0x08
+EVENT_TIMER_EXIT = 0x09
+EVENT_USER = 0x80
+
+EVENT_NAMES = {
+    EVENT_SWITCH: 'switch',
+    EVENT_IRQ_ENTER: 'irq_enter',
+    EVENT_IRQ_LEAVE: 'irq_leave',
+    EVENT_WAKEUP: 'wakeup',
+    EVENT_IPC_TAKE: 'take',
+    EVENT_IPC_TAKEN: 'taken',
+    EVENT_IPC_RELEASE: 'release',
+    EVENT_TIMER_ENTER: 'timer_enter',
+    EVENT_TIMER_EXIT: 'timer_exit',
+}
+
+# the object classes of rtdef.h
+CLASS_NAMES = {
+    0x01: 'thread',
+    0x02: 'sem',
+    0x03: 'mutex',
+    0x0a: 'timer',
+}
+
+# the tracks of a cpu in the Chrome trace
+TRACK_THREAD = 0
+TRACK_IRQ = 1
+TRACK_TIMER = 2
+
+
+class Record(object):
+    def __init__(self, stamp, event, cpu, arg0, arg1):
+        self.stamp = stamp
+        self.event = event
+        self.cpu = cpu
+        self.arg0 = arg0
+        self.arg1 = arg1
+        self.time = 0.0
+
+
+class Trace(object):
+    def __init__(self, data):
+        self.names = {}
+        self.records = []
+        self._parse(data)
+
+    def _parse(self, data):
+        if data[:len(TRACE_MAGIC)] != TRACE_MAGIC:
+            raise ValueError('not a trace dump')
+
+        # the byte order of target, the version is 1
+        endian = '<' if struct.unpack('<H', data[8:10])[0] == 1 else '>'
+        (magic, version, record_size, name_max, cpus, clock_hz, names) = \
+            struct.unpack(endian + '8sHHHHII', data[:24])
+        self.cpus = cpus
+        self.clock_hz = clock_hz
+        offset = 24
+
+        for _ in range(names):
+            obj_id, obj_type = struct.unpack(endian + 'IB', data[offset:offset + 5])
+            name = data[offset + 8:offset + 8 + name_max].split(b'\0')[0]
+            self.names[obj_id] = (obj_type, name.decode('utf-8', 'replace'))
+            offset += 8 + name_max
+
+        for _ in range(cpus):
+            cpu, count = struct.unpack(endian + 'II', data[offset:offset + 8])
+            offset += 8
+            for _ in range(count):
+                (stamp_lo, stamp_hi, event, rcpu, arg0, arg1) = \
+                    struct.unpack(endian + 'IHBBII', data[offset:offset + 16])
+                self.records.append(Record(stamp_hi << 32 | stamp_lo, event, rcpu, arg0, arg1))
+                offset += record_size
+
+        # the time stamps are of the same clock on all cpus
+        self.records.sort(key=lambda r: r.stamp)
+        if self.records:
+            start = self.records[0].stamp
+            for r in self.records:
+                r.time = (r.stamp - start) * 1000000.0 / self.clock_hz
+
+    def name(self, obj_id):
+        if obj_id in self.names:
+            return self.names[obj_id][1]
+        return '0x%08x' % obj_id
+
+    def describe(self, r):
+        if r.event == EVENT_SWITCH:
+            return '%s -> %s' % (self.name(r.arg0), self.name(r.arg1))
+        if r.event in (EVENT_IRQ_ENTER, EVENT_IRQ_LEAVE):
+            return 'nest %d' % r.arg0
+        if r.event == EVENT_WAKEUP:
+            return self.name(r.arg0)
+        if r.event in (EVENT_IPC_TAKE, EVENT_IPC_TAKEN, EVENT_IPC_RELEASE):
+            return '%s %s' % (CLASS_NAMES.get(r.arg1, 'ipc'), self.name(r.arg0))
+        if r.event in (EVENT_TIMER_ENTER, EVENT_TIMER_EXIT):
+            return self.name(r.arg0)
+        return '0x%08x 0x%08x' % (r.arg0, r.arg1)
+
+
+def read_input(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:len(TRACE_MAGIC)] == TRACE_MAGIC:
+        return data
+
+    # the console log, the hex after "#T:" of each line
+    hex_text = []
+    for line in data.decode('utf-8', 'replace').splitlines():
+        pos = line.find('#T:')
+        if pos >= 0:
+            fields = line[pos + 3:].split()
+            if fields:
+                hex_text.append(fields[0])
+    return bytes(bytearray.fromhex(''.join(hex_text)))
+
+
+def export_chrome(trace, out):
+    events = []
+    running = {}
+    irq_stack = {}
+    timer_stack = {}
+
+    def complete(name, cpu, track, begin, end, args=None):
+        event = {'name': name, 'ph': 'X', 'pid': cpu, 'tid': track,
+                 'ts': begin, 'dur': max(end - begin, 0)}
+        if args:
+            event['args'] = args
+        events.append(event)
+
+    def instant(name, cpu, time, args):
+        events.append({'name': name, 'ph': 'i', 's': 't', 'pid': cpu, 'tid': TRACK_THREAD,
+                       'ts': time, 'args': args})
+
+    for cpu in range(trace.cpus):
+        events.append({'name': 'process_name', 'ph': 'M', 'pid': cpu, 'args': {'name': 'cpu%d' % cpu}})
+        for track, name in ((TRACK_THREAD, 'thread'), (TRACK_IRQ, 'irq'), (TRACK_TIMER, 'timer')):
+            events.append({'name': 'thread_name', 'ph': 'M', 'pid': cpu, 'tid': track, 'args': {'name': name}})
+
+    for r in trace.records:
+        if r.event == EVENT_SWITCH:
+            if r.cpu in running:
+                thread, begin = running[r.cpu]
+                complete(trace.name(thread), r.cpu, TRACK_THREAD, begin, r.time)
+            running[r.cpu] = (r.arg1, r.time)
+        elif r.event == EVENT_IRQ_ENTER:
+            irq_stack.setdefault(r.cpu, []).append(r.time)
+        elif r.event == EVENT_IRQ_LEAVE:
+            if irq_stack.get(r.cpu):
+                complete('irq', r.cpu, TRACK_IRQ, irq_stack[r.cpu].pop(), r.time, {'nest': r.arg0})
+        elif r.event == EVENT_TIMER_ENTER:
+            timer_stack.setdefault(r.cpu, []).append((r.arg0, r.time))
+        elif r.event == EVENT_TIMER_EXIT:
+            if timer_stack.get(r.cpu):
+                timer, begin = timer_stack[r.cpu].pop()
+                complete(trace.name(timer), r.cpu, TRACK_TIMER, begin, r.time)
+        else:
+            instant('%s %s' % (EVENT_NAMES.get(r.event, 'user%d' % r.event), trace.describe(r)),
+                    r.cpu, r.time, {'arg0': '0x%08x' % r.arg0, 'arg1': '0x%08x' % r.arg1})
+
+    # the threads still running at the end
+    if trace.records:
+        end = trace.records[-1].time
+        for cpu, (thread, begin) in running.items():
+            complete(trace.name(thread), cpu, TRACK_THREAD, begin, end)
+
+    json.dump({'traceEvents': events, 'displayTimeUnit': 'ns'}, out)
+
+
+def export_text(trace, out):
+    for r in trace.records:
+        out.write('%14.3f us  cpu%d  %-12s %s\n' %
+                  (r.time, r.cpu, EVENT_NAMES.get(r.event, 'user%d' % r.event), trace.describe(r)))
+
+
+def export_summary(trace, out):
+    irq_max = {}
+    irq_stack = {}
+    wakeup = {}
+    latency = {}
+
+    for r in trace.records:
+        if r.event == EVENT_IRQ_ENTER:
+            irq_stack.setdefault(r.cpu, []).append(r.time)
+        elif r.event == EVENT_IRQ_LEAVE and irq_stack.get(r.cpu):
+            duration = r.time - irq_stack[r.cpu].pop()
+            irq_max[r.cpu] = max(irq_max.get(r.cpu, 0), duration)
+        elif r.event == EVENT_WAKEUP:
+            wakeup.setdefault(r.arg0, r.time)
+        elif r.event == EVENT_SWITCH and r.arg1 in wakeup:
+            delay = r.time - wakeup.pop(r.arg1)
+            count, total, worst = latency.get(r.arg1, (0, 0.0, 0.0))
+            latency[r.arg1] = (count + 1, total + delay, max(worst, delay))
+
+    out.write('%d records of %d cpus, clock %d Hz\n' % (len(trace.records), trace.cpus, trace.clock_hz))
+    for cpu in sorted(irq_max):
+        out.write('cpu%d: longest interrupt %.3f us\n' % (cpu, irq_max[cpu]))
+    out.write('%-16s %8s %12s %12s\n' % ('thread', 'wakeups', 'avg(us)', 'max(us)'))
+    for thread, (count, total, worst) in sorted(latency.items(), key=lambda i: -i[1][2]):
+        out.write('%-16s %8d %12.3f %12.3f\n' % (trace.name(thread), count, total / count, worst))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode the dump of RT-Thread kernel trace')
+    parser.add_argument('input', help='the binary dump or the console log')
+    parser.add_argument('-o', '--output', help='the output file, default to stdout')
+    parser.add_argument('-f', '--format', choices=['chrome', 'text', 'summary'], default='chrome',
+                        help='the output format, default to chrome')
+    args = parser.parse_args()
+
+    trace = Trace(read_input(args.input))
+    out = open(args.output, 'w') if args.output else sys.stdout
+    try:
+        if args.format == 'chrome':
+            export_chrome(trace, out)
+        elif args.format == 'text':
+            export_text(trace, out)
+        else:
+            export_summary(trace, out)
+    finally:
+        if out is not sys.stdout:
+            out.close()
+
+
+if __name__ == '__main__':
+    main()